@@ -0,0 +1,94 @@
+// Compares the cost of calling native functions written against the two native function ABIs:
+// - `NativeFn`, which reads its arguments through `util::Args` and reports errors by throwing.
+// - `FastNativeFn`, which reports errors through its return status, has it's arity checked by the
+//   VM and, unless it re-enters the VM, is called without pushing a call frame.
+// - A `FastNativeFn` generated by `vy::bind` from a plain C++ function.
+//
+// Build with `-DBUILD_BENCHMARKS=ON` and run the `native-abi-bench` executable.
+
+#include <chrono>
+#include <cstdio>
+#include <util/args.hpp>
+#include <util/lib_util.hpp>
+#include <util/native_module.hpp>
+#include <vm.hpp>
+
+using namespace vy;
+
+static Value add(VM& vm, int argc) {
+	util::Args args(vm, "add", 2, argc);
+	const number a = args.next_number();
+	const number b = args.next_number();
+	return VYSE_NUM(a + b);
+}
+
+static NativeStatus fast_add(VM& vm, Value* args, int, Value& result) {
+	if (!VYSE_IS_NUM(args[0]) or !VYSE_IS_NUM(args[1])) {
+		util::cfn_error(vm, "fast_add", "Expected numbers.");
+		return NativeStatus::Error;
+	}
+
+	result = VYSE_NUM(VYSE_AS_NUM(args[0]) + VYSE_AS_NUM(args[1]));
+	return NativeStatus::Ok;
+}
+
+// The loop adding the numbers without calling a function is the baseline that the cost of calls is
+// measured against.
+static number plain_add(number a, number b) {
+	return a + b;
+}
+
+static constexpr const char* BenchmarkCode = R"(
+	const add = native.add
+	const fast_add_framed = native.fast_add_framed
+	const fast_add = native.fast_add
+	const bound_add = native.bound_add
+	let sum = 0
+	for i = 0, 10000000 {
+		sum = %s
+	}
+	assert(sum == 49999995000000)
+)";
+
+static double run(const char* expr) {
+	VM vm;
+	vm.load_stdlib();
+
+	Table& native = vm.make<Table>();
+	vm.set_global("native", VYSE_OBJECT(&native));
+	{
+		util::NativeModule module(&vm, &native);
+		module.add_cfunc("add", add);
+		module.add_cfunc("fast_add_framed", fast_add, 2);
+		module.add_cfunc("fast_add", fast_add, 2, false);
+		module.add_cfunc("bound_add", bind<&plain_add>());
+	}
+
+	char code[512];
+	std::snprintf(code, sizeof(code), BenchmarkCode, expr);
+
+	const auto start = std::chrono::steady_clock::now();
+	const ExitCode ec = vm.runcode(code);
+	const auto end = std::chrono::steady_clock::now();
+
+	if (ec != ExitCode::Success) {
+		std::fprintf(stderr, "Benchmark '%s' failed.\n", expr);
+		return 0.0;
+	}
+	return std::chrono::duration<double>(end - start).count();
+}
+
+int main() {
+	static constexpr int NumRuns = 5;
+	for (const char* expr :
+		 {"sum + i", "add(sum, i)", "fast_add_framed(sum, i)", "fast_add(sum, i)",
+		  "bound_add(sum, i)"}) {
+		double best = 0.0;
+		for (int i = 0; i < NumRuns; ++i) {
+			const double elapsed = run(expr);
+			if (i == 0 or elapsed < best) best = elapsed;
+		}
+		std::printf("%-24s %.3fs (best of %d)\n", expr, best, NumRuns);
+	}
+	return 0;
+}
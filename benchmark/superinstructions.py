@@ -0,0 +1,108 @@
+r"""
+Generates include/x_superinstr.hpp, the list of superinstructions the VM and compiler use, from a
+profile of the instruction sequences that run the most in a set of workloads.
+
+A profile is collected by a build of vyse with opcode profiling enabled:
+
+	cmake .. -DCMAKE_BUILD_TYPE=Release -DPROFILE_OPCODES=true
+	VYSE_OPCODE_PROFILE=profile.txt ./vy script.vy
+
+Every run appends its counts to the profile file. To profile a set of scripts and regenerate the
+header in one go, pass the profiling build of `vy` and the scripts to this script:
+
+	python3 superinstructions.py --vy ../build-profile/vy vyse/*.vy
+
+Or generate the header from profile files that were collected earlier:
+
+	python3 superinstructions.py --profile profile.txt
+
+The default set that ships with vyse is trained on the benchmarks in `benchmark/vyse`. Workloads
+that spend their time in different instruction sequences will benefit from regenerating it.
+The compiler and VM pick up the new header once vyse is rebuilt.
+"""
+import argparse
+import os
+import subprocess
+import sys
+import tempfile
+from collections import Counter
+
+HEADER_PATH = os.path.join(os.path.dirname(__file__), '..', 'include', 'x_superinstr.hpp')
+
+
+def read_profile(path, counts):
+	"""Adds the counts in the profile file at [path] to [counts]."""
+	with open(path) as file:
+		for line in file:
+			fields = line.split()
+			if len(fields) < 3:
+				continue
+			counts[tuple(fields[1:])] += int(fields[0])
+
+
+def run_workloads(vy, scripts, counts):
+	"""Runs every script with the profiling build [vy], and adds their profiles to [counts]."""
+	with tempfile.TemporaryDirectory() as tmp:
+		profile = os.path.join(tmp, 'profile.txt')
+		env = dict(os.environ, VYSE_OPCODE_PROFILE=profile)
+		for script in scripts:
+			print(f'Profiling {script}')
+			subprocess.run([vy, script], env=env, stdout=subprocess.DEVNULL, check=True)
+		if not os.path.exists(profile):
+			sys.exit(f'{vy} did not write a profile, was it built with -DPROFILE_OPCODES=true?')
+		read_profile(profile, counts)
+
+
+def pick(counts, count):
+	"""Picks the [count] sequences that save the most dispatches. A sequence of n instructions
+	saves n - 1 dispatches every time it runs."""
+	scored = sorted(counts.items(), key=lambda item: (-item[1] * (len(item[0]) - 1), item[0]))
+	chosen = [ops for ops, _ in scored[:count]]
+	# When sequences of different lengths match at the same place, the longer one wins.
+	return sorted(chosen, key=lambda ops: -len(ops))
+
+
+def write_header(path, sequences, sources):
+	lines = [
+		'// Generated by benchmark/superinstructions.py. Do not edit by hand, instead regenerate it with a',
+		'// profile of the workloads that matter to you (see the script for how).',
+		f'// Trained on: {", ".join(sources)}',
+		'',
+		'// SUPER2(name, a, b), SUPER3(name, a, b, c), in the order they are tried when several match.',
+	]
+	for ops in sequences:
+		name = '__'.join(ops)
+		lines.append(f'SUPER{len(ops)}({name}, {", ".join(ops)})')
+
+	with open(path, 'w') as file:
+		file.write('\n'.join(lines) + '\n')
+
+
+def main():
+	parser = argparse.ArgumentParser(description='Generate the superinstructions of the vyse VM.')
+	parser.add_argument('scripts', nargs='*', help='Vyse scripts to profile, requires --vy.')
+	parser.add_argument('--vy', help='A build of vy with -DPROFILE_OPCODES=true.')
+	parser.add_argument('--profile', action='append', default=[], help='A profile file to read.')
+	parser.add_argument('-n', '--count', type=int, default=16, help='Number of superinstructions.')
+	parser.add_argument('-o', '--output', default=HEADER_PATH, help='Header file to write.')
+	args = parser.parse_args()
+
+	if args.scripts and not args.vy:
+		parser.error('profiling scripts requires --vy')
+
+	counts = Counter()
+	for path in args.profile:
+		read_profile(path, counts)
+	if args.scripts:
+		run_workloads(args.vy, args.scripts, counts)
+	if not counts:
+		parser.error('nothing to generate superinstructions from')
+
+	sources = [os.path.basename(path) for path in args.profile + args.scripts]
+	sequences = pick(counts, args.count)
+	write_header(args.output, sequences, sources)
+	print(f'Wrote {len(sequences)} superinstructions to {args.output}')
+
+
+if __name__ == '__main__':
+	main()
@@ -1,3 +1,6 @@
+#include <bytecode.hpp>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
 #include <string>
 #include <vm.hpp>
@@ -56,22 +59,62 @@ static void repl() {
 	}
 }
 
-static void execfile(const char* filepath) {
-	VM vm;
+static void execfile(const char* filepath, const VMConfig& config = VMConfig{}) {
+	VM vm{config};
 	vm.load_stdlib();
 	vm.runfile(filepath);
 }
 
+/// @brief Compiles the script at [filepath] to a bytecode file next to it, or a bytecode image if
+/// [image] is true, which `execfile` runs without compiling it again.
+static void emit_bytecode(const char* filepath, bool image) {
+	auto source = SourceCode::from_path(filepath);
+	if (!source.has_value()) {
+		fprintf(stderr, "Could not read file: %s\n", filepath);
+		return;
+	}
+
+	std::filesystem::path out_path{source->path};
+	out_path.replace_extension(image ? BytecodeImageExtension : BytecodeExtension);
+
+	// The register code is written too, so that the file runs on either tier.
+	VMConfig config;
+	config.tier = Tier::Register;
+	VM vm{config};
+	Closure* const script = vm.compile(std::move(source.value()));
+	if (script == nullptr) return;
+
+	std::ofstream out{out_path, std::ios::binary};
+	out << (image ? dump_image(*script->m_codeblock) : dump_bytecode(*script->m_codeblock));
+	if (!out) fprintf(stderr, "Could not write file: %s\n", out_path.string().c_str());
+}
+
 static void info() {
 	printf("The Vyse Programming Language. v0.0.1 Pre-alpha .\n");
 	printf("Usage: vy <filename>\n");
+	printf("       vy --register <filename>  (run on the register tier)\n");
+	printf("       vy --jit <filename>       (compile hot functions to native code)\n");
+	printf("       vy --jit-perf <filename>  (same as --jit, and write /tmp/perf-<pid>.map)\n");
+	printf("       vy --compile <filename>   (write the bytecode to a .vyc file, which vy runs)\n");
+	printf("       vy --image <filename>     (write a .vyi bytecode image, which vy maps)\n");
 }
 
 int main(int const argc, char** const argv) {
+	VMConfig config;
+	const std::string flag = argc == 3 ? argv[1] : "";
 	if (argc == 1) {
 		repl();
 	} else if (argc == 2) {
 		execfile(argv[1]);
+	} else if (flag == "--register") {
+		config.tier = Tier::Register;
+		execfile(argv[2], config);
+	} else if (flag == "--jit" or flag == "--jit-perf") {
+		config.jit = true;
+		config.jit_perf_map = flag == "--jit-perf";
+		execfile(argv[2], config);
+	} else if (flag == "--compile" or flag == "--image") {
+		emit_bytecode(argv[2], flag == "--image");
 	} else {
 		info();
 	}
@@ -0,0 +1,53 @@
+#include <aot.hpp>
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vm.hpp>
+
+using namespace vy;
+
+static void info() {
+	printf("The Vyse ahead-of-time compiler. v0.0.1 Pre-alpha .\n");
+	printf("Usage: vyc <input.vy> <output.cpp> [module name]\n");
+	printf("The module is loaded with `vy_aot_<module name>()`, and is named after the input file "
+		   "by default.\n");
+}
+
+/// @brief Turns [name] into a C identifier.
+static std::string module_name(std::string name) {
+	for (char& c : name) {
+		if (!std::isalnum(static_cast<unsigned char>(c))) c = '_';
+	}
+	if (name.empty() or std::isdigit(static_cast<unsigned char>(name[0]))) name = "_" + name;
+	return name;
+}
+
+int main(int const argc, char** const argv) {
+	if (argc != 3 and argc != 4) {
+		info();
+		return 1;
+	}
+
+	// The absolute path of the script is kept in the module, so that it can import files relative
+	// to itself wherever it is run from.
+	auto source = SourceCode::from_path(argv[1]);
+	if (!source.has_value()) {
+		std::cerr << "Could not read file: " << argv[1] << std::endl;
+		return 1;
+	}
+
+	const std::string name =
+		module_name(argc == 4 ? argv[3] : std::filesystem::path(source->path).stem().string());
+
+	std::ofstream out(argv[2]);
+	if (!out) {
+		std::cerr << "Could not write file: " << argv[2] << std::endl;
+		return 1;
+	}
+
+	VM vm;
+	if (!compile_to_cpp(vm, std::move(source.value()), name, out)) return 1;
+	return 0;
+}
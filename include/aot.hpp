@@ -0,0 +1,102 @@
+#pragma once
+#include "common.hpp"
+#include "forward.hpp"
+#include "source.hpp"
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+// The ahead-of-time compiler turns a script into a C++ translation unit with one function for
+// every function in the script. Each one runs the stack code of it's function without dispatching
+// on opcodes, through the same runtime functions as the JIT (see jit_runtime.hpp). The generated
+// C++ is compiled into the program, or into a shared library that is loaded with `DynLoader`.
+//
+// A script that is run from it's AOT module is still compiled to bytecode when it is loaded, and
+// the generated functions are attached to the code blocks whose bytecode they were generated from.
+// This way, functions from AOT modules are regular closures that the interpreter can call and be
+// called from, and a function whose bytecode has changed since is simply interpreted.
+
+namespace vy {
+
+struct JitFrame;
+
+/// @brief A function generated by the AOT compiler. It runs the function in [frame] from the
+/// instruction at the offset [entry], and returns a `JitExit`.
+using AotFunction = u32 (*)(JitFrame* frame, u32 entry);
+
+/// @brief A script that was compiled ahead of time. The generated C++ defines one of these, which
+/// it returns from `vy_aot_<name>()`.
+struct AotModule {
+	/// @brief The name of the module, which is a valid C identifier.
+	const char* name;
+	/// @brief The path of the script, for error messages and to find the files that it imports.
+	const char* path;
+	const char* source;
+	/// @brief The generated functions, in the order that `aot_code_blocks` lists the code blocks.
+	const AotFunction* functions;
+	/// @brief The `aot_fingerprint` of the code block that each function was generated from.
+	const u64* fingerprints;
+	u32 num_functions;
+};
+
+/// @brief The signature of the function that returns the `AotModule` in the generated C++.
+using AotModuleFn = const AotModule*();
+
+/// @return [root], and every function nested in it, in the order that AOT modules list them.
+std::vector<CodeBlock*> aot_code_blocks(CodeBlock& root);
+
+/// @brief A hash of the bytecode of [code], which tells if the bytecode that a script compiles to
+/// is still the one that a function in an AOT module was generated from.
+u64 aot_fingerprint(const CodeBlock& code);
+
+/// @brief Attaches the functions of [module] to [root], which must be the script compiled from
+/// `module.source`, and to the functions nested in it.
+/// @return The number of functions that were attached.
+u32 link_aot_module(const AotModule& module, CodeBlock& root);
+
+/// @brief Compiles [source] with [vm] and writes an AOT module named [name] for it to [out].
+/// @return false if the script has a compile error, which is reported through [vm].
+bool compile_to_cpp(VM& vm, SourceCode source, const std::string& name, std::ostream& out);
+
+} // namespace vy
+
+// -- Used by the generated C++ --
+
+/// Calls the runtime function [helper] for an instruction, and returns from the generated function
+/// if it reports an error.
+#define VYSE_AOT_CALL(helper, depth, ip, a, b, c)                                                  \
+	do {                                                                                           \
+		status = vy::JitRuntime::helper(f, base + (depth), ip, a, b, c);                           \
+		if (status == vy::JitRuntime::Failed) return vy::u32(vy::JitExit::Error);                  \
+		base = f->base;                                                                            \
+	} while (false)
+
+/// Does [op] on two integers inline, and calls [helper] for any other operands.
+#define VYSE_AOT_ARITH(op, helper, depth, ip)                                                      \
+	do {                                                                                           \
+		vy::Value& l = base[(depth)-2];                                                            \
+		const vy::Value& r = base[(depth)-1];                                                      \
+		if (VYSE_IS_INT(l) and VYSE_IS_INT(r)) {                                                   \
+			l = vy::int_or_num(vy::s64(VYSE_AS_INT(l)) op vy::s64(VYSE_AS_INT(r)));                \
+		} else {                                                                                   \
+			VYSE_AOT_CALL(helper, depth, ip, 0, 0, 0);                                             \
+		}                                                                                          \
+	} while (false)
+
+#define VYSE_AOT_CMP(op, helper, depth, ip)                                                        \
+	do {                                                                                           \
+		vy::Value& l = base[(depth)-2];                                                            \
+		const vy::Value& r = base[(depth)-1];                                                      \
+		if (VYSE_IS_INT(l) and VYSE_IS_INT(r)) {                                                   \
+			l = VYSE_BOOL(VYSE_AS_INT(l) op VYSE_AS_INT(r));                                       \
+		} else {                                                                                   \
+			VYSE_AOT_CALL(helper, depth, ip, 0, 0, 0);                                             \
+		}                                                                                          \
+	} while (false)
+
+/// The operands of the runtime functions that refer to a block's constants, inline caches,
+/// global variables and instructions.
+#define VYSE_AOT_K(index) reinterpret_cast<vy::u64>(&block.constant_pool[index])
+#define VYSE_AOT_CACHE(index) reinterpret_cast<vy::u64>(&block.inline_caches[index])
+#define VYSE_AOT_GLOBAL(index) reinterpret_cast<vy::u64>(&block.globals[index])
+#define VYSE_AOT_CODE(offset) reinterpret_cast<vy::u64>(&block.code[offset])
@@ -2,22 +2,282 @@
 #include "common.hpp"
 #include "forward.hpp"
 #include "opcode.hpp"
+#include "reg_opcode.hpp"
 
+#include <utility>
 #include <vector>
 
 namespace vy {
 
+/// @brief An inline cache remembers where the constant string key of a `table_get`,
+/// `table_get_no_pop`, `table_set` or `prep_method_call` instruction was found the last time it
+/// ran. `depth` is the number of prototype links that were followed from the receiver to reach the
+/// table holding the key, and `slot` is the index of the key's entry (or slot, for shaped tables)
+/// in that table. `shape` is the shape the receiver had at the time, if it had one.
+/// Caches are never explicitly invalidated. Instead every hit re-validates the recorded entry
+/// (see `Table::get_cached`), so mutating a table, removing keys or calling `setproto` simply
+/// turns the next lookup into a miss, which refills the cache.
+struct InlineCache {
+	/// Depth of a cache that has never seen a successful lookup.
+	static constexpr u8 Empty = UINT8_MAX;
+
+	const Shape* shape = nullptr;
+	u32 slot = 0;
+	u8 depth = Empty;
+
+	/// Number of times the cache could answer a lookup on its own, and the number of
+	/// times the full table lookup had to be done instead. These are meant for tuning.
+	u32 hits = 0;
+	u32 misses = 0;
+};
+
+/// @brief The hits and misses of all inline caches in a block.
+struct InlineCacheStats {
+	size_t hits = 0;
+	size_t misses = 0;
+};
+
+/// @brief The operand types that an instruction has been seen running with. The interpreter
+/// collects these for the instructions that it can quicken, and uses them to decide when to rewrite
+/// such an instruction into a version specialized for those types.
+struct TypeFeedback {
+	/// Bits of `seen`, one for each kind of operand.
+	enum : u8 {
+		Int = 1 << 0,
+		Double = 1 << 1,
+		String = 1 << 2,
+		Table = 1 << 3,
+		List = 1 << 4,
+		Other = 1 << 5,
+	};
+
+	/// All the kinds of operands that the instruction has been seen with.
+	u8 seen = 0;
+	/// The kinds of operands seen on the last run, and the number of runs in a row that
+	/// have seen the very same kinds.
+	u8 last = 0;
+	u8 streak = 0;
+	/// Number of times the instruction was quickened, and the number of times a quickened
+	/// instruction met operands it couldn't handle and was turned back into the generic one.
+	u8 quickens = 0;
+	u8 dequickens = 0;
+};
+
+/// @brief A global variable that a block accesses. `slot` is the index of the variable in the
+/// VM's global slot array (see `VM::global_slot`), and `name` is kept for error messages and
+/// disassembly.
+struct GlobalRef {
+	String* name;
+	u32 slot;
+};
+
+/// @brief The storage of a block's instructions or line numbers. This is a vector of it's own for
+/// the blocks that the compiler makes. Blocks loaded from a bytecode image refer to the image's
+/// memory instead (see `BytecodeImage`), which they don't own. Changing the size of such a buffer
+/// first copies the contents into a vector, while writing to an element changes the image in place.
+template <typename T>
+class BlockBuffer {
+  public:
+	BlockBuffer() = default;
+
+	BlockBuffer(const BlockBuffer& other) : m_owned(other.begin(), other.end()) {
+		sync();
+	}
+
+	BlockBuffer(BlockBuffer&& other) noexcept {
+		*this = std::move(other);
+	}
+
+	BlockBuffer& operator=(const BlockBuffer& other) {
+		if (this != &other) {
+			m_owned.assign(other.begin(), other.end());
+			sync();
+		}
+		return *this;
+	}
+
+	BlockBuffer& operator=(BlockBuffer&& other) noexcept {
+		m_owned = std::move(other.m_owned);
+		m_external = other.m_external;
+		if (m_external) {
+			m_data = other.m_data;
+			m_size = other.m_size;
+		} else {
+			sync();
+		}
+
+		other.m_owned.clear();
+		other.m_external = false;
+		other.sync();
+		return *this;
+	}
+
+	/// @brief Makes the buffer refer to the [size] elements at [data], which must outlive it.
+	void refer(T* data, size_t size) noexcept {
+		m_owned = {};
+		m_data = data;
+		m_size = size;
+		m_external = true;
+	}
+
+	/// @return Whether the elements are stored outside of the buffer.
+	[[nodiscard]] bool is_external() const noexcept {
+		return m_external;
+	}
+
+	[[nodiscard]] T* data() noexcept {
+		return m_data;
+	}
+
+	[[nodiscard]] const T* data() const noexcept {
+		return m_data;
+	}
+
+	[[nodiscard]] size_t size() const noexcept {
+		return m_size;
+	}
+
+	[[nodiscard]] bool empty() const noexcept {
+		return m_size == 0;
+	}
+
+	T& operator[](size_t index) noexcept {
+		return m_data[index];
+	}
+
+	const T& operator[](size_t index) const noexcept {
+		return m_data[index];
+	}
+
+	T* begin() noexcept {
+		return m_data;
+	}
+
+	T* end() noexcept {
+		return m_data + m_size;
+	}
+
+	const T* begin() const noexcept {
+		return m_data;
+	}
+
+	const T* end() const noexcept {
+		return m_data + m_size;
+	}
+
+	void push_back(T value) {
+		owned().push_back(value);
+		sync();
+	}
+
+	template <typename... Args>
+	void emplace_back(Args&&... args) {
+		owned().emplace_back(std::forward<Args>(args)...);
+		sync();
+	}
+
+	void resize(size_t size) {
+		owned().resize(size);
+		sync();
+	}
+
+	void erase(const T* first, const T* last) {
+		const size_t from = first - m_data;
+		const size_t to = last - m_data;
+		std::vector<T>& elements = owned();
+		elements.erase(elements.begin() + from, elements.begin() + to);
+		sync();
+	}
+
+  private:
+	std::vector<T> m_owned;
+	/// Either `m_owned.data()`, or the external storage. The interpreter reads instructions through
+	/// this, so there is no need to check which one it is.
+	T* m_data = nullptr;
+	size_t m_size = 0;
+	bool m_external = false;
+
+	std::vector<T>& owned() {
+		if (m_external) {
+			m_owned.assign(m_data, m_data + m_size);
+			m_external = false;
+		}
+		return m_owned;
+	}
+
+	void sync() noexcept {
+		m_data = m_owned.data();
+		m_size = m_owned.size();
+	}
+};
+
 struct Block {
-	std::vector<Opcode> code;
+	/// Instructions can be rewritten while the block runs, see `Block::quicken`.
+	mutable BlockBuffer<Opcode> code;
 	std::vector<Value> constant_pool;
-	std::vector<u32> lines;
+	/// The global variables accessed by the block. `get_global` and `set_global` instructions
+	/// refer to a global by its index in this list.
+	std::vector<GlobalRef> globals;
+	BlockBuffer<u32> lines;
+	/// Caches are updated while the (otherwise immutable) block runs.
+	mutable std::vector<InlineCache> inline_caches;
 
 	size_t add_instruction(Opcode i, u32 line);
 	size_t add_num(u8 i, u32 line);
 	size_t add_value(Value value);
+	/// @return The index of the global in [slot] in `globals`, adding it if it isn't there yet.
+	size_t add_global(String* name, u32 slot);
+
+	/// @brief Reserves a new inline cache and returns its index. A block has at most
+	/// `MaxInlineCaches` caches, after which the last one is shared by all remaining sites.
+	/// Sharing a cache is still safe since every hit is validated.
+	u8 add_inline_cache();
+	InlineCacheStats ic_stats() const noexcept;
+
+	static constexpr size_t MaxInlineCaches = UINT8_MAX + 1;
+
+	/// Number of runs in a row with the same operand types after which an instruction is quickened.
+	static constexpr u8 QuickenThreshold = 8;
+	/// An instruction that had to be de-quickened this many times is never quickened again.
+	static constexpr u8 MaxDequickens = 4;
+
+	/// Type feedback for each instruction, indexed by the offset of its opcode. This stays empty
+	/// until the block runs an instruction that collects feedback.
+	mutable std::vector<TypeFeedback> type_feedback;
+
+	/// @return The type feedback collected for the instruction at [offset], or nullptr if the
+	/// instruction has never collected any.
+	const TypeFeedback* feedback_at(size_t offset) const noexcept;
+
+	/// @brief Records that the instruction at [offset] ran with operands of the kinds in [types].
+	/// @return true if the instruction should now be quickened.
+	bool observe(size_t offset, u8 types) const;
+
+	/// @brief Rewrites the instruction at [offset] into [op], a quickened version of it which takes
+	/// the same operands.
+	void quicken(size_t offset, Opcode op) const;
+
+	/// @brief Turns the quickened instruction at [offset] back into the generic [op], after it met
+	/// operands of the kinds in [types].
+	void dequicken(size_t offset, Opcode op, u8 types) const;
 	size_t op_count() const noexcept {
 		return code.size();
 	}
+
+	/// The block's code for the register tier, translated from `code` by the compiler when the VM
+	/// uses that tier (see `VMConfig::tier`). This stays empty for blocks that run on the stack
+	/// tier, which are also the blocks that the translator could not handle.
+	std::vector<RegInstr> reg_code;
+	/// For every instruction in `reg_code`, the offset of the instruction in `code` that it was
+	/// translated from. Line numbers are found through these.
+	std::vector<u32> reg_origins;
+	/// The number of registers that a call frame running `reg_code` uses, including the slot of
+	/// the function itself.
+	u32 reg_frame_size = 0;
+
+	bool has_register_code() const noexcept {
+		return !reg_code.empty();
+	}
 };
 
 } // namespace vy
@@ -0,0 +1,178 @@
+#pragma once
+#include "common.hpp"
+#include "forward.hpp"
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Bytecode files (`.vyc`) hold the code blocks that a script compiles to, so that the VM can load
+// the script without scanning or compiling it again. All integers are stored in little endian.
+//
+//   file     := magic:"\x1bVYC" version:u32 instruction_set:u32
+//               num_strings:u32 string* block
+//   string   := length:u32 byte*
+//   block    := name:string_index num_params:u32 num_upvals:u32 max_stack_size:u32 flags:u8
+//               code_size:u32 opcode* line:u32*
+//               num_constants:u32 constant*
+//               num_globals:u32 name:string_index*
+//               num_inline_caches:u32
+//               reg_frame_size:u32 num_reg_instrs:u32 (op:u8 a:u8 b:u8 c:u8 x:u32 origin:u32)*
+//   constant := kind:u8 (s32 | f64 bits:u64 | string_index | block)?
+//
+// Every string in the file is stored once, in the string table at the start, and referred to by
+// it's index. There is one line for every byte of code, and the upvalue descriptors of a function
+// are in the operands of the `make_func` instruction that creates it's closures. Functions that
+// were translated to register code keep it, and VMs running on the stack tier drop it on load.
+//
+// A file is only loaded by a VM with the same `BytecodeVersion` and the same instruction set that
+// it was written with. Loading checks that the file is well formed, and verifies the code of every
+// function before any of it runs: every operand must refer to a constant, global, inline cache,
+// local or upvalue that exists, every jump must land on an instruction, and the stack must stay
+// within the function's frame and the size it declares. A truncated or corrupted file is an error
+// to load, rather than code that overruns the VM's memory.
+//
+// Bytecode images (`.vyi`) hold the same code blocks, laid out to be mapped into memory and used
+// in place instead of being read. Every block's instructions and line table are run straight from
+// the mapping, so processes that run the same image share the memory it's in. The image is in the
+// byte order of the machine that wrote it, and every section of it is aligned to it's elements.
+//
+//   image    := header (opcode* line* constant* global* reg_instr* reg_origin*)* string_bytes
+//               string* block*
+//   header   := magic:"\x1bVYI" version:u32 instruction_set:u32 byte_order:u32 size:u32
+//               checksum:u32 num_strings:u32 strings_offset:u32 num_blocks:u32 blocks_offset:u32
+//   string   := offset:u32 length:u32
+//   block    := the fields of a block in a bytecode file, with the offsets of it's sections
+//   constant := kind:u32 index:u32 bits:u64
+//
+// The checksum is the FNV-1a hash of every byte after the header. An image whose bytes don't match
+// it is not opened, so a file that was damaged on disk is an error rather than code that runs with
+// different constants than it was compiled with.
+//
+// Blocks refer to the functions nested in them by their index in the block table, which is always
+// greater than their own. The script's block is the first one. Only the script's constants are
+// loaded along with it, and a nested function's constants (and the strings among them) are loaded
+// the first time that a closure of it is made. Opening an image checks every section and verifies
+// the code of every block the same way that loading a bytecode file does, so the functions that
+// are loaded later never see a malformed block. The image is mapped privately, so the
+// instructions that are quickened while running are copied into the process's own memory, and
+// the file never changes.
+
+namespace vy {
+
+/// @brief The first bytes of every bytecode file.
+constexpr std::string_view BytecodeMagic{"\x1bVYC", 4};
+
+/// @brief The version of the bytecode format, which changes whenever the format does.
+constexpr u32 BytecodeVersion = 2;
+
+/// @brief The file extension of bytecode files.
+constexpr const char* BytecodeExtension = ".vyc";
+
+/// @brief The first bytes of every bytecode image.
+constexpr std::string_view BytecodeImageMagic{"\x1bVYI", 4};
+
+/// @brief The file extension of bytecode images.
+constexpr const char* BytecodeImageExtension = ".vyi";
+
+/// @return Whether [bytes] are the contents of a bytecode file.
+bool is_bytecode(std::string_view bytes) noexcept;
+
+/// @return The contents of a bytecode file holding [code], and every function nested in it.
+std::string dump_bytecode(const CodeBlock& code);
+
+/// @return Whether [bytes] are the contents of a bytecode image.
+bool is_bytecode_image(std::string_view bytes) noexcept;
+
+/// @return Whether the file at [path] is a bytecode image.
+bool is_bytecode_image_file(const std::string& path);
+
+/// @return The contents of a bytecode image holding [code], and every function nested in it.
+std::string dump_image(const CodeBlock& code);
+
+/// @brief Loads the code blocks in a bytecode file into a VM.
+class BytecodeReader {
+  public:
+	BytecodeReader(VM& vm, std::string_view bytes) noexcept : m_vm{vm}, m_bytes{bytes} {}
+
+	/// @return The code block of the script in the file, or nullptr if the file can't be loaded.
+	/// `error()` then says why.
+	CodeBlock* read();
+
+	[[nodiscard]] const std::string& error() const noexcept {
+		return m_error;
+	}
+
+  private:
+	VM& m_vm;
+	std::string_view m_bytes;
+	size_t m_pos = 0;
+	/// The strings in the file's string table, which are only made into vyse strings when a block
+	/// refers to them.
+	std::vector<std::string_view> m_strings;
+	std::string m_error;
+
+	bool fail(const char* message);
+	bool read_u8(u8& value);
+	bool read_u32(u32& value);
+	bool read_u64(u64& value);
+	bool read_bytes(size_t size, std::string_view& bytes);
+	/// @brief Reads the index of a string in the string table, and makes the string.
+	String* read_string();
+
+	CodeBlock* read_block(u32 depth);
+	bool read_code(CodeBlock& code);
+	bool read_constant(CodeBlock& code, u32 depth);
+	bool read_register_code(Block& block);
+};
+
+/// @brief A bytecode image in memory. Code blocks that are loaded from an image refer to it's
+/// instructions and line tables, and keep it alive.
+class BytecodeImage final : public std::enable_shared_from_this<BytecodeImage> {
+	VYSE_NO_COPY(BytecodeImage);
+	VYSE_NO_MOVE(BytecodeImage);
+
+  public:
+	~BytecodeImage();
+
+	/// @brief Maps the image file at [path] into memory.
+	/// @return The image, or nullptr if it can't be loaded. [error] then says why.
+	static std::shared_ptr<BytecodeImage> open(const std::string& path, std::string& error);
+
+	/// @brief Makes an image from a copy of [bytes].
+	/// @return The image, or nullptr if it can't be loaded. [error] then says why.
+	static std::shared_ptr<BytecodeImage> from_bytes(std::string_view bytes, std::string& error);
+
+	/// @return The code block of the script in the image, loaded into [vm].
+	CodeBlock* load(VM& vm);
+
+	/// @brief Loads the constants, globals and register code of [code], a function from an image
+	/// that is still pending (see `CodeBlock::is_pending`), into [vm].
+	static void load_pending(VM& vm, CodeBlock& code);
+
+	/// @return Whether the image is mapped from a file, rather than copied into memory.
+	[[nodiscard]] bool is_mapped() const noexcept {
+		return m_mapped;
+	}
+
+  private:
+	BytecodeImage(char* bytes, size_t size, bool mapped) noexcept
+		: m_bytes{bytes}, m_size{size}, m_mapped{mapped} {}
+
+	char* m_bytes;
+	size_t m_size;
+	bool m_mapped;
+	/// The memory of images that are not mapped. This is made of `u64`s to align it.
+	std::unique_ptr<u64[]> m_owned;
+
+	/// @return An error message if the image isn't well formed, or nullptr if it is.
+	const char* validate() const;
+	String* make_string(VM& vm, u32 index) const;
+	/// @brief Makes the pending function at [index] in the block table.
+	CodeBlock* make_block(VM& vm, u32 index);
+
+	template <typename T>
+	T read(size_t offset) const noexcept;
+};
+
+} // namespace vy
@@ -5,6 +5,8 @@
 #include "scanner.hpp"
 #include "source.hpp"
 #include <array>
+#include <string_view>
+#include <unordered_set>
 
 namespace vy {
 
@@ -26,8 +28,8 @@ struct LocalVar {
 	/// only.
 	bool is_const = false;
 
-	// `true` if this local variable has been captured by nested closure
-	// as an upvalue. Needed at compile time only.
+	// `true` if this local variable has been captured by reference by a nested closure, as an
+	// upvalue that has to be closed when it goes out of scope. Needed at compile time only.
 	bool is_captured = false;
 
 	explicit LocalVar() noexcept {};
@@ -40,6 +42,8 @@ struct UpvalDesc {
 	int index = -1;
 	bool is_const = false;
 	bool is_local = false;
+	/// The variable is never reassigned, so it's value is copied into the closure.
+	bool by_value = false;
 };
 
 struct SymbolTable {
@@ -60,7 +64,7 @@ struct SymbolTable {
 
 	/// @brief Add an upvalue to the `m_upvals` array, if it exists already
 	/// then don't add a copy, instead return the index.
-	int add_upvalue(int index, bool is_local, bool is_const);
+	int add_upvalue(int index, bool is_local, bool is_const, bool by_value);
 
 	/// @brief Takes the index of a local variable and returns a struct representing it.
 	const LocalVar* find_by_slot(const u8 offset) const;
@@ -116,11 +120,14 @@ class Compiler {
 	/// operands it takes.
 	int op_arity(u32 indx) const noexcept;
 
+	/// Returns the number of operands taken by the instruction at [op_index] in [block].
+	static int op_arity(const Block& block, size_t op_index) noexcept;
+
 	/// Returns [op]'s stack effect. The stack effect of an
 	/// opcode is the number of values it pushes/pops on/off the
 	/// stack. A stack effect of -1 means the opcode pops one item
 	/// off the stack.
-	int op_stack_effect(Opcode op) const noexcept;
+	static int op_stack_effect(Opcode op) noexcept;
 
   private:
 	struct Loop {
@@ -152,6 +159,13 @@ class Compiler {
 	/// the stack effects of emitted instructions.
 	s64 m_stack_size = 0;
 
+	/// Offset of the last `call_func` instruction emitted, or SIZE_MAX if there is none.
+	size_t m_last_call = SIZE_MAX;
+
+	/// Whether the expression being compiled is the value of a `return`. Method calls in it are not
+	/// made into `invoke`s, so the one at the end can still become a tail call.
+	bool m_in_return_expr = false;
+
 	const SourceCode* m_source;
 	bool has_error = false;
 	/// The scanner object that this compiler draws tokens from. This is a pointer
@@ -164,6 +178,10 @@ class Compiler {
 
 	SymbolTable m_symtable;
 
+	/// The names of the variables that are assigned to anywhere in the source, other than in
+	/// their declarations. Only filled in for the top-level compiler, see `find_reassigned_names`.
+	std::unordered_set<std::string_view> m_reassigned_names;
+
 	void advance(); // move 1 step forward in the token stream.
 
 	inline bool eof() const noexcept {
@@ -204,6 +222,7 @@ class Compiler {
 	void continue_stmt();			// CONTINUE
 	void fn_decl();					// fn (ID|SUFFIXED_EXPR) BLOCK
 	void ret_stmt();				// return EXPR?
+	void return_expr();				// EXPR, returned. Calls at the end are tail calls.
 	void expr_stmt();				// FUNCALL | ASSIGN
 	void complete_expr_stmt(ExpKind prefix_type);
 
@@ -237,6 +256,10 @@ class Compiler {
 	/// @brief Compiles the arguments for a call expression. The current token
 	/// must be the opening '(' for the argument
 	void compile_args(bool is_method = false); // EXPR (',' EXPR)*
+
+	/// @brief Compiles the call of the method whose name is the constant at [name_index], on the
+	/// value at the top of the stack. The current token must be the opening '(' of the arguments.
+	void method_call(u8 name_index);
 	void grouping();						   // '('expr')'
 	void primary();							   // LITERAL | ID
 	void variable(bool can_assign);			   // ID
@@ -256,7 +279,7 @@ class Compiler {
 	/// and accounts for any compound assignment operators.
 	/// @param get_op The 'get' opcode to use, in case it's a compound assignment.
 	/// @param idx_or_name_str The index where to load the variable from, if it's a local
-	/// else the index in the constant pool for the global's name.
+	/// else the index of the global in the block's `globals` list.
 	void var_assign(Opcode get_op, u32 idx_or_name_str);
 
 	/// @brief Compiles a table field assignment RHS assuming the very
@@ -271,6 +294,31 @@ class Compiler {
 	///	constant pool as an operand too.
 	void table_assign(Opcode get_op, int idx);
 
+	/// @brief If the condition compiled since [start] compares a local variable with another local
+	/// or a constant, replaces it with the fused compare-and-branch instruction for it. Must be
+	/// called right before emitting the `pop_jmp_if_false` that tests the condition.
+	void fuse_condition(size_t start);
+
+	/// @brief If the right hand side of an assignment to the local in [slot], compiled since
+	/// [start], adds a constant to that same local then it is replaced with an `add_var_const`.
+	/// Must be called right before emitting the `set_var`.
+	void fuse_increment(size_t start, u8 slot);
+
+	/// @brief If the rest parameter of the current function is only ever indexed, or has it's
+	/// length taken, then those uses are rewritten to read the extra arguments off the stack, and
+	/// calls to the function no longer collect them into a list. Runs once the block is done.
+	void keep_varargs_on_stack();
+
+	/// @brief Peephole pass that rewrites the first instruction of every sequence in the current
+	/// block that has a superinstruction (see x_superinstr.hpp) into that superinstruction.
+	/// Runs once the block is done, since it does not change the size of the code.
+	void emit_superinstructions();
+
+	/// @brief Translates the current block, once it is done, into code for the register tier (see
+	/// `RegisterTranslator` in compiler.cpp). Blocks that can't be translated keep running on the
+	/// stack tier.
+	void emit_register_code();
+
 	void enter_block() noexcept;
 
 	/// Emit pop and close instructions for the variables and upvalues
@@ -330,11 +378,24 @@ class Compiler {
 	/// If no upvalue is found, returns -1.
 	int find_upvalue(const Token& name);
 
+	/// @brief Scans the entire source ahead of compiling it, to fill in `m_reassigned_names`.
+	/// Names are matched by their text alone, so a shadowed variable makes every variable with the
+	/// same name count as reassigned. This only ever results in boxing a variable that could've
+	/// been captured by value.
+	void find_reassigned_names();
+
+	/// @brief returns true if the local variable [var] may change after it's declaration, in which
+	/// case closures have to capture it by reference instead of copying it's value.
+	bool may_be_reassigned(const LocalVar& var) const;
+
 	inline void emit(Opcode op);
 	inline void emit(Opcode a, Opcode b);
 	inline void emit(Opcode op, const Token& token);
 	inline void emit_arg(u8 arg);
 	inline void emit_with_arg(Opcode opm, u8 arg);
+	/// @brief Emits a field access instruction [op] that uses the constant [const_idx] as the
+	/// key, followed by the index of a new inline cache for that instruction.
+	inline void emit_cached(Opcode op, u8 const_idx);
 
 	size_t emit_value(Value value);
 
@@ -347,6 +408,10 @@ class Compiler {
 	int src_string_len(const char* srcbuf, int srclen);
 	u32 emit_string(const Token& token);
 	u32 emit_id_string(const Token& token);
+	/// @brief Adds the global variable named by [token] to the current block's `globals`,
+	/// reserving a slot for it in the VM if it doesn't have one yet.
+	/// @return The index of the global in the block's `globals` list.
+	u32 emit_global(const Token& token);
 
 	/// @brief returns the corresponding bytecode
 	/// from a token. e.g- TokenType::Add
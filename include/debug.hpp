@@ -8,4 +8,9 @@ void disassemble_block(const char* name, const Block& block);
 size_t disassemble_instr(const Block& block, Opcode op, size_t offset);
 const char* op2s(Opcode op);
 
+/// @brief Prints the register tier's code of [block], see `Block::reg_code`.
+void disassemble_register_code(const char* name, const Block& block);
+void disassemble_register_instr(const Block& block, size_t index);
+const char* reg_op2s(RegOp op);
+
 } // namespace vy
@@ -2,31 +2,45 @@
 
 namespace vy {
 
-#ifndef VYSE_NAN_TAG
 struct Value;
-#else
-using Value = double;
-#endif
 
 class Compiler;
+class BytecodeReader;
+class BytecodeImage;
 class VM;
 class GC;
+class PreparedCall;
+class Jit;
+class JitCode;
 
 class Obj;
 class String;
 class Table;
+class Shape;
 class List;
 class CodeBlock;
 class Closure;
 class CClosure;
 class Upvalue;
 
+struct NativeBinding;
+struct Block;
+
 enum class ObjType : unsigned char;
 enum class ValueType : unsigned char;
+enum class NativeStatus : unsigned char;
 
 /// @brief Functions that are called from a snap script but are implemented in C++.
 using NativeFn = Value (*)(VM& vm, int argc);
 
+/// @brief Native functions that report errors through their return status instead of throwing.
+/// `args` points at the `argc` arguments on the VM's stack, and the function's return value is
+/// written to `result`. The VM checks `argc` against the function's declared arity before calling
+/// it, so at least that many arguments are always present. A function returning
+/// `NativeStatus::Error` must have reported the error to the VM (e.g with `util::cfn_error`).
+/// `args[-1]` holds the CClosure that is being called.
+using FastNativeFn = NativeStatus (*)(VM& vm, Value* args, int argc, Value& result);
+
 /// @brief Functions that load a library authored in C++
 using LibInitFn = Table& (*)(VM& vm);
 
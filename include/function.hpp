@@ -1,4 +1,6 @@
 #pragma once
+#include "aot.hpp"
+#include "jit.hpp"
 #include "string.hpp"
 #include "upvalue.hpp"
 
@@ -7,13 +9,15 @@ namespace vy {
 // A protoype is the body of a function that contains the bytecode and other relevant information.
 class CodeBlock final : public Obj {
 	friend Compiler;
+	friend BytecodeReader;
+	friend BytecodeImage;
 
   public:
 	explicit CodeBlock(String* funcname) noexcept : Obj{ObjType::codeblock}, m_name{funcname} {};
 	explicit CodeBlock(String* funcname, u32 param_count) noexcept
 		: Obj{ObjType::codeblock}, m_name{funcname}, m_num_params{param_count} {};
 
-	~CodeBlock(){};
+	~CodeBlock() override;
 
 	[[nodiscard]] constexpr const String* name() const noexcept {
 		return m_name;
@@ -49,6 +53,71 @@ class CodeBlock final : public Obj {
 		return m_is_variadic;
 	}
 
+	/// @brief The number of variables that the closures of this function capture.
+	[[nodiscard]] constexpr u32 upvalue_count() const noexcept {
+		return m_num_upvals;
+	}
+
+	/// @brief Whether the closures of this function capture no variables at all. Such closures are
+	/// indistinguishable, so the VM creates one the first time and reuses it afterwards.
+	[[nodiscard]] constexpr bool is_capture_free() const noexcept {
+		return m_num_upvals == 0;
+	}
+
+	/// @brief The closure shared by all evaluations of a capture-free function, or nullptr if it
+	/// hasn't been made yet.
+	[[nodiscard]] constexpr Closure* shared_closure() const noexcept {
+		return m_shared_closure;
+	}
+
+	void set_shared_closure(Closure* closure) noexcept {
+		VYSE_ASSERT(is_capture_free(), "Closures that capture variables cannot be shared.");
+		m_shared_closure = closure;
+	}
+
+	/// @brief Whether the extra arguments to this variadic function stay on the stack, instead of
+	/// being collected into a list for the rest parameter.
+	[[nodiscard]] constexpr bool keeps_varargs_on_stack() const noexcept {
+		return m_keeps_varargs_on_stack;
+	}
+
+	/// @brief The native code that the JIT compiled this function to, or nullptr if it hasn't been
+	/// compiled (see `Jit`).
+	[[nodiscard]] const JitCode* jit_code() const noexcept {
+		return m_jit_code.get();
+	}
+
+	void set_jit_code(std::unique_ptr<JitCode> code) noexcept;
+
+	/// @brief The function that the AOT compiler generated for this one, or nullptr if it
+	/// doesn't have one (see aot.hpp).
+	[[nodiscard]] AotFunction aot_function() const noexcept {
+		return m_aot_function;
+	}
+
+	void set_aot_function(AotFunction function) noexcept {
+		m_aot_function = function;
+	}
+
+	/// @brief Whether this function has been compiled to native code, by the JIT or ahead of time.
+	[[nodiscard]] bool has_native_code() const noexcept {
+		return m_aot_function != nullptr or m_jit_code != nullptr;
+	}
+
+	/// @brief Counts a call to this function, or a jump back in one of it's loops, towards
+	/// compiling it with the JIT.
+	/// @return true if this made the count reach [threshold]. This only happens once, so a function
+	/// that the JIT can't compile is only ever tried once.
+	bool heat_up(u32 threshold) noexcept {
+		return ++m_hotness == threshold;
+	}
+
+	/// @brief Whether this function was loaded from a bytecode image, and it's constants haven't
+	/// been loaded yet. That happens when the first closure of it is made (see `VM::make_closure`).
+	[[nodiscard]] bool is_pending() const noexcept {
+		return m_is_pending;
+	}
+
   private:
 	String* const m_name;
 	u32 m_num_params = 0;
@@ -57,16 +126,30 @@ class CodeBlock final : public Obj {
 	/// This is computed by the compiler.
 	int max_stack_size = 0;
 	Block m_block;
+	Closure* m_shared_closure = nullptr;
+	std::unique_ptr<JitCode> m_jit_code;
+	AotFunction m_aot_function = nullptr;
+	/// @brief The number of calls and loop iterations counted by `heat_up`.
+	u32 m_hotness = 0;
+
+	/// @brief The image that this function was loaded from, which holds it's code, and the index
+	/// of the function in the image's block table.
+	std::shared_ptr<BytecodeImage> m_image;
+	u32 m_image_index = 0;
+	bool m_is_pending = false;
 
 	/// @brief Whether this function accepts a varying number of arguments.
 	bool m_is_variadic = false;
+	bool m_keeps_varargs_on_stack = false;
 
 	void trace(GC& gc) override;
 };
 
 /// @brief A closure has two parts, code and data. The code part is represented by the prototype
-/// containing all the bytecode instructions and the data part is represented by the upvalues vector
-/// holding all the captured variables from enclosing scopes.
+/// containing all the bytecode instructions and the data part is represented by the captures
+/// holding all the variables captured from enclosing scopes.
+/// The captures are stored inline, right after the closure object, so a closure is a single
+/// allocation. Use `VM::make_closure` to create one.
 class Closure final : public Obj {
   public:
 	CodeBlock* const m_codeblock;
@@ -74,6 +157,10 @@ class Closure final : public Obj {
 	explicit Closure(CodeBlock* proto, u32 upval_count) noexcept;
 	~Closure() override{};
 
+	static void* operator new(size_t size, u32 upval_count);
+	static void operator delete(void* closure, u32 upval_count);
+	static void operator delete(void* closure);
+
 	[[nodiscard]] constexpr const String* name() const noexcept {
 		return m_codeblock->name();
 	}
@@ -82,31 +169,60 @@ class Closure final : public Obj {
 		return m_codeblock->name_cstr();
 	}
 
-	/// @brief returns the Upvalue at index [idx] in the
-	/// upvalue list.
+	/// @brief returns the capture at index [idx]. A variable that is captured by reference is
+	/// held by an `Upvalue` object stored in the capture, and one that is never reassigned is
+	/// captured by value and stored in the capture itself. Only the compiler knows which is which.
+	[[nodiscard]] Value& capture(u32 idx) noexcept {
+		VYSE_ASSERT(idx < m_num_upvals, "Invalid upvalue index.");
+		return captures()[idx];
+	}
+
+	/// @brief returns the Upvalue at index [idx] in the captures. The variable at that index must
+	/// be captured by reference.
 	[[nodiscard]] Upvalue* get_upval(u32 idx) noexcept {
-		VYSE_ASSERT(idx < m_upvals.size(), "Invalid upvalue index.");
-		return m_upvals[idx];
+		VYSE_ASSERT(VYSE_IS_OBJECT(capture(idx)), "Upvalue not captured by reference.");
+		return static_cast<Upvalue*>(VYSE_AS_OBJECT(capture(idx)));
 	}
 
-	/// @brief sets the Upvalue at index [idx] in the upvalue list to the given Upvalue.
-	void set_upval(u32 idx, Upvalue* uv);
+	/// @brief sets the capture at index [idx] to the given Upvalue.
+	void set_upval(u32 idx, Upvalue* uv) noexcept {
+		capture(idx) = VYSE_OBJECT(uv);
+	}
 
 	[[nodiscard]] size_t size() const override {
-		return sizeof(Closure);
+		return sizeof(Closure) + m_num_upvals * sizeof(Value);
 	}
 
   private:
-	std::vector<Upvalue*> m_upvals;
+	const u32 m_num_upvals;
 	void trace(GC& gc) override;
+
+	[[nodiscard]] Value* captures() noexcept {
+		return reinterpret_cast<Value*>(this + 1);
+	}
 };
 
+static_assert(sizeof(Closure) % alignof(Value) == 0, "Captures after a closure are misaligned.");
+
 /// TODO: Upvalues for CFunctions.
 
+/// @brief The outcome of a call to a FastNativeFn.
+enum class NativeStatus : unsigned char { Ok, Error };
+
 class CClosure final : public Obj {
   public:
 	explicit CClosure(NativeFn fn, List* const values = nullptr) noexcept
 		: Obj(ObjType::c_closure), m_values{values}, m_func{fn} {}
+
+	/// @brief Creates a CClosure that uses the status returning ABI.
+	/// @param name The name used when reporting an incorrect number of arguments.
+	/// @param arity The minimum number of arguments the function accepts.
+	/// @param reenters_vm Whether the function calls back into the VM, or needs to access it's
+	/// arguments with `VM::get_arg`. When false, the VM doesn't push a call frame for it.
+	CClosure(FastNativeFn fn, String* name, u8 arity, bool reenters_vm) noexcept
+		: Obj(ObjType::c_closure), m_fast_func{fn}, m_name{name}, m_arity{arity},
+		  m_reenters_vm{reenters_vm} {}
+
 	~CClosure() override = default;
 
 	[[nodiscard]] size_t size() const override {
@@ -117,11 +233,35 @@ class CClosure final : public Obj {
 		return m_func;
 	}
 
+	[[nodiscard]] bool is_fast() const noexcept {
+		return m_fast_func != nullptr;
+	}
+
+	[[nodiscard]] FastNativeFn fast_cfunc() const noexcept {
+		return m_fast_func;
+	}
+
+	[[nodiscard]] const String* name() const noexcept {
+		return m_name;
+	}
+
+	[[nodiscard]] u8 arity() const noexcept {
+		return m_arity;
+	}
+
+	[[nodiscard]] bool reenters_vm() const noexcept {
+		return m_reenters_vm;
+	}
+
 	/// @brief A list of values that the c-closure can use in whichever way it wants.
 	List* m_values = nullptr;
 
   private:
-	const NativeFn m_func;
+	const NativeFn m_func = nullptr;
+	const FastNativeFn m_fast_func = nullptr;
+	String* const m_name = nullptr;
+	const u8 m_arity = 0;
+	const bool m_reenters_vm = true;
 	void trace(GC& gc) override;
 };
 
@@ -0,0 +1,90 @@
+#pragma once
+#include "common.hpp"
+#include "forward.hpp"
+#include <cstdio>
+#include <vector>
+
+namespace vy {
+
+/// @brief How native code hands control back to the VM.
+enum class JitExit : u32 {
+	/// A runtime error was reported.
+	Error,
+	/// The function returned. It's call frame is popped, and the return value is on top of the
+	/// stack, but the caller's block has not been made the current one again.
+	Return,
+	/// The function has to continue in the interpreter, from the VM's `ip`. The stack top is set to
+	/// match the instruction at `ip`. This is also how the JIT declines to run a function.
+	Interpret,
+};
+
+/// @brief The native code that the `Jit` compiled a function's stack code to.
+class JitCode {
+  public:
+	VYSE_NO_COPY(JitCode);
+	VYSE_NO_MOVE(JitCode);
+
+	/// @param memory Executable memory holding the code, which this object takes ownership of.
+	/// @param entries The offset in [memory] of the native code of every instruction in the
+	/// function's block, indexed by the offset of the instruction, or `NoEntry` for instructions
+	/// that can't be entered.
+	JitCode(void* memory, size_t size, std::vector<u32> entries) noexcept
+		: m_memory{memory}, m_size{size}, m_entries{std::move(entries)} {}
+	~JitCode();
+
+	static constexpr u32 NoEntry = UINT32_MAX;
+
+	[[nodiscard]] const void* memory() const noexcept {
+		return m_memory;
+	}
+
+	[[nodiscard]] size_t size() const noexcept {
+		return m_size;
+	}
+
+	/// @return The native code for the instruction at [offset] in the block, or nullptr if the
+	/// function can't be entered there.
+	[[nodiscard]] const void* entry(size_t offset) const noexcept {
+		if (offset >= m_entries.size() or m_entries[offset] == NoEntry) return nullptr;
+		return static_cast<const u8*>(m_memory) + m_entries[offset];
+	}
+
+  private:
+	void* const m_memory;
+	const size_t m_size;
+	const std::vector<u32> m_entries;
+};
+
+/// @brief A baseline JIT compiler for x86-64 Linux. Once a function running on the stack tier has
+/// been called, or has jumped back in a loop, `VMConfig::jit_threshold` times, it's block is
+/// compiled to native code with one template per instruction. Simple instructions (moving values
+/// between stack slots, jumps and integer arithmetic) are done inline, and everything else calls
+/// into the VM's runtime functions. The few instructions that the JIT doesn't support hand the
+/// function back to the interpreter. On other platforms nothing is ever compiled.
+class Jit {
+  public:
+	VYSE_NO_COPY(Jit);
+	VYSE_NO_MOVE(Jit);
+
+	/// @param perf_map Whether to list the compiled functions in `/tmp/perf-<pid>.map`, which is
+	/// where the `perf` profiler finds the names of JIT-ed code.
+	Jit(VM& vm, bool perf_map);
+	~Jit();
+
+	/// @brief Whether the JIT can compile code on this platform.
+	static const bool Supported;
+
+	/// @brief Compiles the block of [code] to native code, which is then kept by [code].
+	/// @return false if the block uses something that the JIT can't compile.
+	bool compile(CodeBlock& code);
+
+	/// @brief Runs the compiled code of the function in the current call frame, starting at the
+	/// instruction at the VM's `ip`.
+	JitExit run(const CodeBlock& code);
+
+  private:
+	VM& m_vm;
+	FILE* m_perf_map = nullptr;
+};
+
+} // namespace vy
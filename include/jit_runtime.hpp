@@ -0,0 +1,113 @@
+#pragma once
+#include "block.hpp"
+#include "common.hpp"
+#include "forward.hpp"
+#include "value.hpp"
+#include <vector>
+
+// The parts of the VM that native code is built on. Both the JIT (see jit.hpp) and the C++ that
+// the AOT compiler generates (see aot.hpp) run a function's stack code this way.
+
+namespace vy {
+
+/// @brief The state of a function running in native code. Native code keeps the values that the
+/// instructions work on in their slots on the VM's stack, at fixed offsets from [base]. Since the
+/// stack may move when the VM calls a function or allocates, native code reloads [base] after
+/// every call into the runtime.
+struct JitFrame {
+	VM* vm;
+	Value* base;
+};
+
+/// @brief The runtime functions that native code calls for everything it doesn't do inline. Each
+/// one does what the interpreter does for an instruction, or for the slow path of one.
+struct JitRuntime {
+	/// @brief What a runtime function tells native code to do next.
+	enum Status : u32 {
+		/// Report the error by returning `JitExit::Error`.
+		Failed,
+		/// Go on with the next instruction.
+		Next,
+		/// Take the branch of the instruction.
+		Branch,
+	};
+
+	// Every runtime function takes the values on the stack below [top], which is the stack top at
+	// the instruction, and up to three operands of the instruction (see x_jit_helper.hpp). [ip] is
+	// the offset of the next instruction, which is where the VM would have it's `ip` while running
+	// this one. The return value is a `Status`.
+#define JIT_HELPER(name) static u32 name(JitFrame* f, Value* top, u32 ip, u64 a, u64 b, u64 c);
+#include "x_jit_helper.hpp"
+#undef JIT_HELPER
+
+	/// @brief The block of the function running in [f].
+	static const Block& block(JitFrame* f) noexcept;
+
+  private:
+	static VM& enter(JitFrame* f, Value* top, u32 ip) noexcept;
+	static u32 leave(JitFrame* f, bool ok, u32 status = Next) noexcept;
+	static Closure& closure(VM& vm) noexcept;
+	static bool finish(VM& vm, u32 frame_count);
+	static bool overload(VM& vm, const char* op_str, const char* method);
+	static bool call(VM& vm, const Value& callee, u8 argc);
+};
+
+using JitHelperFn = u32 (*)(JitFrame*, Value*, u32, u64, u64, u64);
+
+/// @brief The stack code of a block, as native code runs it. Since the number of values on the
+/// stack is the same every time an instruction runs, each value that an instruction works on is in
+/// a slot at a fixed offset from the frame base, which `analyze` finds.
+class NativeBlock {
+  public:
+	explicit NativeBlock(const CodeBlock& code);
+
+	/// @brief Finds the stack depth at every instruction.
+	/// @return false if the block has code that native code can't run.
+	bool analyze();
+
+	[[nodiscard]] const Block& block() const noexcept {
+		return m_block;
+	}
+
+	[[nodiscard]] size_t size() const noexcept {
+		return m_code.size();
+	}
+
+	/// @return The instruction that the interpreter would run at [offset]. Superinstructions run
+	/// their first instruction, and quickened instructions are compiled as the generic ones.
+	[[nodiscard]] Opcode op_at(size_t offset) const noexcept;
+
+	[[nodiscard]] u8 operand(size_t offset, size_t index) const noexcept {
+		return u8(m_code[offset + 1 + index]);
+	}
+
+	[[nodiscard]] const Value& constant(size_t offset, size_t index) const noexcept {
+		return m_block.constant_pool[operand(offset, index)];
+	}
+
+	/// @return The offset right after the instruction at [offset].
+	[[nodiscard]] size_t next(size_t offset) const noexcept;
+
+	/// @return The offset that the jump instruction at [offset] goes to.
+	[[nodiscard]] size_t jump_target(size_t offset) const noexcept;
+
+	/// @return The number of values on the stack when the instruction at [offset] runs, or -1 for
+	/// instructions that are never run.
+	[[nodiscard]] int depth(size_t offset) const noexcept {
+		return m_depths[offset];
+	}
+
+	/// @return Whether the instruction at [offset] is one of the fused comparisons, which also do
+	/// the `pop_jmp_if_false` that follows them.
+	[[nodiscard]] static bool is_fused_cmp(Opcode op) noexcept;
+
+  private:
+	const Block& m_block;
+	const BlockBuffer<Opcode>& m_code;
+	const u32 m_num_params;
+	std::vector<int> m_depths;
+
+	bool visit(std::vector<size_t>& worklist, size_t offset, int depth);
+};
+
+} // namespace vy
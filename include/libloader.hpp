@@ -2,15 +2,28 @@
 #include <common.hpp>
 #include <dino/dino.hpp>
 #include <forward.hpp>
+#include <source.hpp>
+#include <string>
 #include <unordered_map>
 
 namespace vy {
 
 struct StdModule;
+struct AotModule;
 
 static constexpr const char* ModuleCacheName = "__modulecache__";
 static constexpr const char* VMLoadersName = "__loaders__";
 static constexpr const char* VyseEnvVar = "VYSE_PATH";
+static constexpr const char* VyseCacheEnvVar = "VYSE_CACHE";
+
+/// @brief How often imported modules were found in the compile cache (`VMConfig::compile_cache`).
+struct CompileCacheStats {
+	/// Number of modules that were loaded from the cache, and the number that had to be compiled.
+	size_t hits = 0;
+	size_t misses = 0;
+	/// Number of compiled modules that were written to the cache.
+	size_t writes = 0;
+};
 
 class DynLoader final {
 	VYSE_NO_MOVE(DynLoader);
@@ -22,6 +35,8 @@ class DynLoader final {
 	DynLoader() {
 		const char* env_var = getenv(VyseEnvVar);
 		if (env_var) std_dlls_path = env_var;
+		const char* cache_var = getenv(VyseCacheEnvVar);
+		if (cache_var) compile_cache_path = cache_var;
 	}
 
 	/// @brief Load the module loader functions into the VM's global variable table.
@@ -31,6 +46,21 @@ class DynLoader final {
 	/// @brief Read a standard library module and return the value returned by it.
 	Value read_std_lib(VM& vm, const StdModule& module);
 
+	/// @brief Loads the AOT module [module_name] (see aot.hpp) from the shared library [dll_name],
+	/// which is looked for in the same directory as the standard library modules.
+	/// @return The module, or nullptr if the library or the module couldn't be found.
+	const AotModule* read_aot_module(const std::string& dll_name, const std::string& module_name);
+
+	/// @brief Compiles the module in [source] and adds it to the VM's sources. A module that has
+	/// been compiled before is loaded from the compile cache instead, and newly compiled modules
+	/// are written to it.
+	/// @return A closure that runs the module, or nullptr if it couldn't be compiled.
+	Closure* compile_module(VM& vm, SourceCode source);
+
+	[[nodiscard]] const CompileCacheStats& compile_cache_stats() const noexcept {
+		return cache_stats;
+	}
+
   private:
 	/// @brief A cache to avoid re-reading (.dll/.so/.a)s that have already been read.
 	/// Map of module name -> module handle.
@@ -39,6 +69,11 @@ class DynLoader final {
 	/// @brief Path to the directory where all the standard library shared modules
 	/// are placed. This is extracted via the VYSE_PATH environment variable.
 	std::string std_dlls_path;
+
+	/// @brief The directory of the compile cache if `VMConfig::compile_cache` is empty. This is
+	/// extracted via the VYSE_CACHE environment variable.
+	std::string compile_cache_path;
+	CompileCacheStats cache_stats;
 };
 
 } // namespace vy
@@ -0,0 +1,29 @@
+#pragma once
+#include "block.hpp"
+#include <unordered_map>
+
+namespace vy {
+
+/// @brief Counts how many times each sequence of instructions that could become a superinstruction
+/// runs. A sequence is two or three instructions that follow each other in a block, where all but
+/// the last one are straight line instructions (see `is_straight_line`).
+/// VMs built with VYSE_PROFILE_OPCODES collect a profile while they run, and write it out to the
+/// file in the environment variable VYSE_OPCODE_PROFILE when they are destroyed.
+/// benchmark/superinstructions.py turns these files into x_superinstr.hpp.
+class OpProfile {
+  public:
+	/// @brief Records that the instruction at [offset] in [block] is about to run.
+	void record(const Block& block, size_t offset);
+
+	/// @brief Appends the counts to the file at [path]. Each sequence goes on it's own line, as
+	/// it's count followed by the names of it's instructions.
+	/// @return false if the file could not be opened.
+	bool dump(const char* path) const;
+
+  private:
+	/// Counts indexed by the opcodes of a sequence, one per byte. The third byte of a pair is
+	/// `no_op`.
+	std::unordered_map<u32, u64> m_counts;
+};
+
+} // namespace vy
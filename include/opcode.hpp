@@ -6,7 +6,7 @@
 namespace vy {
 
 ///  IMPORTANT: after making any changes to this enum, make sure
-///  relevant changes are made in the 4 variables below, and in the `op_strs`
+///  relevant changes are made in the variables below, and in the `op_strs`
 ///  array in the file debug.cpp.
 enum class Opcode : u8 {
 #define OP(name, _, __) name
@@ -14,20 +14,107 @@ enum class Opcode : u8 {
 #undef OP
 };
 
+/// Flags of the byte that describes each captured variable in the operands of `make_func`. It is
+/// followed by the slot of the local, or the index of the capture in the enclosing closure.
+/// `CaptureLocal` is set for a local of the enclosing function, and `CaptureByValue` for a variable
+/// that is never reassigned, and is copied into the closure instead of being boxed in an upvalue.
+constexpr u8 CaptureLocal = 0b01;
+constexpr u8 CaptureByValue = 0b10;
+
 /// numerically lowest opcode that takes no operands
 constexpr auto Op_0_operands_start = Opcode::pop;
 /// numerically highest opcode that takes no operands
 constexpr auto Op_0_operands_end = Opcode::index_no_pop;
 
 constexpr auto Op_const_start = Opcode::load_const;
-constexpr auto Op_const_end = Opcode::table_get_no_pop;
+constexpr auto Op_const_end = Opcode::load_const;
+
+/// Instructions that take the index of a global variable in the block's `globals` list.
+constexpr auto Op_global_start = Opcode::get_global;
+constexpr auto Op_global_end = Opcode::set_global;
+
+/// Instructions that take a constant index followed by an inline cache index.
+constexpr auto Op_cached_start = Opcode::table_get;
+constexpr auto Op_cached_end = Opcode::table_get_str_key;
+
+/// Fused instructions that take the slot of a local, followed by another slot or a constant index.
+constexpr auto Op_fused_start = Opcode::eq_var_var_jmp;
+constexpr auto Op_fused_end = Opcode::add_var_const;
 
 /// numerically lowest opcode that takes one operand
 constexpr auto Op_1_operands_start = Opcode::set_var;
 /// numerically highest opcode that takes one operand
-constexpr auto Op_1_operands_end = Opcode::call_func;
+constexpr auto Op_1_operands_end = Opcode::tail_call;
 
 constexpr auto Op_2_operands_start = Opcode::jmp;
 constexpr auto Op_2_operands_end = Opcode::for_loop;
 
+/// Superinstructions come right after the last regular instruction. This range is empty when
+/// there are none.
+constexpr auto Op_super_start = Opcode(u8(Opcode::for_loop) + 1);
+constexpr auto Op_super_end = Opcode(u8(Opcode::no_op) - 1);
+
+/// @brief A sequence of instructions that runs as a single superinstruction. The VM runs every
+/// instruction but the last one inline, without dispatching, and then jumps to the last one.
+/// The operands and the opcodes of all but the first instruction stay in the bytecode as they
+/// were, so a jump into the middle of the sequence still lands on a regular instruction.
+struct SuperInstruction {
+	Opcode op;
+	u8 length;
+	std::array<Opcode, 3> ops;
+};
+
+/// All superinstructions, in the order of their priority when more than one of them matches.
+inline constexpr SuperInstruction superinstructions[] = {
+#define SUPER2(name, a, b) {Opcode::name, 2, {Opcode::a, Opcode::b, Opcode::no_op}},
+#define SUPER3(name, a, b, c) {Opcode::name, 3, {Opcode::a, Opcode::b, Opcode::c}},
+#include "x_superinstr.hpp"
+#undef SUPER2
+#undef SUPER3
+	// Keeps the array from being empty, and never matches anything.
+	{Opcode::no_op, 0, {Opcode::no_op, Opcode::no_op, Opcode::no_op}},
+};
+
+/// @return The superinstruction whose opcode is [op], which must be in the superinstruction range.
+constexpr const SuperInstruction& superinstruction(Opcode op) noexcept {
+	return superinstructions[u8(op) - u8(Op_super_start)];
+}
+
+/// @return true if [op] can be anywhere but at the end of a superinstruction. Such instructions
+/// never jump, call functions, or change the stack frame. The VM has an inline body for each one.
+constexpr bool is_straight_line(Opcode op) noexcept {
+	switch (op) {
+	case Opcode::load_const:
+	case Opcode::load_nil:
+	case Opcode::pop:
+	case Opcode::get_var:
+	case Opcode::set_var:
+	case Opcode::get_upval:
+	case Opcode::set_upval:
+	case Opcode::get_capture:
+	case Opcode::get_global:
+	case Opcode::set_global:
+	case Opcode::new_table:
+	case Opcode::new_list:
+	case Opcode::close_upval: return true;
+	default: return false;
+	}
+}
+
+/// @return The generic instruction that [op] was quickened from, or [op] if it isn't quickened.
+constexpr Opcode generic_op(Opcode op) noexcept {
+	switch (op) {
+	case Opcode::add_num_num: return Opcode::add;
+	case Opcode::sub_num_num: return Opcode::sub;
+	case Opcode::mult_num_num: return Opcode::mult;
+	case Opcode::gt_num_num: return Opcode::gt;
+	case Opcode::lt_num_num: return Opcode::lt;
+	case Opcode::gte_num_num: return Opcode::gte;
+	case Opcode::lte_num_num: return Opcode::lte;
+	case Opcode::subscript_get_list_num: return Opcode::subscript_get;
+	case Opcode::table_get_str_key: return Opcode::table_get;
+	default: return op;
+	}
+}
+
 } // namespace vy
\ No newline at end of file
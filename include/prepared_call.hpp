@@ -0,0 +1,82 @@
+#pragma once
+#include "common.hpp"
+#include "forward.hpp"
+#include "value.hpp"
+#include "vm.hpp"
+
+namespace vy {
+
+/// @brief A handle to call the same function many times from C++.
+/// The callee is resolved, and the stack slots for the call reserved, once when the handle is
+/// created. After that, every call only writes the arguments before invoking the callee:
+///
+/// ```cpp
+/// PreparedCall call(vm, func, 2);
+/// for (...) {
+///     call.arg(0) = x;
+///     call.arg(1) = y;
+///     if (!call.invoke()) break;
+///     use(call.result());
+/// }
+/// ```
+///
+/// The arguments have to be written again before every call, since the callee may use their
+/// slots as locals. The reserved slots are on top of the VM's stack, and released when the handle
+/// is destroyed. So nothing may be pushed on top of them that isn't popped before the next call,
+/// and PreparedCalls must be destroyed in the reverse order of their creation.
+class PreparedCall {
+  public:
+	VYSE_NO_COPY(PreparedCall);
+	VYSE_NO_MOVE(PreparedCall);
+	VYSE_NO_DEFAULT_CONSTRUCT(PreparedCall);
+
+	/// @param callee The value to call. It is kept alive as long as the handle is.
+	/// @param argc The number of arguments every call passes.
+	PreparedCall(VM& vm, Value callee, int argc);
+	~PreparedCall();
+
+	/// @brief Returns the slot for the argument at `index`, starting from 0.
+	[[nodiscard]] Value& arg(int index) noexcept {
+		VYSE_ASSERT(index >= 0 and index < m_argc, "Argument index out of range.");
+		return call_slot()[index + 1];
+	}
+
+	/// @brief Calls the callee with the arguments that were written to the argument slots.
+	/// @return true if the call was successful, false if it resulted in an error.
+	bool invoke();
+
+	/// @brief The value returned by the last call.
+	[[nodiscard]] Value result() const noexcept {
+		return *call_slot();
+	}
+
+  private:
+	/// The ways a callee can be invoked, from the fastest to the most general.
+	enum class Kind : u8 {
+		/// A closure that isn't variadic, called without going through `VM::op_call`.
+		Closure,
+		/// A CClosure that uses the status returning ABI.
+		FastNative,
+		/// Any other value, called with `VM::call`.
+		Other,
+	};
+
+	VM& m_vm;
+	const Value m_callee;
+	const int m_argc;
+	Kind m_kind = Kind::Other;
+
+	/// The number of parameters of a `Kind::Closure` callee. Missing arguments are padded with nil
+	/// and extra ones left out of the call.
+	int m_num_params = 0;
+
+	/// The index of the stack slot that keeps the callee alive. It's followed by the slot that the
+	/// callee is called from, and the argument slots. An index stays valid when the stack moves.
+	size_t m_base;
+
+	[[nodiscard]] Value* call_slot() const noexcept {
+		return m_vm.m_stack.values + m_base + 1;
+	}
+};
+
+} // namespace vy
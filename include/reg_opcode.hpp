@@ -0,0 +1,61 @@
+#pragma once
+
+#include "common.hpp"
+
+namespace vy {
+
+/// @brief The layout of a register instruction's operands. This is only needed to print them.
+enum class RegFormat : u8 {
+	A,		 // a register.
+	AB,		 // two registers.
+	ABC,	 // three registers.
+	ABK,	 // two registers and a constant (c).
+	AK,		 // a register and a constant (b).
+	AU,		 // a register and an upvalue index (b).
+	AG,		 // a register and the index of a global in the block's `globals` (b).
+	ABKC,	 // two registers, a constant (c) and an inline cache index (x).
+	J,		 // a jump target (x).
+	AJ,		 // a register and a jump target.
+	ABJ,	 // two registers and a jump target.
+	AKJ,	 // a register, a constant (b) and a jump target.
+	Call,	 // a register and an argument count (b).
+	Closure, // a register, a constant (b) and the offset of a stack instruction (x).
+};
+
+/// @brief The instructions of the register tier, see `RegInstr`.
+enum class RegOp : u8 {
+#define REG_OP(name, _) name,
+#include "x_reg_opcode.hpp"
+#undef REG_OP
+};
+
+/// @brief An instruction of the register tier. The stack tier's instructions take their operands
+/// from the top of the value stack and push their results back onto it. Register instructions
+/// instead name the slots of the call frame that they read and write, so adding two locals is a
+/// single instruction rather than two loads, the addition and a store.
+/// The slot that holds the value at depth `n` of a function's stack in the stack tier is register
+/// `n`, so locals keep their slots, and the registers above them hold temporaries.
+struct RegInstr {
+	RegOp op;
+	u8 a = 0;
+	u8 b = 0;
+	u8 c = 0;
+	/// The index of the instruction to jump to, the index of an inline cache, or for
+	/// `make_func` the offset of the stack instruction that describes the upvalues.
+	u32 x = 0;
+};
+
+static_assert(sizeof(RegInstr) == 8, "Register instructions are meant to be 8 bytes long.");
+
+/// @return The layout of [op]'s operands.
+constexpr RegFormat reg_format(RegOp op) noexcept {
+	switch (op) {
+#define REG_OP(name, format)                                                                       \
+	case RegOp::name: return RegFormat::format;
+#include "x_reg_opcode.hpp"
+#undef REG_OP
+	}
+	return RegFormat::A;
+}
+
+} // namespace vy
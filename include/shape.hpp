@@ -0,0 +1,67 @@
+#pragma once
+#include "common.hpp"
+#include "forward.hpp"
+#include <memory>
+#include <vector>
+
+namespace vy {
+
+/// @brief A shape (or hidden class) describes the layout of a table whose keys are all strings.
+/// Tables that were given the same string keys in the same order share a shape, and keep only
+/// their values in a dense array of slots, where the value of `keys()[i]` lives in slot `i`.
+///
+/// Shapes form a tree owned by the VM. The root is the shape of an empty table, and adding a key
+/// to a table moves it to a child of its current shape. To keep the tree from growing without
+/// bound, it has a limit on the number of keys in a shape and on the number of shapes. Tables
+/// that would need a shape past those limits switch to the hash table layout instead.
+class Shape {
+  public:
+	VYSE_NO_COPY(Shape);
+	VYSE_NO_MOVE(Shape);
+
+	/// @brief Tables with more keys than this use the hash table layout.
+	static constexpr size_t MaxKeys = 32;
+	/// @brief Maximum number of shapes in a single tree.
+	static constexpr size_t MaxShapes = 4096;
+	static constexpr size_t NotFound = SIZE_MAX;
+
+	/// @brief Creates the root of a new shape tree.
+	explicit Shape() noexcept : m_root{this} {};
+
+	const std::vector<String*>& keys() const noexcept {
+		return m_keys;
+	}
+
+	size_t num_keys() const noexcept {
+		return m_keys.size();
+	}
+
+	/// @return The slot of [key] in tables that have this shape, or `NotFound`.
+	size_t find(const String* key) const noexcept {
+		for (size_t i = 0; i < m_keys.size(); ++i) {
+			if (m_keys[i] == key) return i;
+		}
+		return NotFound;
+	}
+
+	/// @return The shape of a table that has this shape and then gets [key] added to it, or
+	/// nullptr if that shape would go past the limits of the tree.
+	Shape* with_key(String* key);
+
+	/// @brief Marks the keys of this shape and all of it's descendants as alive. Shapes are never
+	/// freed, so the keys they refer to must not be either.
+	void trace_keys(GC& gc) const;
+
+  private:
+	explicit Shape(Shape& parent, String* key);
+
+	/// The root of the tree this shape belongs to. Only the root's `m_num_shapes` is used.
+	Shape* const m_root;
+	size_t m_num_shapes = 1;
+
+	std::vector<String*> m_keys;
+	/// Shapes reached by adding a key to this one. The key added is the last key of the child.
+	std::vector<std::unique_ptr<Shape>> m_children;
+};
+
+} // namespace vy
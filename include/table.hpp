@@ -1,4 +1,6 @@
 #pragma once
+#include "block.hpp"
+#include "shape.hpp"
 #include "string.hpp"
 #include "value.hpp"
 #include <cmath>
@@ -9,11 +11,18 @@ namespace vy {
 // This is the core table data structure in vyse.
 // I decided to go with a hashtable implementation that uses Robinhood hashing
 // and linear probing.
+// Tables created from object literals start out with a shaped layout instead, where the string keys
+// are described by a `Shape` shared with other tables, and the table only stores the values.
 class Table final : public Obj {
 	friend GC;
 
   public:
 	explicit Table() noexcept : Obj{ObjType::table} {};
+	/// @brief Creates an empty table with the shaped layout, starting at the shape [root].
+	/// The table switches to the hash table layout once it gets a key that isn't a string, a key
+	/// is removed from it, or the shape tree has no room left for it's keys.
+	explicit Table(Shape* root) noexcept
+		: Obj{ObjType::table}, m_shape{root}, m_entries{nullptr}, m_cap{0} {};
 	~Table();
 
 	/// IMPORTANT: `DefaultCapacity` must always be a power of two, since we are using the `&` trick
@@ -26,6 +35,11 @@ class Table final : public Obj {
 	/// If a property is not found in this table then a lookup is done on the prototype.
 	Table* m_proto_table = nullptr;
 
+	/// @return The shape of this table, or nullptr if it uses the hash table layout.
+	[[nodiscard]] const Shape* shape() const noexcept {
+		return m_shape;
+	}
+
 	/// @return The value assosciated with `key`.
 	[[nodiscard]] Value get(Value key) const;
 
@@ -42,6 +56,58 @@ class Table final : public Obj {
 	/// @return True if a new entry was added, False if an existing entry was modified
 	bool set(String& key, Value value);
 
+	/// @brief Looks up the string [key] using the entry recorded in [cache] by an earlier call to
+	/// `get_and_cache`. The tables between this one and the one holding the key must still not
+	/// have a key of their own that shadows it.
+	/// @return true and stores the value in [result] if the cache is still valid.
+	bool get_cached(Value key, const InlineCache& cache, Value& result) const {
+		// A table that still has the shape it had when the cache was filled keeps the key in the
+		// same slot, or still doesn't have it if it was found on a prototype.
+		const bool same_shape = m_shape != nullptr and m_shape == cache.shape;
+		if (same_shape and cache.depth == 0) {
+			result = m_slots[cache.slot];
+			return true;
+		}
+
+		if (cache.depth == InlineCache::Empty) return false;
+		if (cache.depth > 0 and !same_shape and find_string_key(key) != NotFound) return false;
+
+		// The walk starts at this table, which was checked above and holds the key itself if the
+		// depth is 0. Otherwise the tables between it and the holder must not shadow the key.
+		const Table* holder = this;
+		for (u8 i = 0; i < cache.depth and holder != nullptr; ++i) {
+			if (i > 0 and holder->find_string_key(key) != NotFound) return false;
+			holder = holder->m_proto_table;
+		}
+
+		if (holder == nullptr) return false;
+		return holder->get_slot(cache.slot, key, result);
+	}
+
+	/// @brief Same as `get`, but remembers where the string [key] was found in [cache].
+	Value get_and_cache(Value key, InlineCache& cache) const;
+
+	/// @brief Sets the value of the string [key], that this table already has, to [value] by
+	/// using the slot recorded in [cache].
+	/// @return true if the cache was still valid and the value was set.
+	bool set_cached(Value key, Value value, const InlineCache& cache) {
+		if (cache.depth != 0 or VYSE_IS_NIL(value)) return false;
+		if (m_shape != nullptr) {
+			if (m_shape != cache.shape) return false;
+			m_slots[cache.slot] = value;
+			return true;
+		}
+
+		if (cache.slot >= m_cap) return false;
+		Entry& entry = m_entries[cache.slot];
+		if (!is_same_string_key(entry.key, key)) return false;
+		entry.value = value;
+		return true;
+	}
+
+	/// @brief Same as `set`, but remembers the slot of the string [key] in [cache].
+	void set_and_cache(Value key, Value value, InlineCache& cache);
+
 	/// @return The number of key-value pairs that are active in this table.
 	size_t length() const;
 
@@ -76,6 +142,14 @@ class Table final : public Obj {
 	};
 
   private:
+	static constexpr size_t NotFound = Shape::NotFound;
+
+	/// @brief The shape of the table if it uses the shaped layout, in which case the value of the
+	/// key `m_shape->keys()[i]` is stored in `m_slots[i]` and `m_entries` is not used.
+	Shape* m_shape = nullptr;
+	Value* m_slots = nullptr;
+	size_t m_slot_cap = 0;
+
 	Entry* m_entries = new Entry[DefaultCapacity];
 	/// @brief Total number of entries.
 	/// This includes all tombstones (values that have been
@@ -88,8 +162,49 @@ class Table final : public Obj {
 	size_t m_cap = DefaultCapacity;
 
 	size_t hash_value(Value value) const;
+
+	/// @brief Strings are interned, so two string keys are the same if they are the same object.
+	static bool is_same_string_key(const Value& a, const Value& b) noexcept {
+		return VYSE_IS_OBJECT(a) and VYSE_AS_OBJECT(a) == VYSE_AS_OBJECT(b);
+	}
+
+	/// @return The index of the slot or entry holding the string [key] in this table (ignoring the
+	/// prototype), or `NotFound`.
+	size_t find_string_key(const Value& key) const noexcept {
+		VYSE_ASSERT(VYSE_IS_STRING(key), "Cached table key is not a string.");
+		if (m_shape != nullptr) return m_shape->find(VYSE_AS_STRING(key));
+
+		const size_t mask = m_cap - 1;
+		size_t index = VYSE_AS_STRING(key)->hash() & mask;
+		while (true) {
+			const Entry& entry = m_entries[index];
+			if (is_same_string_key(entry.key, key)) return index;
+			if (VYSE_IS_NIL(entry.key)) return NotFound;
+			index = (index + 1) & mask;
+		}
+	}
 	size_t hash_object(Obj* object) const;
 
+	/// @brief If [slot] is the slot or entry of the string [key] in this table, stores it's
+	/// value in [result].
+	/// @return Whether [slot] holds [key].
+	bool get_slot(size_t slot, const Value& key, Value& result) const noexcept {
+		if (m_shape != nullptr) {
+			if (slot >= m_shape->num_keys() or m_shape->keys()[slot] != VYSE_AS_STRING(key)) {
+				return false;
+			}
+			result = m_slots[slot];
+			return true;
+		}
+
+		if (slot >= m_cap or !is_same_string_key(m_entries[slot].key, key)) return false;
+		result = m_entries[slot].value;
+		return true;
+	}
+
+	/// @brief Moves all the keys and values of a shaped table into a hash table.
+	void to_hash_layout();
+
 	/// @brief If the hashtable is [LoadFactor]th full
 	/// then grows the entries buffer.
 	void ensure_capacity();
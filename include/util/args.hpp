@@ -2,7 +2,12 @@
 #include <common.hpp>
 #include <exception>
 #include <forward.hpp>
+#include <optional>
 #include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <util/lib_util.hpp>
+#include <utility>
 #include <value.hpp>
 #include <vm.hpp>
 
@@ -32,6 +37,12 @@ struct CMiscException : std::runtime_error {
 	const char* fname;
 };
 
+/// @brief Thrown by a function exposed with `vy::bind` to report an error. The native function
+/// that `vy::bind` generates reports it with the name that the function was registered under.
+struct BindError : std::runtime_error {
+	explicit BindError(const char* message) : std::runtime_error(message) {}
+};
+
 template <typename...>
 constexpr bool AlwaysFalse = false;
 
@@ -176,3 +187,256 @@ class Args {
 };
 
 } // namespace vy::util
+
+namespace vy {
+
+/// @brief A native function generated by `vy::bind`, along with the number of arguments it needs.
+/// It can be registered with `NativeModule::add_cfunc`.
+struct NativeBinding {
+	FastNativeFn func;
+	u8 arity;
+	bool reenters_vm;
+};
+
+} // namespace vy
+
+namespace vy::util {
+
+/// @brief Describes how an argument is passed to a parameter of type `T` in a function exposed
+/// with `vy::bind`. `check` tells if a value can be passed as a `T`, `get` converts it.
+template <typename T, typename = void>
+struct BindParam {
+	static_assert(AlwaysFalse<T>, "Unsupported parameter type in a function passed to vy::bind.");
+};
+
+template <>
+struct BindParam<number> {
+	static bool check(const Value& v) noexcept {
+		return VYSE_IS_NUM(v);
+	}
+
+	static number get(const Value& v) noexcept {
+		return VYSE_AS_NUM(v);
+	}
+
+	static const char* type_name() noexcept {
+		return vtype_to_string(ValueType::Number);
+	}
+};
+
+template <>
+struct BindParam<bool> {
+	static bool check(const Value& v) noexcept {
+		return VYSE_IS_BOOL(v);
+	}
+
+	static bool get(const Value& v) noexcept {
+		return VYSE_AS_BOOL(v);
+	}
+
+	static const char* type_name() noexcept {
+		return vtype_to_string(ValueType::Bool);
+	}
+};
+
+template <>
+struct BindParam<Value> {
+	static bool check(const Value&) noexcept {
+		return true;
+	}
+
+	static Value get(const Value& v) noexcept {
+		return v;
+	}
+
+	static const char* type_name() noexcept {
+		return "value";
+	}
+};
+
+/// Objects can be received by pointer or by reference, and the object's type is checked against
+/// the `TagOfType` of the pointee.
+template <typename T>
+struct BindParam<T*, std::enable_if_t<std::is_base_of_v<Obj, T>>> {
+	static constexpr ObjType tag = TagOfType<std::remove_const_t<T>>::tag;
+
+	static bool check(const Value& v) noexcept {
+		return VYSE_IS_OBJECT(v) and VYSE_AS_OBJECT(v)->tag == tag;
+	}
+
+	static T* get(const Value& v) noexcept {
+		return static_cast<T*>(VYSE_AS_OBJECT(v));
+	}
+
+	static const char* type_name() noexcept {
+		return otype_to_string(tag);
+	}
+};
+
+template <typename T>
+struct BindParam<T&, std::enable_if_t<std::is_base_of_v<Obj, T>>> : BindParam<T*> {
+	static T& get(const Value& v) noexcept {
+		return *BindParam<T*>::get(v);
+	}
+};
+
+/// Trailing `std::optional` parameters are empty when the caller doesn't pass them.
+template <typename T>
+struct BindParam<std::optional<T>> : BindParam<T> {};
+
+template <typename T>
+constexpr bool IsOptional = false;
+
+template <typename T>
+constexpr bool IsOptional<std::optional<T>> = true;
+
+/// @brief Converts the value returned by a function exposed with `vy::bind` to a vyse Value.
+template <typename T>
+Value bind_return(T&& value) noexcept {
+	using R = std::remove_cv_t<std::remove_reference_t<T>>;
+	if constexpr (std::is_same_v<R, bool>) {
+		return VYSE_BOOL(value);
+	} else if constexpr (std::is_arithmetic_v<R>) {
+		return VYSE_NUM(value);
+	} else if constexpr (std::is_same_v<R, Value>) {
+		return value;
+	} else if constexpr (std::is_pointer_v<R>) {
+		static_assert(std::is_base_of_v<Obj, std::remove_pointer_t<R>>,
+					  "Unsupported return type in a function passed to vy::bind.");
+		return value == nullptr ? VYSE_NIL : VYSE_OBJECT(value);
+	} else {
+		static_assert(std::is_base_of_v<Obj, R>,
+					  "Unsupported return type in a function passed to vy::bind.");
+		return VYSE_OBJECT(&value);
+	}
+}
+
+template <typename... Ps>
+constexpr bool FirstIsVM = false;
+
+template <typename... Ps>
+constexpr bool FirstIsVM<VM&, Ps...> = true;
+
+template <typename F>
+struct Binder;
+
+/// The native function generated for `Func`, which receives the `Params` it's called with from
+/// vyse. When `Func` also takes a `VM&`, it comes before those.
+template <typename R, typename... Params>
+struct Binder<R (*)(Params...)> {
+	static constexpr bool takes_vm = FirstIsVM<Params...>;
+	static constexpr size_t num_params = sizeof...(Params) - takes_vm;
+
+	template <size_t I>
+	using ScriptParam = std::remove_cv_t<std::tuple_element_t<I + takes_vm, std::tuple<Params...>>>;
+
+	template <size_t... Is>
+	static auto script_params(std::index_sequence<Is...>) -> std::tuple<ScriptParam<Is>...>;
+
+	using ScriptParams = decltype(script_params(std::make_index_sequence<num_params>{}));
+
+	template <size_t I>
+	using Param = std::tuple_element_t<I, ScriptParams>;
+
+	template <size_t... Is>
+	static constexpr size_t count_required(std::index_sequence<Is...>) {
+		// The leading `false` keeps the array from being empty.
+		constexpr bool is_optional[] = {false, IsOptional<Param<Is>>...};
+		size_t required = 0;
+		while (required < sizeof...(Is) and !is_optional[required + 1]) ++required;
+		return required;
+	}
+
+	static constexpr size_t arity = count_required(std::make_index_sequence<num_params>{});
+	static_assert(arity <= UINT8_MAX, "Too many parameters in a function passed to vy::bind.");
+
+	template <size_t... Is>
+	static constexpr bool optionals_last(std::index_sequence<Is...>) {
+		return ((Is < arity or IsOptional<Param<Is>>) and ...);
+	}
+
+	static_assert(optionals_last(std::make_index_sequence<num_params>{}),
+				  "Optional parameters of a function passed to vy::bind must come last.");
+
+	template <size_t I>
+	static bool check_arg(VM& vm, const Value* args, int argc) {
+		if constexpr (IsOptional<Param<I>>) {
+			if (static_cast<int>(I) >= argc or VYSE_IS_NIL(args[I])) return true;
+		}
+
+		if (BindParam<Param<I>>::check(args[I])) return true;
+		bad_arg_error(vm, name(args), I + 1, BindParam<Param<I>>::type_name(),
+					  value_type_name(args[I]));
+		return false;
+	}
+
+	/// @return The name that the native function called with [args] was registered under.
+	static const char* name(const Value* args) noexcept {
+		const String* const name = VYSE_AS_CCLOSURE(args[-1])->name();
+		return name ? name->c_str() : "native function";
+	}
+
+	template <size_t I>
+	static Param<I> get_arg(const Value* args, int argc) {
+		if constexpr (IsOptional<Param<I>>) {
+			if (static_cast<int>(I) >= argc or VYSE_IS_NIL(args[I])) return std::nullopt;
+		}
+		return BindParam<Param<I>>::get(args[I]);
+	}
+
+	template <auto Func, size_t... Is>
+	static NativeStatus call(VM& vm, [[maybe_unused]] Value* args, [[maybe_unused]] int argc,
+							 [[maybe_unused]] Value& result, std::index_sequence<Is...>) {
+		if (!(check_arg<Is>(vm, args, argc) and ...)) return NativeStatus::Error;
+
+		try {
+			if constexpr (std::is_void_v<R>) {
+				if constexpr (takes_vm) Func(vm, get_arg<Is>(args, argc)...);
+				else Func(get_arg<Is>(args, argc)...);
+			} else {
+				if constexpr (takes_vm) result = bind_return(Func(vm, get_arg<Is>(args, argc)...));
+				else result = bind_return(Func(get_arg<Is>(args, argc)...));
+			}
+		} catch (const BindError& error) {
+			cfn_error(vm, name(args), error.what());
+			return NativeStatus::Error;
+		}
+
+		// Functions that take the VM may have reported an error to it.
+		if constexpr (takes_vm) {
+			if (vm.has_error()) return NativeStatus::Error;
+		}
+		return NativeStatus::Ok;
+	}
+
+	template <auto Func>
+	static NativeStatus native(VM& vm, Value* args, int argc, Value& result) {
+		return call<Func>(vm, args, argc, result, std::make_index_sequence<num_params>{});
+	}
+};
+
+} // namespace vy::util
+
+namespace vy {
+
+/// @brief Generates a native function that calls `Func` with the arguments it receives from vyse.
+/// The VM checks that there are as many arguments as `Func` has parameters, leaving out trailing
+/// `std::optional` ones, which are empty when their argument is missing or nil. The arguments are
+/// type checked against the parameters, which can be `number`, `bool`, `Value`, or pointers and
+/// references to vyse objects. `Func` can also take a `VM&` as it's first parameter. It reports
+/// errors by throwing a `util::BindError`, which names the function it was registered as.
+/// @tparam ReentersVM Whether `Func` calls back into the VM. Functions that don't are called
+/// without pushing a call frame.
+///
+/// ```cpp
+/// number hypot(number x, number y) { return std::sqrt(x * x + y * y); }
+/// module.add_cfunc("hypot", vy::bind<&hypot>());
+/// ```
+template <auto Func, bool ReentersVM = false>
+constexpr NativeBinding bind() noexcept {
+	using Binder = util::Binder<decltype(Func)>;
+	return NativeBinding{&Binder::template native<Func>, static_cast<u8>(Binder::arity),
+						 ReentersVM};
+}
+
+} // namespace vy
@@ -18,6 +18,16 @@ class NativeModule {
 
 	/// @brief Add a CClosure wrapping `func` to the table with field-name `name`.
 	void add_cfunc(const char* fname, NativeFn func);
+
+	/// @brief Add a CClosure wrapping the status returning function `func` to the table.
+	/// @param arity The minimum number of arguments `func` accepts. The VM reports an error
+	/// without calling `func` when it recieves fewer.
+	/// @param reenters_vm Pass false if `func` never calls back into the VM, so it can be called
+	/// without pushing a call frame.
+	void add_cfunc(const char* fname, FastNativeFn func, u8 arity, bool reenters_vm = true);
+
+	/// @brief Add a CClosure wrapping a native function generated by `vy::bind`.
+	void add_cfunc(const char* fname, const NativeBinding& binding);
 	void add_field(const char* name, Value value);
 
 	/// @brief add `num_funcs` functions from the `funcs` list to the module's table.
@@ -26,6 +36,10 @@ class NativeModule {
 	/// via the module
 	void add_cclosures(const std::pair<const char*, NativeFn>* funcs, std::size_t num_funcs);
 
+	/// @brief add `num_funcs` functions generated by `vy::bind` from the `funcs` list to the
+	/// module's table.
+	void add_cclosures(const std::pair<const char*, NativeBinding>* funcs, std::size_t num_funcs);
+
   private:
 	VM* const m_vm;
 	Table* const m_table;
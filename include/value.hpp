@@ -4,6 +4,7 @@
 #include "token.hpp"
 #include "value.hpp"
 #include <cassert>
+#include <cstring>
 #include <string>
 
 namespace vy {
@@ -56,29 +57,34 @@ class Obj {
 	virtual size_t size() const = 0;
 };
 
-enum class ValueType : u8 { Number, Bool, Object, Nil, Undefined, MiscData };
+/// `Integer` is only used internally to tag numbers that are stored as 32 bit integers. Such values
+/// are still numbers to the rest of the world: VYSE_GET_TT reports them as `Number`, VYSE_IS_NUM
+/// is true for them and VYSE_AS_NUM converts them to a double.
+enum class ValueType : u8 { Number, Integer, Bool, Object, Nil, Undefined, MiscData };
+
+#ifndef VYSE_NAN_TAGGING
 
 // Without NaN tagging, values are represented as structs weighing 16 bytes. 1 word for the type tag
 // and one for the union representing the possible states. This is a bit wasteful but not that bad.
 
-/// TODO: Implement optional NaN tagging when a macro
-/// VYSE_NAN_TAGGING is defined.
-
 struct Value {
 	ValueType tag;
 	union Data {
 		number num;
+		s32 integer;
 		bool boolean;
 		Obj* object;
 		void* misc_data;
 		constexpr Data() noexcept : num(0) {}
 		constexpr Data(number v) noexcept : num(v) {}
+		constexpr Data(s32 i) noexcept : integer(i) {}
 		constexpr Data(bool b) noexcept : boolean(b) {}
 		constexpr Data(Obj* o) noexcept : object(o) {}
 		constexpr Data(void* p) noexcept : misc_data(p) {}
 	} as;
 
 	explicit constexpr Value(number n) noexcept : tag{ValueType::Number}, as{n} {}
+	explicit constexpr Value(s32 i) noexcept : tag{ValueType::Integer}, as{i} {}
 	explicit constexpr Value(bool b) noexcept : tag{ValueType::Bool}, as{b} {}
 	explicit constexpr Value() noexcept : tag{ValueType::Nil} {}
 	explicit constexpr Value(void* p) noexcept : tag{ValueType::MiscData}, as{p} {}
@@ -93,6 +99,84 @@ struct Value {
 	}
 };
 
+#else
+
+// With NaN tagging, a value is a single 64 bit word. Any bit pattern that is not a quiet NaN with
+// all the bits in `QNaN` set is a plain IEEE-754 double. Everything else lives in the unused
+// payload of such a NaN:
+//
+// - Objects have the sign bit set, and store the (48 bit) pointer in the low bits.
+// - Integers are tagged with `IntTag` and store a 32 bit integer in the low bits.
+// - nil, false, true and undefined are singletons with small numbers in the low bits.
+// - Misc data pointers are tagged with `MiscDataTag` and store the pointer in the low 48 bits.
+//
+// The NaNs produced by arithmetic on x86 and ARM (0x7ff8... and 0xfff8...) do not have all of the
+// `QNaN` bits set, so they are still read back as numbers.
+
+static_assert(sizeof(void*) == 8, "NaN tagging requires 64 bit pointers.");
+
+struct Value {
+	static constexpr u64 SignBit = 0x8000000000000000;
+	static constexpr u64 QNaN = 0x7ffc000000000000;
+	static constexpr u64 ObjectTag = SignBit | QNaN;
+	static constexpr u64 MiscDataTag = QNaN | 0x0001000000000000;
+	static constexpr u64 IntTag = QNaN | 0x0002000000000000;
+	static constexpr u64 IntMask = ObjectTag | 0x0003000000000000;
+	static constexpr u64 PayloadMask = 0x0000ffffffffffff;
+
+	static constexpr u64 NilBits = QNaN | 1;
+	static constexpr u64 FalseBits = QNaN | 2;
+	static constexpr u64 TrueBits = QNaN | 3;
+	static constexpr u64 UndefBits = QNaN | 4;
+
+	u64 bits;
+
+	explicit Value(number n) noexcept {
+		std::memcpy(&bits, &n, sizeof(number));
+	}
+
+	explicit constexpr Value(s32 i) noexcept : bits{IntTag | u32(i)} {}
+	explicit constexpr Value(bool b) noexcept : bits{b ? TrueBits : FalseBits} {}
+	explicit constexpr Value() noexcept : bits{NilBits} {}
+	explicit Value(void* p) noexcept : bits{MiscDataTag | reinterpret_cast<u64>(p)} {}
+	explicit Value(Obj* o) noexcept : bits{ObjectTag | reinterpret_cast<u64>(o)} {
+		VYSE_ASSERT(o != nullptr, "Unexpected nullptr object");
+	}
+
+	static inline constexpr Value undefined() noexcept {
+		Value undef;
+		undef.bits = UndefBits;
+		return undef;
+	}
+
+	inline bool is_int() const noexcept {
+		return (bits & IntMask) == IntTag;
+	}
+
+	inline number as_num() const noexcept {
+		if (is_int()) return s32(u32(bits));
+		number n;
+		std::memcpy(&n, &bits, sizeof(number));
+		return n;
+	}
+
+	inline ValueType type() const noexcept {
+		if ((bits & QNaN) != QNaN or is_int()) return ValueType::Number;
+		if ((bits & ObjectTag) == ObjectTag) return ValueType::Object;
+		if ((bits & MiscDataTag) == MiscDataTag) return ValueType::MiscData;
+		switch (bits) {
+		case FalseBits:
+		case TrueBits: return ValueType::Bool;
+		case UndefBits: return ValueType::Undefined;
+		default: return ValueType::Nil;
+		}
+	}
+};
+
+static_assert(sizeof(Value) == 8, "NaN tagged values must fit in a word.");
+
+#endif
+
 bool operator==(const Value& a, const Value& b);
 bool operator!=(const Value& a, const Value& b);
 
@@ -106,31 +190,64 @@ char* num_to_cstring(number n);
 const char* value_type_name(Value v);
 void print_value(Value v);
 
-#define VYSE_SET_NUM(v, i) ((v).as.num = i)
-#define VYSE_SET_BOOL(v, b) ((v).as.boolean = b)
-#define VYSE_SET_OBJECT(v, o) ((v).as.object = o)
-
 #define VYSE_NUM(n) (vy::Value(static_cast<vy::number>(n)))
+#define VYSE_INT(i) (vy::Value(static_cast<vy::s32>(i)))
 #define VYSE_BOOL(b) (vy::Value(static_cast<bool>(b)))
 #define VYSE_OBJECT(o) (vy::Value(static_cast<vy::Obj*>(o)))
 #define VYSE_NIL (vy::Value())
 #define VYSE_UNDEF (vy::Value::undefined())
 
+#ifndef VYSE_NAN_TAGGING
+
+#define VYSE_SET_NUM(v, i) ((v) = VYSE_NUM(i))
+#define VYSE_SET_BOOL(v, b) ((v).as.boolean = b)
+#define VYSE_SET_OBJECT(v, o) ((v).as.object = o)
+
 #define VYSE_SET_TT(v, tt) ((v).tag = tt)
-#define VYSE_GET_TT(v) ((v).tag)
-#define VYSE_CHECK_TT(v, tt) ((v).tag == tt)
+#define VYSE_GET_TT(v) ((v).tag == vy::ValueType::Integer ? vy::ValueType::Number : (v).tag)
+#define VYSE_CHECK_TT(v, tt) (VYSE_GET_TT(v) == tt)
+
+#define VYSE_IS_NUM(v) ((v).tag <= vy::ValueType::Integer)
+#define VYSE_IS_INT(v) ((v).tag == vy::ValueType::Integer)
+#define VYSE_IS_BOOL(v) ((v).tag == vy::ValueType::Bool)
+#define VYSE_IS_NIL(v) ((v).tag == vy::ValueType::Nil)
+#define VYSE_IS_UNDEFINED(v) ((v).tag == vy::ValueType::Undefined)
+#define VYSE_IS_OBJECT(v) ((v).tag == vy::ValueType::Object)
+
+#define VYSE_AS_NUM(v) (VYSE_IS_INT(v) ? vy::number((v).as.integer) : (v).as.num)
+#define VYSE_AS_INT(v) ((v).as.integer)
+#define VYSE_AS_BOOL(v) ((v).as.boolean)
+#define VYSE_AS_OBJECT(v) ((v).as.object)
+
+#else
+
+#define VYSE_SET_NUM(v, i) ((v) = VYSE_NUM(i))
+#define VYSE_SET_BOOL(v, b) ((v) = VYSE_BOOL(b))
+#define VYSE_SET_OBJECT(v, o) ((v) = VYSE_OBJECT(o))
+
+#define VYSE_GET_TT(v) ((v).type())
+#define VYSE_CHECK_TT(v, tt) ((v).type() == tt)
+
+#define VYSE_IS_NUM(v) (((v).bits & vy::Value::QNaN) != vy::Value::QNaN or (v).is_int())
+#define VYSE_IS_INT(v) ((v).is_int())
+#define VYSE_IS_BOOL(v) (((v).bits | 1) == vy::Value::TrueBits)
+#define VYSE_IS_NIL(v) ((v).bits == vy::Value::NilBits)
+#define VYSE_IS_UNDEFINED(v) ((v).bits == vy::Value::UndefBits)
+#define VYSE_IS_OBJECT(v) (((v).bits & vy::Value::ObjectTag) == vy::Value::ObjectTag)
+
+#define VYSE_AS_NUM(v) ((v).as_num())
+#define VYSE_AS_INT(v) (vy::s32(vy::u32((v).bits)))
+#define VYSE_AS_BOOL(v) ((v).bits == vy::Value::TrueBits)
+#define VYSE_AS_OBJECT(v) (reinterpret_cast<vy::Obj*>((v).bits & vy::Value::PayloadMask))
+
+#endif
 #define VYSE_ASSERT_TT(v, tt) (VYSE_ASSERT(VYSE_CHECK_TT((v), tt), "Mismatched type tags."))
 #define VYSE_ASSERT_OT(v, ot)                                                                      \
 	(VYSE_ASSERT((VYSE_AS_OBJECT(v)->tag == ot), "Mismatched object types."))
 #define VYSE_TYPE_CSTR(v) (value_type_name(v))
 
-#define VYSE_IS_NUM(v) ((v).tag == vy::ValueType::Number)
-#define VYSE_IS_BOOL(v) ((v).tag == vy::ValueType::Bool)
 #define VYSE_IS_FALSE(v) (VYSE_IS_BOOL(v) and !VYSE_AS_BOOL(v))
 #define VYSE_IS_TRUE(v) (VYSE_IS_BOOL(v) and VYSE_AS_BOOL(v))
-#define VYSE_IS_NIL(v) ((v).tag == vy::ValueType::Nil)
-#define VYSE_IS_UNDEFINED(v) ((v).tag == vy::ValueType::Undefined)
-#define VYSE_IS_OBJECT(v) ((v).tag == vy::ValueType::Object)
 
 #define VYSE_IS_STRING(v) (VYSE_IS_OBJECT(v) and VYSE_AS_OBJECT(v)->tag == vy::ObjType::string)
 #define VYSE_IS_TABLE(v) (VYSE_IS_OBJECT(v) and VYSE_AS_OBJECT(v)->tag == vy::ObjType::table)
@@ -144,10 +261,6 @@ void print_value(Value v);
 #define VYSE_IS_FALSY(v) ((VYSE_IS_BOOL(v) and !(VYSE_AS_BOOL(v))) or VYSE_IS_NIL(v))
 #define VYSE_IS_TRUTHY(v) (!VYSE_IS_FALSY(v))
 
-#define VYSE_AS_NUM(v) ((v).as.num)
-#define VYSE_AS_BOOL(v) ((v).as.boolean)
-#define VYSE_AS_NIL(v) ((v).as.double)
-#define VYSE_AS_OBJECT(v) ((v).as.object)
 #define VYSE_AS_CLOSURE(v) (static_cast<vy::Closure*>(VYSE_AS_OBJECT(v)))
 #define VYSE_AS_CCLOSURE(v) (static_cast<vy::CClosure*>(VYSE_AS_OBJECT(v)))
 #define VYSE_AS_PROTO(v) (static_cast<vy::CodeBlock*>(VYSE_AS_OBJECT(v)))
@@ -171,6 +284,17 @@ inline constexpr bool is_integer(number num) noexcept {
 	return num == s64(num);
 }
 
+/// @brief Whether [num] can be stored as an integer Value without losing precision.
+inline constexpr bool fits_int(s64 num) noexcept {
+	return num >= INT32_MIN and num <= INT32_MAX;
+}
+
+/// @brief Returns [num] as an integer Value when it fits in one, and as a double otherwise.
+/// This is used to promote the results of integer arithmetic that overflows.
+inline Value int_or_num(s64 num) noexcept {
+	return fits_int(num) ? VYSE_INT(num) : VYSE_NUM(num);
+}
+
 template <typename T>
 inline constexpr T value_get(Value const& value) {
 	if constexpr (std::is_arithmetic_v<T>) {
@@ -2,11 +2,14 @@
 #include "common.hpp"
 #include "compiler.hpp"
 #include "gc.hpp"
+#include "jit.hpp"
 #include "libloader.hpp"
+#include "op_profile.hpp"
 #include "table.hpp"
 #include "userdata.hpp"
 #include "value.hpp"
 #include "vm_stack.hpp"
+#include <array>
 #include <functional>
 #include <source.hpp>
 #include <unordered_map>
@@ -65,6 +68,16 @@ inline void default_print_fn([[maybe_unused]] const VM& vm, const String* string
 void default_error_fn(VM& vm, RuntimeError error);
 char* default_readline(const VM& vm);
 
+/// @brief The instruction set that the VM compiles functions to, and runs them with.
+enum class Tier : u8 {
+	/// Instructions that operate on the top of the value stack (see x_opcode.hpp).
+	Stack,
+	/// Three address instructions that operate on the slots of a call frame (see
+	/// x_reg_opcode.hpp). Functions that the compiler cannot translate to these still run on the
+	/// stack tier.
+	Register,
+};
+
 struct VMConfig {
 	/// @brief function used by the VM to print a string to console.
 	PrintFn print = default_print_fn;
@@ -76,6 +89,24 @@ struct VMConfig {
 	/// @brief function used by the VM to load a module's source code. this is called whenever the
 	/// [import] global function is invoked in a Vyse script.
 	ModuleLoader load_module = nullptr;
+
+	/// @brief The instruction set that scripts are compiled to.
+	Tier tier = Tier::Stack;
+
+	/// @brief Whether functions running on the stack tier are compiled to native code once they
+	/// get hot. This only has an effect on x86-64 Linux, see `Jit`.
+	bool jit = false;
+	/// @brief The number of calls and loop iterations after which a function is compiled.
+	u32 jit_threshold = 1000;
+	/// @brief Whether the JIT lists the functions that it compiles in `/tmp/perf-<pid>.map`, so
+	/// that `perf` can tell which vyse function the time in native code was spent in.
+	bool jit_perf_map = false;
+
+	/// @brief The directory in which the bytecode of imported modules is cached, so that they are
+	/// only compiled again when they change. When this is empty, the directory in the `VYSE_CACHE`
+	/// environment variable is used instead, and modules are not cached if that isn't set either.
+	/// The directory can be shared by any number of VMs and processes. See `DynLoader`.
+	std::string compile_cache;
 };
 
 enum class ExitCode {
@@ -89,10 +120,15 @@ class VM {
 	// The garbage collector needs access to the VM's root object set.
 	friend GC;
 	friend Compiler;
+	friend PreparedCall;
+	// Native code compiled by the JIT runs instructions through the VM's internals.
+	friend Jit;
+	friend struct JitRuntime;
 
 	// The library loader needs access to the VM's cached libraries.
 	friend Value load_std_module(VM& vm, int argc);
 	friend Value load_module_from_fs(VM& vm, int argc);
+	friend DynLoader;
 
   public:
 
@@ -132,6 +168,14 @@ class VM {
 	}
 
 	VM() : m_gc(*this) {}
+
+	explicit VM(VMConfig config)
+		: print{config.print}, on_error{config.error}, read_line{config.read},
+		  find_module{config.load_module}, m_config{std::move(config)}, m_gc(*this) {
+		if (m_config.jit) m_jit = std::make_unique<Jit>(*this, m_config.jit_perf_map);
+		m_native = m_config.jit;
+	}
+
 	~VM();
 
 	ExitCode interpret();
@@ -145,13 +189,18 @@ class VM {
 		size_t ip = 0;
 
 		/// The base of the Callframe in the VM's
-		/// value stack. This denotes the first
+		/// value stack. This denotes the index of the first
 		/// slot usable by the CallFrame. All local variables
 		/// are represented as a stack offsets from this base.
-		Value* base = nullptr;
+		/// Being an index, it stays valid when the stack is moved.
+		size_t base = 0;
 
-		CallFrame* next = nullptr;
-		CallFrame* prev = nullptr;
+		/// The number of call frames that tail calls have discarded in favor of this one.
+		u32 num_elided = 0;
+
+		/// The number of extra arguments of a variadic function that keeps them on the stack. They
+		/// are right below `base`, where the slot for the function's return value begins.
+		u32 num_varargs = 0;
 
 		[[nodiscard]] bool is_cclosure() const noexcept {
 			return func->tag == ObjType::c_closure;
@@ -161,7 +210,7 @@ class VM {
 	/// @brief Get the [num]th argument of the current function.
 	/// `get_arg(0)` returns the first argument.
 	inline Value& get_arg(u8 idx) const {
-		return m_current_frame->base[idx + 1];
+		return frame_base(*m_current_frame)[idx + 1];
 	}
 
 	/// @brief Returns the currently exceuting function wrapped in a value.
@@ -171,23 +220,51 @@ class VM {
 
 	/// @brief Returns the base of the current call frame.
 	inline Value const* base() const noexcept {
-		return m_current_frame->base;
+		return frame_base(*m_current_frame);
 	}
 
 	/// @brief Returns the base of the current callframe
 	inline Value* base() noexcept {
-		return m_current_frame->base;
+		return frame_base(*m_current_frame);
+	}
+
+	/// @brief Returns a pointer to the first stack slot of [frame].
+	inline Value* frame_base(const CallFrame& frame) const noexcept {
+		return m_stack.values + frame.base;
 	}
 
 	bool init();
 
 	ExitCode runcode(std::string code);
+	/// @brief Runs the script in [file], or [code] if it isn't empty. Bytecode files and images are
+	/// loaded instead of compiled.
 	ExitCode runfile(std::string file, std::string code = "");
+	/// @brief Runs the script of an AOT module, with it's functions in native code.
+	ExitCode runaot(const AotModule& module);
 	ExitCode run();
 
+	/// @brief The configuration that the VM was created with.
+	const VMConfig& config() const noexcept {
+		return m_config;
+	}
+
 	/// @brief Compile [source] and return a `Closure` which when called will execute [source.code]
 	Closure* compile(SourceCode source);
 
+	/// @brief Compiles the script of [module], and attaches the functions of the module to the
+	/// functions that the script compiles to (see aot.hpp). Functions whose bytecode has changed
+	/// since the module was generated are interpreted instead.
+	Closure* compile(const AotModule& module);
+
+	/// @brief Loads a script from the contents of a bytecode file (see bytecode.hpp), and returns a
+	/// `Closure` which when called will run it. The script imports files relative to [path]. A file
+	/// that can't be loaded is reported as a compile error.
+	Closure* load_bytecode(std::string path, std::string_view bytes);
+
+	/// @brief Loads the script in a bytecode image (see bytecode.hpp), and returns a `Closure`
+	/// which when called will run it. The script imports files relative to [path].
+	Closure* load_image(std::string path, BytecodeImage& image);
+
 	/// @brief Load the base vyse standard library.
 	void load_stdlib();
 
@@ -196,6 +273,10 @@ class VM {
 		return m_current_block;
 	}
 
+	/// @brief Sums up the hits and misses of the inline caches in all functions that are
+	/// currently alive. This is meant to be used for tuning the caches.
+	InlineCacheStats ic_stats() const noexcept;
+
 	/// @brief constructs an object of type [T], registers it with the VM and returns a reference to
 	/// the newly created object.
 	template <typename T, typename... Args>
@@ -206,6 +287,7 @@ class VM {
 		static_assert(!std::is_same_v<T, String>, "Use 'VM::make_string' to make string objects.");
 		static_assert(!std::is_same_v<T, UserData>,
 					  "Use 'VM::make_udata' to make UserData objects.");
+		static_assert(!std::is_same_v<T, Closure>, "Use 'VM::make_closure' to make closures.");
 
 		T* object = new T(std::forward<Args>(args)...);
 		register_object(object);
@@ -219,6 +301,14 @@ class VM {
 		return *udata;
 	}
 
+	/// @brief Creates a closure of [code], with room for [num_upvals] captured variables that are
+	/// all nil to begin with.
+	Closure& make_closure(CodeBlock* code, u32 num_upvals);
+
+	/// @brief returns the closure of a function that captures no variables. It is made the first
+	/// time, and reused by every later evaluation of the function.
+	Closure& shared_closure(CodeBlock* code);
+
 	/// TODO: Refactor this logic out from vm.hpp to gc.cpp
 	inline void register_object(Obj* o) noexcept {
 		VYSE_ASSERT(o != nullptr, "Attempt to register NULL object.");
@@ -316,6 +406,11 @@ class VM {
 	void set_global(String* name, Value value);
 	void set_global(const char* name, Value value);
 
+	/// @brief returns the index of the slot that holds the global variable [name], reserving a
+	/// new slot if it doesn't have one yet. The slot of a global that hasn't been assigned to
+	/// holds `VYSE_UNDEF`. Slots are never freed, so compiled code can refer to them by index.
+	u32 global_slot(String* name);
+
 	/// @brief loads the prototypes of all primitive data types.
 	void load_primitives();
 
@@ -324,6 +419,11 @@ class VM {
 	/// @param message The error message.
 	ExitCode runtime_error(std::string const& message);
 
+	/// @brief Returns true if a runtime error has been reported since the VM last started running.
+	[[nodiscard]] bool has_error() const noexcept {
+		return m_has_error;
+	}
+
 	/// @brief Prototypes for primitive data types.
 	struct PrimitiveProtos {
 		Table* string = nullptr;
@@ -363,9 +463,10 @@ class VM {
 	// upvalue pointing to the highest value on the stack.
 	Upvalue* m_open_upvals = nullptr;
 
-	/// the call stack is internally a linked list, the base call frame is always fixed and
-	/// initalized when the VM is constructed.
-	CallFrame* const base_frame = new CallFrame;
+	/// The call stack. Frames are never allocated during a call, the frame at index `i` is the
+	/// `i`th function call made. The first one is the base call frame that runs the script.
+	std::array<CallFrame, MaxCallStack> m_frames;
+	CallFrame* const base_frame = m_frames.data();
 
 	/// The topmost callframe that the VM is currently executing in.
 	CallFrame* m_current_frame = base_frame;
@@ -377,38 +478,133 @@ class VM {
 	// are being read. This is always `m_current_frame->func->block`
 	const Block* m_current_block = nullptr;
 
+	/// @brief The root of the shape tree shared by all tables created from object literals.
+	Shape m_root_shape;
+
+#ifdef VYSE_PROFILE_OPCODES
+	/// @brief Counts of the instruction sequences that ran, see `OpProfile`.
+	OpProfile m_op_profile;
+#endif
+
 	// Vyse interns all strings. If two separate string values are identical, they point
 	// to the same object in heap. To deduplicate strings, we use a table.
 	Table interned_strings;
 
-	/// @brief A map of all global variables.
+	/// @brief The values of all global variables, indexed by their slots. Compiled code accesses
+	/// globals by slot, and only the C++ API has to look a name up in `m_global_slots`.
+	std::vector<Value> m_globals;
+	/// @brief The name of the global variable in each slot.
+	std::vector<String*> m_global_names;
+	/// @brief The slot of every global variable.
 	/// Since vyse strings are interned, using a `String*` as the key does not lead to any
 	/// problems.
-	std::unordered_map<String*, Value> m_global_vars;
+	std::unordered_map<String*, u32> m_global_slots;
+
+	/// @brief Compiles hot functions to native code, if `VMConfig::jit` is set.
+	std::unique_ptr<Jit> m_jit;
 
 	/// @brief Compile the current source and return a `Closure` which when called will execute
 	/// [code]
 	[[nodiscard]] Closure* compile_source();
 
+	/// @brief Whether functions may have native code, from the JIT or from an AOT module. The
+	/// interpreter only looks for native code to run when this is set.
+	bool m_native = false;
+
+	/// @brief Counts a call to the function in the current call frame, or a jump back in one of
+	/// it's loops, and runs the function in native code from `ip` if it has been compiled. If the
+	/// JIT is enabled, functions that get hot enough are compiled first.
+	JitExit run_native();
+
+	/// @brief Runs [code], which must have native code, from `ip` in the current call frame.
+	JitExit run_compiled(const CodeBlock& code);
+
+	/// @brief Runs the function in the current call frame, and the functions that it calls, with
+	/// the register tier's interpreter loop until the function returns. The current block must
+	/// have register code.
+	ExitCode run_registers();
+
+	/// @brief Sets up the registers of a call frame that was just pushed for a function with
+	/// register code. The registers past the arguments start out as nil, and the stack top is
+	/// moved past the last register.
+	void enter_register_frame();
+
+	/// @brief Makes the current call frame's function the running one again, after a function
+	/// that it called has returned from a nested interpreter loop.
+	void restore_frame() noexcept {
+		VYSE_ASSERT(m_current_frame->func->tag == ObjType::closure, "Frame does not run code.");
+		m_current_block = &static_cast<Closure*>(m_current_frame->func)->m_codeblock->block();
+		ip = m_current_frame->ip;
+	}
+
+	/// @brief Calls the overload of the binary operator whose protomethod name is [method] with [l]
+	/// and [r] from the register tier, and runs it to completion.
+	/// @param result Set to the value returned by the overload.
+	/// @return true if the call succeeded, false if there was an error.
+	bool run_binary_overload(const char* op_str, const char* method, Value l, Value r,
+							 Value& result);
+
+	/// @brief Like `run_binary_overload`, for the overload of a unary operator. Returns false
+	/// without reporting an error if [operand] has no such overload.
+	bool run_unary_overload(const char* method, Value operand, Value& result);
+
+	/// @brief Runs the function that a call from the register tier pushed a frame for, if there is
+	/// one. Calls to native functions are already done by the time they return.
+	/// @param frame_count The number of call frames there were before the call.
+	bool finish_call(u32 frame_count);
+
+	/// @brief Runs the function that a call from the stack tier pushed a frame for, if that
+	/// function runs on the register tier. Functions that run on the stack tier are instead run in
+	/// the caller's interpreter loop, after running in native code for as long as they can if the
+	/// JIT is enabled.
+	bool run_register_callee();
+
 	/// @brief Call any callable value from within the VM. Note that this is only used to call
 	/// instructions from inside a vyse script. To call anything from a C/C++ program, the
 	/// `VM::call` method is used instead.
 	bool op_call(Value value, u8 argc);
 
+	/// @brief Calls the value below the top [argc] values on the stack in place of the current
+	/// function. The current call frame is popped first, and the callee and arguments are moved
+	/// down to it's base. A closure callee then gets a call frame at the same depth, while a native
+	/// one returns right away, leaving it's result where the current function's would have been.
+	bool op_tail_call(u8 argc);
+
 	/// @brief Call a vyse closure which has `argc` args on the stack.
 	bool call_closure(Closure* func, int argc);
 
 	/// @brief Call a C closure which has `argc` args on the stack.
 	bool call_cclosure(CClosure* cclosure, int argc) noexcept(false);
 
+	/// @brief Call a C closure that uses the status returning ABI. Its arity is checked before the
+	/// call, and no call frame is pushed unless the function re-enters the VM.
+	bool call_fast_cclosure(CClosure* cclosure, int argc);
+
+	/// @brief Returns true if `cclosure` can be called without pushing a call frame.
+	static bool is_frameless(const CClosure* cclosure) noexcept {
+		return cclosure->is_fast() and !cclosure->reenters_vm();
+	}
+
 	/// @brief Prepares the VM's stack for a varioadic function call.
-	/// All the extra args are placed in a list, which is then pushed on top of the stack.
+	/// All the extra args are placed in a list, which is then pushed on top of the stack. If the
+	/// function keeps them on the stack, then they are moved below the function being called, and
+	/// the rest parameter is nil. Either way the arguments on the stack then match the parameters.
+	/// @param code The function being called.
 	/// @param num_args number of arguments provided to the call.
-	/// @param num_params Number of parameters as mentioned in the function declaration. The last
-	/// argument must be a variadic arg.
-	/// @return The number of arguments that are on the stack after the varargs have been moved to a
-	/// list.
-	int prep_vararg_call(int num_params, int num_args);
+	/// @return The number of extra arguments kept on the stack.
+	u32 prep_vararg_call(const CodeBlock& code, int num_args);
+
+	/// @brief Sets [result] to the number of extra arguments of the current function, which keeps
+	/// them on the stack. Reports the same error as `#nil` when there are none, since the rest
+	/// parameter is nil then.
+	/// @return true if there are extra arguments, false if there is an error.
+	bool get_vararg_len(Value& result);
+
+	/// @brief Sets [result] to the extra argument at [index] of the current function, which keeps
+	/// them on the stack. Reports the same errors as indexing a list, or indexing nil when there
+	/// are no extra arguments.
+	/// @return true if the indexing succeeds, false if there is an error.
+	bool get_vararg(const Value& index, Value& result);
 
 	/// @brief Get a value's prototype.
 	/// If no prototype is found, returns `nullptr`.
@@ -437,6 +633,22 @@ class VM {
 		return VYSE_NIL;
 	}
 
+	/// @brief return the method [key] of [object] for a method call. The lookup starts at [object]
+	/// if it is a table, and at it's prototype otherwise, and goes through the inline [cache] of
+	/// the instruction making the call.
+	inline Value get_method(const Value& object, const Value& key, InlineCache& cache) {
+		const Table* table = VYSE_IS_TABLE(object) ? VYSE_AS_TABLE(object) : get_proto(object);
+		if (table == nullptr) return VYSE_NIL;
+
+		Value method;
+		if (table->get_cached(key, cache, method)) {
+			++cache.hits;
+			return method;
+		}
+		++cache.misses;
+		return table->get_and_cache(key, cache);
+	}
+
 	/// @brief Make an un-interned string object and return a reference to the said object. Note
 	/// that this function must only be called interally in the VM in places where string interning
 	/// is taken care of explicitly.
@@ -510,6 +722,13 @@ class VM {
 	/// function call, which is the toplevel userscript.
 	void invoke_script(Closure* closure);
 
+	/// @brief Runs [script], a script that was loaded or compiled without errors unless it's
+	/// nullptr.
+	ExitCode run_script(Closure* script);
+
+	/// @brief Reports [message] as a compile error in the current source.
+	void load_error(const std::string& message);
+
 	/// @brief Add new active source code.
 	inline void add_source(std::string&& code, std::string&& file_name = "<script>") {
 		m_sources.push_back({std::move(file_name), std::move(code)});
@@ -544,6 +763,13 @@ class VM {
 	/// @param slot A `Value*` pointing to a value inside the VM's value stack.
 	Upvalue* capture_upvalue(Value* slot);
 
+	/// @brief Fills in the capture at [idx] of a [closure] that is being created, as described by
+	/// one pair of the operands of `make_func`.
+	/// @param flags The `CaptureLocal` and `CaptureByValue` flags of the captured variable.
+	/// @param slot The stack slot of the captured local, used when [flags] has `CaptureLocal`.
+	/// @param index The index of the capture in the enclosing closure, used otherwise.
+	void capture_variable(Closure& closure, u8 idx, u8 flags, Value* slot, u8 index);
+
 	// close all the upvalues that are present between the top of the stack and [last].
 	// [last] must point to some value in the VM's stack.
 	void close_upvalues_upto(Value* last);
@@ -9,6 +9,8 @@ namespace vy {
 class VMStack final {
 	friend VM;
 	friend GC;
+	friend PreparedCall;
+	friend struct JitRuntime;
 	VYSE_NO_COPY(VMStack);
 	VYSE_NO_MOVE(VMStack);
 
@@ -0,0 +1,81 @@
+// Note: This file is an XMacro, like x_opcode.hpp. It lists the runtime functions that native code
+// from the JIT and the AOT compiler calls, see jit_runtime.hpp.
+// The operands that a function takes in `a`, `b` and `c` are described next to it.
+// JIT_HELPER(name)
+
+// Arithmetic, comparisons and bitwise operators on the two values on top of the stack.
+JIT_HELPER(add)
+JIT_HELPER(sub)
+JIT_HELPER(mult)
+JIT_HELPER(div)
+JIT_HELPER(mod)
+JIT_HELPER(exp)
+JIT_HELPER(gt)
+JIT_HELPER(lt)
+JIT_HELPER(gte)
+JIT_HELPER(lte)
+JIT_HELPER(eq)
+JIT_HELPER(neq)
+JIT_HELPER(lshift)
+JIT_HELPER(rshift)
+JIT_HELPER(band)
+JIT_HELPER(bxor)
+JIT_HELPER(bor)
+JIT_HELPER(concat)
+
+// Unary operators on the value on top of the stack.
+JIT_HELPER(negate)
+JIT_HELPER(len)
+JIT_HELPER(bnot)
+
+JIT_HELPER(get_global)	// a: the variable's `GlobalRef`
+JIT_HELPER(set_global)	// a: the variable's `GlobalRef`
+JIT_HELPER(get_upval)	// a: the index of the upvalue
+JIT_HELPER(set_upval)	// a: the index of the upvalue
+JIT_HELPER(get_capture) // a: the index of the capture
+JIT_HELPER(close_upval)
+
+JIT_HELPER(new_table)
+JIT_HELPER(new_list)
+JIT_HELPER(table_add_field)
+JIT_HELPER(list_append)
+
+// a: the key in the constant pool, b: the `InlineCache`
+JIT_HELPER(table_get)
+JIT_HELPER(table_get_no_pop)
+JIT_HELPER(table_set)
+JIT_HELPER(prep_method_call)
+JIT_HELPER(invoke) // also c: the argument count
+
+JIT_HELPER(subscript_get)
+JIT_HELPER(subscript_set)
+JIT_HELPER(index_no_pop)
+JIT_HELPER(vararg_len)
+JIT_HELPER(vararg_get)
+
+JIT_HELPER(call_func) // a: the argument count
+JIT_HELPER(make_func) // a: the `make_func` instruction in the block
+JIT_HELPER(return_val)
+// Hands the function to the interpreter at the instruction at `ip`.
+JIT_HELPER(side_exit)
+
+JIT_HELPER(for_prep)
+JIT_HELPER(for_loop) // returns `Branch` to run the loop's body again
+
+// The fused comparisons return `Branch` when the comparison is false.
+// a: the slot of the local on the left, b: the slot of the local on the right
+JIT_HELPER(eq_var_var_jmp)
+JIT_HELPER(neq_var_var_jmp)
+JIT_HELPER(gt_var_var_jmp)
+JIT_HELPER(lt_var_var_jmp)
+JIT_HELPER(gte_var_var_jmp)
+JIT_HELPER(lte_var_var_jmp)
+// a: the slot of the local, b: the constant on the right
+JIT_HELPER(eq_var_const_jmp)
+JIT_HELPER(neq_var_const_jmp)
+JIT_HELPER(gt_var_const_jmp)
+JIT_HELPER(lt_var_const_jmp)
+JIT_HELPER(gte_var_const_jmp)
+JIT_HELPER(lte_var_const_jmp)
+// Also does the `set_var` that follows. a: the slot of the local, b: the constant
+JIT_HELPER(add_var_const)
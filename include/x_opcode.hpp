@@ -11,10 +11,39 @@
 // for usage, see debug.cpp, opcode.hpp and compiler.cpp
 
 // OP(name, arity, stack_effect),
-OP(load_const, 1, 1), OP(get_global, 1, 1), OP(set_global, 1, -1), OP(table_get, 1, 0),
-	OP(table_set, 1, -1), OP(table_get_no_pop, 1, 1), OP(set_var, 1, -1), OP(get_var, 1, 1),
-	OP(set_upval, 1, -1), OP(get_upval, 1, 1), OP(make_func, -1, 1), /* special arity */
-	OP(prep_method_call, 1, 1),
+OP(load_const, 1, 1), OP(get_global, 1, 1), OP(set_global, 1, -1),
+
+	// Field accesses with a constant string key. The first operand is the index of the key in
+	// the constant pool and the second is the index of the instruction's inline cache in the block.
+	OP(table_get, 2, 0), OP(table_set, 2, -1), OP(table_get_no_pop, 2, 1),
+	OP(prep_method_call, 2, 1),
+	// `obj:m(args...)` in a single instruction, in place of `prep_method_call` and `call_func`. The
+	// third operand is the argument count, including `obj`. Looks `m` up once the arguments are on
+	// the stack, so the compiler only emits it when they can't change what `obj:m` refers to.
+	OP(invoke, 3, 0), /* special stack effect */
+	/* quickened table_get, for a receiver that is a table */
+	OP(table_get_str_key, 2, 0),
+
+	// Fused instructions, emitted by the compiler in place of a common sequence of instructions.
+	// The first operand is the slot of a local variable, and the second one is either the slot of
+	// another local (*_var_var) or the index of a constant (*_var_const).
+	// Each one is the prefix of the instruction that follows it, which is always emitted too.
+	//
+	// The comparisons are followed by a `pop_jmp_if_false`. When both operands are numbers (or for
+	// eq and neq, always) they compare them and branch right away, skipping over the jump.
+	// Otherwise they push the result of the generic comparison, and let the jump test it.
+	OP(eq_var_var_jmp, 2, 1), OP(neq_var_var_jmp, 2, 1), OP(gt_var_var_jmp, 2, 1),
+	OP(lt_var_var_jmp, 2, 1), OP(gte_var_var_jmp, 2, 1), OP(lte_var_var_jmp, 2, 1),
+	OP(eq_var_const_jmp, 2, 1), OP(neq_var_const_jmp, 2, 1), OP(gt_var_const_jmp, 2, 1),
+	OP(lt_var_const_jmp, 2, 1), OP(gte_var_const_jmp, 2, 1), OP(lte_var_const_jmp, 2, 1),
+
+	// Followed by a `set_var` to the same local. Adds the constant to the local in place when both
+	// are numbers, skipping the `set_var`. Otherwise it pushes the generic sum for the `set_var`.
+	OP(add_var_const, 2, 1),
+
+	OP(set_var, 1, -1), OP(get_var, 1, 1), OP(set_upval, 1, -1), OP(get_upval, 1, 1),
+	OP(get_capture, 1, 1), /* reads a variable that the closure captured by value */
+	OP(make_func, -1, 1), /* special arity */
 
 	// Note that calling function pushes a new call
 	// frame onto the stack, therefore it does not count
@@ -22,6 +51,11 @@ OP(load_const, 1, 1), OP(get_global, 1, 1), OP(set_global, 1, -1), OP(table_get,
 	// closure.
 	OP(call_func, 1, 0), /* special stack effect */
 
+	// Emitted in place of the `call_func` in `return f(...)`. Calls the function in the current
+	// call frame, which is discarded first, so the callee returns straight to the caller of the
+	// current function. Never falls through to the `return_val` that still follows it.
+	OP(tail_call, 1, 0),
+
 	OP(pop, 0, -1),
 
 	// binary ops
@@ -30,6 +64,13 @@ OP(load_const, 1, 1), OP(get_global, 1, 1), OP(set_global, 1, -1), OP(table_get,
 	OP(rshift, 0, -1), OP(band, 0, -1), OP(bxor, 0, -1), OP(bor, 0, -1), OP(gt, 0, -1),
 	OP(lt, 0, -1), OP(gte, 0, -1), OP(lte, 0, -1),
 
+	// Quickened versions of the arithmetic and comparison operators, for two number operands.
+	// The compiler never emits these. Instead the interpreter rewrites the generic instructions
+	// into them once they have only been seen operating on numbers (see `Block::quicken`).
+	OP(add_num_num, 0, -1), OP(sub_num_num, 0, -1), OP(mult_num_num, 0, -1),
+	OP(gt_num_num, 0, -1), OP(lt_num_num, 0, -1), OP(gte_num_num, 0, -1),
+	OP(lte_num_num, 0, -1),
+
 	/// Insert the value at PEEK(1) into the array PEEK(2)
 	/// and pop top
 	/// el = POP()
@@ -61,6 +102,12 @@ OP(load_const, 1, 1), OP(get_global, 1, 1), OP(set_global, 1, -1), OP(table_get,
 	// INDEX = POP(); LIST = POP();
 	// PUSH(LIST[INDEX])
 	OP(subscript_get, 0, -1),
+	OP(subscript_get_list_num, 0, -1), // quickened subscript_get, for a list and a number index
+
+	// The `len` and `subscript_get` on a rest parameter that stays on the stack, in place of a list
+	// (see `Compiler::keep_varargs_on_stack`). The value below the index, or the one whose length
+	// is taken, is the rest parameter's slot, which only holds nil.
+	OP(vararg_len, 0, 0), OP(vararg_get, 0, -1),
 
 	// INDEX = PEEK(1); LIST = PEEK(2);
 	// PUSH(LIST[INDEX])
@@ -98,4 +145,13 @@ OP(load_const, 1, 1), OP(get_global, 1, 1), OP(set_global, 1, -1), OP(table_get,
 	///   ip -= AB
 	OP(for_loop, 2, 0),
 
+	// Superinstructions, generated from a profile of hot instruction sequences. See
+	// x_superinstr.hpp. A superinstruction replaces only the first opcode of its sequence, and
+	// takes the same operands as that first instruction.
+#define SUPER2(name, _, __) OP(name, -1, 0),
+#define SUPER3(name, _, __, ___) OP(name, -1, 0),
+#include "x_superinstr.hpp"
+#undef SUPER2
+#undef SUPER3
+
 	OP(no_op, -1, 0),
@@ -0,0 +1,109 @@
+// Note: This file is an XMacro, like x_opcode.hpp. It lists the instructions of the register tier
+// (see reg_opcode.hpp), along with the layout of their operands.
+// For usage, see reg_opcode.hpp, debug.cpp and vm.cpp
+
+// R[n] is the register (frame slot) n, K[n] is the constant at index n in the constant pool, and
+// G[n] is the global variable at index n in the block's `globals` list.
+// REG_OP(name, format)
+REG_OP(move, AB)	   // R[a] = R[b]
+REG_OP(load_const, AK) // R[a] = K[b]
+REG_OP(load_nil, A)	   // R[a] = nil
+
+REG_OP(get_global, AG) // R[a] = G[b]
+REG_OP(set_global, AG) // G[b] = R[a]
+REG_OP(get_upval, AU)  // R[a] = upvalues[b]
+REG_OP(set_upval, AU)  // upvalues[b] = R[a]
+REG_OP(get_capture, AU) // R[a] = captures[b], for a variable captured by value
+REG_OP(close_upval, A) // closes the upvalues that point to R[a] or above
+
+// R[a] = R[b] op R[c]
+REG_OP(add, ABC)
+REG_OP(sub, ABC)
+REG_OP(mult, ABC)
+REG_OP(div, ABC)
+REG_OP(mod, ABC)
+REG_OP(exp, ABC)
+REG_OP(concat, ABC)
+REG_OP(lshift, ABC)
+REG_OP(rshift, ABC)
+REG_OP(band, ABC)
+REG_OP(bxor, ABC)
+REG_OP(bor, ABC)
+REG_OP(eq, ABC)
+REG_OP(neq, ABC)
+REG_OP(gt, ABC)
+REG_OP(lt, ABC)
+REG_OP(gte, ABC)
+REG_OP(lte, ABC)
+
+// R[a] = R[b] op K[c]
+REG_OP(add_k, ABK)
+REG_OP(sub_k, ABK)
+REG_OP(mult_k, ABK)
+REG_OP(div_k, ABK)
+REG_OP(mod_k, ABK)
+REG_OP(eq_k, ABK)
+REG_OP(neq_k, ABK)
+REG_OP(gt_k, ABK)
+REG_OP(lt_k, ABK)
+REG_OP(gte_k, ABK)
+REG_OP(lte_k, ABK)
+
+// R[a] = op R[b]
+REG_OP(negate, AB)
+REG_OP(len, AB)
+REG_OP(bnot, AB)
+REG_OP(lnot, AB)
+
+REG_OP(new_table, A)		   // R[a] = {}
+REG_OP(new_list, A)			   // R[a] = []
+REG_OP(list_append, AB)		   // R[a] <<< R[b]
+REG_OP(table_add_field, ABC)   // R[a][R[b]] = R[c], where R[a] is a table literal
+
+// Field accesses with a constant key, and an inline cache at index x.
+REG_OP(table_get, ABKC)		   // R[a] = R[b].K[c]
+REG_OP(table_set, ABKC)		   // R[a].K[c] = R[b]
+REG_OP(prep_method_call, ABKC) // R[a] = R[b].K[c]; R[a + 1] = R[b]
+
+REG_OP(subscript_get, ABC)	   // R[a] = R[b][R[c]]
+REG_OP(subscript_set, ABC)	   // R[a][R[b]] = R[c]
+
+// Jumps go to the instruction at index x.
+REG_OP(jmp, J)
+REG_OP(jmp_if_false, AJ) // if !R[a] jump
+REG_OP(jmp_if_true, AJ)	 // if R[a] jump
+
+// Compare and branch, on two registers or on a register and a constant. These jump *unless* the
+// comparison holds, like the fused instructions of the stack tier.
+REG_OP(eq_jmp, ABJ)
+REG_OP(neq_jmp, ABJ)
+REG_OP(gt_jmp, ABJ)
+REG_OP(lt_jmp, ABJ)
+REG_OP(gte_jmp, ABJ)
+REG_OP(lte_jmp, ABJ)
+REG_OP(eq_k_jmp, AKJ)
+REG_OP(neq_k_jmp, AKJ)
+REG_OP(gt_k_jmp, AKJ)
+REG_OP(lt_k_jmp, AKJ)
+REG_OP(gte_k_jmp, AKJ)
+REG_OP(lte_k_jmp, AKJ)
+
+// A numeric for loop keeps it's counter, limit, step and the user visible variable in R[a] to
+// R[a + 3]. Both work like the stack tier's instructions of the same name.
+REG_OP(for_prep, AJ)
+REG_OP(for_loop, AJ)
+
+// Calls R[a] with the b arguments in R[a + 1] to R[a + b], and stores the result in R[a].
+// R[a] = the number of extra arguments, and R[a] = the extra argument at the index R[b], for
+// functions that keep their extra arguments on the stack. Used like the stack tier's instructions.
+REG_OP(vararg_len, A)
+REG_OP(vararg_get, AB)
+
+REG_OP(call, Call)
+// Like `call`, but in place of the current function, like the stack tier's `tail_call`.
+REG_OP(tail_call, Call)
+REG_OP(return_val, A) // returns R[a]
+
+// R[a] = a new closure of the codeblock K[b]. The upvalues to capture are described by the
+// operands of the `make_func` instruction at offset x in the block's stack code.
+REG_OP(make_func, Closure)
@@ -0,0 +1,21 @@
+// Generated by benchmark/superinstructions.py. Do not edit by hand, instead regenerate it with a
+// profile of the workloads that matter to you (see the script for how).
+// Trained on: binary-trees.vy, fib-recurs.vy, fib.vy, for.vy, method-call.vy, string-equals.vy
+
+// SUPER2(name, a, b), SUPER3(name, a, b, c), in the order they are tried when several match.
+SUPER3(get_var__get_var__load_const, get_var, get_var, load_const)
+SUPER3(get_var__load_const__sub, get_var, load_const, sub)
+SUPER3(load_const__load_const__eq, load_const, load_const, eq)
+SUPER3(get_var__load_const__subscript_get, get_var, load_const, subscript_get)
+SUPER3(get_var__get_var__table_get, get_var, get_var, table_get)
+SUPER3(set_var__get_var__invoke, set_var, get_var, invoke)
+SUPER3(pop__get_var__return_val, pop, get_var, return_val)
+SUPER2(get_var__get_var, get_var, get_var)
+SUPER2(get_var__load_const, get_var, load_const)
+SUPER2(load_const__sub, load_const, sub)
+SUPER2(get_var__return_val, get_var, return_val)
+SUPER2(load_const__load_const, load_const, load_const)
+SUPER2(load_const__eq, load_const, eq)
+SUPER2(get_var__table_get, get_var, table_get)
+SUPER2(load_const__subscript_get, load_const, subscript_get)
+SUPER2(get_var__list_append, get_var, list_append)
@@ -0,0 +1,1446 @@
+#include <bytecode.hpp>
+#include <compiler.hpp>
+#include <cstring>
+#include <fstream>
+#include <function.hpp>
+#include <optional>
+#include <sstream>
+#include <unordered_map>
+#include <vm.hpp>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define VYSE_MMAP_IMAGES
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace vy {
+
+using Op = Opcode;
+
+namespace {
+
+/// @brief The kinds of constants in a bytecode file.
+enum class ConstantKind : u8 { Nil, False, True, Integer, Number, String, CodeBlock };
+
+enum BlockFlags : u8 {
+	Variadic = 1 << 0,
+	KeepsVarargsOnStack = 1 << 1,
+};
+
+/// @brief A hash of the names and operand counts of all instructions. Bytecode written with a
+/// different instruction set is not loaded, since it's opcodes would mean different things.
+constexpr u32 instruction_set_hash() {
+	constexpr const char* instructions[] = {
+#define OP(name, arity, _) #name "/" #arity
+#include <x_opcode.hpp>
+#undef OP
+#define REG_OP(name, format) #name "/" #format,
+#include <x_reg_opcode.hpp>
+#undef REG_OP
+	};
+
+	// FNV-1a
+	u32 hash = 2166136261u;
+	for (const char* instruction : instructions) {
+		for (const char* c = instruction; *c != '\0'; ++c) {
+			hash = (hash ^ u8(*c)) * 16777619u;
+		}
+		hash = (hash ^ u8(',')) * 16777619u;
+	}
+	return hash;
+}
+
+constexpr u32 InstructionSetHash = instruction_set_hash();
+
+constexpr size_t NumRegOps = 0
+#define REG_OP(name, _) +1
+#include <x_reg_opcode.hpp>
+#undef REG_OP
+	;
+
+/// @brief The deepest that functions may be nested in a bytecode file.
+constexpr u32 MaxNesting = 256;
+
+/// @brief The most stack that a function in a file may ask for. The compiler never needs nearly as
+/// much, since locals and arguments are numbered by a byte.
+constexpr u32 MaxStackSize = UINT16_MAX;
+
+/// @brief Appends the instructions of [block] to [out]. Instructions that have been quickened since
+/// are written as the generic ones, which is what the compiler emitted.
+void append_code(std::string& out, const Block& block) {
+	const size_t start = out.size();
+	out.append(reinterpret_cast<const char*>(block.code.data()), block.code.size());
+	for (size_t i = 0; i < block.code.size(); i += 1 + Compiler::op_arity(block, i)) {
+		out[start + i] = char(generic_op(block.code[i]));
+	}
+}
+
+/// @return [op], or the first instruction of [op] if it is a superinstruction.
+constexpr Op first_op(Op op) noexcept {
+	return op >= Op_super_start and op <= Op_super_end ? superinstruction(op).ops[0] : op;
+}
+
+/// @return The number of values that the instruction at [offset] reads off the top of the stack.
+int op_inputs(const BlockBuffer<Op>& code, size_t offset) {
+	const Op op = first_op(code[offset]);
+	// The fused instructions read locals and constants.
+	if (op >= Op_fused_start and op <= Op_fused_end) return 0;
+
+	switch (op) {
+	case Op::load_const:
+	case Op::get_global:
+	case Op::get_var:
+	case Op::get_upval:
+	case Op::get_capture:
+	case Op::load_nil:
+	case Op::new_table:
+	case Op::new_list:
+	case Op::make_func:
+	case Op::jmp:
+	case Op::jmp_back: return 0;
+
+	case Op::set_global:
+	case Op::table_get:
+	case Op::table_get_no_pop:
+	case Op::prep_method_call:
+	case Op::set_var:
+	case Op::set_upval:
+	case Op::pop:
+	case Op::negate:
+	case Op::len:
+	case Op::bnot:
+	case Op::lnot:
+	case Op::close_upval:
+	case Op::return_val:
+	case Op::vararg_len:
+	case Op::jmp_if_false_or_pop:
+	case Op::jmp_if_true_or_pop:
+	case Op::pop_jmp_if_false: return 1;
+
+	case Op::subscript_set:
+	case Op::table_add_field:
+	case Op::for_prep: return 3;
+	case Op::for_loop: return 4;
+
+	// The receiver, followed by the arguments.
+	case Op::invoke: return int(code[offset + 3]);
+	// The function, followed by the arguments.
+	case Op::call_func:
+	case Op::tail_call: return int(code[offset + 1]) + 1;
+
+	// Binary operators, `table_set`, `list_append` and the subscripts.
+	default: return 2;
+	}
+}
+
+/// @return Whether the instruction at [offset] jumps.
+bool is_jump(const BlockBuffer<Op>& code, size_t offset) {
+	const Op op = code[offset];
+	return op == Op::jmp or op == Op::jmp_back or op == Op::jmp_if_false_or_pop or
+		   op == Op::jmp_if_true_or_pop or op == Op::pop_jmp_if_false or op == Op::for_prep or
+		   op == Op::for_loop;
+}
+
+/// @return The offset that the jump at [offset] goes to, which may be out of the block's bounds.
+s64 jump_target(const BlockBuffer<Op>& code, size_t offset) {
+	const Op op = code[offset];
+	const s64 dist = s64((u8(code[offset + 1]) << 8) | u8(code[offset + 2]));
+	const bool backwards = op == Op::jmp_back or op == Op::for_loop;
+	return backwards ? s64(offset) + 3 - dist : s64(offset) + 3 + dist;
+}
+
+/// @brief How a closure holds one of the variables it captured.
+enum class Capture : u8 { Upvalue, Value };
+
+/// @brief What the code of a function is verified against. The functions in a file or an image are
+/// numbered so that every function comes before the ones nested in it.
+struct FunctionInfo {
+	u32 num_params = 0;
+	u32 num_upvals = 0;
+	u32 stack_size = 0;
+	bool is_variadic = false;
+	bool keeps_varargs_on_stack = false;
+	size_t num_globals = 0;
+	size_t num_inline_caches = 0;
+	/// The kind of every constant, along with the number of the function for nested functions.
+	std::vector<std::pair<ConstantKind, u32>> constants;
+	const RegInstr* reg_code = nullptr;
+	size_t num_reg_instrs = 0;
+	u32 reg_frame_size = 0;
+};
+
+/// @brief Checks that the code of functions that were not compiled by this VM is safe to run. Every
+/// instruction must be whole, and only refer to constants, globals, inline caches, locals and
+/// upvalues that exist. Every jump must land on an instruction, no path may run past the end of
+/// the code, and the stack must never shrink below the function's parameters or grow past the size
+/// that the function declares. The register code is checked likewise.
+class Verifier {
+  public:
+	explicit Verifier(size_t num_functions) : m_captures(num_functions) {}
+
+	/// @brief Verifies the function numbered [index], whose code is in [block]. The functions that
+	/// it is nested in must have been verified before it.
+	/// @return An error message, or nullptr if the function is fine.
+	const char* verify(u32 index, const Block& block, const FunctionInfo& info);
+
+  private:
+	/// How the closures of every function hold their captured variables, as told by the first
+	/// `make_func` instruction that makes them.
+	std::vector<std::optional<std::vector<Capture>>> m_captures;
+
+	const char* check_operands(u32 index, const Block& block, const FunctionInfo& info,
+							   size_t offset);
+	const char* check_sequences(const Block& block, const std::vector<bool>& starts,
+								size_t offset) const;
+	const char* check_depths(const Block& block, const FunctionInfo& info,
+							 const std::vector<bool>& starts) const;
+	const char* check_register_code(u32 index, const Block& block, const FunctionInfo& info,
+									const std::vector<bool>& starts) const;
+
+	/// @return The captured variables of the function numbered [index].
+	const std::vector<Capture>& captures(u32 index) const {
+		static const std::vector<Capture> none;
+		return m_captures[index] ? *m_captures[index] : none;
+	}
+};
+
+const char* Verifier::verify(u32 index, const Block& block, const FunctionInfo& info) {
+	// The script is called with no arguments, and has nothing to capture.
+	if (index == 0) {
+		if (info.num_params != 0 or info.num_upvals != 0) return "invalid function.";
+		m_captures[0].emplace();
+	}
+
+	// The rest parameter is the last parameter of variadic functions.
+	if (info.is_variadic ? info.num_params == 0 : info.keeps_varargs_on_stack) {
+		return "invalid function.";
+	}
+	if (info.stack_size > MaxStackSize) return "invalid function.";
+	if (m_captures[index] and m_captures[index]->size() != info.num_upvals) {
+		return "invalid function.";
+	}
+
+	const BlockBuffer<Op>& code = block.code;
+	const size_t size = code.size();
+	if (size == 0) return "function without code.";
+
+	std::vector<bool> starts(size, false);
+	for (size_t offset = 0; offset < size; offset += 1 + Compiler::op_arity(block, offset)) {
+		const Op op = code[offset];
+		// `no_op`s only exist while the compiler is patching jumps, and instructions are only
+		// quickened while they run.
+		if (u8(op) >= u8(Op::no_op) or generic_op(op) != op) return "invalid instruction.";
+		if (op == Op::make_func and offset + 2 >= size) return "truncated instruction.";
+		if (offset + 1 + Compiler::op_arity(block, offset) > size) return "truncated instruction.";
+		starts[offset] = true;
+		if (const char* const error = check_operands(index, block, info, offset)) return error;
+	}
+
+	for (size_t offset = 0; offset < size; offset += 1 + Compiler::op_arity(block, offset)) {
+		if (const char* const error = check_sequences(block, starts, offset)) return error;
+	}
+
+	if (const char* const error = check_depths(block, info, starts)) return error;
+	return check_register_code(index, block, info, starts);
+}
+
+const char* Verifier::check_operands(u32 index, const Block& block, const FunctionInfo& info,
+									 size_t offset) {
+	const BlockBuffer<Op>& code = block.code;
+	const Op op = first_op(code[offset]);
+	const auto operand = [&](size_t n) { return u8(code[offset + n]); };
+
+	// Constants that are used as values. Nested functions are only used by `make_func`.
+	const auto is_value = [&](u8 k) {
+		return k < info.constants.size() and info.constants[k].first != ConstantKind::CodeBlock;
+	};
+
+	const auto is_string = [&](u8 k) {
+		return k < info.constants.size() and info.constants[k].first == ConstantKind::String;
+	};
+
+	const std::vector<Capture>& upvals = captures(index);
+	const auto is_upvalue = [&](u8 n, Capture kind) {
+		return n < upvals.size() and upvals[n] == kind;
+	};
+
+	switch (op) {
+	case Op::load_const: return is_value(operand(1)) ? nullptr : "invalid constant.";
+
+	case Op::get_global:
+	case Op::set_global: return operand(1) < info.num_globals ? nullptr : "invalid global.";
+
+	case Op::invoke:
+		if (operand(3) == 0) return "invalid instruction.";
+		[[fallthrough]];
+	case Op::table_get:
+	case Op::table_set:
+	case Op::table_get_no_pop:
+	case Op::prep_method_call:
+		if (!is_string(operand(1))) return "invalid constant.";
+		return operand(2) < info.num_inline_caches ? nullptr : "invalid inline cache.";
+
+	// The script has no caller to return to.
+	case Op::tail_call: return index == 0 ? "invalid instruction." : nullptr;
+
+	case Op::get_upval:
+	case Op::set_upval:
+		return is_upvalue(operand(1), Capture::Upvalue) ? nullptr : "invalid upvalue.";
+	case Op::get_capture:
+		return is_upvalue(operand(1), Capture::Value) ? nullptr : "invalid upvalue.";
+
+	case Op::make_func: {
+		const u8 k = operand(1);
+		if (k >= info.constants.size() or info.constants[k].first != ConstantKind::CodeBlock) {
+			return "invalid constant.";
+		}
+
+		const u32 nested = info.constants[k].second;
+		if (nested <= index or nested >= m_captures.size()) return "invalid constant.";
+
+		std::vector<Capture> nested_upvals;
+		for (u8 i = 0; i < operand(2); ++i) {
+			const u8 flags = operand(3 + 2 * i);
+			const u8 slot = operand(4 + 2 * i);
+			if ((flags & ~(CaptureLocal | CaptureByValue)) != 0) return "invalid upvalue.";
+			// Locals are checked along with the depth of the stack.
+			if (flags & CaptureLocal) {
+				nested_upvals.push_back(flags & CaptureByValue ? Capture::Value : Capture::Upvalue);
+			} else if (slot < upvals.size()) {
+				nested_upvals.push_back(upvals[slot]);
+			} else {
+				return "invalid upvalue.";
+			}
+		}
+
+		std::optional<std::vector<Capture>>& expected = m_captures[nested];
+		if (!expected) {
+			expected = std::move(nested_upvals);
+		} else if (*expected != nested_upvals) {
+			return "invalid upvalue.";
+		}
+		return nullptr;
+	}
+
+	default:
+		// The constant operand of `*_var_const_jmp` and `add_var_const`.
+		if (op >= Op::eq_var_const_jmp and op <= Op_fused_end) {
+			return is_value(operand(2)) ? nullptr : "invalid constant.";
+		}
+		return nullptr;
+	}
+}
+
+const char* Verifier::check_sequences(const Block& block, const std::vector<bool>& starts,
+									  size_t offset) const {
+	const BlockBuffer<Op>& code = block.code;
+	const Op op = code[offset];
+	const size_t next = offset + 1 + Compiler::op_arity(block, offset);
+
+	if (is_jump(code, offset)) {
+		const s64 target = jump_target(code, offset);
+		if (target < 0 or size_t(target) >= code.size() or !starts[size_t(target)]) {
+			return "invalid jump.";
+		}
+	}
+
+	// The instructions that a superinstruction runs must all follow it.
+	if (op >= Op_super_start and op <= Op_super_end) {
+		const SuperInstruction& super = superinstruction(op);
+		size_t part = offset;
+		for (u8 i = 1; i < super.length; ++i) {
+			part += 1 + Compiler::op_arity(block, part);
+			if (part >= code.size() or first_op(code[part]) != super.ops[i]) {
+				return "invalid instruction.";
+			}
+		}
+	}
+
+	// Fused comparisons branch with the jump that follows them, and `add_var_const` skips the
+	// `set_var` after it.
+	if (op >= Op_fused_start and op < Op::add_var_const) {
+		if (next >= code.size() or code[next] != Op::pop_jmp_if_false) {
+			return "invalid instruction.";
+		}
+	} else if (op == Op::add_var_const) {
+		if (next >= code.size() or first_op(code[next]) != Op::set_var or
+			code[next + 1] != code[offset + 1]) {
+			return "invalid instruction.";
+		}
+	}
+
+	return nullptr;
+}
+
+const char* Verifier::check_depths(const Block& block, const FunctionInfo& info,
+								   const std::vector<bool>& starts) const {
+	const BlockBuffer<Op>& code = block.code;
+	// The slot of the function and the parameters are on the stack when it starts. The VM makes
+	// room for `stack_size` more values.
+	const s64 entry_depth = s64(info.num_params) + 1;
+	const s64 max_depth = entry_depth + s64(info.stack_size);
+
+	std::vector<s64> depths(code.size(), -1);
+	std::vector<size_t> worklist;
+	const char* error = nullptr;
+
+	const auto visit = [&](s64 offset, s64 depth) {
+		if (error != nullptr) return;
+		if (offset < 0 or size_t(offset) >= code.size() or !starts[size_t(offset)]) {
+			error = "code runs past the end of the function.";
+		} else if (depth > max_depth) {
+			error = "function uses more stack than it declares.";
+		} else if (depths[size_t(offset)] == -1) {
+			depths[size_t(offset)] = depth;
+			worklist.push_back(size_t(offset));
+		} else if (depths[size_t(offset)] != depth) {
+			error = "inconsistent stack depth.";
+		}
+	};
+
+	visit(0, entry_depth);
+	while (!worklist.empty() and error == nullptr) {
+		const size_t offset = worklist.back();
+		worklist.pop_back();
+		const s64 depth = depths[offset];
+		const Op op = first_op(code[offset]);
+		const auto operand = [&](size_t n) { return s64(u8(code[offset + n])); };
+		const s64 next = s64(offset) + 1 + Compiler::op_arity(block, offset);
+
+		// Nothing may pop the function's own slot.
+		if (depth - op_inputs(code, offset) < 1) return "stack underflow.";
+
+		switch (op) {
+		case Op::get_var:
+		case Op::set_var:
+			if (operand(1) >= depth) return "invalid local.";
+			break;
+
+		case Op::make_func:
+			for (u8 i = 0; i < operand(2); ++i) {
+				if ((operand(3 + 2 * i) & CaptureLocal) and operand(4 + 2 * i) >= depth) {
+					return "invalid local.";
+				}
+			}
+			break;
+
+		default:
+			if (op >= Op_fused_start and op < Op::eq_var_const_jmp) {
+				if (operand(1) >= depth or operand(2) >= depth) return "invalid local.";
+			} else if (op >= Op::eq_var_const_jmp and op <= Op_fused_end) {
+				if (operand(1) >= depth) return "invalid local.";
+			}
+			break;
+		}
+
+		switch (op) {
+		case Op::jmp:
+		case Op::jmp_back: visit(jump_target(code, offset), depth); break;
+		case Op::return_val:
+		case Op::tail_call: break;
+
+		case Op::pop_jmp_if_false:
+			visit(jump_target(code, offset), depth - 1);
+			visit(next, depth - 1);
+			break;
+
+		case Op::jmp_if_false_or_pop:
+		case Op::jmp_if_true_or_pop:
+			visit(jump_target(code, offset), depth);
+			visit(next, depth - 1);
+			break;
+
+		case Op::for_prep:
+			visit(jump_target(code, offset), depth + 1);
+			visit(next, depth + 1);
+			break;
+
+		case Op::for_loop:
+			visit(jump_target(code, offset), depth);
+			visit(next, depth);
+			break;
+
+		case Op::call_func: visit(next, depth - operand(1)); break;
+		case Op::invoke: visit(next, depth + 1 - operand(3)); break;
+		case Op::make_func: visit(next, depth + 1); break;
+		default: visit(next, depth + Compiler::op_stack_effect(op)); break;
+		}
+	}
+
+	return error;
+}
+
+const char* Verifier::check_register_code(u32 index, const Block& block, const FunctionInfo& info,
+										  const std::vector<bool>& starts) const {
+	if (info.num_reg_instrs == 0) return nullptr;
+
+	// Registers are named by a byte, and the arguments are in the first ones.
+	const u32 frame_size = info.reg_frame_size;
+	if (frame_size < info.num_params + 1 or frame_size > UINT8_MAX) {
+		return "invalid register instruction.";
+	}
+
+	// Register code can't run past it's end either.
+	const RegOp last = info.reg_code[info.num_reg_instrs - 1].op;
+	if (last != RegOp::jmp and last != RegOp::return_val and last != RegOp::tail_call) {
+		return "invalid register instruction.";
+	}
+
+	const auto is_value = [&](u32 k) {
+		return k < info.constants.size() and info.constants[k].first != ConstantKind::CodeBlock;
+	};
+
+	const std::vector<Capture>& upvals = captures(index);
+	const BlockBuffer<Op>& code = block.code;
+
+	for (size_t i = 0; i < info.num_reg_instrs; ++i) {
+		const RegInstr& instr = info.reg_code[i];
+		if (size_t(instr.op) >= NumRegOps) return "invalid register instruction.";
+
+		bool ok = instr.a < frame_size;
+		switch (reg_format(instr.op)) {
+		case RegFormat::A: break;
+		case RegFormat::AB: ok = ok and instr.b < frame_size; break;
+		case RegFormat::ABC: ok = ok and instr.b < frame_size and instr.c < frame_size; break;
+		case RegFormat::ABK: ok = ok and instr.b < frame_size and is_value(instr.c); break;
+		case RegFormat::AK: ok = ok and is_value(instr.b); break;
+		case RegFormat::AG: ok = ok and instr.b < info.num_globals; break;
+		case RegFormat::J: ok = instr.x < info.num_reg_instrs; break;
+		case RegFormat::AJ: ok = ok and instr.x < info.num_reg_instrs; break;
+		case RegFormat::ABJ:
+			ok = ok and instr.b < frame_size and instr.x < info.num_reg_instrs;
+			break;
+		case RegFormat::AKJ: ok = ok and is_value(instr.b) and instr.x < info.num_reg_instrs; break;
+		case RegFormat::Call:
+			ok = u32(instr.a) + instr.b < frame_size and
+				 (instr.op != RegOp::tail_call or index != 0);
+			break;
+
+		case RegFormat::AU: {
+			const Capture kind = instr.op == RegOp::get_capture ? Capture::Value : Capture::Upvalue;
+			ok = ok and instr.b < upvals.size() and upvals[instr.b] == kind;
+			break;
+		}
+
+		case RegFormat::ABKC:
+			ok = ok and instr.b < frame_size and instr.c < info.constants.size() and
+				 info.constants[instr.c].first == ConstantKind::String and
+				 instr.x < info.num_inline_caches;
+			break;
+
+		case RegFormat::Closure: {
+			// The upvalues are described by a `make_func` of the same function in the stack code,
+			// whose operands have been checked already.
+			ok = ok and instr.x < code.size() and starts[instr.x] and
+				 code[instr.x] == Op::make_func and u8(code[instr.x + 1]) == instr.b;
+			if (!ok) break;
+			for (u8 j = 0; j < u8(code[instr.x + 2]); ++j) {
+				const u8 flags = u8(code[instr.x + 3 + 2 * j]);
+				if ((flags & CaptureLocal) and u8(code[instr.x + 4 + 2 * j]) >= frame_size) {
+					ok = false;
+				}
+			}
+			break;
+		}
+		}
+
+		// These also use the registers right after `a`.
+		if (instr.op == RegOp::for_prep or instr.op == RegOp::for_loop) {
+			ok = ok and u32(instr.a) + 3 < frame_size;
+		} else if (instr.op == RegOp::prep_method_call) {
+			ok = ok and u32(instr.a) + 1 < frame_size;
+		}
+
+		if (!ok) return "invalid register instruction.";
+	}
+
+	return nullptr;
+}
+
+/// @brief Verifies the code of [script], and of every function nested in it.
+/// @return An error message, or nullptr if all of it is fine.
+const char* verify_functions(const CodeBlock& script) {
+	// Functions are numbered in the order they are found in, so they come after their parents.
+	std::vector<const CodeBlock*> functions{&script};
+	std::unordered_map<const CodeBlock*, u32> numbers{{&script, 0}};
+	for (size_t i = 0; i < functions.size(); ++i) {
+		for (const Value& value : functions[i]->block().constant_pool) {
+			if (!VYSE_IS_CODEBLOCK(value)) continue;
+			numbers.emplace(VYSE_AS_PROTO(value), u32(functions.size()));
+			functions.push_back(VYSE_AS_PROTO(value));
+		}
+	}
+
+	Verifier verifier{functions.size()};
+	for (u32 i = 0; i < functions.size(); ++i) {
+		const CodeBlock& code = *functions[i];
+		const Block& block = code.block();
+		FunctionInfo info;
+		info.num_params = code.param_count();
+		info.num_upvals = code.upvalue_count();
+		info.stack_size = u32(code.stack_size());
+		info.is_variadic = code.is_vararg();
+		info.keeps_varargs_on_stack = code.keeps_varargs_on_stack();
+		info.num_globals = block.globals.size();
+		info.num_inline_caches = block.inline_caches.size();
+
+		// The verifier only tells strings and functions apart from the other constants.
+		for (const Value& value : block.constant_pool) {
+			if (VYSE_IS_CODEBLOCK(value)) {
+				const u32 nested = numbers.at(VYSE_AS_PROTO(value));
+				info.constants.emplace_back(ConstantKind::CodeBlock, nested);
+			} else {
+				info.constants.emplace_back(
+					VYSE_IS_STRING(value) ? ConstantKind::String : ConstantKind::Nil, 0);
+			}
+		}
+
+		info.reg_code = block.reg_code.data();
+		info.num_reg_instrs = block.reg_code.size();
+		info.reg_frame_size = block.reg_frame_size;
+		if (const char* const error = verifier.verify(i, block, info)) return error;
+	}
+
+	return nullptr;
+}
+
+class BytecodeWriter {
+  public:
+	std::string write(const CodeBlock& code) {
+		write_block(code);
+		std::string body = std::move(m_out);
+
+		m_out.append(BytecodeMagic);
+		write_u32(BytecodeVersion);
+		write_u32(InstructionSetHash);
+		write_u32(u32(m_strings.size()));
+		for (const String* string : m_strings) {
+			write_u32(u32(string->len()));
+			m_out.append(string->c_str(), string->len());
+		}
+		m_out += body;
+		return std::move(m_out);
+	}
+
+  private:
+	std::string m_out;
+	std::vector<const String*> m_strings;
+	/// The index of every string in `m_strings`. Strings are interned, so each one is only stored
+	/// once.
+	std::unordered_map<const String*, u32> m_string_indices;
+
+	void write_u8(u8 value) {
+		m_out.push_back(char(value));
+	}
+
+	void write_u32(u32 value) {
+		for (int i = 0; i < 4; ++i) write_u8(u8(value >> (8 * i)));
+	}
+
+	void write_u64(u64 value) {
+		for (int i = 0; i < 8; ++i) write_u8(u8(value >> (8 * i)));
+	}
+
+	void write_string(const String* string) {
+		const auto [entry, inserted] = m_string_indices.try_emplace(string, m_strings.size());
+		if (inserted) m_strings.push_back(string);
+		write_u32(entry->second);
+	}
+
+	void write_block(const CodeBlock& code);
+	void write_constant(const Value& value);
+};
+
+void BytecodeWriter::write_block(const CodeBlock& code) {
+	const Block& block = code.block();
+	write_string(code.name());
+	write_u32(code.param_count());
+	write_u32(code.upvalue_count());
+	write_u32(u32(code.stack_size()));
+	write_u8((code.is_vararg() ? Variadic : 0) |
+			 (code.keeps_varargs_on_stack() ? KeepsVarargsOnStack : 0));
+
+	write_u32(u32(block.code.size()));
+	append_code(m_out, block);
+	for (const u32 line : block.lines) write_u32(line);
+
+	write_u32(u32(block.constant_pool.size()));
+	for (const Value& value : block.constant_pool) write_constant(value);
+
+	write_u32(u32(block.globals.size()));
+	for (const GlobalRef& global : block.globals) write_string(global.name);
+	write_u32(u32(block.inline_caches.size()));
+
+	write_u32(block.reg_frame_size);
+	write_u32(u32(block.reg_code.size()));
+	for (size_t i = 0; i < block.reg_code.size(); ++i) {
+		const RegInstr& instr = block.reg_code[i];
+		write_u8(u8(instr.op));
+		write_u8(instr.a);
+		write_u8(instr.b);
+		write_u8(instr.c);
+		write_u32(instr.x);
+		write_u32(block.reg_origins[i]);
+	}
+}
+
+void BytecodeWriter::write_constant(const Value& value) {
+	if (VYSE_IS_NIL(value)) {
+		write_u8(u8(ConstantKind::Nil));
+	} else if (VYSE_IS_BOOL(value)) {
+		write_u8(u8(VYSE_AS_BOOL(value) ? ConstantKind::True : ConstantKind::False));
+	} else if (VYSE_IS_INT(value)) {
+		write_u8(u8(ConstantKind::Integer));
+		write_u32(u32(VYSE_AS_INT(value)));
+	} else if (VYSE_IS_NUM(value)) {
+		const number num = VYSE_AS_NUM(value);
+		u64 bits;
+		std::memcpy(&bits, &num, sizeof(bits));
+		write_u8(u8(ConstantKind::Number));
+		write_u64(bits);
+	} else if (VYSE_IS_STRING(value)) {
+		write_u8(u8(ConstantKind::String));
+		write_string(VYSE_AS_STRING(value));
+	} else {
+		VYSE_ASSERT(VYSE_IS_CODEBLOCK(value), "The compiler only makes constants of these types.");
+		write_u8(u8(ConstantKind::CodeBlock));
+		write_block(*VYSE_AS_PROTO(value));
+	}
+}
+
+/// @brief Written to every image as a `u32`, to tell the byte order that it was written in.
+constexpr u32 ByteOrderMark = 0x01020304;
+
+struct ImageHeader {
+	char magic[4];
+	u32 version;
+	u32 instruction_set;
+	u32 byte_order;
+	/// The size of the whole image, in bytes.
+	u32 size;
+	/// A hash of every byte after the header, which catches images that were corrupted on disk.
+	u32 checksum;
+	u32 num_strings;
+	u32 strings_offset;
+	u32 num_blocks;
+	u32 blocks_offset;
+};
+
+/// @return The FNV-1a hash of the [size] bytes at [bytes].
+u32 image_checksum(const char* bytes, size_t size) noexcept {
+	u32 hash = 2166136261u;
+	for (size_t i = 0; i < size; ++i) hash = (hash ^ u8(bytes[i])) * 16777619u;
+	return hash;
+}
+
+struct ImageString {
+	u32 offset;
+	u32 length;
+};
+
+/// @brief A block in an image. The names and strings are indices in the string table, and the
+/// offsets are from the start of the image.
+struct ImageBlock {
+	u32 name;
+	u32 num_params;
+	u32 num_upvals;
+	u32 max_stack_size;
+	u32 flags;
+	/// Offsets of the `code_size` opcodes and lines.
+	u32 code_offset;
+	u32 code_size;
+	u32 lines_offset;
+	/// Offset of the `ImageConstant`s.
+	u32 constants_offset;
+	u32 num_constants;
+	/// Offset of the names of the globals.
+	u32 globals_offset;
+	u32 num_globals;
+	u32 num_inline_caches;
+	u32 reg_frame_size;
+	/// Offsets of the `num_reg_instrs` `RegInstr`s, and of their origins.
+	u32 reg_code_offset;
+	u32 reg_origins_offset;
+	u32 num_reg_instrs;
+};
+
+/// @brief A constant in an image. [index] is the index of a string or a nested block, and [bits]
+/// holds the bits of a number (in the lower half for integers).
+struct ImageConstant {
+	u32 kind;
+	u32 index;
+	u64 bits;
+};
+
+class ImageWriter {
+  public:
+	std::string write(const CodeBlock& code) {
+		collect(code);
+		m_out.resize(sizeof(ImageHeader));
+
+		std::vector<ImageBlock> blocks;
+		for (const CodeBlock* block : m_blocks) blocks.push_back(write_block(*block));
+
+		std::vector<ImageString> strings;
+		for (const String* string : m_strings) {
+			strings.push_back({u32(m_out.size()), u32(string->len())});
+			m_out.append(string->c_str(), string->len());
+		}
+
+		ImageHeader header;
+		std::memcpy(header.magic, BytecodeImageMagic.data(), sizeof(header.magic));
+		header.version = BytecodeVersion;
+		header.instruction_set = InstructionSetHash;
+		header.byte_order = ByteOrderMark;
+		header.num_strings = u32(strings.size());
+		header.strings_offset = append(strings.data(), strings.size());
+		header.num_blocks = u32(blocks.size());
+		header.blocks_offset = append(blocks.data(), blocks.size());
+		header.size = u32(m_out.size());
+		header.checksum =
+			image_checksum(m_out.data() + sizeof(header), m_out.size() - sizeof(header));
+		std::memcpy(m_out.data(), &header, sizeof(header));
+		return std::move(m_out);
+	}
+
+  private:
+	std::string m_out;
+	/// Every block in the image, each one before the blocks nested in it.
+	std::vector<const CodeBlock*> m_blocks;
+	std::unordered_map<const CodeBlock*, u32> m_block_indices;
+	std::vector<const String*> m_strings;
+	std::unordered_map<const String*, u32> m_string_indices;
+
+	void collect(const CodeBlock& code) {
+		VYSE_ASSERT(!code.is_pending(), "Functions are written with all of their constants.");
+		m_block_indices.emplace(&code, u32(m_blocks.size()));
+		m_blocks.push_back(&code);
+		for (const Value& value : code.block().constant_pool) {
+			if (VYSE_IS_CODEBLOCK(value)) collect(*VYSE_AS_PROTO(value));
+		}
+	}
+
+	u32 string_index(const String* string) {
+		const auto [entry, inserted] = m_string_indices.try_emplace(string, m_strings.size());
+		if (inserted) m_strings.push_back(string);
+		return entry->second;
+	}
+
+	/// @brief Appends [count] [items] to the image, aligned to their type.
+	/// @return The offset of the items.
+	template <typename T>
+	u32 append(const T* items, size_t count) {
+		m_out.resize((m_out.size() + alignof(T) - 1) / alignof(T) * alignof(T));
+		const size_t offset = m_out.size();
+		m_out.append(reinterpret_cast<const char*>(items), count * sizeof(T));
+		return u32(offset);
+	}
+
+	ImageBlock write_block(const CodeBlock& code);
+	ImageConstant make_constant(const Value& value);
+};
+
+ImageBlock ImageWriter::write_block(const CodeBlock& code) {
+	const Block& block = code.block();
+	ImageBlock record;
+	record.name = string_index(code.name());
+	record.num_params = code.param_count();
+	record.num_upvals = code.upvalue_count();
+	record.max_stack_size = u32(code.stack_size());
+	record.flags = (code.is_vararg() ? Variadic : 0) |
+				   (code.keeps_varargs_on_stack() ? KeepsVarargsOnStack : 0);
+
+	record.code_offset = u32(m_out.size());
+	record.code_size = u32(block.code.size());
+	append_code(m_out, block);
+	record.lines_offset = append(block.lines.data(), block.lines.size());
+
+	std::vector<ImageConstant> constants;
+	for (const Value& value : block.constant_pool) constants.push_back(make_constant(value));
+	record.constants_offset = append(constants.data(), constants.size());
+	record.num_constants = u32(constants.size());
+
+	std::vector<u32> globals;
+	for (const GlobalRef& global : block.globals) globals.push_back(string_index(global.name));
+	record.globals_offset = append(globals.data(), globals.size());
+	record.num_globals = u32(globals.size());
+	record.num_inline_caches = u32(block.inline_caches.size());
+
+	record.reg_frame_size = block.reg_frame_size;
+	record.reg_code_offset = append(block.reg_code.data(), block.reg_code.size());
+	record.reg_origins_offset = append(block.reg_origins.data(), block.reg_origins.size());
+	record.num_reg_instrs = u32(block.reg_code.size());
+	return record;
+}
+
+ImageConstant ImageWriter::make_constant(const Value& value) {
+	ImageConstant constant{u32(ConstantKind::Nil), 0, 0};
+	if (VYSE_IS_BOOL(value)) {
+		constant.kind = u32(VYSE_AS_BOOL(value) ? ConstantKind::True : ConstantKind::False);
+	} else if (VYSE_IS_INT(value)) {
+		constant.kind = u32(ConstantKind::Integer);
+		constant.bits = u32(VYSE_AS_INT(value));
+	} else if (VYSE_IS_NUM(value)) {
+		const number num = VYSE_AS_NUM(value);
+		constant.kind = u32(ConstantKind::Number);
+		std::memcpy(&constant.bits, &num, sizeof(num));
+	} else if (VYSE_IS_STRING(value)) {
+		constant.kind = u32(ConstantKind::String);
+		constant.index = string_index(VYSE_AS_STRING(value));
+	} else if (VYSE_IS_CODEBLOCK(value)) {
+		constant.kind = u32(ConstantKind::CodeBlock);
+		constant.index = m_block_indices.at(VYSE_AS_PROTO(value));
+	} else {
+		VYSE_ASSERT(VYSE_IS_NIL(value), "The compiler only makes constants of these types.");
+	}
+	return constant;
+}
+
+} // namespace
+
+bool is_bytecode(std::string_view bytes) noexcept {
+	return bytes.substr(0, BytecodeMagic.size()) == BytecodeMagic;
+}
+
+std::string dump_bytecode(const CodeBlock& code) {
+	return BytecodeWriter{}.write(code);
+}
+
+bool is_bytecode_image(std::string_view bytes) noexcept {
+	return bytes.substr(0, BytecodeImageMagic.size()) == BytecodeImageMagic;
+}
+
+bool is_bytecode_image_file(const std::string& path) {
+	std::ifstream file{path, std::ios::binary};
+	char magic[4] = {};
+	file.read(magic, sizeof(magic));
+	return file and is_bytecode_image({magic, sizeof(magic)});
+}
+
+std::string dump_image(const CodeBlock& code) {
+	return ImageWriter{}.write(code);
+}
+
+bool BytecodeReader::fail(const char* message) {
+	if (m_error.empty()) m_error = message;
+	return false;
+}
+
+bool BytecodeReader::read_bytes(size_t size, std::string_view& bytes) {
+	if (m_bytes.size() - m_pos < size) return fail("unexpected end of file.");
+	bytes = m_bytes.substr(m_pos, size);
+	m_pos += size;
+	return true;
+}
+
+bool BytecodeReader::read_u8(u8& value) {
+	std::string_view bytes;
+	if (!read_bytes(1, bytes)) return false;
+	value = u8(bytes[0]);
+	return true;
+}
+
+bool BytecodeReader::read_u32(u32& value) {
+	std::string_view bytes;
+	if (!read_bytes(4, bytes)) return false;
+	value = 0;
+	for (int i = 0; i < 4; ++i) value |= u32(u8(bytes[i])) << (8 * i);
+	return true;
+}
+
+bool BytecodeReader::read_u64(u64& value) {
+	std::string_view bytes;
+	if (!read_bytes(8, bytes)) return false;
+	value = 0;
+	for (int i = 0; i < 8; ++i) value |= u64(u8(bytes[i])) << (8 * i);
+	return true;
+}
+
+String* BytecodeReader::read_string() {
+	u32 index;
+	if (!read_u32(index)) return nullptr;
+	if (index >= m_strings.size()) {
+		fail("string index out of range.");
+		return nullptr;
+	}
+	return &m_vm.make_string(m_strings[index].data(), m_strings[index].size());
+}
+
+CodeBlock* BytecodeReader::read() {
+	std::string_view magic;
+	u32 version, instruction_set, num_strings;
+	if (!read_bytes(BytecodeMagic.size(), magic) or magic != BytecodeMagic) {
+		fail("not a bytecode file.");
+		return nullptr;
+	}
+
+	if (!read_u32(version) or !read_u32(instruction_set)) return nullptr;
+	if (version != BytecodeVersion) {
+		fail("the file was written by a different version of vyse.");
+		return nullptr;
+	}
+
+	if (instruction_set != InstructionSetHash) {
+		fail("the file was written for a different instruction set.");
+		return nullptr;
+	}
+
+	if (!read_u32(num_strings)) return nullptr;
+	for (u32 i = 0; i < num_strings; ++i) {
+		u32 length;
+		std::string_view string;
+		if (!read_u32(length) or !read_bytes(length, string)) return nullptr;
+		m_strings.push_back(string);
+	}
+
+	CodeBlock* const code = read_block(0);
+	if (code == nullptr) return nullptr;
+	if (m_pos != m_bytes.size()) {
+		fail("unexpected data at the end of the file.");
+		return nullptr;
+	}
+
+	if (const char* const error = verify_functions(*code)) {
+		fail(error);
+		return nullptr;
+	}
+	return code;
+}
+
+CodeBlock* BytecodeReader::read_block(u32 depth) {
+	if (depth > MaxNesting) {
+		fail("functions are nested too deeply.");
+		return nullptr;
+	}
+
+	String* const name = read_string();
+	if (name == nullptr) return nullptr;
+
+	// Nothing refers to the block until it has been read, so it is protected from the GC. The
+	// constants that are read into it are kept alive by the block.
+	const GCLock name_lock = m_vm.gc_lock(name);
+	CodeBlock* const code = &m_vm.make<CodeBlock>(name);
+	const GCLock lock = m_vm.gc_lock(code);
+
+	u32 num_params, num_upvals, stack_size;
+	u8 flags;
+	if (!read_u32(num_params) or !read_u32(num_upvals) or !read_u32(stack_size) or
+		!read_u8(flags)) {
+		return nullptr;
+	}
+
+	if (num_params >= Compiler::MaxFuncParams or num_upvals > UINT8_MAX or stack_size > INT32_MAX) {
+		fail("invalid function.");
+		return nullptr;
+	}
+
+	code->m_num_params = num_params;
+	code->m_num_upvals = num_upvals;
+	code->max_stack_size = int(stack_size);
+	code->m_is_variadic = (flags & Variadic) != 0;
+	code->m_keeps_varargs_on_stack = (flags & KeepsVarargsOnStack) != 0;
+
+	if (!read_code(*code)) return nullptr;
+
+	Block& block = code->block();
+	u32 num_constants;
+	if (!read_u32(num_constants)) return nullptr;
+	for (u32 i = 0; i < num_constants; ++i) {
+		if (!read_constant(*code, depth)) return nullptr;
+	}
+
+	u32 num_globals;
+	if (!read_u32(num_globals)) return nullptr;
+	for (u32 i = 0; i < num_globals; ++i) {
+		String* const global = read_string();
+		if (global == nullptr) return nullptr;
+		// Global slots belong to the VM, so the names are given the slots of this VM.
+		block.add_global(global, m_vm.global_slot(global));
+	}
+
+	u32 num_inline_caches;
+	if (!read_u32(num_inline_caches)) return nullptr;
+	if (num_inline_caches > Block::MaxInlineCaches) {
+		fail("too many inline caches.");
+		return nullptr;
+	}
+	block.inline_caches.resize(num_inline_caches);
+
+	if (!read_register_code(block)) return nullptr;
+	return code;
+}
+
+bool BytecodeReader::read_code(CodeBlock& code) {
+	Block& block = code.block();
+	u32 size;
+	std::string_view bytes;
+	if (!read_u32(size) or !read_bytes(size, bytes)) return false;
+	block.code.resize(size);
+	std::memcpy(block.code.data(), bytes.data(), size);
+
+	block.lines.resize(size);
+	for (u32& line : block.lines) {
+		if (!read_u32(line)) return false;
+	}
+	return true;
+}
+
+bool BytecodeReader::read_constant(CodeBlock& code, u32 depth) {
+	std::vector<Value>& pool = code.block().constant_pool;
+	u8 kind;
+	if (!read_u8(kind)) return false;
+
+	switch (ConstantKind(kind)) {
+	case ConstantKind::Nil: pool.push_back(VYSE_NIL); return true;
+	case ConstantKind::False: pool.push_back(VYSE_BOOL(false)); return true;
+	case ConstantKind::True: pool.push_back(VYSE_BOOL(true)); return true;
+
+	case ConstantKind::Integer: {
+		u32 bits;
+		if (!read_u32(bits)) return false;
+		pool.push_back(VYSE_INT(s32(bits)));
+		return true;
+	}
+
+	case ConstantKind::Number: {
+		u64 bits;
+		if (!read_u64(bits)) return false;
+		number num;
+		std::memcpy(&num, &bits, sizeof(num));
+		pool.push_back(VYSE_NUM(num));
+		return true;
+	}
+
+	case ConstantKind::String: {
+		String* const string = read_string();
+		if (string == nullptr) return false;
+		pool.push_back(VYSE_OBJECT(string));
+		return true;
+	}
+
+	case ConstantKind::CodeBlock: {
+		CodeBlock* const nested = read_block(depth + 1);
+		if (nested == nullptr) return false;
+		pool.push_back(VYSE_OBJECT(nested));
+		return true;
+	}
+	}
+
+	return fail("invalid constant.");
+}
+
+bool BytecodeReader::read_register_code(Block& block) {
+	u32 frame_size, size;
+	if (!read_u32(frame_size) or !read_u32(size)) return false;
+	// Each instruction takes 12 bytes, along with it's origin.
+	if (size > (m_bytes.size() - m_pos) / 12) return fail("unexpected end of file.");
+
+	std::vector<RegInstr> reg_code(size);
+	std::vector<u32> origins(size);
+	for (u32 i = 0; i < size; ++i) {
+		u8 op;
+		RegInstr& instr = reg_code[i];
+		if (!read_u8(op) or !read_u8(instr.a) or !read_u8(instr.b) or !read_u8(instr.c) or
+			!read_u32(instr.x) or !read_u32(origins[i])) {
+			return false;
+		}
+
+		if (op >= NumRegOps) return fail("invalid register instruction.");
+		if (origins[i] >= block.code.size()) return fail("invalid register instruction.");
+		instr.op = RegOp(op);
+	}
+
+	// The register code is only of use to VMs that run on the register tier.
+	if (m_vm.config().tier != Tier::Register) return true;
+	block.reg_code = std::move(reg_code);
+	block.reg_origins = std::move(origins);
+	block.reg_frame_size = frame_size;
+	return true;
+}
+
+BytecodeImage::~BytecodeImage() {
+#ifdef VYSE_MMAP_IMAGES
+	if (m_mapped) munmap(m_bytes, m_size);
+#endif
+}
+
+std::shared_ptr<BytecodeImage> BytecodeImage::open(const std::string& path, std::string& error) {
+#ifdef VYSE_MMAP_IMAGES
+	const int file = ::open(path.c_str(), O_RDONLY);
+	if (file < 0) {
+		error = "could not open file.";
+		return nullptr;
+	}
+
+	struct stat stats;
+	if (fstat(file, &stats) != 0 or size_t(stats.st_size) < sizeof(ImageHeader)) {
+		::close(file);
+		error = "unexpected end of file.";
+		return nullptr;
+	}
+
+	// The mapping is private, so that quickening an instruction only copies the page it is on
+	// instead of writing to the file.
+	const size_t size = size_t(stats.st_size);
+	void* const memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0);
+	::close(file);
+	if (memory == MAP_FAILED) {
+		error = "could not map file.";
+		return nullptr;
+	}
+
+	std::shared_ptr<BytecodeImage> image{new BytecodeImage(static_cast<char*>(memory), size, true)};
+	if (const char* const message = image->validate()) {
+		error = message;
+		return nullptr;
+	}
+	return image;
+#else
+	// Without `mmap`, the image is read into memory of it's own.
+	std::ifstream file{path, std::ios::binary};
+	if (!file) {
+		error = "could not open file.";
+		return nullptr;
+	}
+	std::ostringstream bytes;
+	bytes << file.rdbuf();
+	return from_bytes(bytes.str(), error);
+#endif
+}
+
+std::shared_ptr<BytecodeImage> BytecodeImage::from_bytes(std::string_view bytes,
+														 std::string& error) {
+	std::unique_ptr<u64[]> memory = std::make_unique<u64[]>(bytes.size() / sizeof(u64) + 1);
+	std::memcpy(memory.get(), bytes.data(), bytes.size());
+	std::shared_ptr<BytecodeImage> image{
+		new BytecodeImage(reinterpret_cast<char*>(memory.get()), bytes.size(), false)};
+	image->m_owned = std::move(memory);
+
+	if (const char* const message = image->validate()) {
+		error = message;
+		return nullptr;
+	}
+	return image;
+}
+
+template <typename T>
+T BytecodeImage::read(size_t offset) const noexcept {
+	T value;
+	std::memcpy(&value, m_bytes + offset, sizeof(T));
+	return value;
+}
+
+const char* BytecodeImage::validate() const {
+	if (m_size < sizeof(ImageHeader)) return "unexpected end of file.";
+	const auto header = read<ImageHeader>(0);
+	if (!is_bytecode_image({m_bytes, m_size})) return "not a bytecode image.";
+	if (header.version != BytecodeVersion) {
+		return "the image was written by a different version of vyse.";
+	}
+	if (header.instruction_set != InstructionSetHash) {
+		return "the image was written for a different instruction set.";
+	}
+	if (header.byte_order != ByteOrderMark) {
+		return "the image was written on a machine with a different byte order.";
+	}
+	if (header.size != m_size) return "unexpected end of file.";
+	if (header.checksum != image_checksum(m_bytes + sizeof(header), m_size - sizeof(header))) {
+		return "the image is corrupted (checksum mismatch).";
+	}
+
+	// Whether [count] elements of type [T] fit at [offset], which is aligned to them.
+	const auto fits = [&](auto type, size_t offset, size_t count) {
+		using T = decltype(type);
+		return offset <= m_size and offset % alignof(T) == 0 and
+			   count <= (m_size - offset) / sizeof(T);
+	};
+
+	if (!fits(ImageString{}, header.strings_offset, header.num_strings)) {
+		return "invalid string table.";
+	}
+	for (u32 i = 0; i < header.num_strings; ++i) {
+		const auto string = read<ImageString>(header.strings_offset + i * sizeof(ImageString));
+		if (!fits(char{}, string.offset, string.length)) return "invalid string table.";
+	}
+
+	if (header.num_blocks == 0 or !fits(ImageBlock{}, header.blocks_offset, header.num_blocks)) {
+		return "invalid block table.";
+	}
+
+	Verifier verifier{header.num_blocks};
+	for (u32 i = 0; i < header.num_blocks; ++i) {
+		const auto record = read<ImageBlock>(header.blocks_offset + i * sizeof(ImageBlock));
+		if (record.name >= header.num_strings or record.num_params >= Compiler::MaxFuncParams or
+			record.num_upvals > UINT8_MAX or record.max_stack_size > INT32_MAX) {
+			return "invalid function.";
+		}
+
+		if (!fits(Opcode{}, record.code_offset, record.code_size) or
+			!fits(u32{}, record.lines_offset, record.code_size)) {
+			return "invalid function.";
+		}
+
+		FunctionInfo info;
+		info.num_params = record.num_params;
+		info.num_upvals = record.num_upvals;
+		info.stack_size = record.max_stack_size;
+		info.is_variadic = (record.flags & Variadic) != 0;
+		info.keeps_varargs_on_stack = (record.flags & KeepsVarargsOnStack) != 0;
+
+		if (!fits(ImageConstant{}, record.constants_offset, record.num_constants)) {
+			return "invalid constant.";
+		}
+		for (u32 j = 0; j < record.num_constants; ++j) {
+			const auto constant =
+				read<ImageConstant>(record.constants_offset + j * sizeof(ImageConstant));
+			switch (ConstantKind(constant.kind)) {
+			case ConstantKind::Nil:
+			case ConstantKind::False:
+			case ConstantKind::True:
+			case ConstantKind::Integer:
+			case ConstantKind::Number: break;
+			case ConstantKind::String:
+				if (constant.index >= header.num_strings) return "string index out of range.";
+				break;
+			case ConstantKind::CodeBlock:
+				// Nested blocks come after the blocks they're in, so no block can contain itself.
+				if (constant.index <= i or constant.index >= header.num_blocks) {
+					return "invalid constant.";
+				}
+				break;
+			default: return "invalid constant.";
+			}
+			info.constants.emplace_back(ConstantKind(constant.kind), constant.index);
+		}
+
+		if (!fits(u32{}, record.globals_offset, record.num_globals)) return "invalid function.";
+		for (u32 j = 0; j < record.num_globals; ++j) {
+			if (read<u32>(record.globals_offset + j * sizeof(u32)) >= header.num_strings) {
+				return "string index out of range.";
+			}
+		}
+
+		if (record.num_inline_caches > Block::MaxInlineCaches) return "too many inline caches.";
+
+		if (!fits(RegInstr{}, record.reg_code_offset, record.num_reg_instrs) or
+			!fits(u32{}, record.reg_origins_offset, record.num_reg_instrs)) {
+			return "invalid register instruction.";
+		}
+		for (u32 j = 0; j < record.num_reg_instrs; ++j) {
+			const auto instr = read<RegInstr>(record.reg_code_offset + j * sizeof(RegInstr));
+			const auto origin = read<u32>(record.reg_origins_offset + j * sizeof(u32));
+			if (size_t(instr.op) >= NumRegOps or origin >= record.code_size) {
+				return "invalid register instruction.";
+			}
+		}
+
+		info.num_globals = record.num_globals;
+		info.num_inline_caches = record.num_inline_caches;
+		info.reg_code = reinterpret_cast<const RegInstr*>(m_bytes + record.reg_code_offset);
+		info.num_reg_instrs = record.num_reg_instrs;
+		info.reg_frame_size = record.reg_frame_size;
+
+		// Blocks are verified in the order of the block table, so every function's closures are
+		// made by the blocks before it.
+		Block block;
+		block.code.refer(reinterpret_cast<Opcode*>(m_bytes + record.code_offset),
+						 record.code_size);
+		if (const char* const error = verifier.verify(i, block, info)) return error;
+	}
+
+	return nullptr;
+}
+
+String* BytecodeImage::make_string(VM& vm, u32 index) const {
+	const auto header = read<ImageHeader>(0);
+	const auto string = read<ImageString>(header.strings_offset + index * sizeof(ImageString));
+	return &vm.make_string(m_bytes + string.offset, string.length);
+}
+
+CodeBlock* BytecodeImage::make_block(VM& vm, u32 index) {
+	const auto header = read<ImageHeader>(0);
+	const auto record = read<ImageBlock>(header.blocks_offset + index * sizeof(ImageBlock));
+
+	String* const name = make_string(vm, record.name);
+	const GCLock lock = vm.gc_lock(name);
+	CodeBlock* const code = &vm.make<CodeBlock>(name);
+	code->m_num_params = record.num_params;
+	code->m_num_upvals = record.num_upvals;
+	code->max_stack_size = int(record.max_stack_size);
+	code->m_is_variadic = (record.flags & Variadic) != 0;
+	code->m_keeps_varargs_on_stack = (record.flags & KeepsVarargsOnStack) != 0;
+
+	Block& block = code->block();
+	block.code.refer(reinterpret_cast<Opcode*>(m_bytes + record.code_offset), record.code_size);
+	block.lines.refer(reinterpret_cast<u32*>(m_bytes + record.lines_offset), record.code_size);
+
+	code->m_image = shared_from_this();
+	code->m_image_index = index;
+	code->m_is_pending = true;
+	return code;
+}
+
+CodeBlock* BytecodeImage::load(VM& vm) {
+	CodeBlock* const code = make_block(vm, 0);
+	const GCLock lock = vm.gc_lock(code);
+	load_pending(vm, *code);
+	return code;
+}
+
+void BytecodeImage::load_pending(VM& vm, CodeBlock& code) {
+	VYSE_ASSERT(code.is_pending(), "Function has already been loaded.");
+	BytecodeImage& image = *code.m_image;
+	const auto header = image.read<ImageHeader>(0);
+	const auto record =
+		image.read<ImageBlock>(header.blocks_offset + code.m_image_index * sizeof(ImageBlock));
+
+	// The function is alive while it's closure is being made, so every constant is kept alive by it
+	// as soon as it is added to the pool.
+	Block& block = code.block();
+	for (u32 i = 0; i < record.num_constants; ++i) {
+		const auto constant =
+			image.read<ImageConstant>(record.constants_offset + i * sizeof(ImageConstant));
+		switch (ConstantKind(constant.kind)) {
+		case ConstantKind::Nil: block.add_value(VYSE_NIL); break;
+		case ConstantKind::False: block.add_value(VYSE_BOOL(false)); break;
+		case ConstantKind::True: block.add_value(VYSE_BOOL(true)); break;
+		case ConstantKind::Integer: block.add_value(VYSE_INT(s32(u32(constant.bits)))); break;
+		case ConstantKind::Number: {
+			number num;
+			std::memcpy(&num, &constant.bits, sizeof(num));
+			block.add_value(VYSE_NUM(num));
+			break;
+		}
+		case ConstantKind::String:
+			block.add_value(VYSE_OBJECT(image.make_string(vm, constant.index)));
+			break;
+		case ConstantKind::CodeBlock:
+			block.add_value(VYSE_OBJECT(image.make_block(vm, constant.index)));
+			break;
+		}
+	}
+
+	for (u32 i = 0; i < record.num_globals; ++i) {
+		String* const name = image.make_string(vm, image.read<u32>(record.globals_offset + i * 4));
+		block.add_global(name, vm.global_slot(name));
+	}
+	block.inline_caches.resize(record.num_inline_caches);
+
+	// The register code is only of use to VMs that run on the register tier.
+	if (vm.config().tier == Tier::Register and record.num_reg_instrs != 0) {
+		block.reg_code.resize(record.num_reg_instrs);
+		block.reg_origins.resize(record.num_reg_instrs);
+		std::memcpy(block.reg_code.data(), image.m_bytes + record.reg_code_offset,
+					record.num_reg_instrs * sizeof(RegInstr));
+		std::memcpy(block.reg_origins.data(), image.m_bytes + record.reg_origins_offset,
+					record.num_reg_instrs * sizeof(u32));
+		block.reg_frame_size = record.reg_frame_size;
+	}
+
+	code.m_is_pending = false;
+}
+
+} // namespace vy
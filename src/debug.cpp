@@ -2,6 +2,7 @@
 #include <cstdio>
 #include <debug.hpp>
 #include <iostream>
+#include <string.hpp>
 #include <value.hpp>
 
 namespace vy {
@@ -21,6 +22,16 @@ const char* op2s(Op op) {
 	return op_strs[static_cast<u32>(op)];
 }
 
+static constexpr std::array reg_op_strs = {
+#define REG_OP(name, _) #name,
+#include <x_reg_opcode.hpp>
+#undef REG_OP
+};
+
+const char* reg_op2s(RegOp op) {
+	return reg_op_strs[static_cast<u32>(op)];
+}
+
 static void print_line(const Block& block, size_t index) {
 	if (index == 0 or block.lines[index] == block.lines[index - 1]) {
 		printf("   |	");
@@ -39,6 +50,67 @@ static size_t constant_instr(const Block& block, Op op, size_t index) {
 	return 2;
 }
 
+static size_t global_instr(const Block& block, Op op, size_t index) {
+	const u8 global_index = u8(block.code[index + 1]);
+	print_line(block, index);
+	printf("%-4zu  %-22s  %d\t(%s)\n", index, op2s(op), global_index,
+		   block.globals[global_index].name->c_str());
+	return 2;
+}
+
+static size_t cached_instr(const Block& block, Op op, size_t index) {
+	const u8 const_index = u8(block.code[index + 1]);
+	const u8 cache_index = u8(block.code[index + 2]);
+	const InlineCache& cache = block.inline_caches[cache_index];
+	print_line(block, index);
+	printf("%-4zu  %-22s  %d\t(", index, op2s(op), const_index);
+	print_value(block.constant_pool[const_index]);
+	printf(")\t[cache %d: %u hits, %u misses]", cache_index, cache.hits, cache.misses);
+	if (op == Op::invoke) {
+		printf("\t(%d args)\n", int(block.code[index + 3]));
+		return 4;
+	}
+	printf("\n");
+	return 3;
+}
+
+static size_t fused_instr(const Block& block, Op op, size_t index) {
+	const u8 slot = u8(block.code[index + 1]);
+	const u8 operand = u8(block.code[index + 2]);
+	print_line(block, index);
+	printf("%-4zu  %-22s  %d %d", index, op2s(op), slot, operand);
+	if (op >= Op::eq_var_const_jmp) {
+		printf("\t(");
+		print_value(block.constant_pool[operand]);
+		printf(")");
+	}
+	printf("\n");
+	return 3;
+}
+
+static size_t super_instr(const Block& block, Op op, size_t index) {
+	// Superinstructions have the operands of their first instruction, which is either a constant
+	// instruction, or one that takes a single operand or none.
+	const Op first = superinstruction(op).ops[0];
+	print_line(block, index);
+	if (first >= Op_0_operands_start and first <= Op_0_operands_end) {
+		printf("%-4zu  %-22s\n", index, op2s(op));
+		return 1;
+	}
+
+	const u8 operand = u8(block.code[index + 1]);
+	printf("%-4zu  %-22s  %d", index, op2s(op), operand);
+	if (first >= Op_const_start and first <= Op_const_end) {
+		printf("\t(");
+		print_value(block.constant_pool[operand]);
+		printf(")");
+	} else if (first >= Op_global_start and first <= Op_global_end) {
+		printf("\t(%s)", block.globals[operand].name->c_str());
+	}
+	printf("\n");
+	return 2;
+}
+
 static size_t simple_instr(const Block& block, Op op, size_t index) {
 	print_line(block, index);
 	printf("%-4zu  %-22s\n", index, op2s(op));
@@ -81,12 +153,11 @@ size_t disassemble_instr(const Block& block, Op op, size_t offset) {
 
 		const u8 num_upvals = static_cast<u8>(block.code[++offset]);
 		for (int i = 0; i < num_upvals; ++i) {
-			bool is_local = int(block.code[offset++]);
-			if (is_local) {
-				int idx = static_cast<int>(block.code[++offset]);
-				printf("        %-4zu  %-22s  %s %d\n", offset - 1, " ",
-					   (is_local == 0) ? "upvalue" : "local", idx);
-			}
+			const u8 flags = static_cast<u8>(block.code[++offset]);
+			const int idx = static_cast<int>(block.code[++offset]);
+			printf("        %-4zu  %-22s  %s %d%s\n", offset - 1, " ",
+				   (flags & CaptureLocal) ? "local" : "upvalue", idx,
+				   (flags & CaptureByValue) ? " (by value)" : "");
 		}
 		return offset - old_loc + 1;
 	}
@@ -95,6 +166,14 @@ size_t disassemble_instr(const Block& block, Op op, size_t offset) {
 		return simple_instr(block, op, offset);
 	} else if (op >= Op_const_start and op <= Op_const_end) {
 		return constant_instr(block, op, offset);
+	} else if (op >= Op_global_start and op <= Op_global_end) {
+		return global_instr(block, op, offset);
+	} else if (op >= Op_cached_start and op <= Op_cached_end) {
+		return cached_instr(block, op, offset);
+	} else if (op >= Op_fused_start and op <= Op_fused_end) {
+		return fused_instr(block, op, offset);
+	} else if (op >= Op_super_start and op <= Op_super_end) {
+		return super_instr(block, op, offset);
 	} else if (op >= Op_1_operands_start and op <= Op_1_operands_end) {
 		return instr_single_operand(block, offset);
 	} else if (op >= Op_2_operands_start and op <= Op_2_operands_end) {
@@ -111,6 +190,68 @@ void disassemble_block(const char* name, const Block& block) {
 	}
 }
 
+static void print_constant(const Block& block, u8 index) {
+	printf("\t(");
+	print_value(block.constant_pool[index]);
+	printf(")");
+}
+
+static void print_global(const Block& block, u8 index) {
+	printf("\t(%s)", block.globals[index].name->c_str());
+}
+
+void disassemble_register_instr(const Block& block, size_t index) {
+	const RegInstr& instr = block.reg_code[index];
+	const u32 line = block.lines[block.reg_origins[index]];
+	if (index == 0 or line != block.lines[block.reg_origins[index - 1]]) {
+		printf("\n%04d	", line);
+	} else {
+		printf("   |	");
+	}
+
+	printf("%-4zu  %-22s  ", index, reg_op2s(instr.op));
+	switch (reg_format(instr.op)) {
+	case RegFormat::A: printf("r%d", instr.a); break;
+	case RegFormat::AB: printf("r%d r%d", instr.a, instr.b); break;
+	case RegFormat::ABC: printf("r%d r%d r%d", instr.a, instr.b, instr.c); break;
+	case RegFormat::ABK:
+		printf("r%d r%d k%d", instr.a, instr.b, instr.c);
+		print_constant(block, instr.c);
+		break;
+	case RegFormat::AK:
+	case RegFormat::Closure:
+		printf("r%d k%d", instr.a, instr.b);
+		print_constant(block, instr.b);
+		break;
+	case RegFormat::AU: printf("r%d u%d", instr.a, instr.b); break;
+	case RegFormat::AG:
+		printf("r%d g%d", instr.a, instr.b);
+		print_global(block, instr.b);
+		break;
+	case RegFormat::ABKC:
+		printf("r%d r%d k%d", instr.a, instr.b, instr.c);
+		print_constant(block, instr.c);
+		printf("\t[cache %u]", instr.x);
+		break;
+	case RegFormat::J: printf("-> %u", instr.x); break;
+	case RegFormat::AJ: printf("r%d -> %u", instr.a, instr.x); break;
+	case RegFormat::ABJ: printf("r%d r%d -> %u", instr.a, instr.b, instr.x); break;
+	case RegFormat::AKJ:
+		printf("r%d k%d -> %u", instr.a, instr.b, instr.x);
+		print_constant(block, instr.b);
+		break;
+	case RegFormat::Call: printf("r%d (%d args)", instr.a, instr.b); break;
+	}
+	printf("\n");
+}
+
+void disassemble_register_code(const char* name, const Block& block) {
+	printf("<%s> (registers: %u)\n", name, block.reg_frame_size);
+	for (size_t i = 0; i < block.reg_code.size(); ++i) {
+		disassemble_register_instr(block, i);
+	}
+}
+
 #undef op2s
 
 } // namespace vy
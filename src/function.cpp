@@ -2,10 +2,17 @@
 #include <function.hpp>
 #include <gc.hpp>
 #include <list.hpp>
+#include <memory>
 #include <upvalue.hpp>
 
 namespace vy {
 
+CodeBlock::~CodeBlock() = default;
+
+void CodeBlock::set_jit_code(std::unique_ptr<JitCode> code) noexcept {
+	m_jit_code = std::move(code);
+}
+
 u32 CodeBlock::add_param() {
 	++m_num_params;
 	VYSE_ASSERT(m_num_params < Compiler::MaxFuncParams, "Too many function parameters.");
@@ -14,6 +21,7 @@ u32 CodeBlock::add_param() {
 
 void CodeBlock::trace(GC& gc) {
 	gc.mark_object(m_name);
+	gc.mark_object(m_shared_closure);
 	for (Value val : m_block.constant_pool) {
 		gc.mark_value(val);
 	}
@@ -22,24 +30,32 @@ void CodeBlock::trace(GC& gc) {
 /// Function ///
 
 Closure::Closure(CodeBlock* code, u32 upval_count) noexcept
-	: Obj(ObjType::closure), m_codeblock{code} {
-	m_upvals.resize(upval_count);
+	: Obj(ObjType::closure), m_codeblock{code}, m_num_upvals{upval_count} {
+	std::uninitialized_fill_n(captures(), upval_count, VYSE_NIL);
+}
+
+void* Closure::operator new(size_t size, u32 upval_count) {
+	return ::operator new(size + upval_count * sizeof(Value));
+}
+
+void Closure::operator delete(void* closure, u32) {
+	::operator delete(closure);
 }
 
-void Closure::set_upval(u32 idx, Upvalue* uv) {
-	VYSE_ASSERT(idx < m_upvals.size(), "Invalid upvalue index.");
-	m_upvals[idx] = uv;
+void Closure::operator delete(void* closure) {
+	::operator delete(closure);
 }
 
 void Closure::trace(GC& gc) {
-	for (Upvalue* upval : m_upvals) {
-		gc.mark_object(upval);
+	for (u32 i = 0; i < m_num_upvals; ++i) {
+		gc.mark_value(captures()[i]);
 	}
 	gc.mark_object(m_codeblock);
 }
 
 void CClosure::trace(GC& gc) {
 	gc.mark_object(m_values);
+	gc.mark_object(m_name);
 }
 
 } // namespace vy
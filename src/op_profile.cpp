@@ -0,0 +1,46 @@
+#include <compiler.hpp>
+#include <cstdio>
+#include <debug.hpp>
+#include <op_profile.hpp>
+
+namespace vy {
+
+static u32 sequence_key(Opcode a, Opcode b, Opcode c) {
+	return u32(a) | (u32(b) << 8) | (u32(c) << 16);
+}
+
+void OpProfile::record(const Block& block, size_t offset) {
+	const Opcode a = block.code[offset];
+	if (!is_straight_line(a)) return;
+
+	// Instructions that were quickened while running are counted as the generic ones, since
+	// those are what the compiler emits.
+	const size_t b_offset = offset + 1 + Compiler::op_arity(block, offset);
+	if (b_offset >= block.op_count()) return;
+	const Opcode b = generic_op(block.code[b_offset]);
+	++m_counts[sequence_key(a, b, Opcode::no_op)];
+
+	if (!is_straight_line(b)) return;
+	const size_t c_offset = b_offset + 1 + Compiler::op_arity(block, b_offset);
+	if (c_offset >= block.op_count()) return;
+	const Opcode c = generic_op(block.code[c_offset]);
+	++m_counts[sequence_key(a, b, c)];
+}
+
+bool OpProfile::dump(const char* path) const {
+	std::FILE* file = std::fopen(path, "a");
+	if (file == nullptr) return false;
+
+	for (const auto& [key, count] : m_counts) {
+		const Opcode c = Opcode((key >> 16) & 0xff);
+		std::fprintf(file, "%llu %s %s", static_cast<unsigned long long>(count),
+					 op2s(Opcode(key & 0xff)), op2s(Opcode((key >> 8) & 0xff)));
+		if (c != Opcode::no_op) std::fprintf(file, " %s", op2s(c));
+		std::fprintf(file, "\n");
+	}
+
+	std::fclose(file);
+	return true;
+}
+
+} // namespace vy
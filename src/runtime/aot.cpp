@@ -0,0 +1,399 @@
+#include <aot.hpp>
+#include <debug.hpp>
+#include <function.hpp>
+#include <jit_runtime.hpp>
+#include <ostream>
+#include <vm.hpp>
+
+namespace vy {
+
+using Op = Opcode;
+
+std::vector<CodeBlock*> aot_code_blocks(CodeBlock& root) {
+	std::vector<CodeBlock*> blocks{&root};
+	for (size_t i = 0; i < blocks.size(); ++i) {
+		for (const Value& value : blocks[i]->block().constant_pool) {
+			if (VYSE_IS_CODEBLOCK(value)) blocks.push_back(VYSE_AS_PROTO(value));
+		}
+	}
+	return blocks;
+}
+
+u64 aot_fingerprint(const CodeBlock& code) {
+	// FNV-1a
+	u64 hash = 14695981039346656037ull;
+	const auto mix = [&](u64 byte) {
+		hash ^= byte;
+		hash *= 1099511628211ull;
+	};
+
+	const Block& block = code.block();
+	for (const Opcode op : block.code) mix(u8(op));
+	mix(block.constant_pool.size());
+	mix(block.inline_caches.size());
+	mix(code.param_count());
+	return hash;
+}
+
+u32 link_aot_module(const AotModule& module, CodeBlock& root) {
+	const std::vector<CodeBlock*> blocks = aot_code_blocks(root);
+	if (blocks.size() != module.num_functions) return 0;
+
+	u32 num_linked = 0;
+	for (size_t i = 0; i < blocks.size(); ++i) {
+		if (module.functions[i] == nullptr) continue;
+		if (aot_fingerprint(*blocks[i]) != module.fingerprints[i]) continue;
+		blocks[i]->set_aot_function(module.functions[i]);
+		++num_linked;
+	}
+	return num_linked;
+}
+
+namespace {
+
+/// @brief Writes the C++ function for the stack code of one block. The generated code keeps the
+/// same values on the VM's stack as the interpreter would, and does the instructions that don't
+/// touch the VM inline.
+class AotEmitter {
+  public:
+	AotEmitter(const CodeBlock& code, std::ostream& out) : m_native{code}, m_out{out} {}
+
+	/// @brief Writes the function [name].
+	/// @return false if the block has code that native code can't run, and nothing was written.
+	bool emit(const std::string& name);
+
+  private:
+	NativeBlock m_native;
+	std::ostream& m_out;
+
+	void emit_instr(size_t offset, int depth);
+	/// @brief Writes a call to the runtime function [helper].
+	void emit_call(const char* helper, int depth, size_t ip, const std::string& a = "0",
+				   const std::string& b = "0", const std::string& c = "0");
+	void emit_cmp_jmp(size_t offset, int depth, Op op);
+	void emit_for_loop(size_t offset, int depth);
+	void emit_add_var_const(size_t offset, int depth);
+
+	std::string slot(int index) const {
+		return "base[" + std::to_string(index) + "]";
+	}
+
+	std::string label(size_t offset) const {
+		return "L" + std::to_string(offset);
+	}
+
+	std::string constant(size_t offset, size_t index) const {
+		return "block.constant_pool[" + std::to_string(m_native.operand(offset, index)) + "]";
+	}
+
+	std::string goto_label(size_t offset) const {
+		return "goto " + label(offset) + ";";
+	}
+};
+
+void AotEmitter::emit_call(const char* helper, int depth, size_t ip, const std::string& a,
+						   const std::string& b, const std::string& c) {
+	m_out << "\tVYSE_AOT_CALL(" << helper << ", " << depth << ", " << ip << ", " << a << ", " << b
+		  << ", " << c << ");\n";
+}
+
+void AotEmitter::emit_cmp_jmp(size_t offset, int depth, Op op) {
+	const size_t jump = m_native.next(offset);
+	const std::string on_false = goto_label(m_native.jump_target(jump));
+	const std::string on_true = goto_label(m_native.next(jump));
+	const bool is_const = op >= Op::eq_var_const_jmp;
+	const u8 var = m_native.operand(offset, 0);
+
+	const char* cmp = nullptr;
+	switch (op) {
+#define CASE(name, op_str)                                                                         \
+	case Op::name##_var_var_jmp:                                                                   \
+	case Op::name##_var_const_jmp: cmp = op_str; break;
+		CASE(eq, "==")
+		CASE(neq, "!=")
+		CASE(gt, ">")
+		CASE(lt, "<")
+		CASE(gte, ">=")
+		CASE(lte, "<=")
+#undef CASE
+	default: VYSE_UNREACHABLE();
+	}
+
+	const std::string rhs = is_const ? constant(offset, 1) : slot(m_native.operand(offset, 1));
+	m_out << "\t{\n"
+		  << "\t\tconst vy::Value& l = " << slot(var) << ";\n"
+		  << "\t\tconst vy::Value& r = " << rhs << ";\n"
+		  << "\t\tif (VYSE_IS_INT(l) and VYSE_IS_INT(r)) {\n"
+		  << "\t\t\tif (VYSE_AS_INT(l) " << cmp << " VYSE_AS_INT(r)) " << on_true << "\n"
+		  << "\t\t\t" << on_false << "\n"
+		  << "\t\t}\n"
+		  << "\t}\n";
+
+	const std::string index = std::to_string(m_native.operand(offset, 1));
+	const std::string rhs_operand = is_const ? "VYSE_AOT_K(" + index + ")" : index;
+	// The runtime functions for the fused comparisons are named after the instructions.
+	emit_call(op2s(op), depth, m_native.next(offset), std::to_string(var), rhs_operand);
+	m_out << "\tif (status == vy::JitRuntime::Branch) " << on_false << "\n"
+		  << "\t" << on_true << "\n";
+}
+
+void AotEmitter::emit_add_var_const(size_t offset, int depth) {
+	const u8 var = m_native.operand(offset, 0);
+	const u8 k = m_native.operand(offset, 1);
+	m_out << "\tif (VYSE_IS_INT(" << slot(var) << ") and VYSE_IS_INT(" << constant(offset, 1)
+		  << ")) {\n"
+		  << "\t\t" << slot(var) << " = vy::int_or_num(vy::s64(VYSE_AS_INT(" << slot(var)
+		  << ")) + VYSE_AS_INT(" << constant(offset, 1) << "));\n"
+		  << "\t} else {\n\t";
+	emit_call("add_var_const", depth, m_native.next(offset), std::to_string(var),
+			  "VYSE_AOT_K(" + std::to_string(k) + ")");
+	m_out << "\t}\n"
+		  << "\t" << goto_label(m_native.next(m_native.next(offset))) << "\n";
+}
+
+void AotEmitter::emit_for_loop(size_t offset, int depth) {
+	const std::string body = goto_label(m_native.jump_target(offset));
+	// Loops over integers are counted inline, until the counter overflows.
+	m_out << "\t{\n"
+		  << "\t\tvy::Value& counter = " << slot(depth - 4) << ";\n"
+		  << "\t\tconst vy::Value& limit = " << slot(depth - 3) << ";\n"
+		  << "\t\tconst vy::Value& step = " << slot(depth - 2) << ";\n"
+		  << "\t\tif (VYSE_IS_INT(counter) and VYSE_IS_INT(limit) and VYSE_IS_INT(step)) {\n"
+		  << "\t\t\tconst vy::s64 next = vy::s64(VYSE_AS_INT(counter)) + VYSE_AS_INT(step);\n"
+		  << "\t\t\tif (vy::fits_int(next)) {\n"
+		  << "\t\t\t\tcounter = VYSE_INT(next);\n"
+		  << "\t\t\t\t" << slot(depth - 1) << " = counter;\n"
+		  << "\t\t\t\tconst bool loops = VYSE_AS_INT(step) >= 0 ? next < VYSE_AS_INT(limit)\n"
+		  << "\t\t\t\t\t\t\t\t\t\t\t\t   : next >= VYSE_AS_INT(limit);\n"
+		  << "\t\t\t\tif (loops) " << body << "\n"
+		  << "\t\t\t\t" << goto_label(m_native.next(offset)) << "\n"
+		  << "\t\t\t}\n"
+		  << "\t\t}\n"
+		  << "\t}\n";
+	emit_call("for_loop", depth, m_native.next(offset));
+	m_out << "\tif (status == vy::JitRuntime::Branch) " << body << "\n";
+}
+
+void AotEmitter::emit_instr(size_t offset, int depth) {
+	const Op op = m_native.op_at(offset);
+	const size_t ip = m_native.next(offset);
+	const auto operand = [&](size_t index) {
+		return std::to_string(m_native.operand(offset, index));
+	};
+
+	const auto call = [&](const char* helper, const std::string& a = "0",
+						  const std::string& b = "0", const std::string& c = "0") {
+		emit_call(helper, depth, ip, a, b, c);
+	};
+
+	const auto cached = [&](const char* helper) {
+		call(helper, "VYSE_AOT_K(" + operand(0) + ")", "VYSE_AOT_CACHE(" + operand(1) + ")");
+	};
+
+	const auto assign = [&](const std::string& dst, const std::string& src) {
+		m_out << "\t" << dst << " = " << src << ";\n";
+	};
+
+	const auto jump_if = [&](const char* cond) {
+		m_out << "\tif (" << cond << "vy::is_val_falsy(" << slot(depth - 1) << ")) "
+			  << goto_label(m_native.jump_target(offset)) << "\n";
+	};
+
+	switch (op) {
+	case Op::load_const: assign(slot(depth), constant(offset, 0)); break;
+	case Op::load_nil: assign(slot(depth), "VYSE_NIL"); break;
+	case Op::get_var: assign(slot(depth), slot(m_native.operand(offset, 0))); break;
+	case Op::set_var: assign(slot(m_native.operand(offset, 0)), slot(depth - 1)); break;
+	case Op::pop: break;
+
+	case Op::get_global: call("get_global", "VYSE_AOT_GLOBAL(" + operand(0) + ")"); break;
+	case Op::set_global: call("set_global", "VYSE_AOT_GLOBAL(" + operand(0) + ")"); break;
+	case Op::get_upval: call("get_upval", operand(0)); break;
+	case Op::set_upval: call("set_upval", operand(0)); break;
+	case Op::get_capture: call("get_capture", operand(0)); break;
+	case Op::close_upval: call("close_upval"); break;
+
+	case Op::table_get: cached("table_get"); break;
+	case Op::table_set: cached("table_set"); break;
+	case Op::table_get_no_pop: cached("table_get_no_pop"); break;
+	case Op::prep_method_call: cached("prep_method_call"); break;
+	case Op::invoke:
+		call("invoke", "VYSE_AOT_K(" + operand(0) + ")", "VYSE_AOT_CACHE(" + operand(1) + ")",
+			 operand(2));
+		break;
+
+	case Op::add: m_out << "\tVYSE_AOT_ARITH(+, add, " << depth << ", " << ip << ");\n"; break;
+	case Op::sub: m_out << "\tVYSE_AOT_ARITH(-, sub, " << depth << ", " << ip << ");\n"; break;
+	case Op::mult: m_out << "\tVYSE_AOT_ARITH(*, mult, " << depth << ", " << ip << ");\n"; break;
+	case Op::gt: m_out << "\tVYSE_AOT_CMP(>, gt, " << depth << ", " << ip << ");\n"; break;
+	case Op::lt: m_out << "\tVYSE_AOT_CMP(<, lt, " << depth << ", " << ip << ");\n"; break;
+	case Op::gte: m_out << "\tVYSE_AOT_CMP(>=, gte, " << depth << ", " << ip << ");\n"; break;
+	case Op::lte: m_out << "\tVYSE_AOT_CMP(<=, lte, " << depth << ", " << ip << ");\n"; break;
+
+	case Op::div: call("div"); break;
+	case Op::mod: call("mod"); break;
+	case Op::exp: call("exp"); break;
+	case Op::eq: call("eq"); break;
+	case Op::neq: call("neq"); break;
+	case Op::lshift: call("lshift"); break;
+	case Op::rshift: call("rshift"); break;
+	case Op::band: call("band"); break;
+	case Op::bxor: call("bxor"); break;
+	case Op::bor: call("bor"); break;
+	case Op::concat: call("concat"); break;
+	case Op::negate: call("negate"); break;
+	case Op::lnot:
+		m_out << "\t" << slot(depth - 1) << " = VYSE_BOOL(vy::is_val_falsy(" << slot(depth - 1)
+			  << "));\n";
+		break;
+	case Op::len: call("len"); break;
+	case Op::bnot: call("bnot"); break;
+
+	case Op::new_table: call("new_table"); break;
+	case Op::new_list: call("new_list"); break;
+	case Op::table_add_field: call("table_add_field"); break;
+	case Op::list_append: call("list_append"); break;
+	case Op::subscript_get: call("subscript_get"); break;
+	case Op::subscript_set: call("subscript_set"); break;
+	case Op::index_no_pop: call("index_no_pop"); break;
+	case Op::vararg_len: call("vararg_len"); break;
+	case Op::vararg_get: call("vararg_get"); break;
+
+	case Op::make_func: call("make_func", "VYSE_AOT_CODE(" + std::to_string(offset) + ")"); break;
+	case Op::call_func: call("call_func", operand(0)); break;
+	case Op::return_val:
+		call("return_val");
+		m_out << "\treturn vy::u32(vy::JitExit::Return);\n";
+		break;
+
+	case Op::jmp:
+	case Op::jmp_back: m_out << "\t" << goto_label(m_native.jump_target(offset)) << "\n"; break;
+	case Op::pop_jmp_if_false:
+	case Op::jmp_if_false_or_pop: jump_if(""); break;
+	case Op::jmp_if_true_or_pop: jump_if("!"); break;
+
+	case Op::for_prep:
+		call("for_prep");
+		m_out << "\t" << goto_label(m_native.jump_target(offset)) << "\n";
+		break;
+	case Op::for_loop: emit_for_loop(offset, depth); break;
+	case Op::add_var_const: emit_add_var_const(offset, depth); break;
+
+	default:
+		if (NativeBlock::is_fused_cmp(op)) {
+			emit_cmp_jmp(offset, depth, op);
+			break;
+		}
+		// The instructions that native code doesn't support are left to the interpreter.
+		emit_call("side_exit", depth, offset);
+		m_out << "\treturn vy::u32(vy::JitExit::Interpret);\n";
+		break;
+	}
+}
+
+bool AotEmitter::emit(const std::string& name) {
+	if (!m_native.analyze()) return false;
+
+	// The function starts at the instruction at [entry], which is where the interpreter has it's
+	// `ip` when it hands the function over.
+	m_out << "static vy::u32 " << name << "(vy::JitFrame* f, vy::u32 entry) {\n"
+		  << "\t[[maybe_unused]] const vy::Block& block = vy::JitRuntime::block(f);\n"
+		  << "\tvy::Value* base = f->base;\n"
+		  << "\t[[maybe_unused]] vy::u32 status;\n"
+		  << "\tswitch (entry) {\n";
+	for (size_t offset = 0; offset < m_native.size(); offset = m_native.next(offset)) {
+		if (m_native.depth(offset) < 0) continue;
+		m_out << "\tcase " << offset << ": " << goto_label(offset) << "\n";
+	}
+	m_out << "\tdefault: return vy::u32(vy::JitExit::Interpret);\n"
+		  << "\t}\n";
+
+	for (size_t offset = 0; offset < m_native.size(); offset = m_native.next(offset)) {
+		const int depth = m_native.depth(offset);
+		if (depth < 0) continue;
+		m_out << label(offset) << ": // " << op2s(m_native.op_at(offset)) << "\n";
+		emit_instr(offset, depth);
+	}
+
+	// Every path through the code ends in a jump, or in a return.
+	m_out << "}\n\n";
+	return true;
+}
+
+/// @brief Writes [str] as a C++ string literal, with one line of [str] on each line of code.
+void write_string_literal(std::ostream& out, const std::string& str) {
+	out << "\"";
+	for (const char c : str) {
+		switch (c) {
+		case '\n': out << "\\n\"\n\t\""; break;
+		case '\t': out << "\\t"; break;
+		case '\r': out << "\\r"; break;
+		case '"': out << "\\\""; break;
+		case '\\': out << "\\\\"; break;
+		// Keeps trigraphs like `??=` out of the literal.
+		case '?': out << "\\?"; break;
+		default:
+			if (u8(c) < 0x20) {
+				static constexpr const char* digits = "01234567";
+				out << '\\' << digits[(u8(c) >> 6) & 7] << digits[(u8(c) >> 3) & 7]
+					<< digits[u8(c) & 7];
+			} else {
+				out << c;
+			}
+		}
+	}
+	out << "\"";
+}
+
+} // namespace
+
+bool compile_to_cpp(VM& vm, SourceCode source, const std::string& name, std::ostream& out) {
+	const std::string path = source.path;
+	const std::string code = source.code;
+	Closure* const script = vm.compile(std::move(source));
+	if (script == nullptr) return false;
+	const std::vector<CodeBlock*> blocks = aot_code_blocks(*script->m_codeblock);
+
+	out << "// Generated by vyc from " << path << ". Do not edit.\n"
+		<< "#include <aot.hpp>\n"
+		<< "#include <jit.hpp>\n"
+		<< "#include <jit_runtime.hpp>\n"
+		<< "#include <value.hpp>\n\n"
+		<< "namespace {\n\n";
+
+	std::vector<bool> compiled;
+	for (size_t i = 0; i < blocks.size(); ++i) {
+		out << "// " << blocks[i]->name_cstr() << "\n";
+		AotEmitter emitter{*blocks[i], out};
+		compiled.push_back(emitter.emit("fn_" + std::to_string(i)));
+		if (!compiled.back()) out << "// Interpreted.\n\n";
+	}
+
+	out << "const vy::AotFunction functions[] = {\n";
+	for (size_t i = 0; i < blocks.size(); ++i) {
+		out << "\t" << (compiled[i] ? "&fn_" + std::to_string(i) : "nullptr") << ",\n";
+	}
+	out << "};\n\n"
+		<< "const vy::u64 fingerprints[] = {\n";
+	for (size_t i = 0; i < blocks.size(); ++i) {
+		out << "\t" << aot_fingerprint(*blocks[i]) << "ull,\n";
+	}
+	out << "};\n\n"
+		<< "const vy::AotModule module{\n"
+		<< "\t\"" << name << "\",\n\t";
+	write_string_literal(out, path);
+	out << ",\n\t";
+	write_string_literal(out, code);
+	out << ",\n"
+		<< "\tfunctions,\n"
+		<< "\tfingerprints,\n"
+		<< "\t" << blocks.size() << ",\n"
+		<< "};\n\n"
+		<< "} // namespace\n\n"
+		<< "extern \"C\" const vy::AotModule* vy_aot_" << name << "() {\n"
+		<< "\treturn &module;\n"
+		<< "}\n";
+	return true;
+}
+
+} // namespace vy
@@ -42,11 +42,12 @@ void GC::mark() {
 	// 5. The table of global variables.
 	// 6. The 'extra_roots' set.
 	// 7. The primitive prototypes in the VM.
+	// 8. The keys of all table shapes.
 	for (Value* v = m_vm->m_stack.values; v < m_vm->m_stack.top; ++v) {
 		mark_value(*v);
 	}
 
-	for (VM::CallFrame* frame = m_vm->m_current_frame; frame; frame = frame->prev) {
+	for (VM::CallFrame* frame = m_vm->base_frame; frame <= m_vm->m_current_frame; ++frame) {
 		mark_object(frame->func);
 	}
 
@@ -58,15 +59,19 @@ void GC::mark() {
 		mark_object(o);
 	}
 
-	for (auto& entry : m_vm->m_global_vars) {
-		mark_object(entry.first);
-		mark_value(entry.second);
+	for (String* name : m_vm->m_global_names) {
+		mark_object(name);
+	}
+
+	for (Value& value : m_vm->m_globals) {
+		mark_value(value);
 	}
 
 	mark_object(m_vm->prototypes.string);
 	mark_object(m_vm->prototypes.number);
 	mark_object(m_vm->prototypes.boolean);
 	mark_object(m_vm->prototypes.list);
+	m_vm->m_root_shape.trace_keys(*this);
 
 	mark_compiler_roots();
 }
@@ -0,0 +1,871 @@
+#include "../str_format.hpp"
+#include <cinttypes>
+#include <function.hpp>
+#include <functional>
+#include <jit.hpp>
+#include <jit_runtime.hpp>
+#include <vm.hpp>
+
+#if defined(__x86_64__) && defined(__linux__)
+#define VYSE_JIT_X64
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace vy {
+
+#ifdef VYSE_JIT_X64
+const bool Jit::Supported = true;
+#else
+const bool Jit::Supported = false;
+#endif
+
+JitCode::~JitCode() {
+#ifdef VYSE_JIT_X64
+	munmap(m_memory, m_size);
+#endif
+}
+
+Jit::Jit(VM& vm, [[maybe_unused]] bool perf_map) : m_vm{vm} {
+#ifdef VYSE_JIT_X64
+	if (perf_map) {
+		const std::string path = kt::format_str("/tmp/perf-{}.map", getpid());
+		m_perf_map = std::fopen(path.c_str(), "a");
+	}
+#endif
+}
+
+Jit::~Jit() {
+	if (m_perf_map != nullptr) std::fclose(m_perf_map);
+}
+
+#ifndef VYSE_JIT_X64
+
+bool Jit::compile(CodeBlock&) {
+	return false;
+}
+
+JitExit Jit::run(const CodeBlock&) {
+	return JitExit::Interpret;
+}
+
+#else
+
+using Op = Opcode;
+
+// -- Assembler --
+
+namespace {
+
+enum Reg : u8 { RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI, R8, R9, R10, R11, R12, R13, R14, R15 };
+
+enum Cond : u8 {
+	O = 0x0,
+	NO = 0x1,
+	E = 0x4,
+	NE = 0x5,
+	S = 0x8,
+	L = 0xc,
+	GE = 0xd,
+	LE = 0xe,
+	G = 0xf,
+};
+
+/// @brief A memory operand, `[base + disp]`.
+struct Mem {
+	Reg base;
+	s32 disp;
+
+	Mem operator+(s32 offset) const noexcept {
+		return {base, disp + offset};
+	}
+};
+
+/// @brief Emits the handful of x86-64 instructions that the JIT uses. Registers are 64 bits wide
+/// unless the name of the method says otherwise.
+class Assembler {
+  public:
+	using Label = u32;
+
+	Label new_label() {
+		m_labels.push_back(Unbound);
+		return Label(m_labels.size() - 1);
+	}
+
+	void bind(Label label) {
+		m_labels[label] = m_code.size();
+	}
+
+	[[nodiscard]] size_t size() const noexcept {
+		return m_code.size();
+	}
+
+	[[nodiscard]] size_t position(Label label) const noexcept {
+		return m_labels[label];
+	}
+
+	/// @brief Resolves the jumps to labels, which must all be bound by now.
+	std::vector<u8>& finish() {
+		for (const Fixup& fixup : m_fixups) {
+			const s32 rel = s32(s64(m_labels[fixup.label]) - s64(fixup.at + 4));
+			std::memcpy(&m_code[fixup.at], &rel, sizeof(rel));
+		}
+		return m_code;
+	}
+
+	void mov(Reg dst, u64 imm) {
+		if (imm <= UINT32_MAX) {
+			rex(false, 0, dst);
+			byte(0xb8 + (dst & 7));
+			dword(u32(imm));
+		} else {
+			rex(true, 0, dst);
+			byte(0xb8 + (dst & 7));
+			qword(imm);
+		}
+	}
+
+	void mov(Reg dst, Reg src) {
+		rex(true, src, dst);
+		byte(0x89);
+		modrm_reg(src, dst);
+	}
+
+	void load(Reg dst, Mem m) {
+		op_mem(true, {0x8b}, dst, m);
+	}
+
+	void store(Mem m, Reg src) {
+		op_mem(true, {0x89}, src, m);
+	}
+
+	void load32(Reg dst, Mem m) {
+		op_mem(false, {0x8b}, dst, m);
+	}
+
+	void store32(Mem m, Reg src) {
+		op_mem(false, {0x89}, src, m);
+	}
+
+	void lea(Reg dst, Mem m) {
+		op_mem(true, {0x8d}, dst, m);
+	}
+
+	/// @brief Moves 16 bytes from [m] to xmm0.
+	void movups_load(Mem m) {
+		op_mem(false, {0x0f, 0x10}, RAX, m);
+	}
+
+	/// @brief Moves 16 bytes from xmm0 to [m].
+	void movups_store(Mem m) {
+		op_mem(false, {0x0f, 0x11}, RAX, m);
+	}
+
+	void cmp8(Mem m, u8 imm) {
+		op_mem(false, {0x80}, Reg(7), m);
+		byte(imm);
+	}
+
+	void mov8(Mem m, u8 imm) {
+		op_mem(false, {0xc6}, Reg(0), m);
+		byte(imm);
+	}
+
+	void cmp32(Mem m, s32 imm) {
+		op_mem(false, {0x81}, Reg(7), m);
+		dword(u32(imm));
+	}
+
+	void cmp32(Reg r, Mem m) {
+		op_mem(false, {0x3b}, r, m);
+	}
+
+	void add32(Reg r, Mem m) {
+		op_mem(false, {0x03}, r, m);
+	}
+
+	void sub32(Reg r, Mem m) {
+		op_mem(false, {0x2b}, r, m);
+	}
+
+	void imul32(Reg r, Mem m) {
+		op_mem(false, {0x0f, 0xaf}, r, m);
+	}
+
+	void add32(Reg dst, Reg src) {
+		rex(false, src, dst);
+		byte(0x01);
+		modrm_reg(src, dst);
+	}
+
+	void add32(Reg dst, s32 imm) {
+		rex(false, 0, dst);
+		byte(0x81);
+		modrm_reg(0, dst);
+		dword(u32(imm));
+	}
+
+	void cmp32(Reg r, s32 imm) {
+		rex(false, 0, r);
+		byte(0x81);
+		modrm_reg(7, r);
+		dword(u32(imm));
+	}
+
+	void test32(Reg a, Reg b) {
+		rex(false, b, a);
+		byte(0x85);
+		modrm_reg(b, a);
+	}
+
+	void cmp(Reg a, Reg b) {
+		rex(true, b, a);
+		byte(0x39);
+		modrm_reg(b, a);
+	}
+
+	void setcc(Cond cond, Mem m) {
+		op_mem(false, {0x0f, u8(0x90 + cond)}, Reg(0), m);
+	}
+
+	void jcc(Cond cond, Label target) {
+		byte(0x0f);
+		byte(0x80 + cond);
+		rel32(target);
+	}
+
+	void jmp(Label target) {
+		byte(0xe9);
+		rel32(target);
+	}
+
+	void jmp(Reg target) {
+		rex(false, 0, target);
+		byte(0xff);
+		modrm_reg(4, target);
+	}
+
+	void call(Reg target) {
+		rex(false, 0, target);
+		byte(0xff);
+		modrm_reg(2, target);
+	}
+
+	void push(Reg r) {
+		rex(false, 0, r);
+		byte(0x50 + (r & 7));
+	}
+
+	void pop(Reg r) {
+		rex(false, 0, r);
+		byte(0x58 + (r & 7));
+	}
+
+	void ret() {
+		byte(0xc3);
+	}
+
+  private:
+	static constexpr size_t Unbound = SIZE_MAX;
+
+	struct Fixup {
+		size_t at;
+		Label label;
+	};
+
+	std::vector<u8> m_code;
+	std::vector<size_t> m_labels;
+	std::vector<Fixup> m_fixups;
+
+	void byte(u8 b) {
+		m_code.push_back(b);
+	}
+
+	void dword(u32 d) {
+		for (int i = 0; i < 4; ++i) byte(u8(d >> (8 * i)));
+	}
+
+	void qword(u64 q) {
+		for (int i = 0; i < 8; ++i) byte(u8(q >> (8 * i)));
+	}
+
+	void rel32(Label target) {
+		m_fixups.push_back({m_code.size(), target});
+		dword(0);
+	}
+
+	/// @brief Emits a REX prefix if one is needed for a 64 bit operation ([wide]) or to reach
+	/// registers r8-r15 in the `reg` and `rm` fields.
+	void rex(bool wide, u8 reg, u8 rm) {
+		const u8 bits = (wide ? 8 : 0) | ((reg & 8) ? 4 : 0) | ((rm & 8) ? 1 : 0);
+		if (bits != 0) byte(0x40 | bits);
+	}
+
+	void modrm_reg(u8 reg, u8 rm) {
+		byte(0xc0 | ((reg & 7) << 3) | (rm & 7));
+	}
+
+	/// @brief Emits an instruction whose `rm` operand is [m].
+	void op_mem(bool wide, std::initializer_list<u8> opcode, Reg reg, Mem m) {
+		rex(wide, reg, m.base);
+		for (const u8 b : opcode) byte(b);
+
+		const bool short_disp = m.disp >= INT8_MIN and m.disp <= INT8_MAX;
+		byte((short_disp ? 0x40 : 0x80) | ((reg & 7) << 3) | (m.base & 7));
+		// rsp and r12 as a base can only be encoded with a SIB byte.
+		if ((m.base & 7) == RSP) byte(0x24);
+		if (short_disp) {
+			byte(u8(m.disp));
+		} else {
+			dword(u32(m.disp));
+		}
+	}
+};
+
+// -- Compiler --
+
+/// @brief Compiles the stack code of one block to x86-64. The frame base is kept in `rbx`, and a
+/// pointer to the `JitFrame` in `r12`.
+class JitCompiler {
+  public:
+	explicit JitCompiler(const CodeBlock& code) : m_native{code} {}
+
+	/// @return false if the block can't be compiled.
+	bool compile();
+
+	std::vector<u8>& code() {
+		return m_asm.finish();
+	}
+
+	/// @return The native offset of the code of every instruction, see `JitCode`.
+	std::vector<u32> entries() const {
+		std::vector<u32> entries(m_native.size(), JitCode::NoEntry);
+		for (size_t offset = 0; offset < m_native.size(); ++offset) {
+			if (m_native.depth(offset) >= 0) {
+				entries[offset] = u32(m_asm.position(m_labels[offset]));
+			}
+		}
+		return entries;
+	}
+
+  private:
+	using Label = Assembler::Label;
+
+	NativeBlock m_native;
+	std::vector<Label> m_labels;
+	Assembler m_asm;
+	Label m_exit_error = 0;
+	Label m_exit_return = 0;
+	Label m_exit_interpret = 0;
+	/// Code that is only run in uncommon cases, which goes after the rest of the function.
+	std::vector<std::function<void()>> m_slow_paths;
+
+	Op op_at(size_t offset) const noexcept {
+		return m_native.op_at(offset);
+	}
+
+	u8 operand(size_t offset, size_t index) const noexcept {
+		return m_native.operand(offset, index);
+	}
+
+	const Value& constant(size_t offset, size_t index) const noexcept {
+		return m_native.constant(offset, index);
+	}
+
+	size_t next(size_t offset) const noexcept {
+		return m_native.next(offset);
+	}
+
+	size_t jump_target(size_t offset) const noexcept {
+		return m_native.jump_target(offset);
+	}
+
+	static Mem slot(int index) noexcept {
+		return {RBX, s32(index * int(sizeof(Value)))};
+	}
+
+	void emit_instr(size_t offset, int depth);
+	void emit_copy(Mem dst, Mem src);
+	void emit_store(Mem dst, const Value& value);
+	void emit_jump_if(bool truthy, Mem value, Label target);
+	void emit_call(JitHelperFn fn, int depth, size_t ip, u64 a = 0, u64 b = 0, u64 c = 0);
+	void emit_exit(JitExit exit);
+	/// @brief Emits a call to [fn] that only runs when one of the checks jumps to the returned
+	/// label. After the call, the code goes on at [resume], or [branch] if [fn] says so.
+	Label slow_path(JitHelperFn fn, int depth, size_t ip, u64 a, u64 b, Label resume,
+					Label branch);
+
+	void emit_arith(size_t offset, int depth, Op op);
+	void emit_cmp_jmp(size_t offset, int depth, Op op);
+	void emit_for_loop(size_t offset, int depth);
+	void emit_add_var_const(size_t offset, int depth);
+};
+
+void JitCompiler::emit_copy(Mem dst, Mem src) {
+#ifdef VYSE_NAN_TAGGING
+	m_asm.load(RAX, src);
+	m_asm.store(dst, RAX);
+#else
+	static_assert(sizeof(Value) == 16, "Values are copied with one 16 byte move.");
+	m_asm.movups_load(src);
+	m_asm.movups_store(dst);
+#endif
+}
+
+void JitCompiler::emit_store(Mem dst, const Value& value) {
+	u64 words[sizeof(Value) / sizeof(u64)];
+	std::memcpy(words, &value, sizeof(Value));
+	for (size_t i = 0; i < std::size(words); ++i) {
+		m_asm.mov(RAX, words[i]);
+		m_asm.store(dst + s32(i * sizeof(u64)), RAX);
+	}
+}
+
+void JitCompiler::emit_jump_if(bool truthy, Mem value, Label target) {
+	const Label done = m_asm.new_label();
+	// A value is falsy if it is nil or false.
+#ifdef VYSE_NAN_TAGGING
+	m_asm.load(RAX, value);
+	m_asm.mov(RCX, Value::NilBits);
+	m_asm.cmp(RAX, RCX);
+	m_asm.jcc(E, truthy ? done : target);
+	m_asm.mov(RCX, Value::FalseBits);
+	m_asm.cmp(RAX, RCX);
+	m_asm.jcc(truthy ? NE : E, target);
+#else
+	m_asm.cmp8(value + offsetof(Value, tag), u8(ValueType::Nil));
+	m_asm.jcc(E, truthy ? done : target);
+	m_asm.cmp8(value + offsetof(Value, tag), u8(ValueType::Bool));
+	m_asm.jcc(NE, truthy ? target : done);
+	m_asm.cmp8(value + offsetof(Value, as), 0);
+	m_asm.jcc(truthy ? NE : E, target);
+#endif
+	m_asm.bind(done);
+}
+
+void JitCompiler::emit_call(JitHelperFn fn, int depth, size_t ip, u64 a, u64 b, u64 c) {
+	m_asm.mov(RDI, R12);
+	m_asm.lea(RSI, slot(depth));
+	m_asm.mov(RDX, u64(ip));
+	m_asm.mov(RCX, a);
+	m_asm.mov(R8, b);
+	m_asm.mov(R9, c);
+	m_asm.mov(RAX, reinterpret_cast<u64>(fn));
+	m_asm.call(RAX);
+	m_asm.test32(RAX, RAX);
+	m_asm.jcc(E, m_exit_error);
+	m_asm.load(RBX, {R12, offsetof(JitFrame, base)});
+}
+
+void JitCompiler::emit_exit(JitExit exit) {
+	m_asm.mov(RAX, u64(exit));
+	m_asm.pop(R12);
+	m_asm.pop(RBX);
+	m_asm.pop(RBP);
+	m_asm.ret();
+}
+
+#ifndef VYSE_NAN_TAGGING
+// Integers are handled inline where it pays off. The checks are for the layout of plain values.
+Assembler::Label JitCompiler::slow_path(JitHelperFn fn, int depth, size_t ip, u64 a, u64 b,
+										Label resume, Label branch) {
+	const Label entry = m_asm.new_label();
+	m_slow_paths.push_back([=] {
+		m_asm.bind(entry);
+		emit_call(fn, depth, ip, a, b);
+		if (branch != resume) {
+			m_asm.cmp32(RAX, s32(JitRuntime::Branch));
+			m_asm.jcc(E, branch);
+		}
+		m_asm.jmp(resume);
+	});
+	return entry;
+}
+
+static Mem tag(Mem value) noexcept {
+	return value + offsetof(Value, tag);
+}
+
+static Mem payload(Mem value) noexcept {
+	return value + offsetof(Value, as);
+}
+#endif
+
+void JitCompiler::emit_arith(size_t offset, int depth, Op op) {
+	JitHelperFn fn = nullptr;
+	Cond cond = E;
+	switch (op) {
+	case Op::add: fn = &JitRuntime::add; break;
+	case Op::sub: fn = &JitRuntime::sub; break;
+	case Op::mult: fn = &JitRuntime::mult; break;
+	case Op::gt: fn = &JitRuntime::gt, cond = G; break;
+	case Op::lt: fn = &JitRuntime::lt, cond = L; break;
+	case Op::gte: fn = &JitRuntime::gte, cond = GE; break;
+	case Op::lte: fn = &JitRuntime::lte, cond = LE; break;
+	default: VYSE_UNREACHABLE();
+	}
+
+#ifdef VYSE_NAN_TAGGING
+	(void)cond;
+	emit_call(fn, depth, next(offset));
+#else
+	// Two integers are added, subtracted and multiplied with 32 bit arithmetic, and the runtime
+	// function takes over when the result overflows.
+	const Mem l = slot(depth - 2);
+	const Mem r = slot(depth - 1);
+	const Label resume = m_asm.new_label();
+	const Label slow = slow_path(fn, depth, next(offset), 0, 0, resume, resume);
+	m_asm.cmp8(tag(l), u8(ValueType::Integer));
+	m_asm.jcc(NE, slow);
+	m_asm.cmp8(tag(r), u8(ValueType::Integer));
+	m_asm.jcc(NE, slow);
+	m_asm.load32(RAX, payload(l));
+
+	if (op == Op::add or op == Op::sub or op == Op::mult) {
+		if (op == Op::add) m_asm.add32(RAX, payload(r));
+		if (op == Op::sub) m_asm.sub32(RAX, payload(r));
+		if (op == Op::mult) m_asm.imul32(RAX, payload(r));
+		m_asm.jcc(O, slow);
+		m_asm.store32(payload(l), RAX);
+	} else {
+		m_asm.cmp32(RAX, payload(r));
+		m_asm.setcc(cond, payload(l));
+		m_asm.mov8(tag(l), u8(ValueType::Bool));
+	}
+	m_asm.bind(resume);
+#endif
+}
+
+void JitCompiler::emit_cmp_jmp(size_t offset, int depth, Op op) {
+	const size_t jump = next(offset);
+	const Label on_false = m_labels[jump_target(jump)];
+	const Label on_true = m_labels[next(jump)];
+	const bool is_const = op >= Op::eq_var_const_jmp;
+	const u8 var = operand(offset, 0);
+	const u64 rhs = is_const ? reinterpret_cast<u64>(&constant(offset, 1)) : operand(offset, 1);
+
+	JitHelperFn fn = nullptr;
+	// The condition under which the comparison is false.
+	Cond fails = E;
+	switch (op) {
+#define CASE(name, cond)                                                                           \
+	case Op::name##_var_var_jmp:                                                                   \
+	case Op::name##_var_const_jmp:                                                                 \
+		fn = is_const ? &JitRuntime::name##_var_const_jmp : &JitRuntime::name##_var_var_jmp;       \
+		fails = cond;                                                                              \
+		break;
+		CASE(eq, NE)
+		CASE(neq, E)
+		CASE(gt, LE)
+		CASE(lt, GE)
+		CASE(gte, L)
+		CASE(lte, G)
+#undef CASE
+	default: VYSE_UNREACHABLE();
+	}
+
+#ifdef VYSE_NAN_TAGGING
+	(void)fails;
+	emit_call(fn, depth, next(offset), var, rhs);
+	m_asm.cmp32(RAX, s32(JitRuntime::Branch));
+	m_asm.jcc(E, on_false);
+#else
+	// Integer locals are compared inline with each other, or with an integer constant.
+	if (is_const and !VYSE_IS_INT(constant(offset, 1))) {
+		emit_call(fn, depth, next(offset), var, rhs);
+		m_asm.cmp32(RAX, s32(JitRuntime::Branch));
+		m_asm.jcc(E, on_false);
+	} else {
+		const Label slow = slow_path(fn, depth, next(offset), var, rhs, on_true, on_false);
+		m_asm.cmp8(tag(slot(var)), u8(ValueType::Integer));
+		m_asm.jcc(NE, slow);
+		if (is_const) {
+			m_asm.cmp32(payload(slot(var)), VYSE_AS_INT(constant(offset, 1)));
+		} else {
+			m_asm.cmp8(tag(slot(int(rhs))), u8(ValueType::Integer));
+			m_asm.jcc(NE, slow);
+			m_asm.load32(RAX, payload(slot(var)));
+			m_asm.cmp32(RAX, payload(slot(int(rhs))));
+		}
+		m_asm.jcc(fails, on_false);
+	}
+#endif
+	m_asm.jmp(on_true);
+}
+
+void JitCompiler::emit_add_var_const(size_t offset, int depth) {
+	const Label done = m_labels[next(next(offset))];
+	const u8 var = operand(offset, 0);
+	const Value& k = constant(offset, 1);
+	const u64 rhs = reinterpret_cast<u64>(&k);
+
+#ifndef VYSE_NAN_TAGGING
+	if (VYSE_IS_INT(k)) {
+		const Label slow = slow_path(&JitRuntime::add_var_const, depth, next(offset), var, rhs,
+									 done, done);
+		m_asm.cmp8(tag(slot(var)), u8(ValueType::Integer));
+		m_asm.jcc(NE, slow);
+		m_asm.load32(RAX, payload(slot(var)));
+		m_asm.add32(RAX, VYSE_AS_INT(k));
+		m_asm.jcc(O, slow);
+		m_asm.store32(payload(slot(var)), RAX);
+		m_asm.jmp(done);
+		return;
+	}
+#endif
+	emit_call(&JitRuntime::add_var_const, depth, next(offset), var, rhs);
+	m_asm.jmp(done);
+}
+
+void JitCompiler::emit_for_loop(size_t offset, int depth) {
+	const Label body = m_labels[jump_target(offset)];
+	const Label exit = m_labels[next(offset)];
+#ifdef VYSE_NAN_TAGGING
+	emit_call(&JitRuntime::for_loop, depth, next(offset));
+	m_asm.cmp32(RAX, s32(JitRuntime::Branch));
+	m_asm.jcc(E, body);
+#else
+	// A loop over integers counts in a register, until the counter overflows.
+	const Mem counter = slot(depth - 4);
+	const Mem limit = slot(depth - 3);
+	const Mem step = slot(depth - 2);
+	const Mem var = slot(depth - 1);
+	const Label slow = slow_path(&JitRuntime::for_loop, depth, next(offset), 0, 0, exit, body);
+	const Label downwards = m_asm.new_label();
+
+	m_asm.cmp8(tag(counter), u8(ValueType::Integer));
+	m_asm.jcc(NE, slow);
+	m_asm.cmp8(tag(limit), u8(ValueType::Integer));
+	m_asm.jcc(NE, slow);
+	m_asm.cmp8(tag(step), u8(ValueType::Integer));
+	m_asm.jcc(NE, slow);
+	m_asm.load32(RAX, payload(counter));
+	m_asm.load32(RCX, payload(step));
+	m_asm.add32(RAX, RCX);
+	m_asm.jcc(O, slow);
+	m_asm.store32(payload(counter), RAX);
+	emit_copy(var, counter);
+
+	m_asm.test32(RCX, RCX);
+	m_asm.jcc(S, downwards);
+	m_asm.cmp32(RAX, payload(limit));
+	m_asm.jcc(L, body);
+	m_asm.jmp(exit);
+	m_asm.bind(downwards);
+	m_asm.cmp32(RAX, payload(limit));
+	m_asm.jcc(GE, body);
+#endif
+	m_asm.jmp(exit);
+}
+
+void JitCompiler::emit_instr(size_t offset, int depth) {
+	const Op op = op_at(offset);
+	const size_t ip = next(offset);
+	// The instructions that the JIT doesn't support are left to the interpreter.
+	const auto side_exit = [&] {
+		emit_call(&JitRuntime::side_exit, depth, offset);
+		m_asm.jmp(m_exit_interpret);
+	};
+
+	const auto call = [&](JitHelperFn fn, u64 a = 0, u64 b = 0, u64 c = 0) {
+		emit_call(fn, depth, ip, a, b, c);
+	};
+
+	const auto cached = [&](JitHelperFn fn) {
+		call(fn, reinterpret_cast<u64>(&constant(offset, 0)),
+			 reinterpret_cast<u64>(&m_native.block().inline_caches[operand(offset, 1)]));
+	};
+
+	switch (op) {
+	case Op::load_const: emit_store(slot(depth), constant(offset, 0)); break;
+	case Op::load_nil: emit_store(slot(depth), VYSE_NIL); break;
+	case Op::get_var: emit_copy(slot(depth), slot(operand(offset, 0))); break;
+	case Op::set_var: emit_copy(slot(operand(offset, 0)), slot(depth - 1)); break;
+	case Op::pop: break;
+
+	case Op::get_global:
+		call(&JitRuntime::get_global,
+			 reinterpret_cast<u64>(&m_native.block().globals[operand(offset, 0)]));
+		break;
+	case Op::set_global:
+		call(&JitRuntime::set_global,
+			 reinterpret_cast<u64>(&m_native.block().globals[operand(offset, 0)]));
+		break;
+	case Op::get_upval: call(&JitRuntime::get_upval, operand(offset, 0)); break;
+	case Op::set_upval: call(&JitRuntime::set_upval, operand(offset, 0)); break;
+	case Op::get_capture: call(&JitRuntime::get_capture, operand(offset, 0)); break;
+	case Op::close_upval: call(&JitRuntime::close_upval); break;
+
+	case Op::table_get: cached(&JitRuntime::table_get); break;
+	case Op::table_set: cached(&JitRuntime::table_set); break;
+	case Op::table_get_no_pop: cached(&JitRuntime::table_get_no_pop); break;
+	case Op::prep_method_call: cached(&JitRuntime::prep_method_call); break;
+	case Op::invoke:
+		call(&JitRuntime::invoke, reinterpret_cast<u64>(&constant(offset, 0)),
+			 reinterpret_cast<u64>(&m_native.block().inline_caches[operand(offset, 1)]),
+			 operand(offset, 2));
+		break;
+
+	case Op::add:
+	case Op::sub:
+	case Op::mult:
+	case Op::gt:
+	case Op::lt:
+	case Op::gte:
+	case Op::lte: emit_arith(offset, depth, op); break;
+
+	case Op::div: call(&JitRuntime::div); break;
+	case Op::mod: call(&JitRuntime::mod); break;
+	case Op::exp: call(&JitRuntime::exp); break;
+	case Op::eq: call(&JitRuntime::eq); break;
+	case Op::neq: call(&JitRuntime::neq); break;
+	case Op::lshift: call(&JitRuntime::lshift); break;
+	case Op::rshift: call(&JitRuntime::rshift); break;
+	case Op::band: call(&JitRuntime::band); break;
+	case Op::bxor: call(&JitRuntime::bxor); break;
+	case Op::bor: call(&JitRuntime::bor); break;
+	case Op::concat: call(&JitRuntime::concat); break;
+	case Op::negate: call(&JitRuntime::negate); break;
+	case Op::lnot: {
+		const Label falsy = m_asm.new_label();
+		const Label done = m_asm.new_label();
+		emit_jump_if(false, slot(depth - 1), falsy);
+		emit_store(slot(depth - 1), VYSE_BOOL(false));
+		m_asm.jmp(done);
+		m_asm.bind(falsy);
+		emit_store(slot(depth - 1), VYSE_BOOL(true));
+		m_asm.bind(done);
+		break;
+	}
+	case Op::len: call(&JitRuntime::len); break;
+	case Op::bnot: call(&JitRuntime::bnot); break;
+
+	case Op::new_table: call(&JitRuntime::new_table); break;
+	case Op::new_list: call(&JitRuntime::new_list); break;
+	case Op::table_add_field: call(&JitRuntime::table_add_field); break;
+	case Op::list_append: call(&JitRuntime::list_append); break;
+	case Op::subscript_get: call(&JitRuntime::subscript_get); break;
+	case Op::subscript_set: call(&JitRuntime::subscript_set); break;
+	case Op::index_no_pop: call(&JitRuntime::index_no_pop); break;
+	case Op::vararg_len: call(&JitRuntime::vararg_len); break;
+	case Op::vararg_get: call(&JitRuntime::vararg_get); break;
+
+	case Op::make_func:
+		call(&JitRuntime::make_func, reinterpret_cast<u64>(&m_native.block().code[offset]));
+		break;
+	case Op::call_func: call(&JitRuntime::call_func, operand(offset, 0)); break;
+	case Op::return_val:
+		call(&JitRuntime::return_val);
+		m_asm.jmp(m_exit_return);
+		break;
+
+	case Op::jmp:
+	case Op::jmp_back: m_asm.jmp(m_labels[jump_target(offset)]); break;
+	case Op::pop_jmp_if_false:
+	case Op::jmp_if_false_or_pop:
+		emit_jump_if(false, slot(depth - 1), m_labels[jump_target(offset)]);
+		break;
+	case Op::jmp_if_true_or_pop:
+		emit_jump_if(true, slot(depth - 1), m_labels[jump_target(offset)]);
+		break;
+
+	case Op::for_prep:
+		call(&JitRuntime::for_prep);
+		m_asm.jmp(m_labels[jump_target(offset)]);
+		break;
+	case Op::for_loop: emit_for_loop(offset, depth); break;
+	case Op::add_var_const: emit_add_var_const(offset, depth); break;
+
+	default:
+		if (NativeBlock::is_fused_cmp(op)) {
+			emit_cmp_jmp(offset, depth, op);
+			break;
+		}
+		side_exit();
+		break;
+	}
+}
+
+bool JitCompiler::compile() {
+	if (!m_native.analyze()) return false;
+
+	m_labels.reserve(m_native.size());
+	for (size_t i = 0; i < m_native.size(); ++i) m_labels.push_back(m_asm.new_label());
+	m_exit_error = m_asm.new_label();
+	m_exit_return = m_asm.new_label();
+	m_exit_interpret = m_asm.new_label();
+
+	// The code is called as `JitExit (*)(JitFrame* frame, const void* entry)`, and jumps to the
+	// instruction at [entry] after setting up the registers.
+	m_asm.push(RBP);
+	m_asm.push(RBX);
+	m_asm.push(R12);
+	m_asm.mov(R12, RDI);
+	m_asm.load(RBX, {R12, offsetof(JitFrame, base)});
+	m_asm.jmp(RSI);
+
+	for (size_t offset = 0; offset < m_native.size(); offset = next(offset)) {
+		m_asm.bind(m_labels[offset]);
+		if (m_native.depth(offset) >= 0) emit_instr(offset, m_native.depth(offset));
+	}
+
+	// Labels in the middle of an instruction are never jumped to.
+	for (size_t offset = 0; offset < m_native.size(); ++offset) {
+		if (m_asm.position(m_labels[offset]) == SIZE_MAX) m_asm.bind(m_labels[offset]);
+	}
+
+	for (size_t i = 0; i < m_slow_paths.size(); ++i) m_slow_paths[i]();
+
+	m_asm.bind(m_exit_error);
+	emit_exit(JitExit::Error);
+	m_asm.bind(m_exit_return);
+	emit_exit(JitExit::Return);
+	m_asm.bind(m_exit_interpret);
+	emit_exit(JitExit::Interpret);
+	return true;
+}
+
+} // namespace
+
+bool Jit::compile(CodeBlock& code) {
+	JitCompiler compiler{code};
+	if (!compiler.compile()) return false;
+
+	const std::vector<u8>& native = compiler.code();
+	const size_t page_size = size_t(sysconf(_SC_PAGESIZE));
+	const size_t size = (native.size() + page_size - 1) / page_size * page_size;
+	void* const memory =
+		mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (memory == MAP_FAILED) return false;
+
+	std::memcpy(memory, native.data(), native.size());
+	if (mprotect(memory, size, PROT_READ | PROT_EXEC) != 0) {
+		munmap(memory, size);
+		return false;
+	}
+
+	if (m_perf_map != nullptr) {
+		std::fprintf(m_perf_map, "%" PRIxPTR " %zx vy:%s\n", reinterpret_cast<uintptr_t>(memory),
+					 native.size(), code.name_cstr());
+		std::fflush(m_perf_map);
+	}
+
+	code.set_jit_code(std::make_unique<JitCode>(memory, size, compiler.entries()));
+	return true;
+}
+
+JitExit Jit::run(const CodeBlock& code) {
+	using NativeFn = u32 (*)(JitFrame*, const void*);
+
+	const JitCode& jit_code = *code.jit_code();
+	const void* const entry = jit_code.entry(m_vm.ip);
+	if (entry == nullptr) return JitExit::Interpret;
+
+	JitFrame frame{&m_vm, m_vm.base()};
+	const auto native = reinterpret_cast<NativeFn>(reinterpret_cast<uintptr_t>(jit_code.memory()));
+	return JitExit(native(&frame, entry));
+}
+
+#endif
+
+} // namespace vy
@@ -0,0 +1,726 @@
+#include "../str_format.hpp"
+#include <cmath>
+#include <compiler.hpp>
+#include <function.hpp>
+#include <jit_runtime.hpp>
+#include <list.hpp>
+#include <vm.hpp>
+
+namespace vy {
+
+using Op = Opcode;
+
+#define JIT_HELPER(name)                                                                           \
+	u32 JitRuntime::name([[maybe_unused]] JitFrame* f, [[maybe_unused]] Value* top,                \
+						 [[maybe_unused]] u32 ip, [[maybe_unused]] u64 a, [[maybe_unused]] u64 b,  \
+						 [[maybe_unused]] u64 c)
+
+// Compares the numbers [l] and [r] with [op], like the interpreter does.
+#define NUM_CMP(l, op, r)                                                                          \
+	((VYSE_IS_INT(l) and VYSE_IS_INT(r)) ? (VYSE_AS_INT(l) op VYSE_AS_INT(r))                      \
+										 : (VYSE_AS_NUM(l) op VYSE_AS_NUM(r)))
+
+#define ARITH_NUMS(l, op, r)                                                                       \
+	if (VYSE_IS_INT(l) and VYSE_IS_INT(r)) {                                                       \
+		l = int_or_num(s64(VYSE_AS_INT(l)) op s64(VYSE_AS_INT(r)));                                \
+	} else {                                                                                       \
+		VYSE_SET_NUM(l, VYSE_AS_NUM(l) op VYSE_AS_NUM(r));                                         \
+	}
+
+#define RUN_ERROR(...) (vm.runtime_error(kt::format_str(__VA_ARGS__)), Failed)
+#define INDEX_ERROR(v) RUN_ERROR("Attempt to index a '{}' value.", value_type_name(v))
+
+/// @brief Brings the VM up to date with native code before it runs an instruction.
+VM& JitRuntime::enter(JitFrame* f, Value* top, u32 ip) noexcept {
+	VM& vm = *f->vm;
+	vm.m_stack.top = top;
+	vm.ip = ip;
+	return vm;
+}
+
+/// @brief Updates [f] after a call that may have moved the stack.
+u32 JitRuntime::leave(JitFrame* f, bool ok, u32 status) noexcept {
+	f->base = f->vm->base();
+	return ok ? status : Failed;
+}
+
+Closure& JitRuntime::closure(VM& vm) noexcept {
+	return *static_cast<Closure*>(vm.m_current_frame->func);
+}
+
+/// @brief Runs the function that a call has just pushed a frame for, if any, until it returns.
+/// Functions that are already compiled skip the interpreter.
+bool JitRuntime::finish(VM& vm, u32 frame_count) {
+	if (vm.m_frame_count == frame_count) return true;
+
+	const CodeBlock& code = *closure(vm).m_codeblock;
+	const JitExit exit = code.has_native_code() ? vm.run_compiled(code) : JitExit::Interpret;
+	if (exit == JitExit::Error) return false;
+	if (exit == JitExit::Interpret and !vm.finish_call(frame_count)) return false;
+	vm.restore_frame();
+	return true;
+}
+
+/// @brief Runs the overload of a binary operator for the two values on top of the stack, which
+/// are replaced by the result.
+bool JitRuntime::overload(VM& vm, const char* op_str, const char* method) {
+	const u32 frame_count = vm.m_frame_count;
+	return vm.call_binary_overload(op_str, method) and finish(vm, frame_count);
+}
+
+/// @brief Calls [callee], which is on the stack below it's [argc] arguments, and runs it until
+/// it returns. The result is left in the callee's slot.
+bool JitRuntime::call(VM& vm, const Value& callee, u8 argc) {
+	if (VYSE_IS_CCLOSURE(callee) and VM::is_frameless(VYSE_AS_CCLOSURE(callee))) {
+		return vm.call_fast_cclosure(VYSE_AS_CCLOSURE(callee), argc);
+	}
+
+	const u32 frame_count = vm.m_frame_count;
+	return vm.op_call(callee, argc) and finish(vm, frame_count);
+}
+
+#define ARITH_HELPER(name, op, op_str, method)                                                     \
+	JIT_HELPER(name) {                                                                             \
+		Value& l = top[-2];                                                                        \
+		const Value& r = top[-1];                                                                  \
+		if (VYSE_IS_NUM(l) and VYSE_IS_NUM(r)) {                                                   \
+			ARITH_NUMS(l, op, r);                                                                  \
+			return Next;                                                                           \
+		}                                                                                          \
+		VM& vm = enter(f, top, ip);                                                                \
+		return leave(f, overload(vm, op_str, method));                                             \
+	}
+
+#define CMP_HELPER(name, op, method)                                                               \
+	JIT_HELPER(name) {                                                                             \
+		Value& l = top[-2];                                                                        \
+		const Value& r = top[-1];                                                                  \
+		if (VYSE_IS_NUM(l) and VYSE_IS_NUM(r)) {                                                   \
+			l = VYSE_BOOL(NUM_CMP(l, op, r));                                                      \
+			return Next;                                                                           \
+		}                                                                                          \
+		VM& vm = enter(f, top, ip);                                                                \
+		return leave(f, overload(vm, #op, method));                                                \
+	}
+
+#define BIT_HELPER(name, op, method)                                                               \
+	JIT_HELPER(name) {                                                                             \
+		Value& l = top[-2];                                                                        \
+		const Value& r = top[-1];                                                                  \
+		if (VYSE_IS_INT(l) and VYSE_IS_INT(r)) {                                                   \
+			l = int_or_num(s64(VYSE_AS_INT(l)) op s64(VYSE_AS_INT(r)));                            \
+			return Next;                                                                           \
+		}                                                                                          \
+		if (VYSE_IS_NUM(l) and VYSE_IS_NUM(r)) {                                                   \
+			l = int_or_num(VYSE_CAST_INT(l) op VYSE_CAST_INT(r));                                  \
+			return Next;                                                                           \
+		}                                                                                          \
+		VM& vm = enter(f, top, ip);                                                                \
+		return leave(f, overload(vm, #op, method));                                                \
+	}
+
+ARITH_HELPER(add, +, "+", "__add")
+ARITH_HELPER(sub, -, "-", "__sub")
+ARITH_HELPER(mult, *, "*", "__mult")
+CMP_HELPER(gt, >, "__gt")
+CMP_HELPER(lt, <, "__lt")
+CMP_HELPER(gte, >=, "__gte")
+CMP_HELPER(lte, <=, "__lte")
+BIT_HELPER(lshift, <<, "__bsl")
+BIT_HELPER(rshift, >>, "__bsr")
+BIT_HELPER(band, &, "__band")
+BIT_HELPER(bxor, ^, "__bxor")
+BIT_HELPER(bor, |, "__bor")
+
+#undef ARITH_HELPER
+#undef CMP_HELPER
+#undef BIT_HELPER
+
+JIT_HELPER(div) {
+	VM& vm = enter(f, top, ip);
+	Value& l = top[-2];
+	const Value& r = top[-1];
+	if (VYSE_IS_NUM(l) and VYSE_IS_NUM(r)) {
+		if (VYSE_AS_NUM(l) == 0) return RUN_ERROR("Attempt to divide by 0.\n");
+		VYSE_SET_NUM(l, VYSE_AS_NUM(l) / VYSE_AS_NUM(r));
+		return Next;
+	}
+	return leave(f, overload(vm, "/", "__div"));
+}
+
+JIT_HELPER(exp) {
+	Value& base = top[-2];
+	const Value& power = top[-1];
+	if (VYSE_IS_NUM(base) and VYSE_IS_NUM(power)) {
+		VYSE_SET_NUM(base, pow(VYSE_AS_NUM(base), VYSE_AS_NUM(power)));
+		return Next;
+	}
+	VM& vm = enter(f, top, ip);
+	return leave(f, overload(vm, "/", "__exp"));
+}
+
+JIT_HELPER(mod) {
+	Value& l = top[-2];
+	const Value& r = top[-1];
+	if (VYSE_IS_INT(l) and VYSE_IS_INT(r) and VYSE_AS_INT(r) != 0) {
+		l = VYSE_INT(s64(VYSE_AS_INT(l)) % s64(VYSE_AS_INT(r)));
+		return Next;
+	}
+	if (VYSE_IS_NUM(l) and VYSE_IS_NUM(r)) {
+		VYSE_SET_NUM(l, fmod(VYSE_AS_NUM(l), VYSE_AS_NUM(r)));
+		return Next;
+	}
+	VM& vm = enter(f, top, ip);
+	return leave(f, overload(vm, "%", "__mod"));
+}
+
+JIT_HELPER(eq) {
+	top[-2] = VYSE_BOOL(top[-2] == top[-1]);
+	return Next;
+}
+
+JIT_HELPER(neq) {
+	top[-2] = VYSE_BOOL(top[-2] != top[-1]);
+	return Next;
+}
+
+JIT_HELPER(concat) {
+	VM& vm = enter(f, top, ip);
+	Value& l = top[-2];
+	const Value r = top[-1];
+	if (!(VYSE_IS_STRING(l) and VYSE_IS_STRING(r))) {
+		vm.binop_error("..", l, r);
+		return Failed;
+	}
+
+	// The right operand is no longer on the stack when the result is allocated.
+	vm.m_stack.top = top - 1;
+	GCLock _ = vm.gc_lock(VYSE_AS_STRING(r));
+	l = vm.concatenate(VYSE_AS_STRING(l), VYSE_AS_STRING(r));
+	return Next;
+}
+
+JIT_HELPER(negate) {
+	VM& vm = enter(f, top, ip);
+	Value& operand = top[-1];
+	if (VYSE_IS_INT(operand)) {
+		operand = int_or_num(-s64(VYSE_AS_INT(operand)));
+	} else if (VYSE_IS_NUM(operand)) {
+		VYSE_SET_NUM(operand, -VYSE_AS_NUM(operand));
+	} else {
+		const u32 frame_count = vm.m_frame_count;
+		if (!vm.call_unary_overload("__negate")) {
+			return RUN_ERROR("Cannot use operator '{}' on type '{}'.", "-",
+							 value_type_name(operand));
+		}
+		if (!vm.finish_call(frame_count)) return leave(f, false);
+		vm.restore_frame();
+		return leave(f, true);
+	}
+	return Next;
+}
+
+JIT_HELPER(len) {
+	VM& vm = enter(f, top, ip);
+	Value& v = top[-1];
+	if (VYSE_IS_LIST(v)) {
+		v = int_or_num(VYSE_AS_LIST(v)->length());
+	} else if (VYSE_IS_TABLE(v)) {
+		v = int_or_num(VYSE_AS_TABLE(v)->length());
+	} else if (VYSE_IS_STRING(v)) {
+		v = int_or_num(VYSE_AS_STRING(v)->len());
+	} else {
+		return RUN_ERROR("Attempt to get length of a {} value", value_type_name(v));
+	}
+	return Next;
+}
+
+JIT_HELPER(bnot) {
+	VM& vm = enter(f, top, ip);
+	Value& v = top[-1];
+	if (VYSE_IS_INT(v)) {
+		v = VYSE_INT(~VYSE_AS_INT(v));
+	} else if (VYSE_IS_NUM(v)) {
+		v = int_or_num(~VYSE_CAST_INT(v));
+	} else {
+		return RUN_ERROR("Cannot use operator '~' on value of type '{}'", value_type_name(v));
+	}
+	return Next;
+}
+
+// a: the global's `GlobalRef`.
+JIT_HELPER(get_global) {
+	VM& vm = *f->vm;
+	const GlobalRef& global = *reinterpret_cast<const GlobalRef*>(a);
+	const Value value = vm.m_globals[global.slot];
+	if (VYSE_IS_UNDEFINED(value)) {
+		enter(f, top, ip);
+		return RUN_ERROR("Undefined variable '{}'.", global.name->c_str());
+	}
+	*top = value;
+	return Next;
+}
+
+JIT_HELPER(set_global) {
+	f->vm->m_globals[reinterpret_cast<const GlobalRef*>(a)->slot] = top[-1];
+	return Next;
+}
+
+// a: the index of the upvalue or capture.
+JIT_HELPER(get_upval) {
+	*top = *closure(*f->vm).get_upval(a)->m_value;
+	return Next;
+}
+
+JIT_HELPER(set_upval) {
+	*closure(*f->vm).get_upval(a)->m_value = top[-1];
+	return Next;
+}
+
+JIT_HELPER(get_capture) {
+	*top = closure(*f->vm).capture(a);
+	return Next;
+}
+
+JIT_HELPER(close_upval) {
+	f->vm->close_upvalues_upto(top - 1);
+	return Next;
+}
+
+JIT_HELPER(new_table) {
+	VM& vm = enter(f, top, ip);
+	*top = VYSE_OBJECT(&vm.make<Table>(&vm.m_root_shape));
+	return Next;
+}
+
+JIT_HELPER(new_list) {
+	VM& vm = enter(f, top, ip);
+	*top = VYSE_OBJECT(&vm.make<List>());
+	return Next;
+}
+
+JIT_HELPER(table_add_field) {
+	VM& vm = enter(f, top, ip);
+	if (!VYSE_IS_TABLE(top[-3])) return INDEX_ERROR(top[-3]);
+	VYSE_AS_TABLE(top[-3])->set(top[-2], top[-1]);
+	return Next;
+}
+
+JIT_HELPER(list_append) {
+	VM& vm = enter(f, top, ip);
+	const Value& list = top[-2];
+	if (!VYSE_IS_LIST(list)) {
+		return RUN_ERROR("Attempt to append to a {} value. (Can only append to lists)",
+						 value_type_name(list));
+	}
+	VYSE_AS_LIST(list)->append(top[-1]);
+	return Next;
+}
+
+// a: the key in the constant pool, b: the inline cache.
+JIT_HELPER(table_get) {
+	VM& vm = enter(f, top, ip);
+	const Value& key = *reinterpret_cast<const Value*>(a);
+	InlineCache& cache = *reinterpret_cast<InlineCache*>(b);
+	Value& dst = top[-1];
+	if (VYSE_IS_TABLE(dst)) {
+		const Table& table = *VYSE_AS_TABLE(dst);
+		if (table.get_cached(key, cache, dst)) {
+			++cache.hits;
+		} else {
+			++cache.misses;
+			dst = table.get_and_cache(key, cache);
+		}
+		return Next;
+	}
+
+	if (!VYSE_IS_UDATA(dst)) return INDEX_ERROR(dst);
+	const UserData& udata = *VYSE_AS_UDATA(dst);
+	return leave(f, vm.get_field_of_udata(udata, key, dst));
+}
+
+JIT_HELPER(table_get_no_pop) {
+	VM& vm = enter(f, top, ip);
+	const Value& key = *reinterpret_cast<const Value*>(a);
+	InlineCache& cache = *reinterpret_cast<InlineCache*>(b);
+	const Value& object = top[-1];
+	if (VYSE_IS_TABLE(object)) {
+		const Table& table = *VYSE_AS_TABLE(object);
+		if (table.get_cached(key, cache, *top)) {
+			++cache.hits;
+		} else {
+			++cache.misses;
+			*top = table.get_and_cache(key, cache);
+		}
+		return Next;
+	}
+
+	if (!VYSE_IS_UDATA(object)) return INDEX_ERROR(object);
+	Value result;
+	if (!vm.get_field_of_udata(*VYSE_AS_UDATA(object), key, result)) return Failed;
+	vm.m_stack.push(result);
+	return leave(f, true);
+}
+
+JIT_HELPER(table_set) {
+	VM& vm = enter(f, top, ip);
+	const Value& key = *reinterpret_cast<const Value*>(a);
+	InlineCache& cache = *reinterpret_cast<InlineCache*>(b);
+	if (VYSE_IS_NIL(key)) return RUN_ERROR("Table key cannot be nil.");
+
+	const Value value = top[-1];
+	Value& object = top[-2];
+	if (VYSE_IS_TABLE(object)) {
+		Table& table = *VYSE_AS_TABLE(object);
+		if (table.set_cached(key, value, cache)) {
+			++cache.hits;
+		} else {
+			++cache.misses;
+			table.set_and_cache(key, value, cache);
+		}
+	} else if (VYSE_IS_UDATA(object)) {
+		vm.m_stack.top = top - 1;
+		if (!vm.set_field_of_udata(*VYSE_AS_UDATA(object), key, value)) return leave(f, false);
+		f->base = vm.base();
+	} else {
+		return INDEX_ERROR(object);
+	}
+
+	// assignment returns it's RHS.
+	vm.m_stack.top[-1] = value;
+	return Next;
+}
+
+JIT_HELPER(prep_method_call) {
+	VM& vm = enter(f, top, ip);
+	const Value& key = *reinterpret_cast<const Value*>(a);
+	InlineCache& cache = *reinterpret_cast<InlineCache*>(b);
+	const Value object = top[-1];
+	if (VYSE_IS_NIL(object)) return INDEX_ERROR(object);
+	top[-1] = vm.get_method(object, key, cache);
+	*top = object;
+	return Next;
+}
+
+// a: the method's name in the constant pool, b: the inline cache, c: the argument count.
+JIT_HELPER(invoke) {
+	VM& vm = enter(f, top, ip);
+	const Value& key = *reinterpret_cast<const Value*>(a);
+	InlineCache& cache = *reinterpret_cast<InlineCache*>(b);
+	const u8 argc = u8(c);
+	Value* const self = top - argc;
+	if (VYSE_IS_NIL(*self)) return INDEX_ERROR(*self);
+	const Value method = vm.get_method(*self, key, cache);
+
+	// [object, args...] -> [method, object, args...]
+	for (Value* arg = top; arg != self; --arg) *arg = arg[-1];
+	*self = method;
+	vm.m_stack.top = top + 1;
+	return leave(f, call(vm, method, argc));
+}
+
+JIT_HELPER(subscript_get) {
+	VM& vm = enter(f, top, ip);
+	const Value key = top[-1];
+	vm.m_stack.top = top - 1;
+	return leave(f, vm.get_subscript_of_value(top[-2], key, top[-2]));
+}
+
+JIT_HELPER(index_no_pop) {
+	VM& vm = enter(f, top, ip);
+	Value result;
+	const bool ok = vm.get_subscript_of_value(top[-2], top[-1], result);
+	*top = result;
+	return leave(f, ok);
+}
+
+JIT_HELPER(subscript_set) {
+	VM& vm = enter(f, top, ip);
+	const Value rhs = top[-1];
+	const Value key = top[-2];
+	vm.m_stack.top = top - 2;
+	const bool ok = vm.subscript_set(top[-3], key, rhs);
+	// assignment returns it's RHS.
+	top[-3] = ok ? rhs : VYSE_NIL;
+	return leave(f, true);
+}
+
+JIT_HELPER(vararg_len) {
+	VM& vm = enter(f, top, ip);
+	return leave(f, vm.get_vararg_len(top[-1]));
+}
+
+JIT_HELPER(vararg_get) {
+	VM& vm = enter(f, top, ip);
+	const Value index = top[-1];
+	vm.m_stack.top = top - 1;
+	return leave(f, vm.get_vararg(index, top[-2]));
+}
+
+// a: the argument count.
+JIT_HELPER(call_func) {
+	VM& vm = enter(f, top, ip);
+	const u8 argc = u8(a);
+	return leave(f, call(vm, top[-argc - 1], argc));
+}
+
+// a: the `make_func` instruction.
+JIT_HELPER(make_func) {
+	VM& vm = enter(f, top, ip);
+	const Opcode* const pc = reinterpret_cast<const Opcode*>(a);
+	const Value vcode = vm.m_current_block->constant_pool[u8(pc[1])];
+	const u32 num_upvals = u8(pc[2]);
+	if (num_upvals == 0) {
+		*top = VYSE_OBJECT(&vm.shared_closure(VYSE_AS_PROTO(vcode)));
+		return Next;
+	}
+
+	Closure* const func = &vm.make_closure(VYSE_AS_PROTO(vcode), num_upvals);
+	*top = VYSE_OBJECT(func);
+	vm.m_stack.top = top + 1;
+	for (u8 i = 0; i < num_upvals; ++i) {
+		const u8 flags = u8(pc[3 + 2 * i]);
+		const u8 index = u8(pc[4 + 2 * i]);
+		vm.capture_variable(*func, i, flags, f->base + index, index);
+	}
+	return Next;
+}
+
+JIT_HELPER(return_val) {
+	VM& vm = enter(f, top, ip);
+	const Value result = top[-1];
+	vm.close_upvalues_upto(f->base);
+	// The return value replaces the function, below any extra arguments kept on the stack.
+	vm.m_stack.top = f->base - vm.m_current_frame->num_varargs;
+	vm.m_stack.push(result);
+
+	--vm.m_frame_count;
+	if (vm.m_frame_count == 0) {
+		vm.return_value = result;
+	} else {
+		--vm.m_current_frame;
+	}
+	return Next;
+}
+
+// Hands the function to the interpreter, which picks it up at the instruction at [ip].
+JIT_HELPER(side_exit) {
+	enter(f, top, ip);
+	return Next;
+}
+
+JIT_HELPER(for_prep) {
+	VM& vm = enter(f, top, ip);
+	Value& counter = top[-3];
+	const Value& limit = top[-2];
+	const Value& step = top[-1];
+	if (!VYSE_IS_NUM(counter)) return RUN_ERROR("'for' variable not a number.");
+	if (!VYSE_IS_NUM(limit)) return RUN_ERROR("'for' limit not a number.");
+	if (!VYSE_IS_NUM(step)) return RUN_ERROR("'for' step not a number.");
+
+	if (VYSE_IS_INT(counter) and VYSE_IS_INT(step)) {
+		counter = int_or_num(s64(VYSE_AS_INT(counter)) - VYSE_AS_INT(step));
+	} else {
+		VYSE_SET_NUM(counter, VYSE_AS_NUM(counter) - VYSE_AS_NUM(step));
+	}
+	*top = counter;
+	return Next;
+}
+
+JIT_HELPER(for_loop) {
+	Value& counter = top[-4];
+	const Value& limit = top[-3];
+	const Value& step = top[-2];
+
+	if (VYSE_IS_INT(counter) and VYSE_IS_INT(limit) and VYSE_IS_INT(step)) {
+		const s32 istep = VYSE_AS_INT(step);
+		const s64 next = s64(VYSE_AS_INT(counter)) + istep;
+		counter = int_or_num(next);
+		top[-1] = counter;
+		const s32 ilimit = VYSE_AS_INT(limit);
+		return (istep >= 0 ? next < ilimit : next >= ilimit) ? Branch : Next;
+	}
+
+	const number nstep = VYSE_AS_NUM(step);
+	VYSE_SET_NUM(counter, VYSE_AS_NUM(counter) + nstep);
+	top[-1] = counter;
+	const bool loops = nstep >= 0 ? VYSE_AS_NUM(counter) < VYSE_AS_NUM(limit)
+								  : VYSE_AS_NUM(counter) >= VYSE_AS_NUM(limit);
+	return loops ? Branch : Next;
+}
+
+/// @brief Reads the right hand side of a fused instruction, which is the slot of a local when
+/// [is_const] is false, and the address of a constant otherwise.
+template <bool is_const>
+static Value fused_rhs(JitFrame* f, u64 b) noexcept {
+	if constexpr (is_const) return *reinterpret_cast<const Value*>(b);
+	return f->base[b];
+}
+
+// The fused comparisons branch when the comparison is false, like the `pop_jmp_if_false` that
+// follows them. a: the slot of the local, b: see `fused_rhs`.
+#define CMP_JMP_HELPER(name, op, method, is_const)                                                 \
+	JIT_HELPER(name) {                                                                             \
+		const Value l = f->base[a];                                                                \
+		const Value r = fused_rhs<is_const>(f, b);                                                 \
+		if (VYSE_IS_NUM(l) and VYSE_IS_NUM(r)) return NUM_CMP(l, op, r) ? Next : Branch;           \
+		VM& vm = enter(f, top + 2, ip);                                                            \
+		top[0] = l;                                                                                \
+		top[1] = r;                                                                                \
+		if (!overload(vm, #op, method)) return leave(f, false);                                    \
+		return leave(f, true, is_val_truthy(vm.m_stack.pop()) ? Next : Branch);                    \
+	}
+
+#define EQ_JMP_HELPER(name, op, is_const)                                                          \
+	JIT_HELPER(name) {                                                                             \
+		return (f->base[a] op fused_rhs<is_const>(f, b)) ? Next : Branch;                          \
+	}
+
+EQ_JMP_HELPER(eq_var_var_jmp, ==, false)
+EQ_JMP_HELPER(neq_var_var_jmp, !=, false)
+CMP_JMP_HELPER(gt_var_var_jmp, >, "__gt", false)
+CMP_JMP_HELPER(lt_var_var_jmp, <, "__lt", false)
+CMP_JMP_HELPER(gte_var_var_jmp, >=, "__gte", false)
+CMP_JMP_HELPER(lte_var_var_jmp, <=, "__lte", false)
+EQ_JMP_HELPER(eq_var_const_jmp, ==, true)
+EQ_JMP_HELPER(neq_var_const_jmp, !=, true)
+CMP_JMP_HELPER(gt_var_const_jmp, >, "__gt", true)
+CMP_JMP_HELPER(lt_var_const_jmp, <, "__lt", true)
+CMP_JMP_HELPER(gte_var_const_jmp, >=, "__gte", true)
+CMP_JMP_HELPER(lte_var_const_jmp, <=, "__lte", true)
+
+#undef CMP_JMP_HELPER
+#undef EQ_JMP_HELPER
+
+// Also does the `set_var` that follows. a: the slot of the local, b: the constant.
+JIT_HELPER(add_var_const) {
+	Value& var = f->base[a];
+	const Value k = *reinterpret_cast<const Value*>(b);
+	if (VYSE_IS_NUM(var) and VYSE_IS_NUM(k)) {
+		ARITH_NUMS(var, +, k);
+		return Next;
+	}
+
+	VM& vm = enter(f, top + 2, ip);
+	top[0] = var;
+	top[1] = k;
+	if (!overload(vm, "+", "__add")) return leave(f, false);
+	f->base = vm.base();
+	f->base[a] = vm.m_stack.pop();
+	return Next;
+}
+
+const Block& JitRuntime::block(JitFrame* f) noexcept {
+	return closure(*f->vm).m_codeblock->block();
+}
+
+#undef RUN_ERROR
+#undef INDEX_ERROR
+
+
+NativeBlock::NativeBlock(const CodeBlock& code)
+	: m_block{code.block()}, m_code{code.block().code}, m_num_params{code.param_count()},
+	  m_depths(m_code.size(), -1) {}
+
+Op NativeBlock::op_at(size_t offset) const noexcept {
+	Op op = m_code[offset];
+	if (op >= Op_super_start and op <= Op_super_end) op = superinstruction(op).ops[0];
+	return generic_op(op);
+}
+
+size_t NativeBlock::next(size_t offset) const noexcept {
+	return offset + 1 + Compiler::op_arity(m_block, offset);
+}
+
+size_t NativeBlock::jump_target(size_t offset) const noexcept {
+	const Op op = op_at(offset);
+	const u16 dist = u16((operand(offset, 0) << 8) | operand(offset, 1));
+	const bool backwards = op == Op::jmp_back or op == Op::for_loop;
+	return backwards ? offset + 3 - dist : offset + 3 + dist;
+}
+
+bool NativeBlock::is_fused_cmp(Op op) noexcept {
+	return op >= Op_fused_start and op < Op::add_var_const;
+}
+
+bool NativeBlock::visit(std::vector<size_t>& worklist, size_t offset, int depth) {
+	if (offset >= m_code.size() or depth < 0) return false;
+	if (m_depths[offset] == -1) {
+		m_depths[offset] = depth;
+		worklist.push_back(offset);
+		return true;
+	}
+	return m_depths[offset] == depth;
+}
+
+bool NativeBlock::analyze() {
+	if (m_code.empty()) return false;
+	std::vector<size_t> worklist;
+	if (!visit(worklist, 0, m_num_params + 1)) return false;
+
+	while (!worklist.empty()) {
+		const size_t offset = worklist.back();
+		worklist.pop_back();
+		const int depth = m_depths[offset];
+		const Op op = op_at(offset);
+
+		bool ok = true;
+		switch (op) {
+		case Op::jmp:
+		case Op::jmp_back: ok = visit(worklist, jump_target(offset), depth); break;
+		case Op::return_val:
+		case Op::tail_call:
+		case Op::no_op: break;
+
+		case Op::pop_jmp_if_false:
+			ok = visit(worklist, jump_target(offset), depth - 1) and
+				 visit(worklist, next(offset), depth - 1);
+			break;
+
+		case Op::jmp_if_false_or_pop:
+		case Op::jmp_if_true_or_pop:
+			ok = visit(worklist, jump_target(offset), depth) and
+				 visit(worklist, next(offset), depth - 1);
+			break;
+
+		case Op::for_prep:
+			ok = visit(worklist, jump_target(offset), depth + 1) and
+				 visit(worklist, next(offset), depth + 1);
+			break;
+
+		case Op::for_loop:
+			ok = visit(worklist, jump_target(offset), depth) and
+				 visit(worklist, next(offset), depth);
+			break;
+
+		case Op::call_func: ok = visit(worklist, next(offset), depth - operand(offset, 0)); break;
+		case Op::invoke: ok = visit(worklist, next(offset), depth + 1 - operand(offset, 2)); break;
+		case Op::make_func: ok = visit(worklist, next(offset), depth + 1); break;
+
+		// The `set_var` is done by the fused instruction itself.
+		case Op::add_var_const: {
+			const size_t set = next(offset);
+			if (set >= m_code.size() or op_at(set) != Op::set_var) return false;
+			ok = visit(worklist, next(set), depth);
+			break;
+		}
+
+		default: {
+			// The fused comparisons also do the `pop_jmp_if_false` that follows them.
+			if (is_fused_cmp(op)) {
+				const size_t jump = next(offset);
+				if (jump >= m_code.size() or op_at(jump) != Op::pop_jmp_if_false) return false;
+				ok = visit(worklist, jump_target(jump), depth) and
+					 visit(worklist, next(jump), depth);
+				break;
+			}
+			ok = visit(worklist, next(offset), depth + Compiler::op_stack_effect(op));
+		}
+		}
+
+		if (!ok) return false;
+	}
+	return true;
+}
+
+} // namespace vy
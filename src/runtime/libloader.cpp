@@ -1,10 +1,15 @@
 #include "source.hpp"
 #include "util/args.hpp"
+#include <bytecode.hpp>
 #include <cstdlib>
 #include <filesystem>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
 #include <libloader.hpp>
 #include <list.hpp>
+#include <random>
+#include <sstream>
 #include <string_view>
 #include <util/lib_util.hpp>
 #include <vm.hpp>
@@ -43,6 +48,23 @@ Value DynLoader::read_std_lib(VM& vm, const StdModule& module) {
 	return VYSE_NIL;
 }
 
+const AotModule* DynLoader::read_aot_module(const std::string& dll_name,
+											 const std::string& module_name) {
+	if (std_dlls_path.empty()) return nullptr;
+
+	auto cached_it = cached_dyn_libs.find(dll_name);
+	if (cached_it == cached_dyn_libs.end()) {
+		Lib lib(dll_name, std_dlls_path);
+		cached_it = cached_dyn_libs.emplace(dll_name, std::move(lib)).first;
+	}
+
+	const Lib& lib = cached_it->second;
+	if (!lib) return nullptr;
+
+	if (auto get_module = lib.find<AotModuleFn>("vy_aot_" + module_name)) return get_module();
+	return nullptr;
+}
+
 static constexpr std::array<StdModule, 1> std_modules = {{
 #ifdef _WIN32
 	{"math", "libvymath"},
@@ -104,6 +126,91 @@ static bool is_recursive_import(const std::vector<SourceCode>& sources, const st
 	return false;
 }
 
+/// @brief The name of the file in the compile cache that holds the bytecode image of [source]. It
+/// is named after the module's contents and it's path, since the path is in the bytecode too (for
+/// error messages), and the tier, since only register tier VMs keep the register code.
+static std::string cache_file_name(const SourceCode& source, Tier tier) {
+	// FNV-1a
+	u64 hash = 14695981039346656037ull;
+	const auto add = [&hash](std::string_view bytes) {
+		for (const char c : bytes) {
+			hash ^= u8(c);
+			hash *= 1099511628211ull;
+		}
+	};
+	add(source.path);
+	add(std::string_view{"", 1});
+	add(source.code);
+
+	std::ostringstream name;
+	name << std::hex << std::setfill('0') << std::setw(16) << hash << '-' << source.code.size()
+		 << std::dec << "-v" << BytecodeVersion << (tier == Tier::Register ? "r" : "s")
+		 << BytecodeImageExtension;
+	return name.str();
+}
+
+/// @brief Writes [contents] to [path] such that other processes reading the file see either all of
+/// the contents or no file at all. The contents are written to a file of their own in the same
+/// directory first, which then replaces [path] in a single rename. Processes that have mapped the
+/// file that was replaced keep using it unchanged.
+static bool write_file_atomically(const std::filesystem::path& path, std::string_view contents) {
+	namespace fs = std::filesystem;
+	std::error_code error;
+	fs::create_directories(path.parent_path(), error);
+
+	std::random_device random;
+	std::ostringstream suffix;
+	suffix << ".tmp-" << std::hex << random() << random();
+	fs::path temp_path = path;
+	temp_path += suffix.str();
+
+	{
+		std::ofstream out{temp_path, std::ios::binary};
+		out.write(contents.data(), std::streamsize(contents.size()));
+		if (out.flush(); !out) {
+			out.close();
+			fs::remove(temp_path, error);
+			return false;
+		}
+	}
+
+	fs::rename(temp_path, path, error);
+	if (!error) return true;
+	fs::remove(temp_path, error);
+	return false;
+}
+
+Closure* DynLoader::compile_module(VM& vm, SourceCode source) {
+	const std::string& cache_dir =
+		vm.config().compile_cache.empty() ? compile_cache_path : vm.config().compile_cache;
+	if (cache_dir.empty()) return vm.compile(std::move(source));
+
+	const std::filesystem::path cache_file =
+		std::filesystem::path{cache_dir} / cache_file_name(source, vm.config().tier);
+	vm.add_source(std::move(source));
+
+	// Modules are cached as images, so that processes importing the same module share it's code.
+	// Files in the cache that can't be loaded (e.g because they were written by a different version
+	// of vyse, or were corrupted and fail their checksum) are treated as missing, and replaced.
+	std::string error;
+	if (const auto image = BytecodeImage::open(cache_file.string(), error)) {
+		++cache_stats.hits;
+		CodeBlock* const code = image->load(vm);
+		GCLock const lock = vm.gc_lock(code);
+		return &vm.make_closure(code, 0);
+	}
+
+	++cache_stats.misses;
+	Closure* const script = vm.compile_source();
+	if (script == nullptr) return nullptr;
+
+	// The bytecode is written before the module runs, so none of it's instructions are quickened.
+	if (write_file_atomically(cache_file, dump_image(*script->m_codeblock))) {
+		++cache_stats.writes;
+	}
+	return script;
+}
+
 Value load_module_from_fs(VM& vm, int argc) {
 	util::Args args{vm, "load_module_from_fs", 1, argc};
 	String& module_path = args.next<String>();
@@ -120,7 +227,7 @@ Value load_module_from_fs(VM& vm, int argc) {
 	auto maybe_source = SourceCode::from_path(resolved_module_path);
 	if (!maybe_source.has_value()) return VYSE_NIL;
 	
-	Closure* file_func = vm.compile(maybe_source.value());
+	Closure* file_func = vm.dynloader.compile_module(vm, std::move(maybe_source.value()));
 	vm.ensure_slots(1);
 	vm.m_stack.push(VYSE_OBJECT(file_func));
 	vm.call(0);
@@ -0,0 +1,59 @@
+#include <algorithm>
+#include <function.hpp>
+#include <prepared_call.hpp>
+#include <vm.hpp>
+
+namespace vy {
+
+PreparedCall::PreparedCall(VM& vm, Value callee, int argc)
+	: m_vm{vm}, m_callee{callee}, m_argc{argc}, m_base(vm.m_stack.top - vm.m_stack.values) {
+	VYSE_ASSERT(argc >= 0, "Negative argument count.");
+
+	uint num_slots = argc + 2;
+	if (VYSE_IS_CLOSURE(callee) and !VYSE_AS_CLOSURE(callee)->m_codeblock->is_vararg()) {
+		const CodeBlock& code = *VYSE_AS_CLOSURE(callee)->m_codeblock;
+		m_kind = Kind::Closure;
+		m_num_params = code.param_count();
+		num_slots = std::max(argc, m_num_params) + 2 + code.stack_size();
+	} else if (VYSE_IS_CCLOSURE(callee) and VYSE_AS_CCLOSURE(callee)->is_fast()) {
+		m_kind = Kind::FastNative;
+	}
+
+	m_vm.ensure_slots(num_slots);
+	m_vm.m_stack.push(callee);
+	m_vm.m_stack.push(callee);
+	for (int i = 0; i < argc; ++i) m_vm.m_stack.push(VYSE_NIL);
+}
+
+PreparedCall::~PreparedCall() {
+	m_vm.m_stack.top = m_vm.m_stack.values + m_base;
+}
+
+bool PreparedCall::invoke() {
+	Value* const slot = call_slot();
+	// The previous call left it's result in the slot of the callee.
+	*slot = m_callee;
+
+	bool ok;
+	if (m_kind == Kind::Closure and m_vm.m_frame_count < VM::MaxCallStack) {
+		// The slots were reserved up front, so the frame is pushed without checking for room or
+		// resolving the callee's type again.
+		for (int i = m_argc; i < m_num_params; ++i) slot[i + 1] = VYSE_NIL;
+		m_vm.m_stack.top = slot + m_num_params + 1;
+		m_vm.push_callframe(VYSE_AS_OBJECT(m_callee), m_num_params);
+		ok = m_vm.run() == ExitCode::Success;
+	} else if (m_kind == Kind::FastNative) {
+		m_vm.m_stack.top = slot + m_argc + 1;
+		ok = m_vm.call_fast_cclosure(VYSE_AS_CCLOSURE(m_callee), m_argc);
+	} else {
+		m_vm.m_stack.top = slot + m_argc + 1;
+		ok = m_vm.call(m_argc);
+	}
+
+	// Everything the callee left above the argument slots is garbage. The stack may have moved
+	// during the call, so the slot is found again.
+	m_vm.m_stack.top = call_slot() + m_argc + 1;
+	return ok;
+}
+
+} // namespace vy
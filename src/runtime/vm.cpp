@@ -1,9 +1,15 @@
 #include "../str_format.hpp"
 #include "userdata.hpp"
 #include "util.hpp"
+#include <algorithm>
+#include <bytecode.hpp>
 #include <cmath>
 #include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <filesystem>
+#include <jit_runtime.hpp>
 #include <libloader.hpp>
 #include <list.hpp>
 #include <stdlib/base.hpp>
@@ -15,32 +21,90 @@
 #include <vm.hpp>
 
 #if defined(VYSE_DEBUG_RUNTIME) || defined(VYSE_DEBUG_DISASSEMBLY)
-#include <cstdio>
 #include <debug.hpp>
 #endif
 
 #define ERROR(...) runtime_error(kt::format_str(__VA_ARGS__))
-#define INDEX_ERROR(v) ERROR("Attempt to index a '{}' value.", value_type_name(v))
+#define INDEX_ERROR(v) RUN_ERROR("Attempt to index a '{}' value.", value_type_name(v))
 #define CURRENT_LINE() (m_current_block->lines[ip - 1])
+// Reports an error from inside the run loop, where `ip` may be stale.
+#define RUN_ERROR(...) (SAVE_IP(), ERROR(__VA_ARGS__))
 
 #define CHECK_TYPE(v, typ, ...)                                                                    \
 	if (!VYSE_CHECK_TT(v, typ)) {                                                                  \
-		return ERROR(__VA_ARGS__);                                                                 \
+		return RUN_ERROR(__VA_ARGS__);                                                             \
 	}
 
 #define CHECK(cond, ...)                                                                           \
 	if (!(cond)) {                                                                                 \
-		return ERROR(__VA_ARGS__);                                                                 \
+		return RUN_ERROR(__VA_ARGS__);                                                             \
 	}
 
-#define FETCH() (m_current_block->code[ip++])
-#define NEXT_BYTE() (static_cast<u8>(m_current_block->code[ip++]))
+// Inside `VM::run`, the instruction pointer, the constant pool of the running block and the base
+// of the current call frame are cached in the locals `pc`, `constants` and `frame_base`.
+// The VM's own `ip` is only brought up to date by SAVE_IP() right before something that needs to
+// see it (a call, a return, or an error report), and the locals are refreshed from the VM with
+// LOAD_STATE() whenever the current frame may have changed or the stack may have moved.
+#define FETCH() (*pc++)
+#define NEXT_BYTE() (static_cast<u8>(*pc++))
 #define FETCH_SHORT()                                                                              \
-	(ip += 2, (u16)((static_cast<u8>(m_current_block->code[ip - 2]) << 8) |                        \
-					static_cast<u8>(m_current_block->code[ip - 1])))
-#define READ_VALUE() (m_current_block->constant_pool[NEXT_BYTE()])
-#define GET_VAR(index) (m_current_frame->base[index])
-#define SET_VAR(index, value) (m_current_frame->base[index] = value)
+	(pc += 2, (u16)((static_cast<u8>(pc[-2]) << 8) | static_cast<u8>(pc[-1])))
+#define READ_VALUE() (constants[NEXT_BYTE()])
+#define READ_CACHE() (m_current_block->inline_caches[NEXT_BYTE()])
+#define READ_GLOBAL() (m_current_block->globals[NEXT_BYTE()])
+#define GET_VAR(index) (frame_base[index])
+#define SET_VAR(index, value) (frame_base[index] = value)
+
+#define SAVE_IP() (ip = pc - m_current_block->code.data())
+#define LOAD_STATE()                                                                               \
+	(pc = m_current_block->code.data() + ip, constants = m_current_block->constant_pool.data(),    \
+	 frame_base = VM::frame_base(*m_current_frame))
+
+// Evaluates [call], which may push or pop call frames or grow the stack, with the interpreter
+// state spilled beforehand and reloaded afterwards. Yields the (boolean) result of [call].
+// A function that [call] pushes a frame for is run in this loop, unless it runs on the register
+// tier, in which case it runs to completion right away.
+#define PROTECT(call)                                                                              \
+	(SAVE_IP(), protect_ok = (call) and run_register_callee(), LOAD_STATE(), protect_ok)
+
+// Records the kinds of operands ([types]) that the running instruction was given, and rewrites it
+// into [quickened] once it has seen the same kinds for long enough. [n_read] is the number of
+// operand bytes that the instruction has already read.
+#define TRY_QUICKEN(n_read, quickened, types)                                                      \
+	do {                                                                                           \
+		const size_t offset = pc - m_current_block->code.data() - 1 - (n_read);                    \
+		if (m_current_block->observe(offset, types)) {                                             \
+			m_current_block->quicken(offset, Op::quickened);                                       \
+		}                                                                                          \
+	} while (false)
+
+// Turns the running quickened instruction back into [generic] after it was given operands of the
+// kinds in [types], and runs the generic instruction instead. The quickened instruction must not
+// have read any of it's operands yet, or changed the stack.
+// This is a plain block instead of a do-while, since VM_DISPATCH() may be a `break`.
+#define DEQUICKEN(generic, types)                                                                  \
+	{                                                                                              \
+		--pc;                                                                                      \
+		m_current_block->dequicken(pc - m_current_block->code.data(), Op::generic, types);         \
+		VM_DISPATCH();                                                                             \
+	}
+
+// Counts a jump back in a loop towards compiling the running function with the JIT, and continues
+// the loop in native code if the function has been compiled, by the JIT or ahead of time. Since
+// native code runs until the function returns or reaches an instruction that it can't run, the
+// interpreter may then have to return to the caller, or pick the function up at a different
+// instruction.
+#define JIT_BACK_EDGE()                                                                            \
+	if (m_native) {                                                                                \
+		SAVE_IP();                                                                                 \
+		const JitExit exit = run_native();                                                         \
+		if (exit == JitExit::Error) return ExitCode::RuntimeError;                                 \
+		if (exit == JitExit::Return) {                                                             \
+			if (m_frame_count < entry_frames) return ExitCode::Success;                            \
+			restore_frame();                                                                       \
+		}                                                                                          \
+		LOAD_STATE();                                                                              \
+	}
 
 // PEEK(1) fetches the topmost value in the stack.
 #define PEEK(depth) m_stack.top[-(depth)]
@@ -58,42 +122,122 @@ using OT = ObjType;
 #define IS_VAL_FALSY(v) ((VYSE_IS_BOOL(v) and !(VYSE_AS_BOOL(v))) or VYSE_IS_NIL(v))
 #define IS_VAL_TRUTHY(v) (!IS_VAL_FALSY(v))
 
-#define UNOP_ERROR(op, v) ERROR("Cannot use operator '{}' on type '{}'.", op, value_type_name(v))
+#define UNOP_ERROR(op, v)                                                                          \
+	RUN_ERROR("Cannot use operator '{}' on type '{}'.", op, value_type_name(v))
 
-#define CMP_OP(op, proto_method)                                                                   \
+// Compares the numbers [l] and [r] with [op].
+#define NUM_CMP(l, op, r)                                                                          \
+	((VYSE_IS_INT(l) and VYSE_IS_INT(r)) ? (VYSE_AS_INT(l) op VYSE_AS_INT(r))                      \
+										 : (VYSE_AS_NUM(l) op VYSE_AS_NUM(r)))
+
+// Stores the result of comparing the numbers [l] and [r] with [op] in [l].
+#define CMP_NUMS(l, op, r) (l = VYSE_BOOL(NUM_CMP(l, op, r)))
+
+// Two integer operands are added, subtracted or multiplied as 64 bit integers, which can never
+// overflow. The result is then stored as an integer if it fits in one, and as a double otherwise.
+#define ARITH_NUMS(l, op, r)                                                                       \
+	if (VYSE_IS_INT(l) and VYSE_IS_INT(r)) {                                                       \
+		l = int_or_num(s64(VYSE_AS_INT(l)) op s64(VYSE_AS_INT(r)));                                \
+	} else {                                                                                       \
+		VYSE_SET_NUM(l, VYSE_AS_NUM(l) op VYSE_AS_NUM(r));                                         \
+	}
+
+// The generic comparison and arithmetic instructions get quickened into [quickened] once they have
+// only been seen operating on numbers.
+#define CMP_OP(op, proto_method, quickened)                                                        \
 	do {                                                                                           \
 		Value& r = PEEK(1);                                                                        \
 		Value& l = PEEK(2);                                                                        \
                                                                                                    \
 		if (VYSE_IS_NUM(l) and VYSE_IS_NUM(r)) {                                                   \
-			m_stack.top[-2] = (VYSE_BOOL(VYSE_AS_NUM(l) op VYSE_AS_NUM(r)));                       \
+			TRY_QUICKEN(0, quickened, feedback_bits(l) | feedback_bits(r));                        \
+			CMP_NUMS(l, op, r);                                                                    \
 			DISCARD();                                                                             \
-		} else if (!call_binary_overload(#op, proto_method)) {                                     \
+		} else if (!PROTECT(call_binary_overload(#op, proto_method))) {                            \
 			return ExitCode::RuntimeError;                                                         \
 		}                                                                                          \
 	} while (false);
 
-#define BINOP(op, proto_method_name)                                                               \
+#define BINOP(op, proto_method_name, quickened)                                                    \
 	do {                                                                                           \
 		Value& r = PEEK(1);                                                                        \
 		Value& l = PEEK(2);                                                                        \
 		/* Do not pop any values yet, we may still need them for GC */                             \
 		if (VYSE_IS_NUM(l) and VYSE_IS_NUM(r)) {                                                   \
-			VYSE_SET_NUM(l, VYSE_AS_NUM(l) op VYSE_AS_NUM(r));                                     \
+			TRY_QUICKEN(0, quickened, feedback_bits(l) | feedback_bits(r));                        \
+			ARITH_NUMS(l, op, r);                                                                  \
 			DISCARD();                                                                             \
-		} else if (!call_binary_overload(#op, proto_method_name)) {                                \
+		} else if (!PROTECT(call_binary_overload(#op, proto_method_name))) {                       \
 			return ExitCode::RuntimeError;                                                         \
 		}                                                                                          \
 	} while (false);
 
+// A quickened comparison or arithmetic instruction, which turns back into [generic] as soon as
+// it's operands are not both numbers. These are blocks instead of do-whiles, see DEQUICKEN.
+#define QUICK_CMP_OP(op, generic)                                                                  \
+	{                                                                                              \
+		Value& r = PEEK(1);                                                                        \
+		Value& l = PEEK(2);                                                                        \
+		if (!VYSE_IS_NUM(l) or !VYSE_IS_NUM(r)) {                                                  \
+			DEQUICKEN(generic, feedback_bits(l) | feedback_bits(r));                               \
+		}                                                                                          \
+		CMP_NUMS(l, op, r);                                                                        \
+		DISCARD();                                                                                 \
+	}
+
+#define QUICK_BINOP(op, generic)                                                                   \
+	{                                                                                              \
+		Value& r = PEEK(1);                                                                        \
+		Value& l = PEEK(2);                                                                        \
+		if (!VYSE_IS_NUM(l) or !VYSE_IS_NUM(r)) {                                                  \
+			DEQUICKEN(generic, feedback_bits(l) | feedback_bits(r));                               \
+		}                                                                                          \
+		ARITH_NUMS(l, op, r);                                                                      \
+		DISCARD();                                                                                 \
+	}
+
+// Runs a fused compare-and-branch instruction, which is always followed by a `pop_jmp_if_false`.
+// If [cond] holds, the jump is skipped, otherwise it is taken. Either way the `pop_jmp_if_false`
+// itself is never run.
+#define BRANCH_UNLESS(cond)                                                                        \
+	(pc += (cond) ? 3 : 3 + u16((static_cast<u8>(pc[1]) << 8) | static_cast<u8>(pc[2])))
+
+// A fused comparison of a local with [rhs]. Operands that aren't both numbers are handed to the
+// overload of [op], whose result is left on the stack for the `pop_jmp_if_false` that follows.
+#define CMP_JMP(op, proto_method, rhs)                                                             \
+	{                                                                                              \
+		const Value l = GET_VAR(NEXT_BYTE());                                                      \
+		const Value r = rhs;                                                                       \
+		if (VYSE_IS_NUM(l) and VYSE_IS_NUM(r)) {                                                   \
+			BRANCH_UNLESS(NUM_CMP(l, op, r));                                                      \
+		} else {                                                                                   \
+			PUSH(l);                                                                               \
+			PUSH(r);                                                                               \
+			if (!PROTECT(call_binary_overload(#op, proto_method))) {                               \
+				return ExitCode::RuntimeError;                                                     \
+			}                                                                                      \
+		}                                                                                          \
+	}
+
+// Values are compared for equality by identity, so these never need the generic path.
+#define EQ_JMP(op, rhs)                                                                            \
+	{                                                                                              \
+		const Value l = GET_VAR(NEXT_BYTE());                                                      \
+		const Value r = rhs;                                                                       \
+		BRANCH_UNLESS(l op r);                                                                     \
+	}
+
 #define BIT_BINOP(op, proto_method_name)                                                           \
 	Value& b = PEEK(1);                                                                            \
 	Value& a = PEEK(2);                                                                            \
                                                                                                    \
-	if (VYSE_IS_NUM(a) and VYSE_IS_NUM(b)) {                                                       \
-		VYSE_SET_NUM(a, VYSE_CAST_INT(a) op VYSE_CAST_INT(b));                                     \
+	if (VYSE_IS_INT(a) and VYSE_IS_INT(b)) {                                                       \
+		a = int_or_num(s64(VYSE_AS_INT(a)) op s64(VYSE_AS_INT(b)));                                \
 		DISCARD();                                                                                 \
-	} else if (!call_binary_overload(#op, proto_method_name)) {                                    \
+	} else if (VYSE_IS_NUM(a) and VYSE_IS_NUM(b)) {                                                \
+		a = int_or_num(VYSE_CAST_INT(a) op VYSE_CAST_INT(b));                                      \
+		DISCARD();                                                                                 \
+	} else if (!PROTECT(call_binary_overload(#op, proto_method_name))) {                           \
 		return ExitCode::RuntimeError;                                                             \
 	}
 
@@ -108,180 +252,338 @@ void print_stack(Value* stack, size_t sp) {
 }
 #endif
 
-ExitCode VM::run() {
+// Profile builds record every instruction that is about to run, see `OpProfile`.
+#ifdef VYSE_PROFILE_OPCODES
+#define VM_PROFILE() m_op_profile.record(*m_current_block, pc - m_current_block->code.data())
+#else
+#define VM_PROFILE() ((void)0)
+#endif
 
-	while (true) {
-		const Op op = FETCH();
+// When VYSE_COMPUTED_GOTO is defined, every opcode handler in `VM::run` ends by jumping straight
+// to the handler of the next instruction through a table of label addresses (threaded dispatch),
+// instead of going back to the top of the loop and through the switch's bounds check. This gives
+// every handler its own indirect branch, which the CPU's branch predictor can learn independently.
+// `VM_CASE` marks the start of a handler and `VM_DISPATCH` transfers control to the next one.
+#ifdef VYSE_COMPUTED_GOTO
 #ifdef VYSE_DEBUG_RUNTIME
-		disassemble_instr(*m_current_block, op, ip - 1);
+#define VM_TRACE()                                                                                 \
+	(print_stack(m_stack.values, m_stack.top - m_stack.values), printf("\n"),                      \
+	 disassemble_instr(*m_current_block, *pc, pc - m_current_block->code.data()))
+#else
+#define VM_TRACE() ((void)0)
 #endif
 
-		switch (op) {
-		case Op::load_const: PUSH(READ_VALUE()); break;
-		case Op::load_nil: PUSH(VYSE_NIL); break;
+#define VM_CASE(name) op_##name
+#define VM_DISPATCH()                                                                              \
+	do {                                                                                           \
+		VM_TRACE();                                                                                \
+		VM_PROFILE();                                                                              \
+		goto* dispatch_table[static_cast<u8>(FETCH())];                                            \
+	} while (false)
+#else
+#define VM_CASE(name) case Op::name
+#define VM_DISPATCH() break
+#endif
+
+// Ends a superinstruction by running it's last instruction [op]. With threaded dispatch this jumps
+// straight to the handler of [op], unless the instruction has since been quickened into something
+// else, in which case it is dispatched like any other.
+#ifdef VYSE_COMPUTED_GOTO
+#define SUPER_NEXT(op)                                                                             \
+	{                                                                                              \
+		if (*pc == Op::op) {                                                                       \
+			++pc;                                                                                  \
+			goto VM_CASE(op);                                                                      \
+		}                                                                                          \
+		VM_DISPATCH();                                                                             \
+	}
+#else
+#define SUPER_NEXT(op) VM_DISPATCH()
+#endif
+
+// The bodies of the straight line instructions (see `is_straight_line`), which superinstructions
+// run one after the other. Each one reads it's own operands, but not it's opcode.
+#define DO_load_const() PUSH(READ_VALUE())
+#define DO_load_nil() PUSH(VYSE_NIL)
+#define DO_pop() DISCARD()
+#define DO_get_var() PUSH(GET_VAR(NEXT_BYTE()))
+#define DO_set_var()                                                                               \
+	{                                                                                              \
+		const u8 idx = NEXT_BYTE();                                                                \
+		SET_VAR(idx, POP());                                                                       \
+	}
+#define DO_get_upval()                                                                             \
+	{                                                                                              \
+		const u8 idx = NEXT_BYTE();                                                                \
+		VYSE_ASSERT(m_current_frame->func->tag == OT::closure, "enclosing frame a CClosure!");     \
+		Closure* const cl = static_cast<Closure*>(m_current_frame->func);                          \
+		PUSH(*cl->get_upval(idx)->m_value);                                                        \
+	}
+#define DO_set_upval()                                                                             \
+	{                                                                                              \
+		const u8 idx = NEXT_BYTE();                                                                \
+		VYSE_ASSERT(m_current_frame->func->tag == OT::closure, "enclosing frame a CClosure!");     \
+		Closure* const cl = static_cast<Closure*>(m_current_frame->func);                          \
+		*cl->get_upval(idx)->m_value = POP();                                                      \
+	}
+#define DO_get_capture()                                                                           \
+	{                                                                                              \
+		const u8 idx = NEXT_BYTE();                                                                \
+		VYSE_ASSERT(m_current_frame->func->tag == OT::closure, "enclosing frame a CClosure!");     \
+		PUSH(static_cast<Closure*>(m_current_frame->func)->capture(idx));                          \
+	}
+#define DO_get_global()                                                                            \
+	{                                                                                              \
+		const GlobalRef& global = READ_GLOBAL();                                                   \
+		const Value value = m_globals[global.slot];                                                \
+		if (VYSE_IS_UNDEFINED(value)) {                                                            \
+			return RUN_ERROR("Undefined variable '{}'.", global.name->c_str());                    \
+		}                                                                                          \
+		PUSH(value);                                                                               \
+	}
+#define DO_set_global() (m_globals[READ_GLOBAL().slot] = POP())
+#define DO_new_table() PUSH(VYSE_OBJECT(&make<Table>(&m_root_shape)))
+#define DO_new_list() PUSH(VYSE_OBJECT(&make<List>()))
+#define DO_close_upval() (close_upvalues_upto(m_stack.top - 1), DISCARD())
+
+/// @return The `TypeFeedback` bit for the kind of [value].
+static u8 feedback_bits(const Value& value) {
+	if (VYSE_IS_INT(value)) return TypeFeedback::Int;
+	if (VYSE_IS_NUM(value)) return TypeFeedback::Double;
+	if (!VYSE_IS_OBJECT(value)) return TypeFeedback::Other;
+	switch (VYSE_AS_OBJECT(value)->tag) {
+	case OT::string: return TypeFeedback::String;
+	case OT::table: return TypeFeedback::Table;
+	case OT::list: return TypeFeedback::List;
+	default: return TypeFeedback::Other;
+	}
+}
 
-		case Op::pop: m_stack.pop(); break;
-		case Op::add: BINOP(+, "__add"); break;
-		case Op::sub: BINOP(-, "__sub"); break;
-		case Op::mult: BINOP(*, "__mult"); break;
+#if defined(VYSE_COMPUTED_GOTO) && defined(__GNUC__)
+// Labels as values are a GNU extension, which -Wpedantic would otherwise complain about.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#endif
 
-		case Op::gt: CMP_OP(>, "__gt"); break;
-		case Op::lt: CMP_OP(<, "__lt"); break;
-		case Op::gte: CMP_OP(>=, "__gte"); break;
-		case Op::lte: CMP_OP(<=, "__lte"); break;
+ExitCode VM::run() {
+	const Opcode* pc;
+	const Value* constants;
+	Value* frame_base;
+	bool protect_ok;
+	if (m_current_block->has_register_code()) return run_registers();
+	// Returning from the frame below this one means returning to whoever called this function.
+	const u32 entry_frames = m_frame_count;
+	// A function that was just called may run in native code instead.
+	if (m_native and ip == 0) {
+		const JitExit exit = run_native();
+		if (exit == JitExit::Error) return ExitCode::RuntimeError;
+		if (exit == JitExit::Return) return ExitCode::Success;
+	}
+	LOAD_STATE();
+
+#ifdef VYSE_COMPUTED_GOTO
+	// The address of every opcode's handler, indexed by the opcode.
+	static void* const dispatch_table[] = {
+#define OP(name, _, __) &&VM_CASE(name)
+#include <x_opcode.hpp>
+#undef OP
+	};
+
+	VM_DISPATCH();
+	{
+#else
+	while (true) {
+		VM_PROFILE();
+		const Op op = FETCH();
+#ifdef VYSE_DEBUG_RUNTIME
+		disassemble_instr(*m_current_block, op, pc - m_current_block->code.data() - 1);
+#endif
 
-		case Op::div: {
+		switch (op) {
+#endif
+		VM_CASE(load_const): DO_load_const(); VM_DISPATCH();
+		VM_CASE(load_nil): DO_load_nil(); VM_DISPATCH();
+
+		VM_CASE(pop): DO_pop(); VM_DISPATCH();
+		VM_CASE(add): BINOP(+, "__add", add_num_num); VM_DISPATCH();
+		VM_CASE(sub): BINOP(-, "__sub", sub_num_num); VM_DISPATCH();
+		VM_CASE(mult): BINOP(*, "__mult", mult_num_num); VM_DISPATCH();
+
+		VM_CASE(gt): CMP_OP(>, "__gt", gt_num_num); VM_DISPATCH();
+		VM_CASE(lt): CMP_OP(<, "__lt", lt_num_num); VM_DISPATCH();
+		VM_CASE(gte): CMP_OP(>=, "__gte", gte_num_num); VM_DISPATCH();
+		VM_CASE(lte): CMP_OP(<=, "__lte", lte_num_num); VM_DISPATCH();
+
+		VM_CASE(add_num_num): QUICK_BINOP(+, add); VM_DISPATCH();
+		VM_CASE(sub_num_num): QUICK_BINOP(-, sub); VM_DISPATCH();
+		VM_CASE(mult_num_num): QUICK_BINOP(*, mult); VM_DISPATCH();
+		VM_CASE(gt_num_num): QUICK_CMP_OP(>, gt); VM_DISPATCH();
+		VM_CASE(lt_num_num): QUICK_CMP_OP(<, lt); VM_DISPATCH();
+		VM_CASE(gte_num_num): QUICK_CMP_OP(>=, gte); VM_DISPATCH();
+		VM_CASE(lte_num_num): QUICK_CMP_OP(<=, lte); VM_DISPATCH();
+
+		VM_CASE(div): {
 			Value& l = PEEK(2);
 			const Value& r = PEEK(1);
 
 			if (VYSE_IS_NUM(r) and VYSE_IS_NUM(l)) {
 				if (VYSE_AS_NUM(l) == 0) {
-					return runtime_error("Attempt to divide by 0.\n");
+					return RUN_ERROR("Attempt to divide by 0.\n");
 				}
 				VYSE_SET_NUM(l, VYSE_AS_NUM(l) / VYSE_AS_NUM(r));
 				DISCARD();
-			} else if (!call_binary_overload("/", "__div")) {
+			} else if (!PROTECT(call_binary_overload("/", "__div"))) {
 				return binop_error("/", l, r);
 			}
-			break;
+			VM_DISPATCH();
 		}
 
-		case Op::exp: {
+		VM_CASE(exp): {
 			Value& base = PEEK(2);
 			const Value& power = PEEK(1);
 			if (VYSE_IS_NUM(base) and VYSE_IS_NUM(power)) {
 				VYSE_SET_NUM(base, pow(VYSE_AS_NUM(base), VYSE_AS_NUM(power)));
 				DISCARD();
-			} else if (!call_binary_overload("/", "__exp")) {
+			} else if (!PROTECT(call_binary_overload("/", "__exp"))) {
 				return binop_error("**", base, power);
 			}
-			break;
+			VM_DISPATCH();
 		}
 
-		case Op::mod: {
+		VM_CASE(mod): {
 			Value& l = PEEK(2);
 			const Value& r = PEEK(1);
 
-			if (VYSE_IS_NUM(l) and VYSE_IS_NUM(r)) {
+			// The result of '%' on two integers always fits in an integer, and has the same sign
+			// as the one produced by `fmod`.
+			if (VYSE_IS_INT(l) and VYSE_IS_INT(r) and VYSE_AS_INT(r) != 0) {
+				l = VYSE_INT(s64(VYSE_AS_INT(l)) % s64(VYSE_AS_INT(r)));
+				DISCARD();
+			} else if (VYSE_IS_NUM(l) and VYSE_IS_NUM(r)) {
 				VYSE_SET_NUM(l, fmod(VYSE_AS_NUM(l), VYSE_AS_NUM(r)));
 				DISCARD();
-			} else if (!call_binary_overload("%", "__mod")) {
+			} else if (!PROTECT(call_binary_overload("%", "__mod"))) {
 				return binop_error("%", l, r);
 			}
-			break;
+			VM_DISPATCH();
 		}
 
-		case Op::lshift: {
+		VM_CASE(lshift): {
 			BIT_BINOP(<<, "__bsl");
-			break;
+			VM_DISPATCH();
 		}
 
-		case Op::rshift: {
+		VM_CASE(rshift): {
 			BIT_BINOP(>>, "__bsr");
-			break;
+			VM_DISPATCH();
 		}
 
-		case Op::band: {
+		VM_CASE(band): {
 			BIT_BINOP(&, "__band");
-			break;
+			VM_DISPATCH();
 		}
 
-		case Op::bxor: {
+		VM_CASE(bxor): {
 			BIT_BINOP(^, "__bxor");
-			break;
+			VM_DISPATCH();
 		}
 
-		case Op::bor: {
+		VM_CASE(bor): {
 			BIT_BINOP(|, "__bor");
-			break;
+			VM_DISPATCH();
 		}
 
 		/// TODO: overload with __eq
-		case Op::eq: {
+		VM_CASE(eq): {
 			const Value a = m_stack.pop();
 			const Value b = m_stack.pop();
 			PUSH(VYSE_BOOL(a == b));
-			break;
+			VM_DISPATCH();
 		}
 
-		case Op::neq: {
+		VM_CASE(neq): {
 			const Value a = POP();
 			const Value b = POP();
 			PUSH(VYSE_BOOL(a != b));
-			break;
+			VM_DISPATCH();
 		}
 
-		case Op::negate: {
+		VM_CASE(negate): {
 			Value& operand = PEEK(1);
-			if (VYSE_IS_NUM(operand)) {
+			if (VYSE_IS_INT(operand)) {
+				operand = int_or_num(-s64(VYSE_AS_INT(operand)));
+			} else if (VYSE_IS_NUM(operand)) {
 				VYSE_SET_NUM(operand, -VYSE_AS_NUM(operand));
-			} else if (!call_unary_overload("__negate")) {
+			} else if (!PROTECT(call_unary_overload("__negate"))) {
 				return UNOP_ERROR("-", operand);
 			}
-			break;
+			VM_DISPATCH();
 		}
 
-		case Op::lnot: {
+		VM_CASE(lnot): {
 			const Value a = POP();
 			PUSH(VYSE_BOOL(IS_VAL_FALSY(a)));
-			break;
+			VM_DISPATCH();
 		}
 
-		case Op::len: {
+		VM_CASE(len): {
 			const Value v = POP();
 			if (VYSE_IS_LIST(v)) {
-				PUSH(VYSE_NUM(VYSE_AS_LIST(v)->length()));
+				PUSH(int_or_num(VYSE_AS_LIST(v)->length()));
 			} else if (VYSE_IS_TABLE(v)) {
-				PUSH(VYSE_NUM(VYSE_AS_TABLE(v)->length()));
+				PUSH(int_or_num(VYSE_AS_TABLE(v)->length()));
 			} else if (VYSE_IS_STRING(v)) {
-				PUSH(VYSE_NUM(VYSE_AS_STRING(v)->m_length));
+				PUSH(int_or_num(VYSE_AS_STRING(v)->m_length));
 			} else {
-				return ERROR("Attempt to get length of a {} value", value_type_name(v));
+				return RUN_ERROR("Attempt to get length of a {} value", value_type_name(v));
 			}
-			break;
+			VM_DISPATCH();
 		}
 
-		case Op::bnot: {
-			if (VYSE_IS_NUM(PEEK(1))) {
-				VYSE_SET_NUM(PEEK(1), ~s64(VYSE_AS_NUM(PEEK(1))));
+		VM_CASE(bnot): {
+			if (VYSE_IS_INT(PEEK(1))) {
+				PEEK(1) = VYSE_INT(~VYSE_AS_INT(PEEK(1)));
+			} else if (VYSE_IS_NUM(PEEK(1))) {
+				PEEK(1) = int_or_num(~VYSE_CAST_INT(PEEK(1)));
 			} else {
-				return ERROR("Cannot use operator '~' on value of type '{}'",
-							 value_type_name(PEEK(1)));
+				return RUN_ERROR("Cannot use operator '~' on value of type '{}'",
+								 value_type_name(PEEK(1)));
 			}
-			break;
+			VM_DISPATCH();
 		}
 
-		case Op::jmp_if_true_or_pop: {
+		VM_CASE(jmp_if_true_or_pop): {
 			Value& top = PEEK(1);
 			if (IS_VAL_TRUTHY(top)) {
-				ip += FETCH_SHORT();
+				pc += FETCH_SHORT();
 			} else {
-				ip += 2;
+				pc += 2;
 				POP();
 			}
-			break;
+			VM_DISPATCH();
 		}
 
-		case Op::jmp_if_false_or_pop: {
+		VM_CASE(jmp_if_false_or_pop): {
 			Value& top = PEEK(1);
 			if (IS_VAL_FALSY(top)) {
-				ip += FETCH_SHORT();
+				pc += FETCH_SHORT();
 			} else {
-				ip += 2;
+				pc += 2;
 				POP();
 			}
-			break;
+			VM_DISPATCH();
 		}
 
-		case Op::jmp: {
-			ip += FETCH_SHORT();
-			break;
+		VM_CASE(jmp): {
+			pc += FETCH_SHORT();
+			VM_DISPATCH();
 		}
 
-		case Op::jmp_back: {
+		VM_CASE(jmp_back): {
 			const u16 dist = FETCH_SHORT();
-			ip -= dist;
-			break;
+			pc -= dist;
+			JIT_BACK_EDGE();
+			VM_DISPATCH();
 		}
 
 		// In a for loop, the variables are to be set up in the stack as such:
@@ -292,27 +594,49 @@ ExitCode VM::run() {
 		// 1. counter = counter - 1;
 		// 2. i = counter;
 		// 3. jump to to corresponding for_loop opcode;
-		case Op::for_prep: {
+		VM_CASE(for_prep): {
 			Value& counter = PEEK(3);
 			CHECK_TYPE(counter, VT::Number, "'for' variable not a number.");
 			CHECK_TYPE(PEEK(2), VT::Number, "'for' limit not a number.");
 			const Value& step = PEEK(1);
 			CHECK_TYPE(step, VT::Number, "'for' step not a number.");
-			VYSE_SET_NUM(counter, VYSE_AS_NUM(counter) - VYSE_AS_NUM(step));
+			if (VYSE_IS_INT(counter) and VYSE_IS_INT(step)) {
+				counter = int_or_num(s64(VYSE_AS_INT(counter)) - VYSE_AS_INT(step));
+			} else {
+				VYSE_SET_NUM(counter, VYSE_AS_NUM(counter) - VYSE_AS_NUM(step));
+			}
 			PUSH(counter); // load the user exposed loop counter (i).
 			// jump to the corresponding for_loop instruction.
-			ip += FETCH_SHORT();
-			break;
+			pc += FETCH_SHORT();
+			VM_DISPATCH();
 		}
 
 		// counter += step
 		// i = counter
 		// if (counter < limit) jump to start;
-		case Op::for_loop: {
+		VM_CASE(for_loop): {
 			Value& counter = PEEK(4);
 			const Value& limit = PEEK(3);
 			const Value& step = PEEK(2);
 
+			// When the counter, limit and step are all integers, the loop runs on integers until
+			// the counter overflows into a double.
+			if (VYSE_IS_INT(counter) and VYSE_IS_INT(limit) and VYSE_IS_INT(step)) {
+				const s32 istep = VYSE_AS_INT(step);
+				const s64 next = s64(VYSE_AS_INT(counter)) + istep;
+				counter = int_or_num(next);
+				PEEK(1) = counter;
+
+				const s32 ilimit = VYSE_AS_INT(limit);
+				if (istep >= 0 ? next < ilimit : next >= ilimit) {
+					pc -= FETCH_SHORT();
+					JIT_BACK_EDGE();
+				} else {
+					pc += 2;
+				}
+				VM_DISPATCH();
+			}
+
 			const number nstep = VYSE_AS_NUM(step);
 			// update loop counter.
 			VYSE_SET_NUM(counter, VYSE_AS_NUM(counter) + nstep);
@@ -321,75 +645,67 @@ ExitCode VM::run() {
 
 			if (nstep >= 0) {
 				if (VYSE_AS_NUM(counter) < VYSE_AS_NUM(limit)) {
-					ip -= FETCH_SHORT();
-					break;
-				} // else fall to 'ip += 2'
+					pc -= FETCH_SHORT();
+					JIT_BACK_EDGE();
+					VM_DISPATCH();
+				} // else fall to 'pc += 2'
 			} else if (VYSE_AS_NUM(counter) >= VYSE_AS_NUM(limit)) {
-				ip -= FETCH_SHORT();
-				break;
+				pc -= FETCH_SHORT();
+				JIT_BACK_EDGE();
+				VM_DISPATCH();
 			}
 
-			ip += 2;
-			break;
-		}
-
-		case Op::get_var: {
-			u8 idx = NEXT_BYTE();
-			PUSH(GET_VAR(idx));
-			break;
-		}
-
-		case Op::set_var: {
-			u8 idx = NEXT_BYTE();
-			SET_VAR(idx, POP());
-			break;
-		}
-
-		case Op::set_upval: {
-			const u8 idx = NEXT_BYTE();
-			VYSE_ASSERT(m_current_frame->func->tag == OT::closure, "enclosing frame a CClosure!");
-			Closure* const cl = static_cast<Closure*>(m_current_frame->func);
-			*cl->get_upval(idx)->m_value = POP();
-			break;
-		}
-
-		case Op::get_upval: {
-			const u8 idx = NEXT_BYTE();
-			VYSE_ASSERT(m_current_frame->func->tag == OT::closure, "enclosing frame a CClosure!");
-			Closure* const cl = static_cast<Closure*>(m_current_frame->func);
-			PUSH(*cl->get_upval(idx)->m_value);
-			break;
-		}
-
-		case Op::set_global: {
-			const Value name = READ_VALUE();
-			VYSE_ASSERT(VYSE_IS_STRING(name), "global name not a string.");
-			set_global(VYSE_AS_STRING(name), POP());
-			break;
+			pc += 2;
+			VM_DISPATCH();
 		}
 
-		case Op::get_global: {
-			const Value name = READ_VALUE();
-			VYSE_ASSERT(VYSE_IS_STRING(name), "global name not a string.");
-			const Value value = get_global(VYSE_AS_STRING(name));
-			if (VYSE_IS_UNDEFINED(value)) {
-				return ERROR("Undefined variable '{}'.", VYSE_AS_STRING(name)->c_str());
+		VM_CASE(get_var): DO_get_var(); VM_DISPATCH();
+		VM_CASE(set_var): DO_set_var(); VM_DISPATCH();
+
+		VM_CASE(eq_var_var_jmp): EQ_JMP(==, GET_VAR(NEXT_BYTE())); VM_DISPATCH();
+		VM_CASE(neq_var_var_jmp): EQ_JMP(!=, GET_VAR(NEXT_BYTE())); VM_DISPATCH();
+		VM_CASE(gt_var_var_jmp): CMP_JMP(>, "__gt", GET_VAR(NEXT_BYTE())); VM_DISPATCH();
+		VM_CASE(lt_var_var_jmp): CMP_JMP(<, "__lt", GET_VAR(NEXT_BYTE())); VM_DISPATCH();
+		VM_CASE(gte_var_var_jmp): CMP_JMP(>=, "__gte", GET_VAR(NEXT_BYTE())); VM_DISPATCH();
+		VM_CASE(lte_var_var_jmp): CMP_JMP(<=, "__lte", GET_VAR(NEXT_BYTE())); VM_DISPATCH();
+		VM_CASE(eq_var_const_jmp): EQ_JMP(==, READ_VALUE()); VM_DISPATCH();
+		VM_CASE(neq_var_const_jmp): EQ_JMP(!=, READ_VALUE()); VM_DISPATCH();
+		VM_CASE(gt_var_const_jmp): CMP_JMP(>, "__gt", READ_VALUE()); VM_DISPATCH();
+		VM_CASE(lt_var_const_jmp): CMP_JMP(<, "__lt", READ_VALUE()); VM_DISPATCH();
+		VM_CASE(gte_var_const_jmp): CMP_JMP(>=, "__gte", READ_VALUE()); VM_DISPATCH();
+		VM_CASE(lte_var_const_jmp): CMP_JMP(<=, "__lte", READ_VALUE()); VM_DISPATCH();
+
+		// Always followed by a `set_var` to the same slot, which is skipped when the addition can
+		// be done in place.
+		VM_CASE(add_var_const): {
+			Value& var = GET_VAR(NEXT_BYTE());
+			const Value k = READ_VALUE();
+			if (VYSE_IS_NUM(var) and VYSE_IS_NUM(k)) {
+				ARITH_NUMS(var, +, k);
+				pc += 2;
+			} else {
+				PUSH(var);
+				PUSH(k);
+				if (!PROTECT(call_binary_overload("+", "__add"))) {
+					return ExitCode::RuntimeError;
+				}
 			}
-			PUSH(value);
-			break;
+			VM_DISPATCH();
 		}
 
-		case Op::close_upval: {
-			close_upvalues_upto(m_stack.top - 1);
-			DISCARD();
-			break;
-		}
+		VM_CASE(set_upval): DO_set_upval(); VM_DISPATCH();
+		VM_CASE(get_upval): DO_get_upval(); VM_DISPATCH();
+		VM_CASE(get_capture): DO_get_capture(); VM_DISPATCH();
+		VM_CASE(set_global): DO_set_global(); VM_DISPATCH();
+		VM_CASE(get_global): DO_get_global(); VM_DISPATCH();
+		VM_CASE(close_upval): DO_close_upval(); VM_DISPATCH();
 
-		case Op::concat: {
+		VM_CASE(concat): {
 			Value& a = PEEK(2);
 			Value const b = POP();
 
 			if (!(VYSE_IS_STRING(a) and VYSE_IS_STRING(b))) {
+				SAVE_IP();
 				return binop_error("..", a, b);
 			} else {
 				String* const l = VYSE_AS_STRING(a);
@@ -400,61 +716,67 @@ ExitCode VM::run() {
 				GCLock _ = gc_lock(r);
 				a = concatenate(l, r);
 			}
-			break;
+			VM_DISPATCH();
 		}
 
-		case Op::new_list: {
-			PUSH(VYSE_OBJECT(&make<List>()));
-			break;
-		}
+		VM_CASE(new_list): DO_new_list(); VM_DISPATCH();
 
-		case Op::list_append: {
+		VM_CASE(list_append): {
 			Value& vlist = PEEK(2);
 			if (VYSE_IS_LIST(vlist)) {
 				VYSE_AS_LIST(vlist)->append(POP());
 			} else {
-				return ERROR("Attempt to append to a {} value. (Can only append to lists)",
-							 value_type_name(vlist));
+				return RUN_ERROR("Attempt to append to a {} value. (Can only append to lists)",
+								 value_type_name(vlist));
 			}
-			break;
+			VM_DISPATCH();
 		}
 
-		case Op::new_table: {
-			PUSH(VYSE_OBJECT(&make<Table>()));
-			break;
-		}
+		VM_CASE(new_table): DO_new_table(); VM_DISPATCH();
 
-		case Op::table_add_field: {
+		VM_CASE(table_add_field): {
 			const Value value = POP();
 			const Value key = POP();
 
+			// The compiler only emits this after a `new_table`, but code loaded from a file may
+			// have changed the value since.
 			const Value vtable = PEEK(1);
+			if (!VYSE_IS_TABLE(vtable)) return INDEX_ERROR(vtable);
 			VYSE_AS_TABLE(vtable)->set(key, value);
-			break;
+			VM_DISPATCH();
 		}
 
 		// table_or_list[key] = value
-		case Op::subscript_set: {
+		VM_CASE(subscript_set): {
 			const Value rhs = POP();
 			const Value key = POP();
 			const Value& lhs = PEEK(1);
 
+			SAVE_IP();
 			bool ok = subscript_set(lhs, key, rhs);
 			// assignment returns it's RHS.
 			m_stack.top[-1] = ok ? rhs : VYSE_NIL;
-			break;
+			VM_DISPATCH();
 		}
 
 		/// table.key = value
-		case Op::table_set: {
+		VM_CASE(table_set): {
 			const Value& key = READ_VALUE();
-			if (VYSE_IS_NIL(key)) return ERROR("Table key cannot be nil.");
+			InlineCache& cache = READ_CACHE();
+			if (VYSE_IS_NIL(key)) return RUN_ERROR("Table key cannot be nil.");
 			const Value value = POP();
 			Value& object = PEEK(1);
 			if (VYSE_IS_TABLE(object)) {
-				VYSE_AS_TABLE(object)->set(key, value);
+				Table& table = *VYSE_AS_TABLE(object);
+				if (table.set_cached(key, value, cache)) {
+					++cache.hits;
+				} else {
+					++cache.misses;
+					table.set_and_cache(key, value, cache);
+				}
 			} else if (VYSE_IS_UDATA(object)) {
 				const UserData& udata = *VYSE_AS_UDATA(object);
+				SAVE_IP();
 				if (!set_field_of_udata(udata, key, value)) {
 					return ExitCode::RuntimeError;
 				}
@@ -463,38 +785,74 @@ ExitCode VM::run() {
 			}
 
 			m_stack.top[-1] = value; // assignment returns it's RHS
-			break;
+			VM_DISPATCH();
 		}
 
 		// table.key
-		case Op::table_get: {
+		VM_CASE(table_get): {
 			// TOS = as_table(TOS)->get(READ_VAL())
 			const Value lhs = PEEK(1);
 			const Value& rhs = READ_VALUE();
+			InlineCache& cache = READ_CACHE();
 			Value& dst = m_stack.top[-1];
 			if (VYSE_IS_TABLE(lhs)) {
-				dst = VYSE_AS_TABLE(lhs)->get(rhs);
+				TRY_QUICKEN(2, table_get_str_key, TypeFeedback::Table);
+				const Table& table = *VYSE_AS_TABLE(lhs);
+				if (table.get_cached(rhs, cache, dst)) {
+					++cache.hits;
+				} else {
+					++cache.misses;
+					dst = table.get_and_cache(rhs, cache);
+				}
 			} else if (VYSE_IS_UDATA(lhs)) {
 				const UserData& udata = *VYSE_AS_UDATA(lhs);
+				SAVE_IP();
 				if (!get_field_of_udata(udata, rhs, dst)) {
 					return ExitCode::RuntimeError;
 				}
 			} else {
 				return INDEX_ERROR(lhs);
 			}
-			break;
+			VM_DISPATCH();
+		}
+
+		// table.key, where table is known to be a table.
+		VM_CASE(table_get_str_key): {
+			Value& dst = m_stack.top[-1];
+			if (!VYSE_IS_TABLE(dst)) DEQUICKEN(table_get, feedback_bits(dst));
+
+			const Value& key = READ_VALUE();
+			InlineCache& cache = READ_CACHE();
+			const Table& table = *VYSE_AS_TABLE(dst);
+			if (table.get_cached(key, cache, dst)) {
+				++cache.hits;
+			} else {
+				++cache.misses;
+				dst = table.get_and_cache(key, cache);
+			}
+			VM_DISPATCH();
 		}
 
 		// table.key
-		case Op::table_get_no_pop: {
+		VM_CASE(table_get_no_pop): {
 			// push((TOS)->get(READ_VAL()))
 			const Value& lhs = PEEK(1);
 			const Value& rhs = READ_VALUE();
+			InlineCache& cache = READ_CACHE();
 			if (VYSE_IS_TABLE(lhs)) {
-				PUSH(VYSE_AS_TABLE(lhs)->get(rhs));
+				const Table& table = *VYSE_AS_TABLE(lhs);
+				Value result;
+				if (table.get_cached(rhs, cache, result)) {
+					++cache.hits;
+				} else {
+					++cache.misses;
+					result = table.get_and_cache(rhs, cache);
+				}
+				PUSH(result);
 			} else if (VYSE_IS_UDATA(lhs)) {
 				const UserData& udata = *VYSE_AS_UDATA(lhs);
 				Value result;
+				SAVE_IP();
 				if (!get_field_of_udata(udata, rhs, result)) {
 					return ExitCode::RuntimeError;
 				}
@@ -502,69 +860,171 @@ ExitCode VM::run() {
 			} else {
 				return INDEX_ERROR(lhs);
 			}
-			break;
+			VM_DISPATCH();
 		}
 
 		// table_or_string_or_array[key]
-		case Op::subscript_get: {
+		VM_CASE(subscript_get): {
 			const Value key = POP();
 			Value& tvalue = PEEK(1);
+
+			if (VYSE_IS_LIST(tvalue) and VYSE_IS_NUM(key)) {
+				TRY_QUICKEN(0, subscript_get_list_num, TypeFeedback::List | feedback_bits(key));
+			}
+
+			SAVE_IP();
 			if (!get_subscript_of_value(tvalue, key, tvalue)) {
 				return ExitCode::RuntimeError;
 			}
-			break;
+			VM_DISPATCH();
+		}
+
+		// list[number]
+		VM_CASE(subscript_get_list_num): {
+			const Value& key = PEEK(1);
+			Value& tvalue = PEEK(2);
+			if (!VYSE_IS_LIST(tvalue) or !VYSE_IS_NUM(key)) {
+				DEQUICKEN(subscript_get, feedback_bits(tvalue) | feedback_bits(key));
+			}
+
+			const List& list = *VYSE_AS_LIST(tvalue);
+			if (VYSE_IS_INT(key)) {
+				const s32 index = VYSE_AS_INT(key);
+				if (index >= 0 and size_t(index) < list.length()) {
+					tvalue = list[index];
+					DISCARD();
+					VM_DISPATCH();
+				}
+			}
+
+			// Indices that are out of bounds or not integers are reported by the generic path.
+			const Value index = POP();
+			SAVE_IP();
+			if (!get_subscript_of_value(tvalue, index, tvalue)) {
+				return ExitCode::RuntimeError;
+			}
+			VM_DISPATCH();
+		}
+
+		VM_CASE(vararg_len): {
+			SAVE_IP();
+			if (!get_vararg_len(PEEK(1))) return ExitCode::RuntimeError;
+			VM_DISPATCH();
+		}
+
+		VM_CASE(vararg_get): {
+			const Value index = POP();
+			SAVE_IP();
+			if (!get_vararg(index, PEEK(1))) return ExitCode::RuntimeError;
+			VM_DISPATCH();
 		}
 
-		case Op::index_no_pop: {
+		VM_CASE(index_no_pop): {
 			const Value& value = PEEK(2);
 			const Value& key = PEEK(1);
 			Value result;
+			SAVE_IP();
 			if (!get_subscript_of_value(value, key, result)) {
 				return ExitCode::RuntimeError;
 			}
 			PUSH(result);
-			break;
+			VM_DISPATCH();
 		}
 
-		case Op::pop_jmp_if_false: {
-			ip += IS_VAL_FALSY(PEEK(1)) ? FETCH_SHORT() : 2;
+		VM_CASE(pop_jmp_if_false): {
+			pc += IS_VAL_FALSY(PEEK(1)) ? FETCH_SHORT() : 2;
 			DISCARD();
-			break;
+			VM_DISPATCH();
 		}
 
 		// tbl <- POP()
 		// PUSH(tbl[READ_VALUE()])
 		// PUSH(tbl)
 		/// TODO: take care of overloaded `__indx`
-		case Op::prep_method_call: {
-			const Value vtable = PEEK(1);
-			const Value vkey = READ_VALUE();
-			VYSE_ASSERT(VYSE_IS_STRING(vkey), "method name not a string.");
+		VM_CASE(prep_method_call): {
+			const Value object = PEEK(1);
+			const Value& key = READ_VALUE();
+			InlineCache& cache = READ_CACHE();
+			VYSE_ASSERT(VYSE_IS_STRING(key), "method name not a string.");
 
-			if (VYSE_IS_NIL(vtable)) return INDEX_ERROR(vtable);
-			if (VYSE_IS_TABLE(vtable)) {
-				m_stack.top[-1] = VYSE_AS_TABLE(vtable)->get(vkey);
-			} else {
-				m_stack.top[-1] = index_proto(vtable, vkey);
+			if (VYSE_IS_NIL(object)) return INDEX_ERROR(object);
+			m_stack.top[-1] = get_method(object, key, cache);
+			PUSH(object);
+			VM_DISPATCH();
+		}
+
+		VM_CASE(invoke): {
+			const Value& key = READ_VALUE();
+			InlineCache& cache = READ_CACHE();
+			const u8 argc = NEXT_BYTE();
+			Value* const self = m_stack.top - argc;
+			VYSE_ASSERT(VYSE_IS_STRING(key), "method name not a string.");
+
+			if (VYSE_IS_NIL(*self)) return INDEX_ERROR(*self);
+			const Value method = get_method(*self, key, cache);
+
+			// [object, args...] -> [method, object, args...]
+			for (Value* arg = m_stack.top; arg != self; --arg) *arg = arg[-1];
+			*self = method;
+			++m_stack.top;
+
+			if (VYSE_IS_CLOSURE(method) and m_frame_count < MaxCallStack) {
+				if (!PROTECT(call_closure(VYSE_AS_CLOSURE(method), argc))) {
+					return ExitCode::RuntimeError;
+				}
+				VM_DISPATCH();
+			}
+
+			if (VYSE_IS_CCLOSURE(method) and is_frameless(VYSE_AS_CCLOSURE(method))) {
+				SAVE_IP();
+				if (!call_fast_cclosure(VYSE_AS_CCLOSURE(method), argc)) {
+					return ExitCode::RuntimeError;
+				}
+				VM_DISPATCH();
 			}
-			PUSH(vtable);
 
-			break;
+			if (!PROTECT(op_call(method, argc))) return ExitCode::RuntimeError;
+			VM_DISPATCH();
 		}
 
-		case Op::call_func: {
+		VM_CASE(call_func): {
 			const u8 argc = NEXT_BYTE();
 			const Value value = PEEK(argc + 1);
-			if (!op_call(value, argc)) return ExitCode::RuntimeError;
-			break;
+
+			// Native functions that never re-enter the VM leave the interpreter state as it was.
+			if (VYSE_IS_CCLOSURE(value) and is_frameless(VYSE_AS_CCLOSURE(value))) {
+				SAVE_IP();
+				if (!call_fast_cclosure(VYSE_AS_CCLOSURE(value), argc)) {
+					return ExitCode::RuntimeError;
+				}
+				VM_DISPATCH();
+			}
+
+			if (!PROTECT(op_call(value, argc))) return ExitCode::RuntimeError;
+			VM_DISPATCH();
 		}
 
-		case Op::return_val: {
-			const Value result = POP();
-			close_upvalues_upto(m_current_frame->base);
-			m_stack.top = m_current_frame->base + 1;
+		VM_CASE(tail_call): {
+			const u8 argc = NEXT_BYTE();
+			const u32 frame_count = m_frame_count;
+			SAVE_IP();
+			if (!op_tail_call(argc)) return ExitCode::RuntimeError;
+			if (m_frame_count == frame_count and !run_register_callee()) {
+				return ExitCode::RuntimeError;
+			}
 
-			DISCARD();
+			// Unless the callee runs in this function's frame, it has returned to the caller of
+			// this function by now, which might be outside this loop.
+			if (m_frame_count < entry_frames) return ExitCode::Success;
+			LOAD_STATE();
+			VM_DISPATCH();
+		}
+
+		VM_CASE(return_val): {
+			const Value result = POP();
+			close_upvalues_upto(frame_base);
+			// The return value replaces the function, below any extra arguments kept on the stack.
+			m_stack.top = frame_base - m_current_frame->num_varargs;
 			PUSH(result);
 
 			// No more code to run, the script has executed successfully.
@@ -574,60 +1034,703 @@ ExitCode VM::run() {
 				return ExitCode::Success;
 			}
 
-			m_current_frame = m_current_frame->prev;
-			VYSE_ASSERT(m_current_frame != nullptr, "Invalid call stack state.");
+			--m_current_frame;
 
-			// If the call site of this Vyse function was in C++ then we return control to the C++
-			// function.
-			if (m_current_frame->func->tag == OT::c_closure) {
-				return ExitCode::Success;
-			}
+			// If this function was called from C++, or from the register tier, then we return
+			// control to the caller.
+			if (m_frame_count < entry_frames) return ExitCode::Success;
 
 			VYSE_ASSERT(m_current_frame->func->tag == OT::closure,
 						"Invalid callable object at callframe base.");
 			m_current_block = &static_cast<Closure*>(m_current_frame->func)->m_codeblock->block();
 			ip = m_current_frame->ip;
-			break;
+			LOAD_STATE();
+			VM_DISPATCH();
 		}
 
-		case Op::make_func: {
+		VM_CASE(make_func): {
 			const Value vcode = READ_VALUE();
 			VYSE_ASSERT(VYSE_IS_CODEBLOCK(vcode), "make_func arg not a codeblock.");
 			const u32 num_upvals = NEXT_BYTE();
-			Closure* func = &make<Closure>(VYSE_AS_PROTO(vcode), num_upvals);
+			if (num_upvals == 0) {
+				PUSH(VYSE_OBJECT(&shared_closure(VYSE_AS_PROTO(vcode))));
+				VM_DISPATCH();
+			}
 
+			Closure* func = &make_closure(VYSE_AS_PROTO(vcode), num_upvals);
 			PUSH(VYSE_OBJECT(func));
 
 			for (u8 i = 0; i < num_upvals; ++i) {
-				const bool is_local = NEXT_BYTE();
+				const u8 flags = NEXT_BYTE();
 				const u8 index = NEXT_BYTE();
-
-				if (is_local) {
-					func->set_upval(i, capture_upvalue(m_current_frame->base + index));
-				} else {
-					Closure* cl = static_cast<Closure*>(m_current_frame->func);
-					func->set_upval(i, cl->get_upval(index));
-				}
+				capture_variable(*func, i, flags, frame_base + index, index);
 			}
 
-			break;
+			VM_DISPATCH();
 		}
 
-		default: {
+		// Every instruction of a superinstruction but the last one runs inline. The opcodes in
+		// between are skipped, since they are only there for jumps that land on them.
+#define SUPER2(name, a, b) VM_CASE(name): DO_##a(); SUPER_NEXT(b);
+#define SUPER3(name, a, b, c) VM_CASE(name): DO_##a(); ++pc; DO_##b(); SUPER_NEXT(c);
+#include <x_superinstr.hpp>
+#undef SUPER2
+#undef SUPER3
+
+#ifndef VYSE_COMPUTED_GOTO
+		default:
+#endif
+		VM_CASE(no_op): {
 			VYSE_ERROR("Impossible opcode.");
 			return ExitCode::RuntimeError;
 		}
+#ifndef VYSE_COMPUTED_GOTO
 		}
 #ifdef VYSE_DEBUG_RUNTIME
 		// printf("[stack max: %zu]\t", m_stack.size);
 		print_stack(m_stack.values, m_stack.top - m_stack.values);
 		printf("\n");
+#endif
+#endif
+	}
+
+	return ExitCode::Success;
+}
+
+// -- Register tier --
+
+// Inside `VM::run_registers`, `pc` points to the register instruction after INSTR, the one that
+// is running, and `regs` to the first register of the current call frame. Like in `VM::run`, these
+// are only written back to the VM by REG_SAVE_IP() and reloaded with REG_LOAD_STATE() around
+// anything that may push or pop call frames, or move the stack.
+#define INSTR (pc[-1])
+#define R(index) (regs[index])
+#define K(index) (constants[index])
+#define REG_SAVE_IP() (m_current_frame->ip = ip = pc - m_current_block->reg_code.data())
+#define REG_LOAD_STATE()                                                                           \
+	(pc = m_current_block->reg_code.data() + ip,                                                   \
+	 constants = m_current_block->constant_pool.data(), regs = frame_base(*m_current_frame),       \
+	 m_stack.top = regs + m_current_block->reg_frame_size)
+// Like REG_LOAD_STATE(), for when the running block may have changed since the state was saved.
+#define REG_RESTORE_STATE() (restore_frame(), REG_LOAD_STATE())
+// Like REG_RESTORE_STATE(), after a call has returned. The registers above the returned value
+// weren't seen by the garbage collector during the call, so they're cleared before it sees them.
+#define REG_RETURN_STATE()                                                                         \
+	{                                                                                              \
+		Value* const returned_top = m_stack.top;                                                   \
+		REG_RESTORE_STATE();                                                                       \
+		for (Value* slot = returned_top; slot < m_stack.top; ++slot) *slot = VYSE_NIL;             \
+	}
+#define REG_ERROR(...) (REG_SAVE_IP(), ERROR(__VA_ARGS__))
+#define REG_INDEX_ERROR(v) REG_ERROR("Attempt to index a '{}' value.", value_type_name(v))
+#define REG_UNOP_ERROR(op, v)                                                                      \
+	REG_ERROR("Cannot use operator '{}' on type '{}'.", op, value_type_name(v))
+
+// Stores the result of the overload of a binary operator on [l] and [r] in R[a].
+#define REG_BINARY_OVERLOAD(op_str, method, l, r)                                                  \
+	{                                                                                              \
+		Value result;                                                                              \
+		REG_SAVE_IP();                                                                             \
+		const bool ok = run_binary_overload(op_str, method, l, r, result);                         \
+		REG_RESTORE_STATE();                                                                       \
+		if (!ok) return ExitCode::RuntimeError;                                                    \
+		R(INSTR.a) = result;                                                                       \
+	}
+
+// R[a] = R[b] op [rhs]
+#define REG_ARITH(op, method, rhs)                                                                 \
+	{                                                                                              \
+		Value l = R(INSTR.b);                                                                      \
+		const Value r = rhs;                                                                       \
+		if (VYSE_IS_NUM(l) and VYSE_IS_NUM(r)) {                                                   \
+			ARITH_NUMS(l, op, r);                                                                  \
+			R(INSTR.a) = l;                                                                        \
+		} else REG_BINARY_OVERLOAD(#op, method, l, r)                                              \
+	}
+
+#define REG_CMP(op, method, rhs)                                                                   \
+	{                                                                                              \
+		const Value l = R(INSTR.b);                                                                \
+		const Value r = rhs;                                                                       \
+		if (VYSE_IS_NUM(l) and VYSE_IS_NUM(r)) {                                                   \
+			R(INSTR.a) = VYSE_BOOL(NUM_CMP(l, op, r));                                             \
+		} else REG_BINARY_OVERLOAD(#op, method, l, r)                                              \
+	}
+
+#define REG_BIT_BINOP(op, method)                                                                  \
+	{                                                                                              \
+		const Value l = R(INSTR.b);                                                                \
+		const Value r = R(INSTR.c);                                                                \
+		if (VYSE_IS_INT(l) and VYSE_IS_INT(r)) {                                                   \
+			R(INSTR.a) = int_or_num(s64(VYSE_AS_INT(l)) op s64(VYSE_AS_INT(r)));                   \
+		} else if (VYSE_IS_NUM(l) and VYSE_IS_NUM(r)) {                                            \
+			R(INSTR.a) = int_or_num(VYSE_CAST_INT(l) op VYSE_CAST_INT(r));                         \
+		} else REG_BINARY_OVERLOAD(#op, method, l, r)                                              \
+	}
+
+#define REG_JUMP() (pc = m_current_block->reg_code.data() + INSTR.x)
+
+// Jumps unless R[a] op [rhs] holds. Operands that are not both numbers are compared by the
+// overload of [op], and the jump is taken unless it returns a truthy value.
+#define REG_CMP_JMP(op, method, rhs)                                                               \
+	{                                                                                              \
+		const Value l = R(INSTR.a);                                                                \
+		const Value r = rhs;                                                                       \
+		if (VYSE_IS_NUM(l) and VYSE_IS_NUM(r)) {                                                   \
+			if (!NUM_CMP(l, op, r)) REG_JUMP();                                                    \
+		} else {                                                                                   \
+			Value result;                                                                          \
+			REG_SAVE_IP();                                                                         \
+			const bool ok = run_binary_overload(#op, method, l, r, result);                        \
+			REG_RESTORE_STATE();                                                                   \
+			if (!ok) return ExitCode::RuntimeError;                                                \
+			if (IS_VAL_FALSY(result)) REG_JUMP();                                                  \
+		}                                                                                          \
+	}
+
+#define REG_EQ_JMP(op, rhs)                                                                        \
+	if (!(R(INSTR.a) op rhs)) REG_JUMP();
+
+#ifdef VYSE_DEBUG_RUNTIME
+#define REG_TRACE()                                                                                \
+	disassemble_register_instr(*m_current_block, pc - m_current_block->reg_code.data())
+#else
+#define REG_TRACE() ((void)0)
+#endif
+
+#ifdef VYSE_COMPUTED_GOTO
+#define REG_CASE(name) reg_op_##name
+#define REG_DISPATCH()                                                                             \
+	do {                                                                                           \
+		REG_TRACE();                                                                               \
+		goto* reg_dispatch_table[static_cast<u8>((pc++)->op)];                                     \
+	} while (false)
+#else
+#define REG_CASE(name) case RegOp::name
+#define REG_DISPATCH() break
+#endif
+
+void VM::enter_register_frame() {
+	const u32 frame_size = m_current_block->reg_frame_size;
+	ensure_slots(frame_size);
+	Value* const frame_end = frame_base(*m_current_frame) + frame_size;
+	VYSE_ASSERT(m_stack.top <= frame_end, "Arguments past the last register.");
+	for (Value* slot = m_stack.top; slot < frame_end; ++slot) *slot = VYSE_NIL;
+	m_stack.top = frame_end;
+}
+
+ExitCode VM::run_registers() {
+	VYSE_ASSERT(m_current_block->has_register_code(), "Block has no register code.");
+	// Returning from the frame below this one means returning to whoever called this function.
+	const u32 entry_frames = m_frame_count;
+	enter_register_frame();
+
+	const RegInstr* pc;
+	const Value* constants;
+	Value* regs;
+	REG_RESTORE_STATE();
+
+#ifdef VYSE_COMPUTED_GOTO
+	static void* const reg_dispatch_table[] = {
+#define REG_OP(name, _) &&REG_CASE(name),
+#include <x_reg_opcode.hpp>
+#undef REG_OP
+	};
+
+	REG_DISPATCH();
+	{
+#else
+	while (true) {
+		REG_TRACE();
+		switch ((pc++)->op) {
+#endif
+		REG_CASE(move): R(INSTR.a) = R(INSTR.b); REG_DISPATCH();
+		REG_CASE(load_const): R(INSTR.a) = K(INSTR.b); REG_DISPATCH();
+		REG_CASE(load_nil): R(INSTR.a) = VYSE_NIL; REG_DISPATCH();
+
+		REG_CASE(get_global): {
+			const GlobalRef& global = m_current_block->globals[INSTR.b];
+			const Value value = m_globals[global.slot];
+			if (VYSE_IS_UNDEFINED(value)) {
+				return REG_ERROR("Undefined variable '{}'.", global.name->c_str());
+			}
+			R(INSTR.a) = value;
+			REG_DISPATCH();
+		}
+
+		REG_CASE(set_global):
+			m_globals[m_current_block->globals[INSTR.b].slot] = R(INSTR.a);
+			REG_DISPATCH();
+
+		REG_CASE(get_upval): {
+			Closure* const cl = static_cast<Closure*>(m_current_frame->func);
+			R(INSTR.a) = *cl->get_upval(INSTR.b)->m_value;
+			REG_DISPATCH();
+		}
+
+		REG_CASE(get_capture): {
+			Closure* const cl = static_cast<Closure*>(m_current_frame->func);
+			R(INSTR.a) = cl->capture(INSTR.b);
+			REG_DISPATCH();
+		}
+
+		REG_CASE(set_upval): {
+			Closure* const cl = static_cast<Closure*>(m_current_frame->func);
+			*cl->get_upval(INSTR.b)->m_value = R(INSTR.a);
+			REG_DISPATCH();
+		}
+
+		REG_CASE(close_upval): close_upvalues_upto(&R(INSTR.a)); REG_DISPATCH();
+
+		REG_CASE(add): REG_ARITH(+, "__add", R(INSTR.c)); REG_DISPATCH();
+		REG_CASE(sub): REG_ARITH(-, "__sub", R(INSTR.c)); REG_DISPATCH();
+		REG_CASE(mult): REG_ARITH(*, "__mult", R(INSTR.c)); REG_DISPATCH();
+		REG_CASE(add_k): REG_ARITH(+, "__add", K(INSTR.c)); REG_DISPATCH();
+		REG_CASE(sub_k): REG_ARITH(-, "__sub", K(INSTR.c)); REG_DISPATCH();
+		REG_CASE(mult_k): REG_ARITH(*, "__mult", K(INSTR.c)); REG_DISPATCH();
+
+		REG_CASE(div):
+		REG_CASE(div_k): {
+			const Value l = R(INSTR.b);
+			const Value r = INSTR.op == RegOp::div ? R(INSTR.c) : K(INSTR.c);
+			if (VYSE_IS_NUM(l) and VYSE_IS_NUM(r)) {
+				if (VYSE_AS_NUM(l) == 0) {
+					return REG_ERROR("Attempt to divide by 0.\n");
+				}
+				R(INSTR.a) = VYSE_NUM(VYSE_AS_NUM(l) / VYSE_AS_NUM(r));
+			} else REG_BINARY_OVERLOAD("/", "__div", l, r)
+			REG_DISPATCH();
+		}
+
+		REG_CASE(mod):
+		REG_CASE(mod_k): {
+			const Value l = R(INSTR.b);
+			const Value r = INSTR.op == RegOp::mod ? R(INSTR.c) : K(INSTR.c);
+			if (VYSE_IS_INT(l) and VYSE_IS_INT(r) and VYSE_AS_INT(r) != 0) {
+				R(INSTR.a) = VYSE_INT(s64(VYSE_AS_INT(l)) % s64(VYSE_AS_INT(r)));
+			} else if (VYSE_IS_NUM(l) and VYSE_IS_NUM(r)) {
+				R(INSTR.a) = VYSE_NUM(fmod(VYSE_AS_NUM(l), VYSE_AS_NUM(r)));
+			} else REG_BINARY_OVERLOAD("%", "__mod", l, r)
+			REG_DISPATCH();
+		}
+
+		REG_CASE(exp): {
+			const Value base = R(INSTR.b);
+			const Value power = R(INSTR.c);
+			if (VYSE_IS_NUM(base) and VYSE_IS_NUM(power)) {
+				R(INSTR.a) = VYSE_NUM(pow(VYSE_AS_NUM(base), VYSE_AS_NUM(power)));
+			} else REG_BINARY_OVERLOAD("/", "__exp", base, power)
+			REG_DISPATCH();
+		}
+
+		REG_CASE(concat): {
+			const Value l = R(INSTR.b);
+			const Value r = R(INSTR.c);
+			if (!(VYSE_IS_STRING(l) and VYSE_IS_STRING(r))) {
+				REG_SAVE_IP();
+				return binop_error("..", l, r);
+			}
+			R(INSTR.a) = concatenate(VYSE_AS_STRING(l), VYSE_AS_STRING(r));
+			REG_DISPATCH();
+		}
+
+		REG_CASE(lshift): REG_BIT_BINOP(<<, "__bsl"); REG_DISPATCH();
+		REG_CASE(rshift): REG_BIT_BINOP(>>, "__bsr"); REG_DISPATCH();
+		REG_CASE(band): REG_BIT_BINOP(&, "__band"); REG_DISPATCH();
+		REG_CASE(bxor): REG_BIT_BINOP(^, "__bxor"); REG_DISPATCH();
+		REG_CASE(bor): REG_BIT_BINOP(|, "__bor"); REG_DISPATCH();
+
+		REG_CASE(eq): R(INSTR.a) = VYSE_BOOL(R(INSTR.b) == R(INSTR.c)); REG_DISPATCH();
+		REG_CASE(neq): R(INSTR.a) = VYSE_BOOL(R(INSTR.b) != R(INSTR.c)); REG_DISPATCH();
+		REG_CASE(eq_k): R(INSTR.a) = VYSE_BOOL(R(INSTR.b) == K(INSTR.c)); REG_DISPATCH();
+		REG_CASE(neq_k): R(INSTR.a) = VYSE_BOOL(R(INSTR.b) != K(INSTR.c)); REG_DISPATCH();
+
+		REG_CASE(gt): REG_CMP(>, "__gt", R(INSTR.c)); REG_DISPATCH();
+		REG_CASE(lt): REG_CMP(<, "__lt", R(INSTR.c)); REG_DISPATCH();
+		REG_CASE(gte): REG_CMP(>=, "__gte", R(INSTR.c)); REG_DISPATCH();
+		REG_CASE(lte): REG_CMP(<=, "__lte", R(INSTR.c)); REG_DISPATCH();
+		REG_CASE(gt_k): REG_CMP(>, "__gt", K(INSTR.c)); REG_DISPATCH();
+		REG_CASE(lt_k): REG_CMP(<, "__lt", K(INSTR.c)); REG_DISPATCH();
+		REG_CASE(gte_k): REG_CMP(>=, "__gte", K(INSTR.c)); REG_DISPATCH();
+		REG_CASE(lte_k): REG_CMP(<=, "__lte", K(INSTR.c)); REG_DISPATCH();
+
+		REG_CASE(negate): {
+			const Value operand = R(INSTR.b);
+			if (VYSE_IS_INT(operand)) {
+				R(INSTR.a) = int_or_num(-s64(VYSE_AS_INT(operand)));
+			} else if (VYSE_IS_NUM(operand)) {
+				R(INSTR.a) = VYSE_NUM(-VYSE_AS_NUM(operand));
+			} else {
+				Value result;
+				REG_SAVE_IP();
+				const bool ok = run_unary_overload("__negate", operand, result);
+				REG_RESTORE_STATE();
+				if (!ok) return REG_UNOP_ERROR("-", operand);
+				R(INSTR.a) = result;
+			}
+			REG_DISPATCH();
+		}
+
+		REG_CASE(lnot): R(INSTR.a) = VYSE_BOOL(IS_VAL_FALSY(R(INSTR.b))); REG_DISPATCH();
+
+		REG_CASE(len): {
+			const Value v = R(INSTR.b);
+			if (VYSE_IS_LIST(v)) {
+				R(INSTR.a) = int_or_num(VYSE_AS_LIST(v)->length());
+			} else if (VYSE_IS_TABLE(v)) {
+				R(INSTR.a) = int_or_num(VYSE_AS_TABLE(v)->length());
+			} else if (VYSE_IS_STRING(v)) {
+				R(INSTR.a) = int_or_num(VYSE_AS_STRING(v)->m_length);
+			} else {
+				return REG_ERROR("Attempt to get length of a {} value", value_type_name(v));
+			}
+			REG_DISPATCH();
+		}
+
+		REG_CASE(bnot): {
+			const Value v = R(INSTR.b);
+			if (VYSE_IS_INT(v)) {
+				R(INSTR.a) = VYSE_INT(~VYSE_AS_INT(v));
+			} else if (VYSE_IS_NUM(v)) {
+				R(INSTR.a) = int_or_num(~VYSE_CAST_INT(v));
+			} else {
+				return REG_ERROR("Cannot use operator '~' on value of type '{}'",
+								 value_type_name(v));
+			}
+			REG_DISPATCH();
+		}
+
+		REG_CASE(new_table): R(INSTR.a) = VYSE_OBJECT(&make<Table>(&m_root_shape)); REG_DISPATCH();
+		REG_CASE(new_list): R(INSTR.a) = VYSE_OBJECT(&make<List>()); REG_DISPATCH();
+
+		REG_CASE(list_append): {
+			const Value vlist = R(INSTR.a);
+			if (!VYSE_IS_LIST(vlist)) {
+				return REG_ERROR("Attempt to append to a {} value. (Can only append to lists)",
+								 value_type_name(vlist));
+			}
+			VYSE_AS_LIST(vlist)->append(R(INSTR.b));
+			REG_DISPATCH();
+		}
+
+		REG_CASE(table_add_field): {
+			if (!VYSE_IS_TABLE(R(INSTR.a))) return REG_INDEX_ERROR(R(INSTR.a));
+			VYSE_AS_TABLE(R(INSTR.a))->set(R(INSTR.b), R(INSTR.c));
+			REG_DISPATCH();
+		}
+
+		REG_CASE(table_get): {
+			const Value object = R(INSTR.b);
+			const Value& key = K(INSTR.c);
+			InlineCache& cache = m_current_block->inline_caches[INSTR.x];
+			Value result;
+			if (VYSE_IS_TABLE(object)) {
+				const Table& table = *VYSE_AS_TABLE(object);
+				if (table.get_cached(key, cache, result)) {
+					++cache.hits;
+				} else {
+					++cache.misses;
+					result = table.get_and_cache(key, cache);
+				}
+			} else if (VYSE_IS_UDATA(object)) {
+				REG_SAVE_IP();
+				if (!get_field_of_udata(*VYSE_AS_UDATA(object), key, result)) {
+					return ExitCode::RuntimeError;
+				}
+			} else {
+				return REG_INDEX_ERROR(object);
+			}
+			R(INSTR.a) = result;
+			REG_DISPATCH();
+		}
+
+		REG_CASE(table_set): {
+			const Value object = R(INSTR.a);
+			const Value value = R(INSTR.b);
+			const Value& key = K(INSTR.c);
+			InlineCache& cache = m_current_block->inline_caches[INSTR.x];
+			if (VYSE_IS_NIL(key)) return REG_ERROR("Table key cannot be nil.");
+			if (VYSE_IS_TABLE(object)) {
+				Table& table = *VYSE_AS_TABLE(object);
+				if (table.set_cached(key, value, cache)) {
+					++cache.hits;
+				} else {
+					++cache.misses;
+					table.set_and_cache(key, value, cache);
+				}
+			} else if (VYSE_IS_UDATA(object)) {
+				REG_SAVE_IP();
+				if (!set_field_of_udata(*VYSE_AS_UDATA(object), key, value)) {
+					return ExitCode::RuntimeError;
+				}
+			} else {
+				return REG_INDEX_ERROR(object);
+			}
+			REG_DISPATCH();
+		}
+
+		REG_CASE(prep_method_call): {
+			const Value object = R(INSTR.b);
+			InlineCache& cache = m_current_block->inline_caches[INSTR.x];
+			if (VYSE_IS_NIL(object)) return REG_INDEX_ERROR(object);
+
+			R(INSTR.a) = get_method(object, K(INSTR.c), cache);
+			R(INSTR.a + 1) = object;
+			REG_DISPATCH();
+		}
+
+		REG_CASE(subscript_get): {
+			Value result;
+			REG_SAVE_IP();
+			if (!get_subscript_of_value(R(INSTR.b), R(INSTR.c), result)) {
+				return ExitCode::RuntimeError;
+			}
+			R(INSTR.a) = result;
+			REG_DISPATCH();
+		}
+
+		REG_CASE(subscript_set): {
+			REG_SAVE_IP();
+			if (!subscript_set(R(INSTR.a), R(INSTR.b), R(INSTR.c))) return ExitCode::RuntimeError;
+			REG_DISPATCH();
+		}
+
+		REG_CASE(jmp): REG_JUMP(); REG_DISPATCH();
+
+		REG_CASE(jmp_if_false): {
+			if (IS_VAL_FALSY(R(INSTR.a))) REG_JUMP();
+			REG_DISPATCH();
+		}
+
+		REG_CASE(jmp_if_true): {
+			if (IS_VAL_TRUTHY(R(INSTR.a))) REG_JUMP();
+			REG_DISPATCH();
+		}
+
+		REG_CASE(eq_jmp): REG_EQ_JMP(==, R(INSTR.b)); REG_DISPATCH();
+		REG_CASE(neq_jmp): REG_EQ_JMP(!=, R(INSTR.b)); REG_DISPATCH();
+		REG_CASE(gt_jmp): REG_CMP_JMP(>, "__gt", R(INSTR.b)); REG_DISPATCH();
+		REG_CASE(lt_jmp): REG_CMP_JMP(<, "__lt", R(INSTR.b)); REG_DISPATCH();
+		REG_CASE(gte_jmp): REG_CMP_JMP(>=, "__gte", R(INSTR.b)); REG_DISPATCH();
+		REG_CASE(lte_jmp): REG_CMP_JMP(<=, "__lte", R(INSTR.b)); REG_DISPATCH();
+		REG_CASE(eq_k_jmp): REG_EQ_JMP(==, K(INSTR.b)); REG_DISPATCH();
+		REG_CASE(neq_k_jmp): REG_EQ_JMP(!=, K(INSTR.b)); REG_DISPATCH();
+		REG_CASE(gt_k_jmp): REG_CMP_JMP(>, "__gt", K(INSTR.b)); REG_DISPATCH();
+		REG_CASE(lt_k_jmp): REG_CMP_JMP(<, "__lt", K(INSTR.b)); REG_DISPATCH();
+		REG_CASE(gte_k_jmp): REG_CMP_JMP(>=, "__gte", K(INSTR.b)); REG_DISPATCH();
+		REG_CASE(lte_k_jmp): REG_CMP_JMP(<=, "__lte", K(INSTR.b)); REG_DISPATCH();
+
+		// The registers are [counter, limit, step, i], see the stack tier's `for_prep`.
+		REG_CASE(for_prep): {
+			Value* const loop = &R(INSTR.a);
+			Value& counter = loop[0];
+			const Value& step = loop[2];
+			if (!VYSE_CHECK_TT(counter, VT::Number)) {
+				return REG_ERROR("'for' variable not a number.");
+			}
+			if (!VYSE_CHECK_TT(loop[1], VT::Number)) return REG_ERROR("'for' limit not a number.");
+			if (!VYSE_CHECK_TT(step, VT::Number)) return REG_ERROR("'for' step not a number.");
+
+			if (VYSE_IS_INT(counter) and VYSE_IS_INT(step)) {
+				counter = int_or_num(s64(VYSE_AS_INT(counter)) - VYSE_AS_INT(step));
+			} else {
+				VYSE_SET_NUM(counter, VYSE_AS_NUM(counter) - VYSE_AS_NUM(step));
+			}
+			loop[3] = counter;
+			REG_JUMP();
+			REG_DISPATCH();
+		}
+
+		REG_CASE(for_loop): {
+			Value* const loop = &R(INSTR.a);
+			Value& counter = loop[0];
+			const Value& limit = loop[1];
+			const Value& step = loop[2];
+
+			if (VYSE_IS_INT(counter) and VYSE_IS_INT(limit) and VYSE_IS_INT(step)) {
+				const s32 istep = VYSE_AS_INT(step);
+				const s64 next = s64(VYSE_AS_INT(counter)) + istep;
+				counter = int_or_num(next);
+				loop[3] = counter;
+
+				const s32 ilimit = VYSE_AS_INT(limit);
+				if (istep >= 0 ? next < ilimit : next >= ilimit) REG_JUMP();
+				REG_DISPATCH();
+			}
+
+			const number nstep = VYSE_AS_NUM(step);
+			VYSE_SET_NUM(counter, VYSE_AS_NUM(counter) + nstep);
+			loop[3] = counter;
+			if (nstep >= 0 ? VYSE_AS_NUM(counter) < VYSE_AS_NUM(limit)
+						   : VYSE_AS_NUM(counter) >= VYSE_AS_NUM(limit)) {
+				REG_JUMP();
+			}
+			REG_DISPATCH();
+		}
+
+		REG_CASE(vararg_len): {
+			REG_SAVE_IP();
+			if (!get_vararg_len(R(INSTR.a))) return ExitCode::RuntimeError;
+			REG_DISPATCH();
+		}
+
+		REG_CASE(vararg_get): {
+			REG_SAVE_IP();
+			if (!get_vararg(R(INSTR.b), R(INSTR.a))) return ExitCode::RuntimeError;
+			REG_DISPATCH();
+		}
+
+		REG_CASE(call): {
+			REG_SAVE_IP();
+			Value* const func = &R(INSTR.a);
+			m_stack.top = func + INSTR.b + 1;
+
+			// Calls to functions on the register tier that take exactly the arguments they are
+			// passed skip the generic call path.
+			if (VYSE_IS_CLOSURE(*func) and m_frame_count < MaxCallStack) {
+				Closure* const callee = VYSE_AS_CLOSURE(*func);
+				const CodeBlock& code = *callee->m_codeblock;
+				if (code.block().has_register_code() and code.param_count() == INSTR.b and
+					!code.is_vararg()) {
+					push_callframe(callee, INSTR.b);
+					enter_register_frame();
+					REG_LOAD_STATE();
+					REG_DISPATCH();
+				}
+			}
+
+			if (VYSE_IS_CCLOSURE(*func) and is_frameless(VYSE_AS_CCLOSURE(*func))) {
+				if (!call_fast_cclosure(VYSE_AS_CCLOSURE(*func), INSTR.b)) {
+					return ExitCode::RuntimeError;
+				}
+				REG_RETURN_STATE();
+				REG_DISPATCH();
+			}
+
+			const u32 frame_count = m_frame_count;
+			if (!op_call(*func, INSTR.b)) return ExitCode::RuntimeError;
+
+			// Functions that run on the register tier are run in this loop, others in their own.
+			if (m_frame_count > frame_count and m_current_block->has_register_code()) {
+				enter_register_frame();
+				REG_LOAD_STATE();
+				REG_DISPATCH();
+			}
+
+			if (m_frame_count > frame_count and run() != ExitCode::Success) {
+				return ExitCode::RuntimeError;
+			}
+			REG_RETURN_STATE();
+			REG_DISPATCH();
+		}
+
+		REG_CASE(tail_call): {
+			REG_SAVE_IP();
+			m_stack.top = &R(INSTR.a) + INSTR.b + 1;
+			const u32 frame_count = m_frame_count;
+			if (!op_tail_call(INSTR.b)) return ExitCode::RuntimeError;
+
+			if (m_frame_count == frame_count) {
+				if (m_current_block->has_register_code()) {
+					enter_register_frame();
+					REG_LOAD_STATE();
+					REG_DISPATCH();
+				}
+				if (run() != ExitCode::Success) return ExitCode::RuntimeError;
+			}
+
+			if (m_frame_count < entry_frames) return ExitCode::Success;
+			REG_RETURN_STATE();
+			REG_DISPATCH();
+		}
+
+		REG_CASE(return_val): {
+			const Value result = R(INSTR.a);
+			close_upvalues_upto(regs);
+			m_stack.top = regs - m_current_frame->num_varargs;
+			*m_stack.top++ = result;
+
+			if (--m_frame_count == 0) {
+				return_value = result;
+				return ExitCode::Success;
+			}
+
+			--m_current_frame;
+			if (m_frame_count < entry_frames) return ExitCode::Success;
+
+			REG_RETURN_STATE();
+			REG_DISPATCH();
+		}
+
+		REG_CASE(make_func): {
+			// The upvalues are described by the operands of the stack tier's `make_func`.
+			const Opcode* const operands = m_current_block->code.data() + INSTR.x + 1;
+			const u32 num_upvals = static_cast<u8>(operands[1]);
+			if (num_upvals == 0) {
+				R(INSTR.a) = VYSE_OBJECT(&shared_closure(VYSE_AS_PROTO(K(INSTR.b))));
+				REG_DISPATCH();
+			}
+
+			Closure* const func = &make_closure(VYSE_AS_PROTO(K(INSTR.b)), num_upvals);
+			R(INSTR.a) = VYSE_OBJECT(func);
+
+			for (u8 i = 0; i < num_upvals; ++i) {
+				const u8 flags = static_cast<u8>(operands[2 + 2 * i]);
+				const u8 index = static_cast<u8>(operands[3 + 2 * i]);
+				capture_variable(*func, i, flags, regs + index, index);
+			}
+			REG_DISPATCH();
+		}
+#ifndef VYSE_COMPUTED_GOTO
+		}
 #endif
 	}
 
 	return ExitCode::Success;
 }
 
+#undef R
+#undef K
+#undef REG_SAVE_IP
+#undef REG_LOAD_STATE
+#undef REG_RESTORE_STATE
+#undef REG_RETURN_STATE
+#undef REG_ERROR
+#undef REG_INDEX_ERROR
+#undef REG_UNOP_ERROR
+#undef REG_BINARY_OVERLOAD
+#undef REG_ARITH
+#undef REG_CMP
+#undef REG_BIT_BINOP
+#undef REG_JUMP
+#undef REG_CMP_JMP
+#undef REG_EQ_JMP
+#undef REG_TRACE
+#undef REG_CASE
+#undef REG_DISPATCH
+
+#if defined(VYSE_COMPUTED_GOTO) && defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+#undef VM_CASE
+#undef VM_DISPATCH
+#undef VM_PROFILE
+#undef SUPER_NEXT
+#undef DO_load_const
+#undef DO_load_nil
+#undef DO_pop
+#undef DO_get_var
+#undef DO_set_var
+#undef DO_get_upval
+#undef DO_set_upval
+#undef DO_get_capture
+#undef DO_get_global
+#undef DO_set_global
+#undef DO_new_table
+#undef DO_new_list
+#undef DO_close_upval
+
 Value VM::concatenate(const String* left, const String* right) {
 	const size_t length = left->len() + right->len();
 
@@ -652,9 +1755,9 @@ Value VM::concatenate(const String* left, const String* right) {
 }
 
 Value VM::get_global(String* name) const {
-	const auto search = m_global_vars.find(name);
-	if (search == m_global_vars.end()) return VYSE_UNDEF;
-	return search->second;
+	const auto search = m_global_slots.find(name);
+	if (search == m_global_slots.end()) return VYSE_UNDEF;
+	return m_globals[search->second];
 }
 
 Value VM::get_global(const char* name) {
@@ -662,8 +1765,20 @@ Value VM::get_global(const char* name) {
 	return get_global(&sname);
 }
 
+InlineCacheStats VM::ic_stats() const noexcept {
+	InlineCacheStats stats;
+	for (const Obj* object = m_gc.m_objects; object != nullptr; object = object->next) {
+		if (object->tag != OT::codeblock) continue;
+		const Block& block = static_cast<const CodeBlock*>(object)->block();
+		const InlineCacheStats block_stats = block.ic_stats();
+		stats.hits += block_stats.hits;
+		stats.misses += block_stats.misses;
+	}
+	return stats;
+}
+
 void VM::set_global(String* name, Value value) {
-	m_global_vars[name] = value;
+	m_globals[global_slot(name)] = value;
 }
 
 void VM::set_global(const char* name, Value value) {
@@ -673,19 +1788,38 @@ void VM::set_global(const char* name, Value value) {
 	String& sname = make_string(name, strlen(name));
 	if (VYSE_IS_OBJECT(value)) m_stack.pop();
 
-	m_global_vars[&sname] = value;
+	m_globals[global_slot(&sname)] = value;
+}
+
+u32 VM::global_slot(String* name) {
+	const auto [entry, inserted] = m_global_slots.try_emplace(name, m_globals.size());
+	if (inserted) {
+		m_globals.push_back(VYSE_UNDEF);
+		m_global_names.push_back(name);
+	}
+	return entry->second;
 }
 
+#undef SAVE_IP
+#undef LOAD_STATE
+#undef PROTECT
+#undef TRY_QUICKEN
+#undef DEQUICKEN
 #undef FETCH
 #undef FETCH_SHORT
 #undef NEXT_BYTE
 #undef READ_VALUE
+#undef READ_CACHE
+#undef READ_GLOBAL
 #undef GET_VAR
 #undef SET_VAR
 #undef BINOP
 #undef BINOP_ERROR
 #undef IS_VAL_TRUTHY
 #undef CMP_OP
+#undef CMP_JMP
+#undef EQ_JMP
+#undef BRANCH_UNLESS
 #undef PEEK
 #undef PUSH
 #undef DISCARD
@@ -713,6 +1847,10 @@ bool VM::init() {
 #ifdef VYSE_DEBUG_DISASSEMBLY
 	disassemble_block(script->name()->c_str(), *m_current_block);
 	printf("\n");
+	if (m_current_block->has_register_code()) {
+		disassemble_register_code(script->name()->c_str(), *m_current_block);
+		printf("\n");
+	}
 #endif
 
 	return true;
@@ -724,6 +1862,38 @@ Closure* VM::compile(SourceCode src) {
 	return script;
 }
 
+Closure* VM::compile(const AotModule& module) {
+	Closure* const script = compile(SourceCode{module.path, module.source});
+	if (script == nullptr) return nullptr;
+	if (link_aot_module(module, *script->m_codeblock) != 0) m_native = true;
+	return script;
+}
+
+Closure* VM::load_bytecode(std::string path, std::string_view bytes) {
+	add_source("", std::move(path));
+	BytecodeReader reader{*this, bytes};
+	CodeBlock* const code = reader.read();
+	if (code == nullptr) {
+		load_error("Could not load bytecode: " + reader.error());
+		return nullptr;
+	}
+
+	GCLock const lock = gc_lock(code);
+	return &make_closure(code, 0);
+}
+
+Closure* VM::load_image(std::string path, BytecodeImage& image) {
+	add_source("", std::move(path));
+	CodeBlock* const code = image.load(*this);
+	GCLock const lock = gc_lock(code);
+	return &make_closure(code, 0);
+}
+
+void VM::load_error(const std::string& message) {
+	const std::string& file = m_sources.back().path;
+	on_error(*this, RuntimeError(file, message, kt::format_str("{}: {}", file, message)));
+}
+
 Closure* VM::compile_source() {
 	VYSE_ASSERT(!m_sources.empty(), "attempt to compile file without setting sources.");
 	Compiler compiler{this, m_sources.back()};
@@ -739,7 +1909,7 @@ Closure* VM::compile_source() {
 	// There are no reachable references to [code] when we allocate `script`. Since allocating a
 	// function can trigger a garbage collection cycle, we protect the code block.
 	GCLock const lock = gc_lock(code);
-	Closure* const closure = &make<Closure>(code, 0);
+	Closure* const closure = &make_closure(code, 0);
 
 	m_compiler = nullptr;
 	return closure;
@@ -757,7 +1927,7 @@ void VM::invoke_script(Closure* script) {
 
 	// Push the closure onto the stack and change the update the base callframe.
 	m_stack.push(VYSE_OBJECT(script));
-	base_frame->base = m_stack.top - 1;
+	base_frame->base = m_stack.top - m_stack.values - 1;
 	base_frame->ip = 0;
 	ip = 0;
 	base_frame->func = script;
@@ -772,20 +1942,53 @@ ExitCode VM::runcode(std::string code) {
 }
 
 ExitCode VM::runfile(std::string file_path, std::string code) {
-	if (!code.empty()) {
+	// Image files are mapped instead of read, so that the processes running one share it's memory.
+	const bool is_image =
+		code.empty() ? is_bytecode_image_file(file_path) : is_bytecode_image(code);
+	if (is_image) {
+		std::string error;
+		const std::shared_ptr<BytecodeImage> image = code.empty()
+														 ? BytecodeImage::open(file_path, error)
+														 : BytecodeImage::from_bytes(code, error);
 		file_path = std::filesystem::absolute(std::move(file_path)).string();
-		add_source(std::move(code), std::move(file_path));
+		if (image == nullptr) {
+			add_source("", std::move(file_path));
+			load_error("Could not load bytecode image: " + error);
+			return run_script(nullptr);
+		}
+		return run_script(load_image(std::move(file_path), *image));
+	}
+
+	SourceCode source;
+	if (!code.empty()) {
+		source = {std::filesystem::absolute(std::move(file_path)).string(), std::move(code)};
+	} else {
+		auto maybe_source = SourceCode::from_path(file_path);
+		if (!maybe_source.has_value()) {
+			ERROR("Could not read file: {}", file_path);
+			return ExitCode::CompileError;
+		}
+		source = std::move(maybe_source.value());
+	}
+
+	if (!is_bytecode(source.code)) {
+		add_source(std::move(source));
 		return interpret();
 	}
+	return run_script(load_bytecode(std::move(source.path), source.code));
+}
+
+ExitCode VM::runaot(const AotModule& module) {
+	return run_script(compile(module));
+}
 
-	auto maybe_source = SourceCode::from_path(file_path);
-	if (!maybe_source.has_value()) {
-		ERROR("Could not read file: {}", file_path);
+ExitCode VM::run_script(Closure* script) {
+	if (script == nullptr) {
+		m_has_error = true;
 		return ExitCode::CompileError;
 	}
-
-	add_source(std::move(maybe_source.value()));
-	return interpret();
+	invoke_script(script);
+	return run();
 }
 
 void VM::add_stdlib_object(const char* name, Obj* o) {
@@ -830,6 +2033,29 @@ void VM::load_primitives() {
 
 using OT = ObjType;
 
+Closure& VM::make_closure(CodeBlock* code, u32 num_upvals) {
+	if (code->is_pending()) BytecodeImage::load_pending(*this, *code);
+	Closure* const closure = new (num_upvals) Closure(code, num_upvals);
+	register_object(closure);
+	return *closure;
+}
+
+Closure& VM::shared_closure(CodeBlock* code) {
+	if (code->shared_closure() == nullptr) code->set_shared_closure(&make_closure(code, 0));
+	return *code->shared_closure();
+}
+
+void VM::capture_variable(Closure& closure, u8 idx, u8 flags, Value* slot, u8 index) {
+	if (!(flags & CaptureLocal)) {
+		// Whether it holds an upvalue or a value, the enclosing closure's capture is shared as is.
+		closure.capture(idx) = static_cast<Closure*>(m_current_frame->func)->capture(index);
+	} else if (flags & CaptureByValue) {
+		closure.capture(idx) = *slot;
+	} else {
+		closure.set_upval(idx, capture_upvalue(slot));
+	}
+}
+
 Upvalue* VM::capture_upvalue(Value* slot) {
 	// start at the head of the linked list
 	Upvalue* current = m_open_upvals;
@@ -837,7 +2063,7 @@ Upvalue* VM::capture_upvalue(Value* slot) {
 
 	// keep going until we reach a slot whose depth is lower than what we've been looking for, or
 	// until we reach the end of the list.
-	while (current != nullptr and current->m_value < slot) {
+	while (current != nullptr and current->m_value > slot) {
 		prev = current;
 		current = current->next_upval;
 	}
@@ -911,6 +2137,22 @@ bool VM::op_call(Value value, u8 argc) {
 	return ok;
 }
 
+bool VM::op_tail_call(u8 argc) {
+	VYSE_ASSERT(m_frame_count > 1, "Tail call from the base call frame.");
+	const u32 num_elided = m_current_frame->num_elided + 1;
+
+	close_upvalues_upto(frame_base(*m_current_frame));
+	Value* const base = frame_base(*m_current_frame) - m_current_frame->num_varargs;
+	std::memmove(base, m_stack.top - argc - 1, (argc + 1) * sizeof(Value));
+	m_stack.top = base + argc + 1;
+	pop_callframe();
+
+	const u32 frame_count = m_frame_count;
+	if (!op_call(*base, argc)) return false;
+	if (m_frame_count > frame_count) m_current_frame->num_elided = num_elided;
+	return true;
+}
+
 void VM::push_callframe(Obj* callee, int argc) {
 	VYSE_ASSERT(callee->tag == OT::c_closure or callee->tag == OT::closure,
 				"Non callable callframe pushed.");
@@ -920,20 +2162,14 @@ void VM::push_callframe(Obj* callee, int argc) {
 	// when the next function returns.
 	m_current_frame->ip = ip;
 
-	// prepare the next call frame
-	if (m_current_frame->next) {
-		m_current_frame = m_current_frame->next;
-	} else {
-		CallFrame* const next_cf = new CallFrame;
-		m_current_frame->next = next_cf;
-		next_cf->prev = m_current_frame;
-		m_current_frame = next_cf;
-	}
-
+	VYSE_ASSERT(m_frame_count < MaxCallStack, "Call stack overflow.");
+	m_current_frame = &m_frames[m_frame_count];
 	++m_frame_count;
 
 	m_current_frame->func = callee;
-	m_current_frame->base = m_stack.top - argc - 1;
+	m_current_frame->base = m_stack.top - m_stack.values - argc - 1;
+	m_current_frame->num_elided = 0;
+	m_current_frame->num_varargs = 0;
 
 	// Start new function from the first opcode
 	m_current_frame->ip = ip = 0;
@@ -951,8 +2187,7 @@ void VM::pop_callframe() noexcept {
 	// If we are in the top level script, then there is no older call frame.
 	if (m_frame_count == 0) return;
 
-	m_current_frame = m_current_frame->prev;
-	VYSE_ASSERT(m_current_frame != nullptr, "Invalid Call stack state.");
+	--m_current_frame;
 
 	// restore the instruction pointer to continue from where we left off.
 	ip = m_current_frame->ip;
@@ -967,8 +2202,16 @@ void VM::pop_callframe() noexcept {
 bool VM::call_closure(Closure* func, int num_args) {
 	const int num_params = func->m_codeblock->param_count();
 
-	// make sure there is enough room in the stack for this function call.
-	ensure_slots(func->m_codeblock->stack_size());
+	// make sure there is enough room in the stack for this function call, including the missing
+	// arguments that are padded with nil.
+	ensure_slots(func->m_codeblock->stack_size() + num_params);
+
+	if (func->m_codeblock->is_vararg()) {
+		const u32 num_varargs = prep_vararg_call(*func->m_codeblock, num_args);
+		push_callframe(func, num_params);
+		m_current_frame->num_varargs = num_varargs;
+		return true;
+	}
 
 	// extra arguments are ignored and missing arguments are padded with 'nil'.
 	if (num_args < num_params) {
@@ -977,8 +2220,6 @@ bool VM::call_closure(Closure* func, int num_args) {
 			m_stack.push(VYSE_NIL);
 			num_args++;
 		}
-	} else if (func->m_codeblock->is_vararg()) {
-		num_args = prep_vararg_call(num_params, num_args);
 	} else {
 		while (num_args != num_params) {
 			m_stack.pop();
@@ -991,19 +2232,40 @@ bool VM::call_closure(Closure* func, int num_args) {
 	return true;
 }
 
-int VM::prep_vararg_call(int num_params, int num_args) {
-	VYSE_ASSERT(num_args >= num_params, "bad call to VM::prep_vararg_call");
+u32 VM::prep_vararg_call(const CodeBlock& code, int num_args) {
+	const int num_params = code.param_count();
+	// When no extra arguments are passed, the rest parameter is nil. Functions that keep their
+	// extra arguments on the stack then have none of them.
+	if (num_args < num_params) {
+		while (num_args < num_params) {
+			m_stack.push(VYSE_NIL);
+			++num_args;
+		}
+		return 0;
+	}
+
+	const int num_varargs = num_args - num_params + 1;
+	Value* const varargs = m_stack.top - num_varargs;
+
+	if (code.keeps_varargs_on_stack()) {
+		// [func, params..., varargs...] -> [varargs..., func, params..., nil]
+		std::rotate(varargs - num_params, varargs, m_stack.top);
+		m_stack.push(VYSE_NIL);
+		return num_varargs;
+	}
+
 	List& vararg_list = make<List>();
-	int num_varargs = num_args - num_params + 1;
-	for (Value* arg = m_stack.top - num_varargs; arg < m_stack.top; ++arg) {
+	for (Value* arg = varargs; arg < m_stack.top; ++arg) {
 		vararg_list.append(*arg);
 	}
 	m_stack.popn(num_varargs);
 	m_stack.push(VYSE_OBJECT(&vararg_list));
-	return num_params;
+	return 0;
 }
 
 bool VM::call_cclosure(CClosure* cclosure, int argc) noexcept(false) {
+	if (cclosure->is_fast()) return call_fast_cclosure(cclosure, argc);
+
 	push_callframe(cclosure, argc);
 	NativeFn c_func = cclosure->cfunc();
 
@@ -1032,6 +2294,34 @@ bool VM::call_cclosure(CClosure* cclosure, int argc) noexcept(false) {
 	return !m_has_error;
 }
 
+bool VM::call_fast_cclosure(CClosure* cclosure, int argc) {
+	if (argc < cclosure->arity()) {
+		ERROR("In call to '{}': Expected {} arguments. Got {}.", cclosure->name()->c_str(),
+			  static_cast<int>(cclosure->arity()), argc);
+		return false;
+	}
+
+	const FastNativeFn c_func = cclosure->fast_cfunc();
+	Value* const args = m_stack.top - argc;
+
+	Value ret = VYSE_NIL;
+	NativeStatus status;
+	if (cclosure->reenters_vm()) {
+		push_callframe(cclosure, argc);
+		status = c_func(*this, args, argc, ret);
+		pop_callframe();
+	} else {
+		status = c_func(*this, args, argc, ret);
+	}
+
+	VYSE_ASSERT(status == NativeStatus::Ok or m_has_error,
+				"Native function failed without reporting an error.");
+
+	m_stack.popn(argc);
+	m_stack.top[-1] = ret;
+	return status == NativeStatus::Ok;
+}
+
 bool VM::call_binary_overload(const char* op_str, const char* method_name) {
 	/// TODO: get rid of the temporary string object here
 	const Value overload_name = VYSE_OBJECT(&make_string(method_name));
@@ -1070,6 +2360,63 @@ bool VM::call_unary_overload(const char* method_name) {
 	return op_call(method, 1);
 }
 
+bool VM::run_binary_overload(const char* op_str, const char* method, Value l, Value r,
+							 Value& result) {
+	ensure_slots(2);
+	m_stack.push(l);
+	m_stack.push(r);
+	const u32 frame_count = m_frame_count;
+	if (!call_binary_overload(op_str, method) or !finish_call(frame_count)) return false;
+	result = m_stack.pop();
+	return true;
+}
+
+bool VM::run_unary_overload(const char* method, Value operand, Value& result) {
+	ensure_slots(1);
+	m_stack.push(operand);
+	const u32 frame_count = m_frame_count;
+	if (!call_unary_overload(method) or !finish_call(frame_count)) return false;
+	result = m_stack.pop();
+	return true;
+}
+
+bool VM::finish_call(u32 frame_count) {
+	if (m_frame_count == frame_count) return true;
+	return run() == ExitCode::Success;
+}
+
+bool VM::run_register_callee() {
+	if (m_current_block->has_register_code()) {
+		if (run_registers() != ExitCode::Success) return false;
+		restore_frame();
+		return true;
+	}
+
+	// A function on the stack tier may run in native code instead. Only a frame that was just
+	// pushed has it's `ip` at the start of the function.
+	if (!m_native or ip != 0) return true;
+	const JitExit exit = run_native();
+	if (exit == JitExit::Return) restore_frame();
+	return exit != JitExit::Error;
+}
+
+JitExit VM::run_native() {
+	CodeBlock& code = *static_cast<Closure*>(m_current_frame->func)->m_codeblock;
+	if (!code.has_native_code() and
+		!(m_jit != nullptr and code.heat_up(m_config.jit_threshold) and m_jit->compile(code))) {
+		return JitExit::Interpret;
+	}
+	return run_compiled(code);
+}
+
+JitExit VM::run_compiled(const CodeBlock& code) {
+	if (code.aot_function() != nullptr) {
+		JitFrame frame{this, base()};
+		return JitExit(code.aot_function()(&frame, ip));
+	}
+	return m_jit->run(code);
+}
+
 bool VM::call_func_overload(Value& object, int argc) {
 	static constexpr const char* overload_name = "__call";
 	String& method_string = make_string(overload_name);
@@ -1146,6 +2493,42 @@ bool VM::set_field_of_udata(const UserData& udata, const Value& key, Value value
 	return true;
 }
 
+bool VM::get_vararg_len(Value& result) {
+	const u32 num_varargs = m_current_frame->num_varargs;
+	if (num_varargs == 0) {
+		ERROR("Attempt to get length of a nil value");
+		return false;
+	}
+	result = int_or_num(num_varargs);
+	return true;
+}
+
+bool VM::get_vararg(const Value& index, Value& result) {
+	const u32 num_varargs = m_current_frame->num_varargs;
+	if (num_varargs == 0) return get_subscript_of_value(VYSE_NIL, index, result);
+	const Value* const varargs = frame_base(*m_current_frame) - num_varargs;
+	if (VYSE_IS_INT(index)) {
+		const s32 idx = VYSE_AS_INT(index);
+		if (idx >= 0 and u32(idx) < num_varargs) {
+			result = varargs[idx];
+			return true;
+		}
+	}
+
+	if (not VYSE_IS_NUM(index)) {
+		ERROR("List index not a number.");
+		return false;
+	}
+
+	const number idx = VYSE_AS_NUM(index);
+	if (idx < 0 or idx >= num_varargs) {
+		ERROR("List index out of bounds. (index: {}, length: {})", idx, num_varargs);
+		return false;
+	}
+	result = varargs[size_t(idx)];
+	return true;
+}
+
 bool VM::get_subscript_of_value(const Value& value, const Value& index, Value& result) {
 	if (VYSE_IS_NIL(value)) {
 		ERROR("Attempt to index a nil value.");
@@ -1165,6 +2548,14 @@ bool VM::get_subscript_of_value(const Value& value, const Value& index, Value& r
 
 		case OT::list: {
 			const List* list = static_cast<List*>(object);
+			if (VYSE_IS_INT(index)) {
+				const s32 idx = VYSE_AS_INT(index);
+				if (idx >= 0 and size_t(idx) < list->length()) {
+					result = list->at(idx);
+					return true;
+				}
+			}
+
 			if (not VYSE_IS_NUM(index)) {
 				ERROR("List index not a number.");
 				return false;
@@ -1240,6 +2631,14 @@ bool VM::subscript_set(const Value& lhs, const Value& key, const Value& rhs) {
 }
 
 bool VM::list_index_set(List& list, const Value& key, const Value& value) {
+	if (VYSE_IS_INT(key)) {
+		const s32 index = VYSE_AS_INT(key);
+		if (index >= 0 and size_t(index) < list.length()) {
+			list[index] = value;
+			return true;
+		}
+	}
+
 	if (!VYSE_CHECK_TT(key, VT::Number)) {
 		ERROR("List index not a number.");
 		return false;
@@ -1297,32 +2696,32 @@ String& VM::make_string(const char* chars, size_t length) {
 /*
  * Growing the VM stack is done by `realloc`ing the old stack buffer to a new
  * location in memory. However, when we do so, we must be careful enough to update
- * all pointers that pointed to the old stack. Let's use call frames as an example.
- * Every call frame has a 'base' pointer, that points to the first slot in the stack
- * which belongs to the frame. When the stack is moved to a new location, this
- * 'base' pointer must also be updated.
+ * all pointers that pointed to the old stack. Let's use open upvalues as an example.
+ * Every open upvalue has a 'm_value' pointer, that points to the stack slot holding
+ * the captured variable. When the stack is moved to a new location, this pointer
+ * must also be updated.
  *
  * The key idea is that since the contents and state of the stack are preserved on
- * growth, so the distance between the old stack's base and the callframe's base is
- * equal to the distance between the new stack's base and the callframe's base.
+ * growth, so the distance between the old stack's base and the upvalue's slot is
+ * equal to the distance between the new stack's base and the upvalue's slot.
  *
- * dH = call_frame.base - old_stack.base
- * call_frame.base = new_stack.base + dH
+ * dH = upvalue.m_value - old_stack.base
+ * upvalue.m_value = new_stack.base + dH
  *
  *                                                                    +--------+
  *                                                                    |        |
  *                                                                    |--------|
  * +-------+                                                          |        |
  * |       |      (BEFORE)                         (AFTER)            |--------|
- * |-------| <- call_frame.base -+                                    |        |
- * |       |                     |            +- call_frame.base ->   |--------|
+ * |-------| <- upvalue.m_value -+                                    |        |
+ * |       |                     |            +- upvalue.m_value ->   |--------|
  * |-------|                     |  dH1 = dH2 |                       |        |
  * |       |                     |            |                       |--------|
  * +-------+ <- old_stack.base  -+            |                       |        |
  *                                            +- new_stack.base  ->   +--------+
  * OLD STACK                                                          NEW STACK
  *
- * Similarly, we also update the pointers in the upvalue chain of the VM.
+ * Call frames don't need this, since they store their base as an index into the stack.
  *
  */
 void VM::ensure_slots(uint num_requested_slots) {
@@ -1337,12 +2736,9 @@ void VM::ensure_slots(uint num_requested_slots) {
 	m_stack.size = new_stack_size;
 	m_stack.values = static_cast<Value*>(realloc(m_stack.values, m_stack.size * sizeof(Value)));
 
-	// Now that the stack has moved in memory, the CallFrames and the Upvalue chain still contain
-	// dangling pointers to the old stack, so we update those to the same relative distance from the
-	// new stack's base address.
-	for (CallFrame* cf = m_current_frame; cf; cf = cf->prev) {
-		cf->base = m_stack.values + (cf->base - old_stack_base);
-	}
+	// Now that the stack has moved in memory, the Upvalue chain still contains dangling pointers to
+	// the old stack, so we update those to the same relative distance from the new stack's base
+	// address. CallFrames store their base as an index into the stack, and need no updating.
 
 	for (Upvalue* upval = m_open_upvals; upval != nullptr; upval = upval->next_upval) {
 		upval->m_value = (upval->m_value - old_stack_base) + m_stack.values;
@@ -1369,19 +2765,31 @@ ExitCode VM::binop_error(const char* opstr, const Value& a, const Value& b) {
 				 value_type_name(b));
 }
 
+/// @return The line of the register instruction that ran last in a frame running [block], whose
+/// instruction pointer is at [ip].
+static u32 register_line(const Block& block, size_t ip) {
+	return block.lines[block.reg_origins[ip == 0 ? 0 : ip - 1]];
+}
+
 ExitCode VM::runtime_error(const std::string& message) {
 	// avoid cascading errors if one error has already been reported
 	if (m_has_error) return ExitCode::RuntimeError;
 
 	m_has_error = true;
-	std::string error_str = (m_current_frame->is_cclosure())
-								? kt::format_str("[internal] {}\nstack trace:\n", message)
-								: kt::format_str("{}:{}: {}\nstack trace:\n", get_current_file(),
-												 CURRENT_LINE(), message);
+	std::string error_str;
+	if (m_current_frame->is_cclosure()) {
+		error_str = kt::format_str("[internal] {}\nstack trace:\n", message);
+	} else {
+		const u32 line = m_current_block->has_register_code()
+							 ? register_line(*m_current_block, ip)
+							 : CURRENT_LINE();
+		error_str = kt::format_str("{}:{}: {}\nstack trace:\n", get_current_file(), line, message);
+	}
 
 	std::optional<RuntimeError::DebugInfo> location = std::nullopt;
 	size_t trace_depth = 0;
-	for (CallFrame* frame = m_current_frame; frame; frame = frame->prev) {
+	for (size_t i = m_current_frame - base_frame + 1; i-- > 0;) {
+		const CallFrame* const frame = &m_frames[i];
 		++trace_depth;
 		if (trace_depth >= MaxStackTraceDepth) {
 			continue;
@@ -1393,15 +2801,21 @@ ExitCode VM::runtime_error(const std::string& message) {
 
 		const Block& block = func.m_codeblock->block();
 		VYSE_ASSERT(frame->ip < block.lines.size(),
-					"IP not in range for std::vector<u32> block.lines.");
+					"IP not in range for block.lines.");
 
-		const u32 line = block.lines[frame->ip];
+		const u32 line =
+			block.has_register_code() ? register_line(block, frame->ip) : block.lines[frame->ip];
 		if (frame == base_frame) {
 			error_str += kt::format_str("\t[line {}] in {}", line, func.name_cstr());
 		} else {
 			error_str += kt::format_str("\t[line {}] in function {}.\n", line, func.name_cstr());
 		}
 
+		// The functions that made tail calls leading to this one left no frames behind.
+		if (frame->num_elided > 0) {
+			error_str += kt::format_str("\t[{} frames elided by tail calls]\n", frame->num_elided);
+		}
+
 		if (frame == base_frame) {
 			location = {line, func.name_cstr()};
 		}
@@ -1411,7 +2825,10 @@ ExitCode VM::runtime_error(const std::string& message) {
 		const size_t diff = trace_depth - MaxStackTraceDepth;
 		error_str += "\t.\n\t.\n\t.\n\t" + std::to_string(diff) + " not shown.\n";
 		Closure* const scriptfn = static_cast<Closure*>(base_frame->func);
-		const int line = scriptfn->m_codeblock->block().lines[base_frame->ip];
+		const Block& script_block = scriptfn->m_codeblock->block();
+		const int line = script_block.has_register_code()
+							 ? register_line(script_block, base_frame->ip)
+							 : script_block.lines[base_frame->ip];
 		error_str += kt::format_str("\t[line {}] in function {}.\n", line, scriptfn->name_cstr());
 	}
 
@@ -1448,18 +2865,20 @@ char* default_readline(const VM&) {
 /// TODO: The user might need some objects even after the VM has been destructed. Add support for
 /// this.
 VM::~VM() {
+#ifdef VYSE_PROFILE_OPCODES
+	if (const char* const profile_path = std::getenv("VYSE_OPCODE_PROFILE")) {
+		if (!m_op_profile.dump(profile_path)) {
+			std::fprintf(stderr, "Could not write opcode profile to '%s'.\n", profile_path);
+		}
+	}
+#endif
+
 	if (m_gc.m_objects == nullptr) return;
 	for (Obj* object = m_gc.m_objects; object != nullptr;) {
 		Obj* const next = object->next;
 		delete object;
 		object = next;
 	}
-
-	for (CallFrame* cf = base_frame; cf != nullptr;) {
-		CallFrame* const next = cf->next;
-		delete cf;
-		cf = next;
-	}
 }
 
 } // namespace vy
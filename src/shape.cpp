@@ -0,0 +1,32 @@
+#include <gc.hpp>
+#include <shape.hpp>
+#include <string.hpp>
+
+namespace vy {
+
+Shape::Shape(Shape& parent, String* key) : m_root{parent.m_root}, m_keys{parent.m_keys} {
+	m_keys.push_back(key);
+	++m_root->m_num_shapes;
+}
+
+Shape* Shape::with_key(String* key) {
+	VYSE_ASSERT(find(key) == NotFound, "Key already exists in shape.");
+
+	for (const std::unique_ptr<Shape>& child : m_children) {
+		if (child->m_keys.back() == key) return child.get();
+	}
+
+	if (num_keys() >= MaxKeys or m_root->m_num_shapes >= MaxShapes) return nullptr;
+	m_children.push_back(std::unique_ptr<Shape>(new Shape(*this, key)));
+	return m_children.back().get();
+}
+
+void Shape::trace_keys(GC& gc) const {
+	// Every key of a shape is also a key of one of it's ancestors, except for the last one.
+	if (!m_keys.empty()) gc.mark_object(m_keys.back());
+	for (const std::unique_ptr<Shape>& child : m_children) {
+		child->trace_keys(gc);
+	}
+}
+
+} // namespace vy
@@ -1,5 +1,6 @@
 #include "../str_format.hpp"
 #include <list.hpp>
+#include <prepared_call.hpp>
 #include <stdlib/vy_list.hpp>
 #include <util/args.hpp>
 #include <util/lib_util.hpp>
@@ -18,15 +19,12 @@ Value foreach (VM& vm, int argc) {
 	List& list = args.next<List>();
 	Value vfunc = args.next_arg();
 
+	PreparedCall call(vm, vfunc, 2);
 	uint list_len = list.length();
 	for (uint i = 0; i < list_len; ++i) {
-		vm.m_stack.push(vfunc);
-		vm.m_stack.push(list[i]);
-		vm.m_stack.push(VYSE_NUM(i));
-		bool ok = vm.call(2);
-		if (!ok) return VYSE_NIL;
-		// the result of the function call is now on the stack, so we pop it off.
-		vm.m_stack.pop();
+		call.arg(0) = list[i];
+		call.arg(1) = VYSE_NUM(i);
+		if (!call.invoke()) return VYSE_NIL;
 	}
 
 	return VYSE_NIL;
@@ -90,16 +88,12 @@ Value map(VM& vm, int argc) {
 	List& ret = vm.make<List>();
 	GCLock _ = vm.gc_lock(&ret);
 
+	PreparedCall call(vm, vfunc, 2);
 	for (uint i = 0; i < list.length(); ++i) {
-		vm.m_stack.push(vfunc);
-		vm.m_stack.push(list[i]);
-		vm.m_stack.push(VYSE_NUM(i));
-		bool ok = vm.call(2);
-		if (!ok) {
-			vm.gc_unprotect(&ret);
-			return VYSE_NIL;
-		}
-		ret.append(vm.m_stack.pop());
+		call.arg(0) = list[i];
+		call.arg(1) = VYSE_NUM(i);
+		if (!call.invoke()) return VYSE_NIL;
+		ret.append(call.result());
 	}
 
 	return VYSE_OBJECT(&ret);
@@ -137,13 +131,13 @@ Value reduce(VM& vm, int argc) {
 		start_index = 1;
 	}
 
+	PreparedCall call(vm, vfunc, 3);
 	for (uint i = start_index; i < list.length(); ++i) {
-		vm.m_stack.push(vfunc);
-		vm.m_stack.push(init);
-		vm.m_stack.push(list[i]);
-		vm.m_stack.push(VYSE_NUM(i));
-		if (!vm.call(3)) return VYSE_NIL;
-		init = vm.m_stack.pop();
+		call.arg(0) = init;
+		call.arg(1) = list[i];
+		call.arg(2) = VYSE_NUM(i);
+		if (!call.invoke()) return VYSE_NIL;
+		init = call.result();
 	}
 
 	return init;
@@ -162,16 +156,15 @@ Value filter(VM& vm, int argc) {
 	List& ret = vm.make<List>();
 	vm.gc_protect(&ret);
 
+	PreparedCall call(vm, vfunc, 2);
 	for (uint i = 0; i < list.length(); ++i) {
-		vm.m_stack.push(vfunc);
-		vm.m_stack.push(list[i]);
-		vm.m_stack.push(VYSE_NUM(i));
-		if (!vm.call(2)) {
+		call.arg(0) = list[i];
+		call.arg(1) = VYSE_NUM(i);
+		if (!call.invoke()) {
 			vm.gc_unprotect(&ret);
 			return VYSE_NIL;
 		}
-		Value res = vm.m_stack.pop();
-		if (is_val_truthy(res)) {
+		if (is_val_truthy(call.result())) {
 			ret.append(list[i]);
 		}
 	}
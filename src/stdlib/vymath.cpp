@@ -1,5 +1,6 @@
 #include <cmath>
 #include <limits>
+#include <optional>
 #include <random>
 #include <type_traits>
 #include <util/auxlib.hpp>
@@ -20,9 +21,8 @@ static constexpr integer vy_max_int = std::numeric_limits<integer>::max();
 static constexpr integer vy_min_int = std::numeric_limits<integer>::min();
 static constexpr number vy_inf = std::numeric_limits<number>::infinity();
 
-Value sqrt(VM& vm, int argc) {
-	Args args(vm, "math.sqrt", 1, argc);
-	return VYSE_NUM(std::sqrt(args.next_number()));
+number sqrt(number x) {
+	return std::sqrt(x);
 }
 
 template <typename T>
@@ -39,7 +39,7 @@ T vy_random(T lo = 0, T hi = 1) {
 }
 
 Value random(VM& vm, int argc) {
-	static constexpr const char* fname = "math.random";
+	static constexpr const char* fname = "random";
 
 	if (argc != 0 and argc != 2) {
 		cfn_error(vm, fname, "Expected 0 or 2 arguments.");
@@ -60,46 +60,36 @@ Value random(VM& vm, int argc) {
 	return VYSE_NUM(vy_random<number>(low, high));
 }
 
-Value randint(VM& vm, int argc) {
-	Args args(vm, "math.randint", 2, argc);
-
-	number low = args.next_number();
-	number high = args.next_number();
-	return VYSE_NUM(vy_random<int64_t>(low, high + 1));
+number randint(number low, number high) {
+	return vy_random<int64_t>(low, high + 1);
 }
 
-Value sin(VM& vm, int argc) {
-	Args args(vm, "math.sin", 1, argc);
-	return VYSE_NUM(std::sin(args.next_number()));
+number sin(number x) {
+	return std::sin(x);
 }
 
-Value cos(VM& vm, int argc) {
-	Args args(vm, "math.cos", 1, argc);
-	return VYSE_NUM(std::cos(args.next_number()));
+number cos(number x) {
+	return std::cos(x);
 }
 
-Value tan(VM& vm, int argc) {
-	Args args(vm, "math.tan", 1, argc);
-	return VYSE_NUM(std::tan(args.next_number()));
+number tan(number x) {
+	return std::tan(x);
 }
 
-Value asin(VM& vm, int argc) {
-	Args args(vm, "math.asin", 1, argc);
-	return VYSE_NUM(std::asin(args.next_number()));
+number asin(number x) {
+	return std::asin(x);
 }
 
-Value acos(VM& vm, int argc) {
-	Args args(vm, "math.acos", 1, argc);
-	return VYSE_NUM(std::acos(args.next_number()));
+number acos(number x) {
+	return std::acos(x);
 }
 
-Value atan(VM& vm, int argc) {
-	Args args(vm, "math.atan", 1, argc);
-	return VYSE_NUM(std::atan(args.next_number()));
+number atan(number x) {
+	return std::atan(x);
 }
 
 Value max(VM& vm, int argc) {
-	Args args(vm, "math.max", argc, argc);
+	Args args(vm, "max", argc, argc);
 	args.check(argc >= 1, "Expected 1 or more arguments");
 
 	number max = args.next_number();
@@ -111,7 +101,7 @@ Value max(VM& vm, int argc) {
 }
 
 Value min(VM& vm, int argc) {
-	Args args(vm, "math.min", 1, argc); // We assume there is at-least 1 argument
+	Args args(vm, "min", 1, argc); // We assume there is at-least 1 argument
 	args.check(argc >= 1, "Expected 1 or more arguments");
 
 	number min = args.next_number();
@@ -122,60 +112,48 @@ Value min(VM& vm, int argc) {
 	return VYSE_NUM(min);
 }
 
-Value isnan(VM& vm, int argc) {
-	Args args(vm, "math.isnan", 1, argc);
-	return VYSE_BOOL(std::isnan(args.next_number()));
+bool isnan(number x) {
+	return std::isnan(x);
 }
 
-Value isinf(VM& vm, int argc) {
-	Args args(vm, "math.isinf", 1, argc);
-	return VYSE_BOOL(std::isinf(args.next_number()));
+bool isinf(number x) {
+	return std::isinf(x);
 }
 
-Value log(VM& vm, int argc) {
-	Args args(vm, "math.log", 1, argc); // need at least 1 arg
-
-	const number x = args.next_number();
-	if (argc == 2) {
-		const number base = args.next_number();
-		if (base == 10.0) return VYSE_NUM(std::log10(x));
-		if (base == 2.0) return VYSE_NUM(std::log2(x));
-		return VYSE_NUM(std::log(x) / std::log(base));
+number log(number x, std::optional<number> base) {
+	if (base) {
+		if (*base == 10.0) return std::log10(x);
+		if (*base == 2.0) return std::log2(x);
+		return std::log(x) / std::log(*base);
 	}
 
-	return VYSE_NUM(std::log(x));
+	return std::log(x);
 }
 
-Value log10(VM& vm, int argc) {
-	Args args(vm, "math.log10", 1, argc);
-	return VYSE_NUM(std::log10(args.next_number()));
+number log10(number x) {
+	return std::log10(x);
 }
 
-Value exp(VM& vm, int argc) {
-	Args args(vm, "math.exp", 1, argc);
-	return VYSE_NUM(expf(args.next_number()));
+number exp(number x) {
+	return expf(x);
 }
 
-Value todeg(VM& vm, int argc) {
+number todeg(number x) {
 	static constexpr number factor = 180.0 / pi;
-	Args args(vm, "math.todeg", 1, argc);
-	return VYSE_NUM(args.next_number() * factor);
+	return x * factor;
 }
 
-Value torad(VM& vm, int argc) {
+number torad(number x) {
 	static constexpr number factor = pi / 180.0;
-	Args args(vm, "math.torad", 1, argc);
-	return VYSE_NUM(args.next_number() * factor);
+	return x * factor;
 }
 
-Value atan2(VM& vm, int argc) {
-	Args args(vm, "math.atan2", 2, argc);
-	return VYSE_NUM(std::atan2(args.next_number(), args.next_number()));
+number atan2(number y, number x) {
+	return std::atan2(y, x);
 }
 
-Value tan2(VM& vm, int argc) {
-	Args args(vm, "math.tan2", 2, argc);
-	return VYSE_NUM(std::tan(args.next_number()) * std::tan(args.next_number()));
+number tan2(number x, number y) {
+	return std::tan(x) * std::tan(y);
 }
 
 s64 powmod(s64 x, s64 y, s64 mod) {
@@ -190,19 +168,17 @@ s64 powmod(s64 x, s64 y, s64 mod) {
 	return result;
 }
 
-Value pow(VM& vm, int argc) {
-	Args args(vm, "math.pow", 2, argc);
-	const number base = args.next_number();
-	const number power = args.next_number();
-	if (args.has_next()) {
-		const number mod = args.next_number();
-		args.check(is_integer(power) && is_integer(mod) && is_integer(base),
-				   "Expected integer base, power and modulus");
-		args.check(mod >= 0, "3rd argument (modulus) must be positive.");
-		return VYSE_NUM(powmod(base, power, mod));
+number pow(number base, number power, std::optional<number> mod) {
+	if (mod) {
+		if (!is_integer(power) or !is_integer(*mod) or !is_integer(base)) {
+			throw BindError("Expected integer base, power and modulus");
+		}
+		if (*mod < 0) throw BindError("3rd argument (modulus) must be positive.");
+
+		return powmod(base, power, *mod);
 	}
 
-	return VYSE_NUM(std::pow(base, power));
+	return std::pow(base, power);
 }
 
 // fast combination algorithm
@@ -218,38 +194,39 @@ int64_t vy_comb(int64_t n, int64_t k) {
 	return result;
 }
 
-Value comb(VM& vm, int argc) {
-	Args args(vm, "math.comb", 2, argc);
-	const number n = args.next_number();
-	const number k = args.next_number();
-	args.check(is_integer(n) && is_integer(k), "Expected integer arguments");
-	return VYSE_NUM(vy_comb(static_cast<int64_t>(n), static_cast<int64_t>(k)));
+number comb(number n, number k) {
+	if (!is_integer(n) or !is_integer(k)) throw BindError("Expected integer arguments");
+	return vy_comb(static_cast<int64_t>(n), static_cast<int64_t>(k));
 }
 
-Value floor(VM& vm, int argc) {
-	Args args(vm, "math.floor", 1, argc);
-	return VYSE_NUM(std::floor(args.next_number()));
+number floor(number x) {
+	return std::floor(x);
 }
 
-Value ceil(VM& vm, int argc) {
-	Args args(vm, "math.ceil", 1, argc);
-	return VYSE_NUM(std::ceil(args.next_number()));
+number ceil(number x) {
+	return std::ceil(x);
 }
 
-Value gcd(VM& vm, int argc) {
-	Args args(vm, "math.gcd", 2, argc);
-	const number l = args.next_number();
-	const number r = args.next_number();
-	return VYSE_NUM(std::gcd(s64(l), s64(r)));
+number gcd(number l, number r) {
+	return std::gcd(s64(l), s64(r));
 }
 
+// The functions that take a fixed list of arguments are exposed with `vy::bind`.
 static constexpr std::pair<const char*, NativeFn> funcs[] = {
-	{"sqrt", sqrt}, {"random", random}, {"randint", randint}, {"sin", sin},		{"cos", cos},
-	{"tan", tan},	{"asin", asin},		{"acos", acos},		  {"atan", atan},	{"math", atan},
-	{"atan", atan}, {"max", max},		{"min", min},		  {"isnan", isnan}, {"isinf", isinf},
-	{"log", log},	{"log10", log10},	{"exp", exp},		  {"todeg", todeg}, {"torad", torad},
-	{"tan2", tan2}, {"atan2", atan2},	{"pow", pow},		  {"comb", comb},	{"floor", floor},
-	{"ceil", ceil}, {"gcd", gcd},
+	{"random", random},
+	{"max", max},
+	{"min", min},
+};
+
+static constexpr std::pair<const char*, NativeBinding> bound_funcs[] = {
+	{"sqrt", bind<&sqrt>()},   {"randint", bind<&randint>()}, {"sin", bind<&sin>()},
+	{"cos", bind<&cos>()},	   {"tan", bind<&tan>()},		  {"asin", bind<&asin>()},
+	{"acos", bind<&acos>()},   {"atan", bind<&atan>()},		  {"math", bind<&atan>()},
+	{"isnan", bind<&isnan>()}, {"isinf", bind<&isinf>()},	  {"log", bind<&log>()},
+	{"log10", bind<&log10>()}, {"exp", bind<&exp>()},		  {"todeg", bind<&todeg>()},
+	{"torad", bind<&torad>()}, {"tan2", bind<&tan2>()},		  {"atan2", bind<&atan2>()},
+	{"pow", bind<&pow>()},	   {"comb", bind<&comb>()},		  {"floor", bind<&floor>()},
+	{"ceil", bind<&ceil>()},   {"gcd", bind<&gcd>()},
 };
 
 VYSE_API void load_math(VM* vm, Table* module) {
@@ -257,6 +234,7 @@ VYSE_API void load_math(VM* vm, Table* module) {
 	NativeModule math(vm, module);
 
 	math.add_cclosures(funcs, array_size(funcs));
+	math.add_cclosures(bound_funcs, array_size(bound_funcs));
 
 	math.add_field("pi", VYSE_NUM(pi));
 	math.add_field("nan", VYSE_NUM(vy_nan));
@@ -21,4 +21,59 @@ size_t Block::add_value(Value value) {
 	return constant_pool.size() - 1;
 }
 
+size_t Block::add_global(String* name, u32 slot) {
+	for (size_t i = 0; i < globals.size(); ++i) {
+		if (globals[i].slot == slot) return i;
+	}
+	globals.push_back({name, slot});
+	return globals.size() - 1;
+}
+
+u8 Block::add_inline_cache() {
+	if (inline_caches.size() < MaxInlineCaches) inline_caches.emplace_back();
+	return inline_caches.size() - 1;
+}
+
+const TypeFeedback* Block::feedback_at(size_t offset) const noexcept {
+	if (offset >= type_feedback.size() or type_feedback[offset].seen == 0) return nullptr;
+	return &type_feedback[offset];
+}
+
+bool Block::observe(size_t offset, u8 types) const {
+	if (type_feedback.size() != code.size()) type_feedback.resize(code.size());
+	TypeFeedback& feedback = type_feedback[offset];
+	feedback.seen |= types;
+	if (feedback.last != types) {
+		feedback.last = types;
+		feedback.streak = 0;
+	}
+
+	if (feedback.streak < UINT8_MAX) ++feedback.streak;
+	return feedback.streak >= QuickenThreshold and feedback.dequickens < MaxDequickens;
+}
+
+void Block::quicken(size_t offset, Opcode op) const {
+	code[offset] = op;
+	TypeFeedback& feedback = type_feedback[offset];
+	if (feedback.quickens < UINT8_MAX) ++feedback.quickens;
+}
+
+void Block::dequicken(size_t offset, Opcode op, u8 types) const {
+	code[offset] = op;
+	TypeFeedback& feedback = type_feedback[offset];
+	feedback.seen |= types;
+	feedback.last = types;
+	feedback.streak = 0;
+	if (feedback.dequickens < UINT8_MAX) ++feedback.dequickens;
+}
+
+InlineCacheStats Block::ic_stats() const noexcept {
+	InlineCacheStats stats;
+	for (const InlineCache& cache : inline_caches) {
+		stats.hits += cache.hits;
+		stats.misses += cache.misses;
+	}
+	return stats;
+}
+
 } // namespace vy
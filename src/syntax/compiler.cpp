@@ -2,6 +2,8 @@
 #include "common.hpp"
 #include "debug.hpp"
 #include "source.hpp"
+#include <algorithm>
+#include <array>
 #include <compiler.hpp>
 #include <cstring>
 #include <string>
@@ -29,6 +31,7 @@ using TT = TokenType;
 Compiler::Compiler(VM* vm, const SourceCode& src) : m_vm{vm}, m_source{&src} {
 	m_scanner = new Scanner{src.code};
 	advance(); // set `peek` to the first token in the token stream.
+	find_reassigned_names();
 
 	const char* base_f_name = src.path.empty() ? "<script>" : src.path.data();
 	String* fname = &vm->make_string(base_f_name, strlen(base_f_name));
@@ -68,6 +71,8 @@ CodeBlock* Compiler::compile() {
 	}
 
 	emit(Op::load_nil, Op::return_val);
+	if (m_vm->config().tier == Tier::Register and !has_error) emit_register_code();
+	emit_superinstructions();
 	m_codeblock->m_num_upvals = m_symtable.m_num_upvals;
 	return m_codeblock;
 }
@@ -78,11 +83,10 @@ CodeBlock* Compiler::compile_func(bool is_arrowfn) {
 	if (is_arrowfn) {
 		if (check(TT::LCurlBrace)) {
 			block_stmt();
-			emit(Op::load_nil);
+			emit(Op::load_nil, Op::return_val);
 		} else {
-			expr();
+			return_expr();
 		}
-		emit(Op::return_val);
 	} else {
 		test(TT::LCurlBrace, "Expected '{' before function body.");
 		block_stmt();
@@ -91,6 +95,9 @@ CodeBlock* Compiler::compile_func(bool is_arrowfn) {
 		emit(Op::load_nil, Op::return_val);
 	}
 
+	if (m_codeblock->is_vararg()) keep_varargs_on_stack();
+	if (m_vm->config().tier == Tier::Register and !has_error) emit_register_code();
+	emit_superinstructions();
 	m_codeblock->m_num_upvals = m_symtable.m_num_upvals;
 	m_vm->m_compiler = m_parent;
 	return m_codeblock;
@@ -157,7 +164,9 @@ void Compiler::block_stmt() {
 
 void Compiler::if_stmt() {
 	advance(); // consume 'if'
-	expr();	   // parse condition.
+	const size_t cond_start = THIS_BLOCK.op_count();
+	expr(); // parse condition.
+	fuse_condition(cond_start);
 
 	// If the condition is false, we simply pop it and jump to the end of the if statement.
 	// This puts as after the closing '}', which might be an 'else' block sometimes.
@@ -275,6 +284,7 @@ void Compiler::while_stmt() {
 	enter_loop(loop);
 
 	expr(); // parse condition.
+	fuse_condition(loop.start);
 	const u32 jmp = emit_jump(Opcode::pop_jmp_if_false);
 	toplevel();
 	exit_loop(Op::jmp_back);
@@ -306,7 +316,7 @@ void Compiler::for_stmt() {
 	if (match(TT::Comma)) {
 		expr();
 	} else {
-		const int idx = emit_value(VYSE_NUM(1));
+		const int idx = emit_value(VYSE_INT(1));
 		emit_with_arg(Op::load_const, idx);
 	}
 
@@ -390,8 +400,8 @@ void Compiler::func_expr(String* fname, bool is_method, bool is_arrow) {
 		compiler.expect(TT::Arrow, "Expected '->' before lambda body.");
 	}
 
+	compiler.m_codeblock->m_is_variadic = is_vararg;
 	CodeBlock* const code = compiler.compile_func(is_arrow);
-	code->m_is_variadic = is_vararg;
 	if (compiler.has_error) has_error = true;
 	const u8 idx = emit_value(VYSE_OBJECT(code));
 
@@ -402,11 +412,10 @@ void Compiler::func_expr(String* fname, bool is_method, bool is_arrow) {
 	for (int i = 0; i < compiler.m_symtable.m_num_upvals; ++i) {
 		const UpvalDesc& upval = compiler.m_symtable.m_upvals[i];
 
-		// An operand of '1' means that the upvalue exists in the call
-		// frame of the currently executing function while this closure is
-		// being created. '0' means the upvalue exists in the current
-		// function's upvalue list.
-		emit_arg(upval.is_local ? 1 : 0);
+		// `CaptureLocal` means that the upvalue exists in the call frame of the currently executing
+		// function while this closure is being created. Otherwise it exists in the current
+		// function's captures. `CaptureByValue` copies the value instead of boxing it.
+		emit_arg((upval.is_local ? CaptureLocal : 0) | (upval.by_value ? CaptureByValue : 0));
 		emit_arg(upval.index);
 	}
 
@@ -429,9 +438,22 @@ void Compiler::ret_stmt() {
 	// where a `nil` after the return is implicit.
 	if (peek.is_literal() or check(TT::Id) or peek.is_unary_op() or check(TT::LParen) or
 		check(TT::Fn) or check(TT::LCurlBrace) or check(TT::LSqBrace)) {
-		expr();
+		return_expr();
 	} else {
-		emit(Op::load_nil);
+		emit(Op::load_nil, Op::return_val);
+	}
+}
+
+void Compiler::return_expr() {
+	const bool in_return_expr = m_in_return_expr;
+	m_in_return_expr = true;
+	expr();
+	m_in_return_expr = in_return_expr;
+	// If the expression ends with a call in a function, then that call is a tail call. The
+	// `return_val` is still needed by jumps that skip the call, like the one in `return x or f()`.
+	Block& block = THIS_BLOCK;
+	if (m_parent != nullptr and m_last_call != SIZE_MAX and m_last_call + 2 == block.op_count()) {
+		block.code[m_last_call] = Op::tail_call;
 	}
 	emit(Op::return_val);
 }
@@ -534,11 +556,11 @@ void Compiler::complete_expr_stmt(ExpKind prefix_type) {
 
 			if (is_assign_tok(peek.type)) {
 				table_assign(Op::table_get_no_pop, index);
-				emit_with_arg(Op::table_set, index);
+				emit_cached(Op::table_set, index);
 				return;
 			} else {
 				exp_kind = ExpKind::prefix;
-				emit_with_arg(Op::table_get, index);
+				emit_cached(Op::table_get, index);
 			}
 			break;
 		}
@@ -546,9 +568,7 @@ void Compiler::complete_expr_stmt(ExpKind prefix_type) {
 		case TT::Colon: {
 			advance();
 			expect(TT::Id, "Expected method name.");
-			const u8 index = emit_id_string(token);
-			emit_with_arg(Op::prep_method_call, index);
-			compile_args(true);
+			method_call(emit_id_string(token));
 			exp_kind = ExpKind::call;
 			break;
 		}
@@ -689,15 +709,13 @@ void Compiler::suffix_expr() {
 			advance();
 			expect(TT::Id, "Expected field name.");
 			const u8 index = emit_id_string(token);
-			emit_with_arg(Op::table_get, index);
+			emit_cached(Op::table_get, index);
 			break;
 		}
 		case TT::Colon: {
 			advance();
 			expect(TT::Id, "Expected method name.");
-			u8 index = emit_id_string(token);
-			emit_with_arg(Op::prep_method_call, index);
-			compile_args(true);
+			method_call(emit_id_string(token));
 			break;
 		}
 		default: return;
@@ -723,8 +741,11 @@ void Compiler::table_assign(Op get_op, int idx) {
 	/// get the original field value, push it on top of the stack, modify this value then use a
 	/// 'set' opcode to store it back into the table/array. The 'set' opcode is emitted by the
 	/// caller.
-	emit(get_op);
-	if (idx > 0) emit_arg(idx);
+	if (idx >= 0) {
+		emit_cached(get_op, idx);
+	} else {
+		emit(get_op);
+	}
 	expr();
 	emit(toktype_to_op(ttype));
 }
@@ -744,9 +765,59 @@ void Compiler::compile_args(bool is_method) {
 	}
 
 	expect(TT::RParen, "Expected ')' after call.");
+	m_last_call = THIS_BLOCK.op_count();
 	emit_with_arg(Op::call_func, argc);
 }
 
+/// @return true if running [op] can never call a function or change an existing table.
+static bool is_pure_load(Op op) {
+	switch (op) {
+	case Op::load_const:
+	case Op::load_nil:
+	case Op::get_var:
+	case Op::get_upval:
+	case Op::get_capture:
+	case Op::get_global:
+	case Op::make_func:
+	case Op::new_table:
+	case Op::new_list:
+	case Op::table_add_field:
+	case Op::list_append: return true;
+	default: return false;
+	}
+}
+
+void Compiler::method_call(u8 name_index) {
+	Block& block = THIS_BLOCK;
+	const size_t prep = block.op_count();
+	emit_cached(Op::prep_method_call, name_index);
+	compile_args(true);
+	if (m_in_return_expr) return;
+
+	// The method can be looked up after the arguments are evaluated, instead of before, when
+	// evaluating them has no side effects. Then the `prep_method_call` and `call_func` are replaced
+	// with an `invoke`. Jumps in the arguments are relative, and still land where they did.
+	const size_t call = block.op_count() - 2;
+	for (size_t i = prep + 3; i < call; i += 1 + op_arity(i)) {
+		if (!is_pure_load(block.code[i])) return;
+	}
+
+	const u8 cache = u8(block.code[prep + 2]);
+	const u8 argc = u8(block.code[call + 1]);
+	const u32 line = block.lines[prep];
+	block.code.resize(call);
+	block.lines.resize(call);
+	block.code.erase(block.code.begin() + prep, block.code.begin() + prep + 3);
+	block.lines.erase(block.lines.begin() + prep, block.lines.begin() + prep + 3);
+	m_last_call = SIZE_MAX;
+
+	emit_with_arg(Op::invoke, name_index);
+	emit_arg(cache);
+	emit_arg(argc);
+	// Errors in the lookup are reported on the line of the method's name.
+	std::fill(block.lines.end() - 4, block.lines.end(), line);
+}
+
 void Compiler::grouping() {
 	if (match(TT::LParen)) {
 		expr();
@@ -848,11 +919,15 @@ void Compiler::variable(bool can_assign) {
 		if (index == -1) {
 			get_op = Opcode::get_global;
 			set_op = Opcode::set_global;
-			index = emit_id_string(token);
+			index = emit_global(token);
 		} else {
-			get_op = Opcode::get_upval;
+			const UpvalDesc& upval = m_symtable.m_upvals[index];
+			// A variable captured by value is never assigned to, unless it's a const.
+			get_op = upval.by_value ? Opcode::get_capture : Opcode::get_upval;
 			set_op = Opcode::set_upval;
-			is_const = m_symtable.m_upvals[index].is_const;
+			is_const = upval.is_const;
+			VYSE_ASSERT(!can_assign or !upval.by_value or is_const,
+						"Assignment to a copied upvalue.");
 		}
 	}
 
@@ -867,7 +942,9 @@ void Compiler::variable(bool can_assign) {
 		/// Compile the RHS of the assignment, and any necessary arithmetic ops if its a compound
 		/// assignment operator. So by the time we are setting the value, the RHS is sitting ready
 		/// on top of the stack.
+		const size_t rhs_start = THIS_BLOCK.op_count();
 		var_assign(get_op, index);
+		if (set_op == Op::set_var) fuse_increment(rhs_start, index);
 		emit_with_arg(set_op, index);
 	} else {
 		emit_with_arg(get_op, index);
@@ -892,7 +969,13 @@ void Compiler::literal() {
 	advance();
 	u32 index = 0;
 	switch (token.type) {
-	case TT::Integer:
+	case TT::Integer: {
+		// Integer literals that fit in 32 bits are stored as integers to take the VM's integer fast
+		// paths, everything else is a double.
+		const number num = std::stod(token.raw(m_source->code));
+		index = emit_value(is_integer(num) and fits_int(s64(num)) ? VYSE_INT(num) : VYSE_NUM(num));
+		break;
+	}
 	case TT::Float: index = emit_value(TOK2NUM(token)); break;
 	case TT::String: index = emit_string(token); break;
 	case TT::True: index = emit_value(VYSE_BOOL(true)); break;
@@ -921,6 +1004,898 @@ void Compiler::goto_eof() {
 	}
 }
 
+/// @return The fused compare-and-branch instruction for the comparison [op] of a local with another
+/// local, or with a constant if [with_const] is set. `Op::no_op` if [op] is not a comparison.
+static Op fused_comparison(Op op, bool with_const) {
+	Op fused;
+	switch (op) {
+	case Op::eq: fused = Op::eq_var_var_jmp; break;
+	case Op::neq: fused = Op::neq_var_var_jmp; break;
+	case Op::gt: fused = Op::gt_var_var_jmp; break;
+	case Op::lt: fused = Op::lt_var_var_jmp; break;
+	case Op::gte: fused = Op::gte_var_var_jmp; break;
+	case Op::lte: fused = Op::lte_var_var_jmp; break;
+	default: return Op::no_op;
+	}
+
+	// The *_var_const instructions are in the same order as the *_var_var ones.
+	constexpr u8 const_offset = u8(Op::eq_var_const_jmp) - u8(Op::eq_var_var_jmp);
+	return with_const ? Op(u8(fused) + const_offset) : fused;
+}
+
+// Both fusions look for 3 instructions of exactly 2, 2 and 1 bytes. Since [start] is always the
+// start of an instruction, and none of these are jumps, no jump can land in the middle of the
+// sequence being replaced.
+
+void Compiler::fuse_condition(size_t start) {
+	Block& block = THIS_BLOCK;
+	// get_var a; (get_var b | load_const b); <cmp>  ->  <cmp>_var_(var|const)_jmp a b
+	if (block.op_count() != start + 5 or block.code[start] != Op::get_var) return;
+
+	const Op rhs = block.code[start + 2];
+	if (rhs != Op::get_var and rhs != Op::load_const) return;
+
+	const Op fused = fused_comparison(block.code[start + 4], rhs == Op::load_const);
+	if (fused == Op::no_op) return;
+
+	block.code[start] = fused;
+	block.code[start + 2] = block.code[start + 3];
+	block.code.resize(start + 3);
+	block.lines.resize(start + 3);
+}
+
+void Compiler::fuse_increment(size_t start, u8 slot) {
+	Block& block = THIS_BLOCK;
+	// get_var slot; load_const k; add  ->  add_var_const slot k
+	if (block.op_count() != start + 5 or block.code[start] != Op::get_var or
+		u8(block.code[start + 1]) != slot or block.code[start + 2] != Op::load_const or
+		block.code[start + 4] != Op::add) {
+		return;
+	}
+
+	block.code[start] = Op::add_var_const;
+	block.code[start + 2] = block.code[start + 3];
+	block.code.resize(start + 3);
+	block.lines.resize(start + 3);
+}
+
+/// @return true if the instruction at [offset] in [block] reads or writes the local in [slot], or
+/// captures it in a closure.
+static bool uses_local(const Block& block, size_t offset, u8 slot) {
+	const Op op = block.code[offset];
+	switch (op) {
+	case Op::get_var:
+	case Op::set_var: return u8(block.code[offset + 1]) == slot;
+
+	case Op::make_func: {
+		const u8 num_upvals = u8(block.code[offset + 2]);
+		for (u8 i = 0; i < num_upvals; ++i) {
+			const bool is_local = u8(block.code[offset + 3 + 2 * i]) & CaptureLocal;
+			if (is_local and u8(block.code[offset + 4 + 2 * i]) == slot) return true;
+		}
+		return false;
+	}
+
+	default:
+		if (op < Op_fused_start or op > Op_fused_end) return false;
+		if (u8(block.code[offset + 1]) == slot) return true;
+		// The second operand of the *_var_var instructions is a local too.
+		return op < Op::eq_var_const_jmp and u8(block.code[offset + 2]) == slot;
+	}
+}
+
+void Compiler::keep_varargs_on_stack() {
+	Block& block = THIS_BLOCK;
+	// The rest parameter is the last one, and slot 0 holds the function itself.
+	const u8 rest = u8(m_codeblock->param_count());
+
+	// The `len` or `subscript_get` instructions that read the rest parameter.
+	std::vector<size_t> uses;
+	for (size_t i = 0; i < block.op_count(); i += 1 + op_arity(block, i)) {
+		if (!uses_local(block, i, rest)) continue;
+		if (block.code[i] != Op::get_var) return;
+
+		// get_var rest; len
+		const size_t next = i + 2;
+		if (block.code[next] == Op::len) {
+			uses.push_back(next);
+			continue;
+		}
+
+		// get_var rest; (get_var | load_const) index; subscript_get
+		const Op index = block.code[next];
+		if ((index == Op::get_var or index == Op::load_const) and next + 2 < block.op_count() and
+			block.code[next + 2] == Op::subscript_get) {
+			uses.push_back(next + 2);
+			continue;
+		}
+
+		return;
+	}
+
+	for (const size_t use : uses) {
+		block.code[use] = block.code[use] == Op::len ? Op::vararg_len : Op::vararg_get;
+	}
+	m_codeblock->m_keeps_varargs_on_stack = true;
+}
+
+#ifndef VYSE_PROFILE_OPCODES
+/// @return true if the instructions starting at [offset] in [block] are the ones in [super].
+static bool matches(const Block& block, size_t offset, const SuperInstruction& super) {
+	// The last entry of `superinstructions` is empty, and should not match anything.
+	if (super.length == 0) return false;
+
+	for (u8 i = 0; i < super.length; ++i) {
+		if (offset >= block.op_count() or block.code[offset] != super.ops[i]) return false;
+		offset += 1 + Compiler::op_arity(block, offset);
+	}
+	return true;
+}
+
+#endif
+
+void Compiler::emit_superinstructions() {
+#ifndef VYSE_PROFILE_OPCODES
+	// Superinstructions may overlap. If the last instruction of one has been made into the start
+	// of another superinstruction, the first one simply dispatches to it instead of jumping
+	// straight to the last instruction's handler.
+	Block& block = THIS_BLOCK;
+	for (size_t i = 0; i < block.op_count(); i += 1 + op_arity(i)) {
+		if (!is_straight_line(block.code[i])) continue;
+		for (const SuperInstruction& super : superinstructions) {
+			if (matches(block, i, super)) {
+				block.code[i] = super.op;
+				break;
+			}
+		}
+	}
+#endif
+}
+
+// -- Register tier --
+
+namespace {
+
+/// @brief Translates the stack code of a block into register code (see `RegInstr`).
+///
+/// The slot that holds the value at depth `n` of the stack is register `n`. The translator first
+/// finds the depth of the stack at every reachable instruction. It then walks the code keeping
+/// track of where the value of every slot on the stack is: either in it's own register, in some
+/// other register, or a constant. Loads of constants and locals are never emitted on their own.
+/// Instead the instruction that uses the value reads it from the local's register or the constant
+/// pool. A value is only written to it's own slot when something needs it there, like a call, a
+/// jump, or an instruction that overwrites the register it is being read from.
+class RegisterTranslator {
+  public:
+	RegisterTranslator(Block& block, u32 num_params) : m_block{block}, m_code{block.code} {
+		m_depths.resize(m_code.size(), -1);
+		m_is_label.resize(m_code.size(), false);
+		m_pc_of.resize(m_code.size(), 0);
+		// The stack starts out with the function, followed by it's parameters.
+		m_num_params = num_params;
+	}
+
+	/// @brief Fills in the block's register code.
+	/// @return false if the block uses something that the translator can't handle, in which case
+	/// the block is left untouched.
+	bool translate();
+
+  private:
+	/// Where the value of a stack slot is kept.
+	struct Slot {
+		enum class Kind : u8 { Reg, Const, Nil } kind = Kind::Reg;
+		/// The register or the index of the constant.
+		u8 index = 0;
+	};
+
+	/// Upper bound on how deep `make_writable` and `materialize` may recurse into each other.
+	/// Only a cycle of values stored in each other's registers goes this deep.
+	static constexpr int MaxBarrierDepth = 64;
+
+	Block& m_block;
+	const BlockBuffer<Op>& m_code;
+	u32 m_num_params;
+
+	/// The depth of the stack at every instruction, -1 for instructions that are never reached.
+	std::vector<int> m_depths;
+	/// Whether a jump lands on the instruction at the offset.
+	std::vector<bool> m_is_label;
+	/// The index of the register instruction that the stack instruction at the offset starts at.
+	std::vector<u32> m_pc_of;
+	/// Registers that belong to locals captured as upvalues by closures made in this block.
+	std::array<bool, UINT8_MAX + 1> m_captured{};
+
+	std::vector<Slot> m_stack;
+	std::vector<RegInstr> m_out;
+	std::vector<u32> m_origins;
+
+	/// Offset of the stack instruction being translated.
+	size_t m_offset = 0;
+	/// The register written by the last instruction emitted, if that instruction can be made to
+	/// write to another register instead, and the offset of the stack instruction that emitted it.
+	int m_retargetable = -1;
+	size_t m_retargetable_offset = 0;
+	/// Whether the instruction being translated can be reached by running the previous one.
+	bool m_falls_through = true;
+	size_t m_frame_size = 0;
+	int m_barrier_depth = 0;
+	bool m_failed = false;
+
+	/// @return The offset right after the instruction at [offset].
+	size_t next(size_t offset) const {
+		return offset + 1 + Compiler::op_arity(m_block, offset);
+	}
+
+	/// @return The offset that the jump instruction at [offset] goes to.
+	size_t jump_target(size_t offset) const {
+		const Op op = m_code[offset];
+		const u16 dist = u16((u8(m_code[offset + 1]) << 8) | u8(m_code[offset + 2]));
+		const bool backwards = op == Op::jmp_back or op == Op::for_loop;
+		return backwards ? offset + 3 - dist : offset + 3 + dist;
+	}
+
+	bool compute_depths();
+	void find_captured();
+	void translate_instr(Op op);
+
+	/// @brief Records that the instruction at [offset] is reached with [depth] values on the stack.
+	void visit(std::vector<size_t>& worklist, size_t offset, int depth, bool is_jump);
+
+	void emit(RegOp op, u8 a, u8 b = 0, u8 c = 0, u32 x = 0);
+	/// @brief Emits an instruction whose only effect on registers is writing [a].
+	void emit_write(RegOp op, u8 a, u8 b = 0, u8 c = 0, u32 x = 0);
+
+	void push(Slot slot);
+	void pop(size_t count = 1) {
+		m_stack.resize(m_stack.size() - count);
+	}
+
+	size_t top() const {
+		return m_stack.size() - 1;
+	}
+
+	/// @brief Moves every value that is kept in register [reg] to it's own slot, except the value
+	/// of the slot [reg] itself. Must be called before anything writes to [reg].
+	void make_writable(size_t reg);
+
+	/// @brief Writes the value of the stack slot at [pos] to it's own register.
+	void materialize(size_t pos);
+
+	/// @brief Writes the values of the bottom [count] stack slots to their own registers.
+	void flush(size_t count);
+	void flush() {
+		flush(m_stack.size());
+	}
+
+	/// @return The register holding the value of the stack slot at [pos]. Constants are first
+	/// written to the slot's own register.
+	u8 reg(size_t pos) {
+		if (m_stack[pos].kind != Slot::Kind::Reg) materialize(pos);
+		return m_stack[pos].index;
+	}
+
+	/// @return The register for a value pushed on top of the stack.
+	u8 fresh() {
+		make_writable(m_stack.size());
+		return u8(m_stack.size());
+	}
+
+	void binary(RegOp op, RegOp op_k);
+	void unary(RegOp op);
+	void set_var(u8 slot);
+};
+
+bool RegisterTranslator::translate() {
+	if (!compute_depths()) return false;
+	find_captured();
+
+	for (u32 i = 0; i <= m_num_params; ++i) push({Slot::Kind::Reg, u8(i)});
+
+	for (size_t offset = 0; offset < m_code.size() and !m_failed;) {
+		const Op op = m_code[offset];
+		size_t next_offset = next(offset);
+		// The fused instructions are translated together with the instruction that follows them,
+		// so nothing may jump to that one.
+		if (op >= Op_fused_start and op <= Op_fused_end) {
+			if (m_is_label[next_offset]) return false;
+			next_offset = next(next_offset);
+		}
+
+		if (m_depths[offset] == -1) {
+			offset = next_offset;
+			continue;
+		}
+
+		if (m_is_label[offset]) {
+			// Every path into a jump target has all values in their own registers.
+			if (m_falls_through) flush();
+			m_stack.clear();
+			for (int i = 0; i < m_depths[offset]; ++i) push({Slot::Kind::Reg, u8(i)});
+			m_retargetable = -1;
+		} else if (!m_falls_through or m_stack.size() != size_t(m_depths[offset])) {
+			return false;
+		}
+
+		m_pc_of[offset] = m_out.size();
+		m_offset = offset;
+		m_falls_through = true;
+		translate_instr(op);
+		offset = next_offset;
+	}
+
+	if (m_failed or m_frame_size > UINT8_MAX) return false;
+
+	for (RegInstr& instr : m_out) {
+		const RegFormat format = reg_format(instr.op);
+		if (format == RegFormat::J or format == RegFormat::AJ or format == RegFormat::ABJ or
+			format == RegFormat::AKJ) {
+			instr.x = m_pc_of[instr.x];
+		}
+	}
+
+	m_block.reg_code = std::move(m_out);
+	m_block.reg_origins = std::move(m_origins);
+	m_block.reg_frame_size = m_frame_size;
+	return true;
+}
+
+void RegisterTranslator::visit(std::vector<size_t>& worklist, size_t offset, int depth,
+							   bool is_jump) {
+	if (offset >= m_code.size() or depth < 0) {
+		m_failed = true;
+		return;
+	}
+
+	if (is_jump) m_is_label[offset] = true;
+	if (m_depths[offset] == -1) {
+		m_depths[offset] = depth;
+		worklist.push_back(offset);
+	} else if (m_depths[offset] != depth) {
+		m_failed = true;
+	}
+}
+
+bool RegisterTranslator::compute_depths() {
+	std::vector<size_t> worklist;
+	visit(worklist, 0, m_num_params + 1, false);
+
+	while (!worklist.empty() and !m_failed) {
+		const size_t offset = worklist.back();
+		worklist.pop_back();
+		const int depth = m_depths[offset];
+		const Op op = m_code[offset];
+
+		switch (op) {
+		case Op::jmp:
+		case Op::jmp_back: visit(worklist, jump_target(offset), depth, true); break;
+		case Op::return_val:
+		case Op::tail_call: break;
+
+		case Op::pop_jmp_if_false:
+			visit(worklist, jump_target(offset), depth - 1, true);
+			visit(worklist, next(offset), depth - 1, false);
+			break;
+
+		case Op::jmp_if_false_or_pop:
+		case Op::jmp_if_true_or_pop:
+			visit(worklist, jump_target(offset), depth, true);
+			visit(worklist, next(offset), depth - 1, false);
+			break;
+
+		// The loop's body right after `for_prep` is entered through the jump back from `for_loop`.
+		case Op::for_prep:
+			visit(worklist, jump_target(offset), depth + 1, true);
+			visit(worklist, next(offset), depth + 1, false);
+			break;
+
+		case Op::for_loop:
+			visit(worklist, jump_target(offset), depth, true);
+			visit(worklist, next(offset), depth, false);
+			break;
+
+		case Op::call_func:
+			visit(worklist, next(offset), depth - int(m_code[offset + 1]), false);
+			break;
+
+		case Op::invoke:
+			visit(worklist, next(offset), depth + 1 - int(m_code[offset + 3]), false);
+			break;
+
+		case Op::make_func: visit(worklist, next(offset), depth + 1, false); break;
+
+		case Op::add_var_const: {
+			const size_t set = next(offset);
+			if (m_code[set] != Op::set_var or m_code[set + 1] != m_code[offset + 1]) return false;
+			visit(worklist, next(set), depth, false);
+			break;
+		}
+
+		default: {
+			if (op >= Op_fused_start and op < Op::add_var_const) {
+				const size_t jump = next(offset);
+				if (m_code[jump] != Op::pop_jmp_if_false) return false;
+				visit(worklist, jump_target(jump), depth, true);
+				visit(worklist, next(jump), depth, false);
+				break;
+			}
+
+			// Superinstructions and quickened instructions only show up once the block is done.
+			if (op == Op::no_op or generic_op(op) != op or op >= Op_super_start) return false;
+			visit(worklist, next(offset), depth + Compiler::op_stack_effect(op), false);
+		}
+		}
+	}
+
+	return !m_failed;
+}
+
+void RegisterTranslator::find_captured() {
+	for (size_t offset = 0; offset < m_code.size(); offset = next(offset)) {
+		if (m_code[offset] != Op::make_func) continue;
+		const u8 num_upvals = u8(m_code[offset + 2]);
+		for (u8 i = 0; i < num_upvals; ++i) {
+			// Locals captured by value are only read once, when the closure is made.
+			if (u8(m_code[offset + 3 + 2 * i]) == CaptureLocal) {
+				m_captured[u8(m_code[offset + 4 + 2 * i])] = true;
+			}
+		}
+	}
+}
+
+void RegisterTranslator::emit(RegOp op, u8 a, u8 b, u8 c, u32 x) {
+	m_out.push_back({op, a, b, c, x});
+	m_origins.push_back(m_offset);
+	m_retargetable = -1;
+}
+
+void RegisterTranslator::emit_write(RegOp op, u8 a, u8 b, u8 c, u32 x) {
+	emit(op, a, b, c, x);
+	m_retargetable = a;
+	m_retargetable_offset = m_offset;
+}
+
+void RegisterTranslator::push(Slot slot) {
+	m_stack.push_back(slot);
+	m_frame_size = std::max(m_frame_size, m_stack.size());
+	if (m_stack.size() > UINT8_MAX) m_failed = true;
+}
+
+void RegisterTranslator::make_writable(size_t reg) {
+	if (++m_barrier_depth > MaxBarrierDepth) {
+		m_failed = true;
+		return;
+	}
+
+	for (size_t pos = 0; pos < m_stack.size() and !m_failed; ++pos) {
+		const Slot& slot = m_stack[pos];
+		if (pos != reg and slot.kind == Slot::Kind::Reg and slot.index == reg) materialize(pos);
+	}
+	--m_barrier_depth;
+}
+
+void RegisterTranslator::materialize(size_t pos) {
+	if (m_stack[pos].kind == Slot::Kind::Reg and m_stack[pos].index == pos) return;
+	make_writable(pos);
+	if (m_failed) return;
+
+	const Slot slot = m_stack[pos];
+	switch (slot.kind) {
+	case Slot::Kind::Reg:
+		if (slot.index != pos) emit(RegOp::move, u8(pos), slot.index);
+		break;
+	case Slot::Kind::Const: emit(RegOp::load_const, u8(pos), slot.index); break;
+	case Slot::Kind::Nil: emit(RegOp::load_nil, u8(pos)); break;
+	}
+	m_stack[pos] = {Slot::Kind::Reg, u8(pos)};
+}
+
+void RegisterTranslator::flush(size_t count) {
+	for (size_t pos = 0; pos < count; ++pos) materialize(pos);
+}
+
+void RegisterTranslator::binary(RegOp op, RegOp op_k) {
+	const size_t lhs = top() - 1;
+	const size_t rhs = top();
+	const bool use_k = op_k != op and m_stack[rhs].kind == Slot::Kind::Const;
+
+	reg(lhs);
+	if (!use_k) reg(rhs);
+	make_writable(lhs);
+	const u8 a = reg(lhs);
+	const u8 b = use_k ? m_stack[rhs].index : reg(rhs);
+
+	pop(2);
+	emit_write(use_k ? op_k : op, u8(lhs), a, b);
+	push({Slot::Kind::Reg, u8(lhs)});
+}
+
+void RegisterTranslator::unary(RegOp op) {
+	const size_t pos = top();
+	reg(pos);
+	make_writable(pos);
+	const u8 operand = reg(pos);
+	pop();
+	emit_write(op, u8(pos), operand);
+	push({Slot::Kind::Reg, u8(pos)});
+}
+
+void RegisterTranslator::set_var(u8 slot) {
+	const size_t value = top();
+
+	// The instruction that computed the value can store it in the local straight away, unless
+	// the local's register holds a value that is still needed.
+	if (m_retargetable == int(value) and m_retargetable_offset != m_offset and
+		m_stack[value].kind == Slot::Kind::Reg and m_stack[value].index == value and
+		slot != value) {
+		bool still_read = false;
+		for (size_t pos = 0; pos < value; ++pos) {
+			const Slot& s = m_stack[pos];
+			still_read |= pos != slot and s.kind == Slot::Kind::Reg and s.index == slot;
+		}
+
+		if (!still_read) {
+			m_out.back().a = slot;
+			pop();
+			m_stack[slot] = {Slot::Kind::Reg, slot};
+			m_retargetable = -1;
+			return;
+		}
+	}
+
+	make_writable(slot);
+	const Slot src = m_stack[value];
+	pop();
+	switch (src.kind) {
+	case Slot::Kind::Reg:
+		if (src.index != slot) emit(RegOp::move, slot, src.index);
+		break;
+	case Slot::Kind::Const: emit(RegOp::load_const, slot, src.index); break;
+	case Slot::Kind::Nil: emit(RegOp::load_nil, slot); break;
+	}
+	m_stack[slot] = {Slot::Kind::Reg, slot};
+}
+
+/// @return The register instruction for the binary operator [op], followed by the version of it
+/// that takes a constant as the right operand. The second one is the same as the first for
+/// operators that have no such version.
+static std::pair<RegOp, RegOp> register_binop(Op op) {
+	switch (op) {
+	case Op::add: return {RegOp::add, RegOp::add_k};
+	case Op::sub: return {RegOp::sub, RegOp::sub_k};
+	case Op::mult: return {RegOp::mult, RegOp::mult_k};
+	case Op::div: return {RegOp::div, RegOp::div_k};
+	case Op::mod: return {RegOp::mod, RegOp::mod_k};
+	case Op::eq: return {RegOp::eq, RegOp::eq_k};
+	case Op::neq: return {RegOp::neq, RegOp::neq_k};
+	case Op::gt: return {RegOp::gt, RegOp::gt_k};
+	case Op::lt: return {RegOp::lt, RegOp::lt_k};
+	case Op::gte: return {RegOp::gte, RegOp::gte_k};
+	case Op::lte: return {RegOp::lte, RegOp::lte_k};
+	case Op::exp: return {RegOp::exp, RegOp::exp};
+	case Op::concat: return {RegOp::concat, RegOp::concat};
+	case Op::lshift: return {RegOp::lshift, RegOp::lshift};
+	case Op::rshift: return {RegOp::rshift, RegOp::rshift};
+	case Op::band: return {RegOp::band, RegOp::band};
+	case Op::bxor: return {RegOp::bxor, RegOp::bxor};
+	case Op::bor: return {RegOp::bor, RegOp::bor};
+	default: VYSE_UNREACHABLE(); return {RegOp::move, RegOp::move};
+	}
+}
+
+void RegisterTranslator::translate_instr(Op op) {
+	const size_t offset = m_offset;
+	const u8 arg = offset + 1 < m_code.size() ? u8(m_code[offset + 1]) : 0;
+
+	switch (op) {
+	case Op::load_const: push({Slot::Kind::Const, arg}); break;
+	case Op::load_nil: push({Slot::Kind::Nil, 0}); break;
+	case Op::pop: pop(); break;
+
+	case Op::get_var: {
+		const Slot local = m_stack[arg];
+		// Calls can change captured locals through their upvalues, so these are copied right away.
+		if (local.kind == Slot::Kind::Reg and m_captured[local.index]) {
+			const u8 dst = fresh();
+			emit_write(RegOp::move, dst, local.index);
+			push({Slot::Kind::Reg, dst});
+		} else {
+			push(local);
+		}
+		break;
+	}
+
+	case Op::set_var: set_var(arg); break;
+
+	case Op::get_upval:
+	case Op::get_capture:
+	case Op::get_global: {
+		const u8 dst = fresh();
+		const RegOp reg_op = op == Op::get_upval	  ? RegOp::get_upval
+							 : op == Op::get_capture ? RegOp::get_capture
+													 : RegOp::get_global;
+		emit_write(reg_op, dst, arg);
+		push({Slot::Kind::Reg, dst});
+		break;
+	}
+
+	case Op::set_upval:
+	case Op::set_global: {
+		const u8 value = reg(top());
+		pop();
+		emit(op == Op::set_upval ? RegOp::set_upval : RegOp::set_global, value, arg);
+		break;
+	}
+
+	case Op::close_upval:
+		materialize(top());
+		emit(RegOp::close_upval, u8(top()));
+		pop();
+		break;
+
+	case Op::add:
+	case Op::sub:
+	case Op::mult:
+	case Op::div:
+	case Op::mod:
+	case Op::exp:
+	case Op::concat:
+	case Op::eq:
+	case Op::neq:
+	case Op::gt:
+	case Op::lt:
+	case Op::gte:
+	case Op::lte:
+	case Op::lshift:
+	case Op::rshift:
+	case Op::band:
+	case Op::bxor:
+	case Op::bor: {
+		const auto [reg_op, reg_op_k] = register_binop(op);
+		binary(reg_op, reg_op_k);
+		break;
+	}
+
+	case Op::negate: unary(RegOp::negate); break;
+	case Op::len: unary(RegOp::len); break;
+	case Op::vararg_len: {
+		// The rest parameter whose length is taken only holds nil, and isn't read.
+		pop();
+		const u8 dst = fresh();
+		emit_write(RegOp::vararg_len, dst);
+		push({Slot::Kind::Reg, dst});
+		break;
+	}
+	case Op::bnot: unary(RegOp::bnot); break;
+	case Op::lnot: unary(RegOp::lnot); break;
+
+	case Op::new_table:
+	case Op::new_list: {
+		const u8 dst = fresh();
+		emit_write(op == Op::new_table ? RegOp::new_table : RegOp::new_list, dst);
+		push({Slot::Kind::Reg, dst});
+		break;
+	}
+
+	case Op::list_append: {
+		const u8 list = reg(top() - 1);
+		const u8 value = reg(top());
+		pop();
+		emit(RegOp::list_append, list, value);
+		break;
+	}
+
+	case Op::table_add_field: {
+		reg(top() - 2), reg(top() - 1), reg(top());
+		emit(RegOp::table_add_field, reg(top() - 2), reg(top() - 1), reg(top()));
+		pop(2);
+		break;
+	}
+
+	// Assignments leave the assigned value where the object was.
+	case Op::subscript_set: {
+		reg(top() - 2), reg(top() - 1), reg(top());
+		emit(RegOp::subscript_set, reg(top() - 2), reg(top() - 1), reg(top()));
+		const Slot value = m_stack[top()];
+		pop(3);
+		push(value);
+		break;
+	}
+
+	case Op::table_set: {
+		reg(top() - 1), reg(top());
+		emit(RegOp::table_set, reg(top() - 1), reg(top()), arg, u8(m_code[offset + 2]));
+		const Slot value = m_stack[top()];
+		pop(2);
+		push(value);
+		break;
+	}
+
+	case Op::table_get: {
+		const size_t pos = top();
+		reg(pos);
+		make_writable(pos);
+		const u8 object = reg(pos);
+		pop();
+		emit_write(RegOp::table_get, u8(pos), object, arg, u8(m_code[offset + 2]));
+		push({Slot::Kind::Reg, u8(pos)});
+		break;
+	}
+
+	case Op::table_get_no_pop: {
+		reg(top());
+		const u8 dst = fresh();
+		emit_write(RegOp::table_get, dst, reg(top()), arg, u8(m_code[offset + 2]));
+		push({Slot::Kind::Reg, dst});
+		break;
+	}
+
+	case Op::prep_method_call: {
+		const size_t pos = top();
+		reg(pos);
+		make_writable(pos);
+		make_writable(pos + 1);
+		const u8 object = reg(pos);
+		pop();
+		emit(RegOp::prep_method_call, u8(pos), object, arg, u8(m_code[offset + 2]));
+		push({Slot::Kind::Reg, u8(pos)});
+		push({Slot::Kind::Reg, u8(pos + 1)});
+		break;
+	}
+
+	case Op::vararg_get: {
+		const size_t pos = top() - 1;
+		reg(pos + 1);
+		make_writable(pos);
+		const u8 index = reg(pos + 1);
+		pop(2);
+		emit_write(RegOp::vararg_get, u8(pos), index);
+		push({Slot::Kind::Reg, u8(pos)});
+		break;
+	}
+
+	case Op::subscript_get: {
+		const size_t pos = top() - 1;
+		reg(pos), reg(pos + 1);
+		make_writable(pos);
+		const u8 object = reg(pos);
+		const u8 key = reg(pos + 1);
+		pop(2);
+		emit_write(RegOp::subscript_get, u8(pos), object, key);
+		push({Slot::Kind::Reg, u8(pos)});
+		break;
+	}
+
+	case Op::index_no_pop: {
+		reg(top() - 1), reg(top());
+		const u8 dst = fresh();
+		emit_write(RegOp::subscript_get, dst, reg(top() - 1), reg(top()));
+		push({Slot::Kind::Reg, dst});
+		break;
+	}
+
+	case Op::call_func: {
+		// The callee's frame starts at the function, and may use any register above it.
+		flush();
+		const size_t func = top() - arg;
+		pop(arg + 1);
+		emit(RegOp::call, u8(func), arg);
+		push({Slot::Kind::Reg, u8(func)});
+		break;
+	}
+
+	case Op::invoke: {
+		// This is done as a `prep_method_call` and a `call`, which can read the object from any
+		// register. The arguments have no side effects, so the method may be looked up after them.
+		// The method goes in a new slot below the object, and the values above it move up one.
+		const u8 argc = u8(m_code[offset + 3]);
+		const size_t pos = top() + 1 - argc;
+		const u8 object = reg(pos);
+		m_stack[pos] = {Slot::Kind::Nil, 0};
+		m_stack.insert(m_stack.begin() + pos, {Slot::Kind::Nil, 0});
+		m_frame_size = std::max(m_frame_size, m_stack.size());
+		make_writable(pos);
+		make_writable(pos + 1);
+		emit(RegOp::prep_method_call, u8(pos), object, arg, u8(m_code[offset + 2]));
+		m_stack[pos] = {Slot::Kind::Reg, u8(pos)};
+		m_stack[pos + 1] = {Slot::Kind::Reg, u8(pos + 1)};
+
+		flush();
+		pop(argc + 1);
+		emit(RegOp::call, u8(pos), argc);
+		push({Slot::Kind::Reg, u8(pos)});
+		break;
+	}
+
+	case Op::tail_call: {
+		flush();
+		const size_t func = top() - arg;
+		emit(RegOp::tail_call, u8(func), arg);
+		m_falls_through = false;
+		break;
+	}
+
+	case Op::make_func: {
+		// Captured locals need to be in their own registers, which the upvalues point to.
+		flush();
+		const u8 dst = fresh();
+		emit_write(RegOp::make_func, dst, arg, 0, offset);
+		push({Slot::Kind::Reg, dst});
+		break;
+	}
+
+	case Op::return_val:
+		emit(RegOp::return_val, reg(top()));
+		m_falls_through = false;
+		break;
+
+	case Op::jmp:
+	case Op::jmp_back:
+		flush();
+		emit(RegOp::jmp, 0, 0, 0, jump_target(offset));
+		m_falls_through = false;
+		break;
+
+	case Op::pop_jmp_if_false: {
+		flush(m_stack.size() - 1);
+		emit(RegOp::jmp_if_false, reg(top()), 0, 0, jump_target(offset));
+		pop();
+		break;
+	}
+
+	// The value tested stays on the stack when the jump is taken.
+	case Op::jmp_if_false_or_pop:
+	case Op::jmp_if_true_or_pop: {
+		flush();
+		const RegOp jmp = op == Op::jmp_if_false_or_pop ? RegOp::jmp_if_false : RegOp::jmp_if_true;
+		emit(jmp, u8(top()), 0, 0, jump_target(offset));
+		pop();
+		break;
+	}
+
+	case Op::for_prep: {
+		flush();
+		const size_t counter = top() - 2;
+		fresh();
+		emit(RegOp::for_prep, u8(counter), 0, 0, jump_target(offset));
+		push({Slot::Kind::Reg, u8(counter + 3)});
+		m_falls_through = false;
+		break;
+	}
+
+	case Op::for_loop:
+		flush();
+		emit(RegOp::for_loop, u8(top() - 3), 0, 0, jump_target(offset));
+		break;
+
+	case Op::add_var_const: {
+		reg(arg);
+		make_writable(arg);
+		emit(RegOp::add_k, arg, reg(arg), u8(m_code[offset + 2]));
+		m_stack[arg] = {Slot::Kind::Reg, arg};
+		break;
+	}
+
+	default: {
+		VYSE_ASSERT(op >= Op_fused_start and op < Op::add_var_const, "Unexpected instruction.");
+		// The fused comparisons are in the same order as the register ones, with the same
+		// operands, and their jump is in the `pop_jmp_if_false` that follows.
+		flush();
+		const bool with_const = op >= Op::eq_var_const_jmp;
+		const u8 index = u8(op) - u8(with_const ? Op::eq_var_const_jmp : Op::eq_var_var_jmp);
+		const RegOp jmp = RegOp(u8(with_const ? RegOp::eq_k_jmp : RegOp::eq_jmp) + index);
+		emit(jmp, arg, u8(m_code[offset + 2]), 0, jump_target(next(offset)));
+		break;
+	}
+	}
+}
+
+} // namespace
+
+void Compiler::emit_register_code() {
+	RegisterTranslator translator{THIS_BLOCK, m_codeblock->param_count()};
+	translator.translate();
+}
+
 void Compiler::enter_block() noexcept {
 	++m_symtable.m_scope_depth;
 }
@@ -1023,7 +1998,7 @@ void Compiler::error_at(const char* message, u32 const line) {
 	if (has_error) return;
 	std::string const full_msg = kt::format_str("[line {}]: {}", line, message);
 	RuntimeError::DebugInfo location{line, ""};
-	RuntimeError err(m_vm->m_sources.end()->path, location, message, full_msg);
+	RuntimeError err(m_vm->m_sources.back().path, location, message, full_msg);
 	m_vm->on_error(*m_vm, err);
 
 	has_error = true;
@@ -1038,7 +2013,7 @@ void Compiler::error(std::string message, const Token& token) {
 		kt::format_str(fmt, token.location.line, token.raw(m_source->code), message);
 
 	RuntimeError::DebugInfo location{token.location.line, ""};
-	RuntimeError err(m_vm->m_sources.end()->path, location, message, full_msg);
+	RuntimeError err(m_vm->m_sources.back().path, location, message, full_msg);
 	m_vm->on_error(*m_vm, err);
 	has_error = true;
 }
@@ -1093,6 +2068,15 @@ u32 Compiler::emit_id_string(const Token& token) {
 	return emit_value(VYSE_OBJECT(s));
 }
 
+u32 Compiler::emit_global(const Token& token) {
+	String* name = &m_vm->make_string(token.raw_cstr(m_source->code), token.length());
+	const size_t index = THIS_BLOCK.add_global(name, m_vm->global_slot(name));
+	if (index >= Compiler::MaxLocalVars) {
+		error("Too many global variables in a single block.", token);
+	}
+	return index;
+}
+
 int Compiler::find_local_var(const Token& name_token) const noexcept {
 	const char* name = name_token.raw_cstr(m_source->code);
 	const int length = name_token.length();
@@ -1110,8 +2094,9 @@ int Compiler::find_upvalue(const Token& token) {
 	// If found the local var, then add it to the upvalues list and mark the upvalue is "local".
 	if (index != -1) {
 		LocalVar& local = m_parent->m_symtable.m_symbols[index];
-		local.is_captured = true;
-		return m_symtable.add_upvalue(index, true, local.is_const);
+		const bool by_value = !m_parent->may_be_reassigned(local);
+		if (!by_value) local.is_captured = true;
+		return m_symtable.add_upvalue(index, true, local.is_const, by_value);
 	}
 
 	// If not found within the parent compiler's local vars then look into the parent compiler's
@@ -1122,13 +2107,39 @@ int Compiler::find_upvalue(const Token& token) {
 	if (index != -1) {
 		// is not local since we found it in an enclosing compiler.
 		const UpvalDesc& upval = m_parent->m_symtable.m_upvals[index];
-		return m_symtable.add_upvalue(index, false, upval.is_const);
+		return m_symtable.add_upvalue(index, false, upval.is_const, upval.by_value);
 	}
 
 	// No local variable in any of the enclosing scopes was found with the same name.
 	return -1;
 }
 
+void Compiler::find_reassigned_names() {
+	Scanner scanner{m_source->code};
+	// The two tokens before the current one.
+	Token before_prev;
+	Token prev;
+	for (Token token = scanner.next_token(); token.type != TT::Eof; token = scanner.next_token()) {
+		// `x = ...` and `x += ...` assign to a variable, unless they are a declaration like
+		// `let x = ...`, or a field assignment like `t.x = ...`. Note that the `for i = ...`
+		// of a loop counts as an assignment, since all iterations share the loop variable.
+		if (is_assign_tok(token.type) and prev.type == TT::Id and before_prev.type != TT::Let and
+			before_prev.type != TT::Const and before_prev.type != TT::Dot and
+			before_prev.type != TT::Colon) {
+			m_reassigned_names.emplace(prev.raw_cstr(m_source->code), prev.length());
+		}
+		before_prev = prev;
+		prev = token;
+	}
+}
+
+bool Compiler::may_be_reassigned(const LocalVar& var) const {
+	if (var.is_const) return false;
+	const Compiler* top = this;
+	while (top->m_parent != nullptr) top = top->m_parent;
+	return top->m_reassigned_names.count(std::string_view(var.name, var.length)) != 0;
+}
+
 size_t Compiler::emit_value(Value v) {
 	const size_t index = THIS_BLOCK.add_value(v);
 	if (index >= Compiler::MaxLocalVars) {
@@ -1160,9 +2171,15 @@ inline void Compiler::emit_with_arg(Op op, u8 arg) {
 	emit_arg(arg);
 }
 
+inline void Compiler::emit_cached(Op op, u8 const_idx) {
+	VYSE_ASSERT(op >= Op_cached_start and op <= Op_cached_end, "Opcode does not use a cache.");
+	emit_with_arg(op, const_idx);
+	emit_arg(THIS_BLOCK.add_inline_cache());
+}
+
 inline void Compiler::emit(Op a, Op b) {
-	emit(a, token);
-	emit(b, token);
+	emit(a);
+	emit(b);
 }
 
 Op Compiler::toktype_to_op(TT toktype) const noexcept {
@@ -1198,12 +2215,20 @@ Op Compiler::toktype_to_op(TT toktype) const noexcept {
 
 #define CHECK_ARITY(x, y) ((x) >= (Op_##y##_operands_start) and ((x) <= (Op_##y##_operands_end)))
 int Compiler::op_arity(u32 op_index) const noexcept {
-	const Op op = THIS_BLOCK.code[op_index];
+	return op_arity(THIS_BLOCK, op_index);
+}
+
+int Compiler::op_arity(const Block& block, size_t op_index) noexcept {
+	Op op = block.code[op_index];
+	// Superinstructions take the operands of their first instruction.
+	if (op >= Op_super_start and op <= Op_super_end) op = superinstruction(op).ops[0];
+
 	if (op == Op::make_func) {
-		VYSE_ASSERT(op_index != THIS_BLOCK.op_count() - 1,
-					"Op::make_func cannot be the last opcode");
-		int n_upvals = int(THIS_BLOCK.code[op_index + 1]);
-		return 1 + n_upvals * 2;
+		VYSE_ASSERT(op_index != block.op_count() - 1, "Op::make_func cannot be the last opcode");
+		// The operands are the codeblock's constant index, the number of upvalues, and then a pair
+		// of bytes for each upvalue.
+		int n_upvals = int(block.code[op_index + 2]);
+		return 2 + n_upvals * 2;
 	}
 
 	if (CHECK_ARITY(op, 0)) return 0;
@@ -1211,12 +2236,20 @@ int Compiler::op_arity(u32 op_index) const noexcept {
 
 	// Constant instructions take 1 operand: the index of the constant in the constant pool.
 	if (op >= Op_const_start and op <= Op_const_end) return 1;
+	// Global variable instructions take the index of the global in the block's `globals` list.
+	if (op >= Op_global_start and op <= Op_global_end) return 1;
+	// Cached field accesses take the constant index, followed by the inline cache index. `invoke`
+	// also takes the argument count.
+	if (op == Op::invoke) return 3;
+	if (op >= Op_cached_start and op <= Op_cached_end) return 2;
+	// Fused instructions take a local's slot, and another slot or a constant index.
+	if (op >= Op_fused_start and op <= Op_fused_end) return 2;
 	VYSE_ASSERT(CHECK_ARITY(op, 2), "Instructions other than make_func can have upto 2 operands.");
 	return 2;
 }
 #undef CHECK_ARITY
 
-int Compiler::op_stack_effect(Op op) const noexcept {
+int Compiler::op_stack_effect(Op op) noexcept {
 #define OP(_, __, stack_effect) stack_effect
 	constexpr std::array<int, size_t(Op::no_op) + 1> stack_effects = {
 #include "x_opcode.hpp"
@@ -1292,7 +2325,7 @@ const LocalVar* SymbolTable::find_by_slot(const u8 index) const {
 	return &m_symbols[index];
 }
 
-int SymbolTable::add_upvalue(int index, bool is_local, bool is_const) {
+int SymbolTable::add_upvalue(int index, bool is_local, bool is_const, bool by_value) {
 	// If the upvalue has already been captured, then return the stored value.
 	for (int i = 0; i < m_num_upvals; ++i) {
 		UpvalDesc& upval = m_upvals[i];
@@ -1301,7 +2334,7 @@ int SymbolTable::add_upvalue(int index, bool is_local, bool is_const) {
 		}
 	}
 
-	m_upvals[m_num_upvals] = UpvalDesc{index, is_const, is_local};
+	m_upvals[m_num_upvals] = UpvalDesc{index, is_const, is_local, by_value};
 	return m_num_upvals++;
 }
 
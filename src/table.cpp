@@ -12,7 +12,7 @@ using OT = ObjType;
 #define TABLE_GET_SLOT(k, h) search_entry<Table, Entry>(this, k, h)
 #define TABLE_GET_SLOT_CONST(k, h) search_entry<const Table, const Entry>(this, k, h)
 #define TABLE_PLACE_TOMBSTONE(e)                                                                   \
-	(VYSE_SET_TT(e.key, VT::Undefined), e.value = VYSE_NIL, ++m_num_tombstones)
+	(e.key = VYSE_UNDEF, e.value = VYSE_NIL, ++m_num_tombstones)
 
 // check if an entry is unoccupied.
 #define IS_ENTRY_FREE(e) (VYSE_IS_NIL(e.key))
@@ -21,6 +21,25 @@ using OT = ObjType;
 
 Table::~Table() {
 	delete[] m_entries;
+	free(m_slots);
+}
+
+void Table::to_hash_layout() {
+	VYSE_ASSERT(m_shape != nullptr, "Table already uses the hash table layout.");
+	const Shape* shape = m_shape;
+	Value* slots = m_slots;
+
+	m_shape = nullptr;
+	m_slots = nullptr;
+	m_slot_cap = 0;
+	m_cap = DefaultCapacity;
+	m_entries = new Entry[m_cap];
+
+	for (size_t i = 0; i < shape->num_keys(); ++i) {
+		set(VYSE_OBJECT(shape->keys()[i]), slots[i]);
+	}
+
+	free(slots);
 }
 
 void Table::ensure_capacity() {
@@ -51,6 +70,14 @@ void Table::ensure_capacity() {
 [[nodiscard]] Value Table::get(Value key) const {
 	if (VYSE_IS_NIL(key)) return VYSE_NIL;
 
+	if (m_shape != nullptr) {
+		if (VYSE_IS_STRING(key)) {
+			const size_t slot = m_shape->find(VYSE_AS_STRING(key));
+			if (slot != NotFound) return m_slots[slot];
+		}
+		return m_proto_table == nullptr ? VYSE_NIL : m_proto_table->get(key);
+	}
+
 	size_t mask = m_cap - 1;
 	size_t hash = hash_value(key);
 	size_t index = hash & mask;
@@ -65,6 +92,24 @@ void Table::ensure_capacity() {
 	return m_proto_table == nullptr ? VYSE_NIL : m_proto_table->get(key);
 }
 
+Value Table::get_and_cache(Value key, InlineCache& cache) const {
+	cache.shape = m_shape;
+	const Table* table = this;
+	for (u32 depth = 0; table != nullptr and depth < InlineCache::Empty; ++depth) {
+		const size_t slot = table->find_string_key(key);
+		if (slot != NotFound) {
+			cache.slot = slot;
+			cache.depth = depth;
+			Value value;
+			table->get_slot(slot, key, value);
+			return value;
+		}
+		table = table->m_proto_table;
+	}
+
+	return table == nullptr ? VYSE_NIL : table->get(key);
+}
+
 bool Table::set(String& key, Value value) {
 	return set(VYSE_OBJECT(&key), value);
 }
@@ -72,6 +117,34 @@ bool Table::set(String& key, Value value) {
 bool Table::set(Value key, Value value) {
 	VYSE_ASSERT(!VYSE_IS_NIL(key), "Table key is nil.");
 
+	if (m_shape != nullptr) {
+		if (VYSE_IS_STRING(key)) {
+			String* const skey = VYSE_AS_STRING(key);
+			const size_t slot = m_shape->find(skey);
+			if (slot != NotFound and !VYSE_IS_NIL(value)) {
+				m_slots[slot] = value;
+				return false;
+			}
+
+			if (slot == NotFound) {
+				if (VYSE_IS_NIL(value)) return false;
+				Shape* const next_shape = m_shape->with_key(skey);
+				if (next_shape != nullptr) {
+					if (m_shape->num_keys() == m_slot_cap) {
+						m_slot_cap = m_slot_cap == 0 ? 4 : m_slot_cap * GrowthFactor;
+						m_slots = static_cast<Value*>(realloc(m_slots, m_slot_cap * sizeof(Value)));
+					}
+					m_slots[m_shape->num_keys()] = value;
+					m_shape = next_shape;
+					return true;
+				}
+			}
+		}
+
+		// Removing a key, adding a key that is not a string or running out of shapes.
+		to_hash_layout();
+	}
+
 	// If the value is nil, then the key is
 	// simply removed with a tombstone in the
 	// table.
@@ -146,7 +219,20 @@ bool Table::set(Value key, Value value) {
 	return true;
 }
 
+void Table::set_and_cache(Value key, Value value, InlineCache& cache) {
+	set(key, value);
+	if (VYSE_IS_NIL(value)) return;
+	cache.shape = m_shape;
+	cache.slot = find_string_key(key);
+	cache.depth = 0;
+}
+
 bool Table::remove(Value key) {
+	if (m_shape != nullptr) {
+		if (!VYSE_IS_STRING(key) or m_shape->find(VYSE_AS_STRING(key)) == NotFound) return false;
+		to_hash_layout();
+	}
+
 	if (m_num_entries == 0) return false;
 
 	// Find the slot where this key would go.
@@ -167,12 +253,14 @@ bool Table::remove(Value key) {
 }
 
 size_t Table::length() const {
+	if (m_shape != nullptr) return m_shape->num_keys();
 	return m_num_entries - m_num_tombstones;
 }
 
 String* Table::find_string(const char* chars, size_t length, size_t hash) const {
 	VYSE_ASSERT(chars != nullptr, "key string is null.");
 	VYSE_ASSERT(hash == hash_cstring(chars, length), "Incorrect cstring hash.");
+	VYSE_ASSERT(m_shape == nullptr, "String lookup in a shaped table.");
 
 	size_t mask = m_cap - 1;
 	size_t index = hash & mask;
@@ -217,6 +305,14 @@ size_t Table::hash_object(Obj* object) const {
 }
 
 void Table::trace(GC& gc) {
+	gc.mark_object(m_proto_table);
+
+	// The keys of a shaped table are kept alive by the shape tree.
+	if (m_shape != nullptr) {
+		for (size_t i = 0; i < m_shape->num_keys(); ++i) gc.mark_value(m_slots[i]);
+		return;
+	}
+
 	for (size_t i = 0; i < m_cap; ++i) {
 		Entry& e = m_entries[i];
 		if (IS_ENTRY_FREE(e) or IS_ENTRY_DEAD(e)) continue;
@@ -226,6 +322,7 @@ void Table::trace(GC& gc) {
 }
 
 void Table::delete_white_string_keys() {
+	if (m_shape != nullptr) return;
 	for (u32 i = 0; i < m_cap; ++i) {
 		Entry& entry = m_entries[i];
 		if (IS_ENTRY_DEAD(entry) or IS_ENTRY_FREE(entry)) continue;
@@ -236,6 +333,7 @@ void Table::delete_white_string_keys() {
 }
 
 size_t Table::size() const {
+	if (m_shape != nullptr) return sizeof(Table) + m_slot_cap * sizeof(Value);
 	return sizeof(Table) + m_cap * sizeof(Value);
 }
 
@@ -1,5 +1,6 @@
 #include "function.hpp"
 #include "gc.hpp"
+#include <util/args.hpp>
 #include <util/native_module.hpp>
 #include <vm.hpp>
 
@@ -16,6 +17,18 @@ void NativeModule::add_cfunc(const char* name, NativeFn func) {
 	m_vm->gc_on();
 }
 
+void NativeModule::add_cfunc(const char* name, FastNativeFn func, u8 arity, bool reenters_vm) {
+	m_vm->gc_off();
+	String* sname = &m_vm->make_string(name);
+	CClosure* fn = &m_vm->make<CClosure>(func, sname, arity, reenters_vm);
+	m_table->set(VYSE_OBJECT(sname), VYSE_OBJECT(fn));
+	m_vm->gc_on();
+}
+
+void NativeModule::add_cfunc(const char* name, const NativeBinding& binding) {
+	add_cfunc(name, binding.func, binding.arity, binding.reenters_vm);
+}
+
 void NativeModule::add_cclosures(const std::pair<const char*, NativeFn>* funcs,
 								 std::size_t num_funcs) {
 	m_vm->gc_off();
@@ -28,6 +41,13 @@ void NativeModule::add_cclosures(const std::pair<const char*, NativeFn>* funcs,
 	m_vm->gc_on();
 }
 
+void NativeModule::add_cclosures(const std::pair<const char*, NativeBinding>* funcs,
+								 std::size_t num_funcs) {
+	for (uint i = 0; i < num_funcs; ++i) {
+		add_cfunc(funcs[i].first, funcs[i].second);
+	}
+}
+
 void NativeModule::add_field(const char* name, Value value) {
 	String& vyname = m_vm->make_string(name);
 	GCLock lock = m_vm->gc_lock(&vyname);
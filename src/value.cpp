@@ -45,6 +45,7 @@ char* num_to_cstring(number num) {
 std::string value_to_string(Value v) {
 	switch (VYSE_GET_TT(v)) {
 	case VT::Number: {
+		if (VYSE_IS_INT(v)) return std::to_string(VYSE_AS_INT(v));
 		number num = VYSE_AS_NUM(v);
 		if (s64(num) == num) return std::to_string(s64(num));
 		return std::to_string(num);
@@ -86,7 +87,8 @@ std::string value_to_string(Value v) {
 
 const char* vtype_to_string(VT tag) {
 	switch (tag) {
-	case VT::Number: return "number";
+	case VT::Number:
+	case VT::Integer: return "number";
 	case VT::Bool: return "boolean";
 	case VT::Object: return "object";
 	case VT::Nil: return "nil";
@@ -119,9 +121,18 @@ const char* value_type_name(Value v) {
 }
 
 bool operator==(const Value& a, const Value& b) {
+	// Integers and doubles that represent the same number are equal.
+	if (VYSE_IS_NUM(a) and VYSE_IS_NUM(b)) {
+		if (VYSE_IS_INT(a) and VYSE_IS_INT(b)) return VYSE_AS_INT(a) == VYSE_AS_INT(b);
+		return VYSE_AS_NUM(a) == VYSE_AS_NUM(b);
+	}
+
+#ifdef VYSE_NAN_TAGGING
+	// Two non-numeric values are equal only if they have the exact same bit pattern.
+	return a.bits == b.bits;
+#else
 	if (a.tag != b.tag) return false;
 	switch (a.tag) {
-	case VT::Number: return VYSE_AS_NUM(b) == VYSE_AS_NUM(a);
 	case VT::Bool: return VYSE_AS_BOOL(a) == VYSE_AS_BOOL(b);
 	case VT::Object: {
 		const Obj* oa = VYSE_AS_OBJECT(a);
@@ -132,6 +143,7 @@ bool operator==(const Value& a, const Value& b) {
 	case VT::Nil: return true;
 	default: return false;
 	}
+#endif
 }
 
 bool operator!=(const Value& a, const Value& b) {
@@ -0,0 +1,61 @@
+#include "assert.hpp"
+#include <aot.hpp>
+#include <iostream>
+#include <vm.hpp>
+
+using namespace vy;
+
+// Every auto test, compiled to C++ by vyc (see CMakeLists.txt).
+#define AOT_MODULE(name) extern "C" const AotModule* vy_aot_##name();
+#include <aot_modules.hpp>
+#undef AOT_MODULE
+
+static void run_module(const AotModule& module) {
+	std::cout << "[Running test] " << module.name << " ... ";
+	VM vm;
+	vm.load_stdlib();
+
+	// The script compiles to the bytecode that the module was generated from, so every function in
+	// it gets the native code from the module.
+	Closure* const script = vm.compile(module);
+	ASSERT(script != nullptr, "AOT modules compile.");
+	for (CodeBlock* code : aot_code_blocks(*script->m_codeblock)) {
+		ASSERT(code->aot_function() != nullptr, "Every function is compiled ahead of time.");
+	}
+
+	ASSERT(vm.runaot(module) == ExitCode::Success, "Scripts run the same when compiled to C++.");
+	std::cout << " [DONE]\n";
+}
+
+static void stale_module_test() {
+	// A script that has changed since the module was generated is interpreted instead.
+	AotModule module = *vy_aot_int();
+	module.source = "let x = 1 return x + 1";
+	VM vm;
+	Closure* const script = vm.compile(module);
+	ASSERT(script != nullptr and script->m_codeblock->aot_function() == nullptr,
+		   "Native code is only used for the bytecode that it was generated from.");
+	ASSERT(vm.runaot(module) == ExitCode::Success and vm.return_value == VYSE_INT(2),
+		   "Stale AOT modules are interpreted.");
+}
+
+static void shared_library_test() {
+	VM vm;
+	vm.load_stdlib();
+	const AotModule* const module = vm.dynloader.read_aot_module("vyaot_call", "call");
+	ASSERT(module != nullptr, "AOT modules can be loaded from shared libraries.");
+	ASSERT(vm.dynloader.read_aot_module("vyaot_call", "missing") == nullptr,
+		   "Modules that aren't in the library are not found.");
+	ASSERT(vm.runaot(*module) == ExitCode::Success, "AOT modules run from shared libraries.");
+}
+
+int main() {
+#define AOT_MODULE(name) run_module(*vy_aot_##name());
+#include <aot_modules.hpp>
+#undef AOT_MODULE
+
+	stale_module_test();
+	shared_library_test();
+	std::cout << "AOT tests passed" << std::endl;
+	return 0;
+}
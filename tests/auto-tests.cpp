@@ -1,4 +1,5 @@
 #include "util/test_utils.hpp"
+#include <bytecode.hpp>
 #include <cassert>
 #include <filesystem>
 #include <fstream>
@@ -12,13 +13,47 @@ int main() {
 	std::string dir_path = "../tests/test_programs/auto";
 	assert(stdfs::exists(dir_path) && "test directory exists.");
 
+	// Every test runs on both tiers, and on the stack tier with every function compiled by the JIT.
 	auto run_code = [](std::string fpath, std::string code) {
-		vy::VM vm;
-		vm.load_stdlib();
-		vy::ExitCode ec = vm.runfile(fpath, code);
-		if (ec != vy::ExitCode::Success) {
-			std::cerr << "Failure running auto test ("  << fpath << "). " << std::endl;
-			abort();
+		const char* const names[] = {"stack", "register", "JIT"};
+		for (int i = 0; i < 3; ++i) {
+			vy::VMConfig config;
+			config.tier = i == 1 ? vy::Tier::Register : vy::Tier::Stack;
+			config.jit = i == 2;
+			config.jit_threshold = 1;
+			vy::VM vm{config};
+			vm.load_stdlib();
+			vy::ExitCode ec = vm.runfile(fpath, code);
+			if (ec != vy::ExitCode::Success) {
+				std::cerr << "Failure running auto test (" << fpath << ") on the " << names[i]
+						  << " tier. " << std::endl;
+				abort();
+			}
+		}
+	};
+
+	// Every test is also written to a bytecode file and a bytecode image, which are run on both
+	// tiers.
+	auto run_bytecode = [](std::string fpath, std::string code) {
+		vy::VMConfig config;
+		config.tier = vy::Tier::Register;
+		vy::VM compiler_vm{config};
+		vy::Closure* const script = compiler_vm.compile(vy::SourceCode{fpath, std::move(code)});
+		assert(script != nullptr && "auto tests compile.");
+		const std::string bytecode = vy::dump_bytecode(*script->m_codeblock);
+		const std::string image = vy::dump_image(*script->m_codeblock);
+
+		for (const vy::Tier tier : {vy::Tier::Stack, vy::Tier::Register}) {
+			for (const std::string* contents : {&bytecode, &image}) {
+				config.tier = tier;
+				vy::VM vm{config};
+				vm.load_stdlib();
+				if (vm.runfile(fpath, *contents) != vy::ExitCode::Success) {
+					std::cerr << "Failure running auto test (" << fpath << ") from bytecode."
+							  << std::endl;
+					abort();
+				}
+			}
 		}
 	};
 
@@ -29,6 +64,7 @@ int main() {
 			std::ostringstream ostream;
 			ostream << stream.rdbuf();
 			run_code(entry.path().string(), ostream.str());
+			run_bytecode(entry.path().string(), ostream.str());
 			std::cout << " [DONE]\n";
 		}
 	}
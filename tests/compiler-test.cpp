@@ -39,6 +39,13 @@ static void compiler_test() {
 		let T = {a : 1} 
 	)");
 
+	// fused instructions
+	print_disassembly(R"(
+		let i = 0
+		while i < 10 { i += 1 }
+		if i == 10 { i = i + 2 }
+	)");
+
 	// print_disassembly(R"(
 	// 	const tbl = {
 	// 		[123 + 4]: "abc" .. "def"
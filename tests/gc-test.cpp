@@ -26,8 +26,10 @@ void test_gc() {
 
 	ASSERT_MEM(vm.memory(), 0, "0kb allocated before compilation is triggered.");
 
+	// Tables created from literals use the shaped layout, and don't allocate any slots until they
+	// get a key.
 	vm.runcode("const empty_t = {}");
-	ASSERT_MEM(vm.memory(), table_size() + base_size, "Empty table allocations.");
+	ASSERT_MEM(vm.memory(), table_size(0) + base_size, "Empty table allocations.");
 	vm.collect_garbage();
 
 	vm.runcode("const s = 'abcdefg'");
@@ -116,12 +116,59 @@ void intern_test() {
 	delete s;
 }
 
+void shape_test() {
+	vy::Shape root;
+	unique_str_ptr x(STR("x", 1));
+	unique_str_ptr y(STR("y", 1));
+
+	vy::Table a(&root);
+	vy::Table b(&root);
+	a.set(VYSE_OBJECT(x.get()), NUM(1));
+	a.set(VYSE_OBJECT(y.get()), NUM(2));
+	b.set(VYSE_OBJECT(x.get()), NUM(3));
+	b.set(VYSE_OBJECT(y.get()), NUM(4));
+	EXPECT(a.shape() != nullptr and a.shape() == b.shape(),
+		   "Tables with the same string keys in the same order share a shape.");
+	EXPECT(a.get(VYSE_OBJECT(y.get())) == NUM(2) and b.get(VYSE_OBJECT(x.get())) == NUM(3),
+		   "Table::get on shaped tables.");
+	EXPECT(a.length() == 2, "Table::length on shaped tables.");
+
+	vy::Table c(&root);
+	c.set(VYSE_OBJECT(y.get()), NUM(5));
+	c.set(VYSE_OBJECT(x.get()), NUM(6));
+	EXPECT(c.shape() != a.shape(), "Tables with keys added in a different order.");
+
+	a.set(VYSE_OBJECT(x.get()), NIL);
+	EXPECT(a.shape() == nullptr, "Removing a key switches to the hash table layout.");
+	EXPECT(VYSE_IS_NIL(a.get(VYSE_OBJECT(x.get()))) and a.get(VYSE_OBJECT(y.get())) == NUM(2),
+		   "Keys and values are kept when switching layouts.");
+
+	b.set(NUM(1), NUM(7));
+	EXPECT(b.shape() == nullptr and b.get(NUM(1)) == NUM(7), "Non string keys switch layouts.");
+	EXPECT(b.get(VYSE_OBJECT(y.get())) == NUM(4),
+		   "Keys and values are kept when switching layouts.");
+
+	std::vector<unique_str_ptr> keys;
+	vy::Table d(&root);
+	for (size_t i = 0; i <= vy::Shape::MaxKeys; ++i) {
+		const std::string k = "key" + std::to_string(i);
+		keys.emplace_back(STR(k.c_str(), k.size()));
+		d.set(VYSE_OBJECT(keys.back().get()), NUM(i));
+	}
+	EXPECT(d.shape() == nullptr and d.length() == vy::Shape::MaxKeys + 1,
+		   "Tables with too many keys switch to the hash table layout.");
+	for (size_t i = 0; i <= vy::Shape::MaxKeys; ++i) {
+		EXPECT(d.get(VYSE_OBJECT(keys[i].get())) == NUM(i), "Table::get after a shape explosion.");
+	}
+}
+
 int main() {
 	run_test();
 	resize_test();
 	removal_test();
 	strkey_test();
 	intern_test();
+	shape_test();
 
 	std::cout << "[All Table Tests Passed]\n";
 
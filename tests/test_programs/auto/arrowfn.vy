@@ -10,3 +10,16 @@ const mult = /(a, b) -> {
 }
 
 assert(mult(2, 3) == 6)
+
+-- Functions that capture nothing are made once, and reused.
+const made = []
+for i = 0, 3 { made <<< /(x) -> x + 1 }
+assert(made[0] == made[2] and made[1](1) == 2)
+
+-- Ones that do capture are made every time.
+const capturing = []
+for i = 0, 3 {
+  const j = i
+  capturing <<< /(x) -> x + j
+}
+assert(capturing[0] != capturing[2] and capturing[2](1) == 3)
@@ -0,0 +1,77 @@
+-- Locals that are never reassigned are copied into the closures that capture them.
+fn make_adder(n) {
+  const add = /(x) -> x + n
+  return add
+}
+const add5 = make_adder(5)
+assert(add5(1) == 6 and make_adder(1)(1) == 2)
+
+const scale = 3
+const scaled = [1, 2, 3]:map(/(x) -> x * scale)
+assert(scaled[0] == 3 and scaled[2] == 9)
+
+-- Copies are passed down through closures nested several levels deep.
+fn outer(a) {
+  const b = a * 2
+  return fn() {
+    return fn() { return a + b }
+  }
+}
+assert(outer(1)()() == 3)
+
+-- Locals that are reassigned, before or after being captured, are shared with the closure.
+fn make_counter() {
+  let count = 0
+  return fn() {
+    count += 1
+    return count
+  }
+}
+const counter = make_counter()
+counter()
+assert(counter() == 2)
+
+fn late_assign() {
+  let x = 1
+  const get = fn() { return x }
+  x = 10
+  return get()
+}
+assert(late_assign() == 10)
+
+-- A shadowing variable that is reassigned keeps the one it shadows shared too.
+fn shadow() {
+  let v = 1
+  const get = fn() { return v }
+  {
+    let v = 2
+    v = 3
+  }
+  return get()
+}
+assert(shadow() == 1)
+
+-- Closures made in a loop body copy that iteration's locals.
+const fns = []
+let i = 0
+while i < 3 {
+  const j = i
+  fns <<< fn() { return j }
+  i = i + 1
+}
+assert(fns[0]() == 0 and fns[2]() == 2)
+
+-- All iterations of a for loop share the loop variable.
+const shared = []
+for k = 0, 3 { shared <<< fn() { return k } }
+assert(shared[0]() == shared[2]())
+
+-- A function that calls itself captures it's own name.
+fn fact(n) {
+  const rec = fn(m) {
+    if m <= 1 { return 1 }
+    return m * fact(m - 1)
+  }
+  return rec(n)
+}
+assert(fact(5) == 120)
@@ -0,0 +1,75 @@
+-- conditions and increments that compile to fused instructions.
+let i = 0
+let n = 10
+let sum = 0
+while i < n {
+  sum += i
+  i = i + 1
+}
+assert(i == 10 and sum == 45)
+
+let x = 0.5
+while x <= 3 { x += 1 }
+assert(x == 3.5)
+
+-- every comparison, with locals and with constants.
+fn check(a, b) {
+  let res = ''
+  if a == b { res = res .. '=' }
+  if a != b { res = res .. '!' }
+  if a < b { res = res .. '<' }
+  if a <= b { res = res .. 'l' }
+  if a > b { res = res .. '>' }
+  if a >= b { res = res .. 'g' }
+  return res
+}
+
+assert(check(1, 2) == '!<l')
+assert(check(2, 2) == '=lg')
+assert(check(2.5, 2) == '!>g')
+assert(check(1, 1.0) == '=lg')
+
+fn check_const(a) {
+  let res = ''
+  if a == 2 { res = res .. '=' }
+  if a != 2 { res = res .. '!' }
+  if a < 2 { res = res .. '<' }
+  if a <= 2 { res = res .. 'l' }
+  if a > 2 { res = res .. '>' }
+  if a >= 2 { res = res .. 'g' }
+  return res
+}
+
+assert(check_const(1) == '!<l')
+assert(check_const(2) == '=lg')
+assert(check_const(3.5) == '!>g')
+
+let s = 'abc'
+let matched = false
+if s == 'abc' { matched = true }
+assert(matched)
+
+-- operands that are not numbers go through overloads.
+const Num = {
+  new(v) { return setproto({ v: v }, self) }
+}
+Num.__lt = /(a, b) -> a.v < b.v
+Num.__add = fn (a, b) { return Num:new(a.v + b) }
+
+let lo = Num:new(1)
+const hi = Num:new(5)
+let steps = 0
+while lo < hi {
+  lo += 1
+  steps += 1
+}
+assert(steps == 4 and lo.v == 5)
+
+let count = 0
+if lo < hi { count = 1 } else { count = 2 }
+assert(count == 2)
+
+-- integers that overflow when incremented.
+let big = 2147483647
+big = big + 1
+assert(big == 2147483648)
@@ -0,0 +1,74 @@
+-- field accesses are cached per instruction, the caches must notice every change to the tables.
+fn get_x(t) { return t.x }
+fn set_x(t, v) { t.x = v }
+fn call_f(t) { return t:f() }
+
+-- the same site sees different tables, and tables that grow and get rehashed.
+const a = { x: 1 }
+const b = { y: 2, x: 3 }
+assert(get_x(a) == 1)
+assert(get_x(b) == 3)
+assert(get_x(a) == 1)
+for i = 0, 100 { a[i] = i }
+assert(get_x(a) == 1)
+
+-- removing a key.
+a.x = nil
+assert(get_x(a) == nil)
+set_x(a, 10)
+assert(get_x(a) == 10)
+set_x(b, 20)
+set_x(a, 11)
+assert(a.x == 11 and b.x == 20)
+
+-- keys found on the prototype.
+const proto = { f: /() -> 'proto', x: 'proto x' }
+const obj = setproto({}, proto)
+assert(call_f(obj) == 'proto')
+assert(get_x(obj) == 'proto x')
+
+-- a key added to the object shadows the prototype.
+obj.f = /() -> 'own'
+assert(call_f(obj) == 'own')
+obj.f = nil
+assert(call_f(obj) == 'proto')
+
+-- changing the prototype.
+const other = { f: /() -> 'other' }
+setproto(obj, other)
+assert(call_f(obj) == 'other')
+assert(get_x(obj) == nil)
+
+-- changing the prototype's fields.
+other.f = /() -> 'changed'
+assert(call_f(obj) == 'changed')
+
+-- longer prototype chains, with a key shadowed half way through.
+const base = { f: /() -> 'base' }
+const mid = setproto({}, base)
+const leaf = setproto({}, mid)
+assert(call_f(leaf) == 'base')
+mid.f = /() -> 'mid'
+assert(call_f(leaf) == 'mid')
+
+-- compound assignment to the first constant of a function.
+fn incr(t) {
+  t.n += 1
+  return t.n
+}
+assert(incr({ n: 1 }) == 2)
+
+-- a cache filled by a table that has the key itself, used by a table of another shape (or one
+-- that isn't shaped) which also has the key and a prototype with it.
+const P = { x: 'proto' }
+fn get_own_x(o) { return o.x }
+assert(get_own_x({ x: 'a-own' }) == 'a-own')
+assert(get_own_x(setproto({ x: 'b-own', y: 1 }, P)) == 'b-own')
+
+const hashed_a = {}
+hashed_a.x = 'a-own'
+const hashed_b = setproto({}, P)
+hashed_b.z = 1
+hashed_b.x = 'b-own'
+fn get_hashed_x(o) { return o.x }
+assert(get_hashed_x(hashed_a) == 'a-own' and get_hashed_x(hashed_b) == 'b-own')
@@ -0,0 +1,56 @@
+-- integer arithmetic promotes to doubles on overflow
+const big = 2147483647
+assert(big + 1 == 2147483648)
+assert(big * big == 4611686014132420609)
+assert(-big - 2 == -2147483649)
+assert(-(-big - 1) == 2147483648)
+
+-- mixed integer and double operands
+assert(1 + 0.5 == 1.5)
+assert(3 / 2 == 1.5)
+assert(7 % 3 == 1)
+assert(-7 % 3 == -1)
+assert(7 % 0.5 == 0)
+assert(1 == 1.0)
+assert(2 < 2.5 and 2.5 < 3)
+
+-- bitwise operators
+assert((5 & 3) == 1)
+assert((5 | 3) == 7)
+assert((5 ^ 3) == 6)
+assert((1 << 40) == 1099511627776)
+assert((1099511627776 >> 38) == 4)
+assert(~0 == -1)
+assert((5.0 & 3) == 1)
+
+-- integers and doubles are the same table key
+const t = {}
+t[1] = 'one'
+assert(t[1.0] == 'one')
+
+-- lists can be indexed with either
+const xs = [10, 20, 30]
+assert(xs[1] == 20)
+assert(xs[2.0] == 30)
+xs[0.0] = 5
+assert(xs[0] == 5)
+assert(#xs == 3)
+
+-- for loops whose counter overflows into a double
+let count = 0
+for i = 2147483645, 2147483650 {
+  count = count + 1
+}
+assert(count == 5)
+
+let sum = 0
+for i = 10, 0, -2 {
+  sum = sum + i
+}
+assert(sum == 30)
+
+let fsum = 0
+for i = 0, 2, 0.5 {
+  fsum = fsum + i
+}
+assert(fsum == 3)
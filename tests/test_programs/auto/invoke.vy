@@ -0,0 +1,75 @@
+-- method calls whose arguments have no side effects are a single `invoke` instruction.
+const Point = {
+  norm1: fn(self) { return self.x + self.y },
+  sum: fn(self, a, b, c) { return self.x + a + b + c }
+}
+Point.scaled = fn(self, k) { return setproto({ x: self.x * k, y: self.y * k }, Point) }
+
+fn run() {
+  const p = setproto({ x: 1, y: 2 }, Point)
+  const k = 2
+  let total = 0
+  for i = 0, 3 {
+    total = total + p:norm1() + p:scaled(k):norm1() + p:sum(i, 10, k)
+  }
+  return total
+}
+assert(run() == 3 * 3 + 3 * 6 + (0 + 1 + 2) + 3 * 13)
+
+-- missing arguments are nil and extra ones are dropped.
+const Args = {
+  count: fn(self, a, b) {
+    if b == nil { return 1 }
+    return 2
+  }
+}
+fn count_args() {
+  const x = 1
+  const a = Args:count(x)
+  const b = Args:count(x, x, x, x)
+  return a * 10 + b
+}
+assert(count_args() == 12)
+
+-- tables, lists and functions made in the arguments.
+const Calls = { apply: fn(self, t, l, f) { return f(t.v + l[1]) } }
+fn literals() {
+  const n = 3
+  const r = Calls:apply({ v: n }, [0, n], /x -> x * 2)
+  return r
+}
+assert(literals() == 12)
+
+-- methods of primitives come from their prototypes.
+fn primitives() {
+  const s = "hello"
+  const sub = s:substr(1, 3)
+  const l = [1, 2, 3]
+  const m = l:map(/x -> x + 1)
+  return [sub, m[2]]
+}
+const prims = primitives()
+assert(prims[0] == "ell" and prims[1] == 4)
+
+-- the cache of an `invoke` sees changes to the object and it's prototype.
+fn call_f(t) {
+  const v = t:f()
+  return v
+}
+const proto = { f: /() -> 'proto' }
+const obj = setproto({}, proto)
+assert(call_f(obj) == 'proto')
+obj.f = /() -> 'own'
+assert(call_f(obj) == 'own')
+obj.f = nil
+proto.f = /() -> 'changed'
+assert(call_f(obj) == 'changed')
+
+-- a method call in tail position is still a tail call.
+const Counter = {
+  down: fn(self, n) {
+    if n == 0 { return self.done }
+    return self:down(n - 1)
+  }
+}
+assert(setproto({ done: 'done' }, Counter):down(100000) == 'done')
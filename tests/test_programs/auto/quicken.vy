@@ -0,0 +1,32 @@
+-- instructions quickened after seeing only numbers, lists or tables must still handle other operands.
+const Num = {
+  new(v) { return setproto({ v: v }, self) }
+}
+Num.__add = /(a, b) -> Num:new(a.v + b.v)
+Num.__lt = /(a, b) -> a.v < b.v
+
+fn add(a, b) { return a + b }
+fn less(a, b) { return a < b }
+fn index(xs, i) { return xs[i] }
+fn field(t) { return t.v }
+
+for round = 0, 3 {
+  for i = 0, 20 {
+    assert(add(i, 1) == i + 1)
+    assert(add(0.5, i) == i + 0.5)
+    assert(less(i, 100))
+    assert(index([1, 2, 3], 1) == 2)
+    assert(field({ v: i }) == i)
+  }
+
+  assert(add(Num:new(1), Num:new(2)).v == 3)
+  assert(less(Num:new(1), Num:new(2)))
+  assert(index({ k: 'v' }, 'k') == 'v')
+  assert(index('abc', 1) == 'b')
+  assert(field(setproto({}, { v: 'proto' })) == 'proto')
+}
+
+-- list indices that are not integers.
+const xs = [1, 2, 3]
+for i = 0, 20 { index(xs, 0) }
+assert(index(xs, 1.0) == 2)
@@ -0,0 +1,48 @@
+-- tables created from literals share shapes, and switch to hash tables when they have to.
+fn make_point(x, y) { return { x: x, y: y } }
+
+const points = []
+for i = 0, 100 { points <<< make_point(i, i * 2) }
+for i = 0, 100 {
+  const p = points[i]
+  assert(p.x == i and p.y == i * 2)
+  assert(#p == 2)
+}
+
+-- adding keys after creation.
+const p = make_point(1, 2)
+p.z = 3
+assert(p.x + p.y + p.z == 6)
+p.x = 10
+assert(p.x == 10)
+
+-- removing a key.
+p.y = nil
+assert(p.y == nil and p.x == 10 and p.z == 3)
+assert(#p == 2)
+p.y = 20
+assert(p.y == 20)
+
+-- keys that are not strings.
+const q = make_point(1, 2)
+q[0] = 'zero'
+q[true] = 'true'
+assert(q[0] == 'zero' and q[true] == 'true' and q.x == 1 and q.y == 2)
+
+-- computed string keys are the same as field names.
+const r = { ['a' .. 'b']: 1 }
+assert(r.ab == 1)
+r['c' .. 'd'] = 2
+assert(r.cd == 2)
+
+-- more keys than a shape can hold.
+const big = {}
+for i = 0, 100 { big['k' .. i:to_string()] = i }
+for i = 0, 100 { assert(big['k' .. i:to_string()] == i) }
+assert(#big == 100)
+
+-- prototypes.
+const Animal = { speak() { return self.sound } }
+const dog = setproto({ sound: 'woof' }, Animal)
+const cat = setproto({ sound: 'meow' }, Animal)
+assert(dog:speak() == 'woof' and cat:speak() == 'meow')
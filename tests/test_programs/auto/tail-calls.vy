@@ -0,0 +1,63 @@
+-- calls in tail position reuse the caller's frame, so they can recurse past the call stack's limit.
+fn count(n, acc) {
+  if n == 0 { return acc }
+  return count(n - 1, acc + 1)
+}
+assert(count(100000, 0) == 100000)
+
+let is_odd = nil
+fn is_even(n) {
+  if n == 0 { return true }
+  return is_odd(n - 1)
+}
+is_odd = /n -> n != 0 and is_even(n - 1)
+assert(is_even(5000) and !is_even(5001))
+
+-- the extra arguments of a tail call are dropped, and the missing ones are nil.
+const pair = /(a, b) -> [a, b]
+fn call_pair(x) { return pair(x, x + 1, x + 2) }
+fn call_pair_short(x) { return pair(x) }
+assert(call_pair(1)[1] == 2 and call_pair_short(1)[1] == nil)
+
+const sum = /(xs...) -> xs:reduce(/(x, y) -> x + y)
+fn call_sum(a, b, c) { return sum(a, b, c) }
+assert(call_sum(1, 2, 3) == 6)
+
+-- native functions, and tables with a `__call` overload.
+fn describe(x) { return x:to_string() }
+assert(describe(12) == '12')
+
+const Counter = { __call: fn (self, n) { return n * 2 } }
+const doubler = setproto({}, Counter)
+fn double(n) { return doubler(n) }
+assert(double(21) == 42)
+
+-- methods.
+const Node = {
+  depth(n) {
+    if n == 0 { return self.name }
+    return self:depth(n - 1)
+  }
+}
+const node = setproto({ name: 'node' }, Node)
+assert(node:depth(5000) == 'node')
+
+-- the function making the tail call closes over it's locals before it's frame is reused.
+const id = /(x) -> x
+fn make_getter(v) {
+  const get = fn () { return v }
+  return id(get)
+}
+assert(make_getter(10)() == 10)
+
+-- calls that are skipped by a jump still return to the function that made them.
+fn first_or(x, fallback) { return x or id(fallback) }
+assert(first_or(1, 2) == 1 and first_or(nil, 2) == 2)
+
+-- functions that return a constant without making any call.
+fn ret_nil() { return nil }
+fn ret_true() { return true }
+fn ret_false() { return false }
+assert(ret_nil() == nil and ret_true() and !ret_false())
+const Cmp = { __lt: fn (a, b) { return nil } }
+assert(!(setproto({}, Cmp) < setproto({}, Cmp)))
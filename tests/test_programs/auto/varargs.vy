@@ -9,4 +9,34 @@ assert(mult(1, 2) == 2 && mult(1, 2, 3) == 6, "varargs in arrow functions broken
 
 const scale_and_reduce = /a, xs... -> a * xs:reduce(/x, y -> x + y)
 
-assert(scale_and_reduce(2, 1, 2, 3) == 12, "varargs preceding an argument broken")
\ No newline at end of file
+assert(scale_and_reduce(2, 1, 2, 3) == 12, "varargs preceding an argument broken")
+-- rest parameters that are only indexed or measured keep their arguments on the stack.
+fn sum(xs...) {
+  let total = 0
+  for i = 0, #xs { total = total + xs[i] }
+  return total
+}
+assert(sum(5) == 5 and sum(1, 2, 3, 4) == 10, "on-stack varargs broken")
+
+fn second(a, rest...) {
+  if #rest < 2 { return a }
+  return rest[1]
+}
+assert(second(1, 2) == 1 and second(1, 2, 3) == 3, "fixed params with varargs")
+
+const last = /(xs...) -> xs[#xs - 1]
+assert(last(7, 8, 9) == 9, "on-stack varargs in arrow functions")
+
+-- the function's result replaces it, and the extra arguments are gone after the call.
+const results = [sum(1, 2), sum(3, 4, 5, 6), second(0, 1, 2)]
+assert(results[0] == 3 and results[1] == 18 and results[2] == 2 and #results == 3)
+
+-- rest parameters that escape are still lists, and nil when there are no extra arguments.
+fn pack(xs...) { return xs }
+assert(pack() == nil and pack(1, 2)[1] == 2, "escaping varargs broken")
+
+fn count_later(xs...) {
+  const get = fn () { return #xs }
+  return get()
+}
+assert(count_later(1, 2, 3) == 3, "captured varargs broken")
@@ -10,6 +10,14 @@
 using namespace vy;
 using TT = vy::TokenType;
 
+Tier test_tier = Tier::Stack;
+
+static VMConfig test_config() {
+	VMConfig config;
+	config.tier = test_tier;
+	return config;
+}
+
 void print_ttype(vy::TokenType type) {
 	std::string type_strs[] = {
 		"Integer",	 "Float",	   "String",
@@ -77,14 +85,14 @@ void assert_val_eq(Value expected, Value actual, const char* message) {
 }
 
 void test_return(const std::string&& code, Value expected, const char* message) {
-	VM vm;
+	VM vm{test_config()};
 	vm.load_stdlib();
 	vm.runcode(code);
 	assert_val_eq(expected, vm.return_value, message);
 }
 
 void test_error(std::string&& code, const std::string& message) {
-	VM vm;
+	VM vm{test_config()};
 	vm.load_stdlib();
 	vm.on_error = [](VM& vm, RuntimeError error) {
 		vm.set_global("#ErrMsg#",
@@ -124,7 +132,7 @@ void test_file(const char* filename, Value expected, const char* message) {
 
 void test_string_return(const char* filename, const char* expected, const char* message) {
 	std::string code{load_file(filename)};
-	VM vm;
+	VM vm{test_config()};
 	vm.load_stdlib();
 
 	if (vm.runcode(code) != ExitCode::Success) {
@@ -148,7 +156,7 @@ void test_string_return(const char* filename, const char* expected, const char*
 }
 
 void runcode(std::string&& code) {
-	VM vm;
+	VM vm{test_config()};
 	vm.load_stdlib();
 	ExitCode ec = vm.runcode(code);
 	if (ec != ExitCode::Success) {
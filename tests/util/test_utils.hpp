@@ -2,6 +2,10 @@
 #include <block.hpp>
 #include <compiler.hpp>
 #include <token.hpp>
+#include <vm.hpp>
+
+/// The tier that the VMs created by the helpers below run code on.
+extern vy::Tier test_tier;
 
 void print_ttype(vy::TokenType ttype);
 void print_token(const vy::Token& token, const std::string& src);
@@ -1,9 +1,18 @@
 #include "assert.hpp"
+#include "bytecode.hpp"
+#include "compiler.hpp"
+#include "prepared_call.hpp"
 #include "util/test_utils.hpp"
 #include "value.hpp"
 #include "vm.hpp"
+#include <cstring>
+#include <filesystem>
 #include <fstream>
+#include <util/args.hpp>
+#include <util/lib_util.hpp>
+#include <util/native_module.hpp>
 #include <memory>
+#include <sstream>
 #include <stdlib.h>
 
 using namespace vy;
@@ -134,10 +143,27 @@ static void table_test() {
 	std::cout << "[Table tests passed]\n";
 }
 
+static std::string error_trace;
+
 static void global_test() {
 	VM vm;
 	vm.set_global("foo", NUM(42));
 	assert_val_eq(vm.get_global("foo"), NUM(42), "Global variables.");
+	ASSERT(VYSE_IS_UNDEFINED(vm.get_global("bar")), "Missing globals are undefined.");
+
+	// `get_bar` is compiled before `bar` is defined, from either Vyse or C++.
+	vm.on_error = [](VM&, RuntimeError error) { error_trace = error.message; };
+	ExitCode res = vm.runcode("get_bar = fn() { return bar }  return get_bar()");
+	ASSERT(res == ExitCode::RuntimeError and
+			   error_trace.find("Undefined variable 'bar'.") != std::string::npos,
+		   "Reading an undefined global is an error.");
+	ASSERT(VYSE_IS_UNDEFINED(vm.get_global("bar")), "Compiling a global doesn't define it.");
+
+	vm.set_global("bar", NUM(1));
+	res = vm.runcode("bar = bar + foo  return get_bar()");
+	ASSERT(res == ExitCode::Success, "Globals are shared between runs.");
+	assert_val_eq(vm.return_value, NUM(43), "Globals defined after the code using them.");
+	assert_val_eq(vm.get_global("bar"), NUM(43), "Globals set from Vyse are visible from C++.");
 }
 
 static void string_test() {
@@ -181,21 +207,744 @@ static void multiple_runs_test() {
 	ASSERT(res == ExitCode::Success, fail_message);
 }
 
+static void inline_cache_test() {
+	VM vm;
+	vm.load_stdlib();
+	vm.runcode(R"(
+		const Point = { get_x() { return self.x } }
+		const p = setproto({ x: 1 }, Point)
+		for i = 0, 100 { p.x = p:get_x() + 1 }
+	)");
+
+	const InlineCacheStats stats = vm.ic_stats();
+	ASSERT(stats.hits + stats.misses >= 300, "Inline caches count every lookup.");
+	ASSERT(stats.misses < 10, "Inline caches hit on repeated field accesses.");
+	std::cout << "[Inline cache tests passed]\n";
+}
+
+/// @return The offset of the first [op] instruction in [block], or -1 if there is none.
+static int find_op(const Block& block, Opcode op) {
+	for (size_t i = 0; i < block.code.size(); i += 1 + Compiler::op_arity(block, i)) {
+		if (block.code[i] == op) return i;
+	}
+	return -1;
+}
+
+static void quickening_test() {
+	VM vm;
+	vm.load_stdlib();
+	vm.runcode(R"(
+		add = fn (a, b) { return a + b }
+		for i = 0, 20 { add(i, 1.5) }
+	)");
+
+	const Block& block = VYSE_AS_CLOSURE(vm.get_global("add"))->m_codeblock->block();
+	const int offset = find_op(block, Opcode::add_num_num);
+	ASSERT(offset >= 0, "'add' is quickened after only seeing numbers.");
+	const TypeFeedback* feedback = block.feedback_at(offset);
+	ASSERT(feedback != nullptr, "Type feedback is collected for quickened instructions.");
+	ASSERT(feedback->seen == (TypeFeedback::Int | TypeFeedback::Double),
+		   "Type feedback records the kinds of operands seen.");
+
+	vm.runcode(R"(
+		const T = { __add: /(a, b) -> 1 }
+		assert(add(setproto({}, T), 2) == 1)
+	)");
+	ASSERT(block.code[offset] == Opcode::add, "Quickened instructions de-quicken on a type miss.");
+	ASSERT(feedback->dequickens == 1 and (feedback->seen & TypeFeedback::Table),
+		   "Type feedback records de-quickening.");
+	std::cout << "[Quickening tests passed]\n";
+}
+
+static void fused_ops_test() {
+	VM vm;
+	vm.load_stdlib();
+	vm.runcode(R"(
+		count = fn (a, b) {
+			let n = 0
+			while a < b {
+				a += 1
+				n = n + 1
+			}
+			if n != 5 { return -1 }
+			return n
+		}
+	)");
+
+	const Block& block = VYSE_AS_CLOSURE(vm.get_global("count"))->m_codeblock->block();
+	ASSERT(find_op(block, Opcode::lt_var_var_jmp) >= 0, "Comparing two locals is fused.");
+	ASSERT(find_op(block, Opcode::neq_var_const_jmp) >= 0, "Comparing with a constant is fused.");
+	ASSERT(find_op(block, Opcode::lt) == -1, "Fused comparisons replace the generic ones.");
+
+	const int incr = find_op(block, Opcode::add_var_const);
+	ASSERT(incr >= 0 and block.code[incr + 3] == Opcode::set_var, "Increments are fused.");
+	ASSERT(find_op(block, Opcode::add) == -1, "Fused increments replace the generic add.");
+
+	const ExitCode res = vm.runcode("assert(count(0, 5) == 5 and count(1.5, 6) == 5)");
+	ASSERT(res == ExitCode::Success, "Fused instructions run like the ones they replace.");
+	std::cout << "[Fused instruction tests passed]\n";
+}
+
+#ifndef VYSE_PROFILE_OPCODES
+/// @return true if the instructions starting at [offset] in [block] are the ones in [super],
+/// seeing through any superinstructions that they have been rewritten into.
+static bool is_sequence(const Block& block, size_t offset, const SuperInstruction& super) {
+	for (u8 i = 0; i < super.length; ++i) {
+		if (offset >= block.op_count()) return false;
+		Opcode op = block.code[offset];
+		if (op >= Op_super_start and op <= Op_super_end) op = superinstruction(op).ops[0];
+		if (op != super.ops[i]) return false;
+		offset += 1 + Compiler::op_arity(block, offset);
+	}
+	return super.length > 0;
+}
+#endif
+
+static void superinstruction_test() {
+	VM vm;
+	vm.load_stdlib();
+	vm.runcode(R"(
+		sum = fn (xs) {
+			let total = 0
+			let i = 0
+			while i < #xs {
+				const x = xs[i]
+				if x != nil { total = total + x * 2 - 1 }
+				i += 1
+			}
+			return total
+		}
+	)");
+
+	const Block& block = VYSE_AS_CLOSURE(vm.get_global("sum"))->m_codeblock->block();
+	for (size_t i = 0; i < block.op_count(); i += 1 + Compiler::op_arity(block, i)) {
+		const Opcode op = block.code[i];
+#ifdef VYSE_PROFILE_OPCODES
+		// Profiling builds count the sequences that superinstructions are made from, so they run
+		// the sequences unfused.
+		ASSERT(op < Op_super_start or op > Op_super_end,
+			   "Profiling builds don't emit superinstructions.");
+#else
+		if (op >= Op_super_start and op <= Op_super_end) {
+			ASSERT(is_sequence(block, i, superinstruction(op)),
+				   "Superinstructions replace the sequences they are made of.");
+			continue;
+		}
+
+		for (const SuperInstruction& super : superinstructions) {
+			ASSERT(!is_sequence(block, i, super),
+				   "Every sequence with a superinstruction uses it.");
+		}
+#endif
+	}
+
+	const ExitCode res = vm.runcode("assert(sum([1, 2, 3]) == 9 and sum([0.5]) == 0)");
+	ASSERT(res == ExitCode::Success, "Superinstructions run like the sequences they replace.");
+	std::cout << "[Superinstruction tests passed]\n";
+}
+
+static void register_tier_test() {
+	VMConfig config;
+	config.tier = Tier::Register;
+	VM vm{config};
+	vm.load_stdlib();
+	vm.runcode(R"(
+		poly = fn (x, y) {
+			let a = x * 2 + y
+			let b = a - x * y
+			return a * b + 1
+		}
+	)");
+
+	const Block& block = VYSE_AS_CLOSURE(vm.get_global("poly"))->m_codeblock->block();
+	ASSERT(block.has_register_code(), "Functions are translated to register code.");
+
+	size_t num_stack_instrs = 0;
+	for (size_t i = 0; i < block.op_count(); i += 1 + Compiler::op_arity(block, i)) {
+		++num_stack_instrs;
+	}
+	ASSERT(2 * block.reg_code.size() <= num_stack_instrs,
+		   "Register code needs at most half as many instructions for arithmetic.");
+
+	const ExitCode res = vm.runcode(R"(
+		assert(poly(3, 4) == -19 and poly(0.5, 1) == 4)
+		const V = { __mult: fn (v, k) { return v.x * k } }
+		assert(poly(setproto({ x: 3 }, V), 1) == 7 * (7 - 3) + 1)
+	)");
+	ASSERT(res == ExitCode::Success, "Register code runs like the stack code it replaces.");
+	std::cout << "[Register tier tests passed]\n";
+}
+
+static void vararg_test() {
+	VM vm;
+	vm.load_stdlib();
+	vm.runcode(R"(
+		sum = fn (xs...) {
+			let total = 0
+			for i = 0, #xs { total = total + xs[i] }
+			return total
+		}
+		pack = fn (xs...) { return xs }
+		count = /(xs...) -> xs:length()
+	)");
+
+	const auto code = [&](const char* name) -> const CodeBlock& {
+		return *VYSE_AS_CLOSURE(vm.get_global(name))->m_codeblock;
+	};
+	ASSERT(code("sum").keeps_varargs_on_stack(), "Indexed rest parameters stay on the stack.");
+	ASSERT(find_op(code("sum").block(), Opcode::len) == -1 and
+			   find_op(code("sum").block(), Opcode::subscript_get) == -1,
+		   "Rest parameters on the stack are read with the vararg instructions.");
+	ASSERT(!code("pack").keeps_varargs_on_stack() and !code("count").keeps_varargs_on_stack(),
+		   "Rest parameters that escape are lists.");
+
+	ExitCode res = vm.runcode("assert(sum(1, 2, 3) == 6 and #pack(1, 2) == 2)");
+	ASSERT(res == ExitCode::Success, "Functions with varargs on the stack return to their caller.");
+
+	// Without extra arguments the rest parameter is nil, whether or not it stays on the stack.
+	vm.on_error = [](VM&, RuntimeError error) { error_trace = error.message; };
+	ASSERT(vm.runcode("assert(pack() == nil)") == ExitCode::Success,
+		   "Rest parameters without arguments are nil.");
+	res = vm.runcode("sum()");
+	ASSERT(res == ExitCode::RuntimeError and
+			   error_trace.find("Attempt to get length of a nil value") != std::string::npos,
+		   "Rest parameters on the stack without arguments are nil.");
+	res = vm.runcode("first = fn (xs...) { return xs[0] }  first()");
+	ASSERT(res == ExitCode::RuntimeError and
+			   error_trace.find("Attempt to index a nil value.") != std::string::npos,
+		   "Rest parameters on the stack without arguments can't be indexed.");
+	std::cout << "[Vararg tests passed]\n";
+}
+
+static void tail_call_test() {
+	VM vm{VMConfig{}};
+	vm.load_stdlib();
+	vm.runcode(R"(
+		loop = fn (n) {
+			if n == 0 { return nil + 1 }
+			return loop(n - 1)
+		}
+		loop_plus_one = fn (n) { return loop(n) + 1 }
+	)");
+
+	const Block& block = VYSE_AS_CLOSURE(vm.get_global("loop"))->m_codeblock->block();
+	ASSERT(find_op(block, Opcode::tail_call) >= 0, "Returned calls are tail calls.");
+	const Block& other = VYSE_AS_CLOSURE(vm.get_global("loop_plus_one"))->m_codeblock->block();
+	ASSERT(find_op(other, Opcode::tail_call) == -1, "Only calls that are returned are tail calls.");
+
+	for (const Tier tier : {Tier::Stack, Tier::Register}) {
+		VMConfig config;
+		config.tier = tier;
+		VM vm{config};
+		vm.load_stdlib();
+		vm.on_error = [](VM&, RuntimeError error) { error_trace = error.full_message; };
+
+		vm.runcode(R"(
+			loop = fn (n) {
+				if n == 0 { return nil + 1 }
+				return loop(n - 1)
+			}
+			loop(5000)
+		)");
+		ASSERT(error_trace.find("[5000 frames elided by tail calls]") != std::string::npos,
+			   "Stack traces count the frames discarded by tail calls.");
+	}
+	std::cout << "[Tail call tests passed]\n";
+}
+
+static NativeStatus fast_add(VM& vm, Value* args, int, Value& result) {
+	if (!VYSE_IS_NUM(args[0]) or !VYSE_IS_NUM(args[1])) {
+		util::cfn_error(vm, "fast.add", "Expected numbers.");
+		return NativeStatus::Error;
+	}
+	result = VYSE_NUM(VYSE_AS_NUM(args[0]) + VYSE_AS_NUM(args[1]));
+	return NativeStatus::Ok;
+}
+
+static NativeStatus fast_apply(VM& vm, Value*, int, Value& result) {
+	// `args` is stale once the VM is re-entered, so the arguments are read from the call frame.
+	const Value fn = vm.get_arg(0);
+	const Value arg = vm.get_arg(1);
+	vm.m_stack.push(fn);
+	vm.m_stack.push(arg);
+	if (!vm.call(1)) return NativeStatus::Error;
+	result = vm.m_stack.pop();
+	return NativeStatus::Ok;
+}
+
+static void fast_native_test() {
+	VM vm;
+	vm.load_stdlib();
+	Table& fast = vm.make<Table>();
+	vm.set_global("fast", VYSE_OBJECT(&fast));
+	{
+		util::NativeModule module(&vm, &fast);
+		module.add_cfunc("add", fast_add, 2, false);
+		module.add_cfunc("apply", fast_apply, 2);
+	}
+
+	ExitCode res = vm.runcode(R"(
+		assert(fast.add(1, 2) == 3 and fast.add(1, 2, 3) == 3)
+		assert(fast.apply(/x -> fast.add(x, 1), 41) == 42)
+	)");
+	ASSERT(res == ExitCode::Success, "Status returning native functions can be called.");
+
+	vm.on_error = [](VM&, RuntimeError error) { error_trace = error.message; };
+	res = vm.runcode("fast.add(1)");
+	ASSERT(res == ExitCode::RuntimeError and
+			   error_trace.find("Expected 2 arguments. Got 1.") != std::string::npos,
+		   "The VM checks the arity of status returning native functions.");
+	res = vm.runcode("fast.add(1, 'x')");
+	ASSERT(res == ExitCode::RuntimeError and
+			   error_trace.find("In call to fast.add: Expected numbers.") != std::string::npos,
+		   "Status returning native functions report their own errors.");
+	std::cout << "[Fast native function tests passed]\n";
+}
+
+static number scale(number x, std::optional<number> factor) {
+	return x * factor.value_or(2);
+}
+
+static bool is_long(const String& s) {
+	return s.len() > 3;
+}
+
+static String* repeat(VM& vm, const String& s, number n) {
+	if (n < 0) throw util::BindError("Expected a positive count.");
+
+	std::string repeated;
+	for (int i = 0; i < n; ++i) repeated += s.c_str();
+	return &vm.make_string(repeated.c_str());
+}
+
+static void bind_test() {
+	static_assert(bind<&scale>().arity == 1 and bind<&repeat>().arity == 2,
+				  "Bound functions take as many arguments as they have required parameters.");
+
+	VM vm;
+	vm.load_stdlib();
+	Table& bound = vm.make<Table>();
+	vm.set_global("bound", VYSE_OBJECT(&bound));
+	{
+		util::NativeModule module(&vm, &bound);
+		module.add_cfunc("scale", bind<&scale>());
+		module.add_cfunc("is_long", bind<&is_long>());
+		module.add_cfunc("rep", bind<&repeat>());
+	}
+
+	ExitCode res = vm.runcode(R"(
+		assert(bound.scale(3) == 6 and bound.scale(3, 3) == 9 and bound.scale(3, nil) == 6)
+		assert(bound.is_long('vyse!') and !bound.is_long('vy'))
+		assert(bound.rep('ab', 3) == 'ababab')
+	)");
+	ASSERT(res == ExitCode::Success, "Bound functions convert their arguments and results.");
+
+	vm.on_error = [](VM&, RuntimeError error) { error_trace = error.message; };
+	res = vm.runcode("bound.is_long(10)");
+	ASSERT(res == ExitCode::RuntimeError and
+			   error_trace.find("Bad argument #1 to 'is_long' expected string, got number.") !=
+				   std::string::npos,
+		   "Bound functions check the types of their arguments.");
+	res = vm.runcode("bound.scale(1, 'x')");
+	ASSERT(res == ExitCode::RuntimeError and
+			   error_trace.find("Bad argument #2") != std::string::npos,
+		   "Optional arguments are type checked when they are passed.");
+	res = vm.runcode("bound.rep('a', -1)");
+	ASSERT(res == ExitCode::RuntimeError and
+			   error_trace.find("In call to rep: Expected a positive count.") != std::string::npos,
+		   "Bound functions report errors with the name they were registered under.");
+	std::cout << "[Native binding tests passed]\n";
+}
+
+static void prepared_call_test() {
+	VM vm;
+	vm.load_stdlib();
+	vm.runcode(R"(
+		add = fn (a, b) { return a + b }
+		first = /x -> x
+		count = /(xs...) -> #xs
+		firsts = setproto({}, { __call: fn (self, a, b) { return a } })
+		concat = fn (a, b) { return a .. b }
+	)");
+
+	const auto sum_with = [&](const char* fname) {
+		PreparedCall call(vm, vm.get_global(fname), 2);
+		number total = 0;
+		for (int i = 0; i < 100; ++i) {
+			call.arg(0) = VYSE_NUM(i);
+			call.arg(1) = VYSE_NUM(i);
+			ASSERT(call.invoke(), "Prepared calls succeed.");
+			total += VYSE_AS_NUM(call.result());
+		}
+		return total;
+	};
+
+	ASSERT(sum_with("add") == 9900, "Prepared calls pass their arguments.");
+	ASSERT(sum_with("first") == 4950, "Extra arguments are left out of a prepared call.");
+	ASSERT(sum_with("count") == 200, "Variadic functions can be prepared.");
+	ASSERT(sum_with("firsts") == 4950, "Tables with a `__call` overload can be prepared.");
+
+	{
+		// Calls that allocate can collect the garbage left by the ones before them.
+		PreparedCall call(vm, vm.get_global("concat"), 2);
+		for (int i = 0; i < 10000; ++i) {
+			call.arg(0) = VYSE_OBJECT(&vm.make_string("vy"));
+			call.arg(1) = VYSE_OBJECT(&vm.make_string("se"));
+			ASSERT(call.invoke() and VYSE_AS_STRING(call.result())->len() == 4,
+				   "Prepared calls keep their arguments alive.");
+		}
+	}
+
+	{
+		PreparedCall call(vm, vm.get_global("add"), 2);
+		call.arg(0) = VYSE_NUM(1);
+		call.arg(1) = VYSE_NIL;
+		ASSERT(!call.invoke(), "Prepared calls report errors.");
+	}
+	std::cout << "[Prepared call tests passed]\n";
+}
+
+static void jit_test() {
+	if (!Jit::Supported) return;
+
+	VMConfig config;
+	config.jit = true;
+	config.jit_threshold = 10;
+	VM vm{config};
+	vm.load_stdlib();
+	vm.on_error = [](VM&, RuntimeError error) { error_trace = error.message; };
+	vm.runcode(R"(
+		poly = fn (x, y) {
+			let a = x * 2 + y
+			let b = a - x * y
+			return a * b + 1
+		}
+		sum_to = fn (n) {
+			let total = 0
+			for i = 0, n { total = total + i }
+			return total
+		}
+		cold = fn () { return 1 }
+	)");
+
+	const auto jit_code = [&](const char* fname) {
+		return VYSE_AS_CLOSURE(vm.get_global(fname))->m_codeblock->jit_code();
+	};
+
+	ExitCode res = vm.runcode(R"(
+		for i = 0, 20 { assert(poly(i, 1) == (i * 2 + 1) * (i + 1) + 1) }
+		assert(sum_to(100) == 4950)
+		cold()
+	)");
+	ASSERT(res == ExitCode::Success, "JIT-ed code gives the same results as the interpreter.");
+	ASSERT(jit_code("poly") != nullptr, "Functions that are called often are compiled.");
+	ASSERT(jit_code("sum_to") != nullptr, "Functions with hot loops are compiled.");
+	ASSERT(jit_code("cold") == nullptr, "Functions that are rarely run are not compiled.");
+
+	res = vm.runcode(R"(
+		assert(poly(0.5, 1) == 4)
+		assert(poly(65536, 0) == 17179869184 + 1)
+		const V = { __mult: fn (v, k) { return v.x * k } }
+		assert(poly(setproto({ x: 3 }, V), 1) == 7 * (7 - 3) + 1)
+	)");
+	ASSERT(res == ExitCode::Success, "JIT-ed code handles floats, overflow and overloads.");
+
+	res = vm.runcode("poly(nil, 1)");
+	ASSERT(res == ExitCode::RuntimeError and
+			   error_trace.find("Bad types for operator '*'") != std::string::npos,
+		   "JIT-ed code reports runtime errors.");
+	std::cout << "[JIT tests passed]\n";
+}
+
 static void negative_tests() {
 	test_error("1 + 2", "Unexpected expression.");
 	test_error("_ = nil[0]", "Attempt to index a nil value.");
 	test_error("=", "Unexpected '='.");
+	test_error("const f = /(xs...) -> xs[2]\nf(1, 2)",
+			   "List index out of bounds. (index: 2, length: 2)");
+}
+
+static void bytecode_test() {
+	const char* const code = R"(
+		const add = fn (xs...) { return xs:reduce(/x, y -> x + y) }
+		let s = "str" .. "1.5"
+		return add(1, 2, 3) + #s
+	)";
+
+	VM vm;
+	vm.load_stdlib();
+	Closure* const script = vm.compile(SourceCode{"bytecode.vy", code});
+	ASSERT(script != nullptr, "Scripts compile.");
+	const std::string bytecode = dump_bytecode(*script->m_codeblock);
+	ASSERT(is_bytecode(bytecode) and !is_bytecode(code), "Bytecode files are recognized.");
+
+	// Loading a file in another VM gives back the same code blocks.
+	VM loader;
+	Closure* const loaded = loader.load_bytecode("bytecode.vyc", bytecode);
+	ASSERT(loaded != nullptr and dump_bytecode(*loaded->m_codeblock) == bytecode,
+		   "Bytecode round trips through a VM.");
+
+	VM runner;
+	runner.load_stdlib();
+	ASSERT(runner.runfile("bytecode.vyc", bytecode) == ExitCode::Success and
+			   runner.return_value == VYSE_INT(12),
+		   "Bytecode files run like the scripts they were compiled from.");
+
+	const auto load_error = [](std::string bytes) {
+		VM vm;
+		vm.on_error = [](VM&, RuntimeError error) { error_trace = error.message; };
+		error_trace.clear();
+		if (vm.load_bytecode("bad.vyc", bytes) != nullptr) return std::string{};
+		return error_trace;
+	};
+
+	ASSERT(load_error(bytecode.substr(0, bytecode.size() / 2)).find("unexpected end of file") !=
+			   std::string::npos,
+		   "Truncated bytecode files are not loaded.");
+
+	std::string other_version = bytecode;
+	other_version[BytecodeMagic.size()] ^= 0xff;
+	ASSERT(load_error(other_version).find("different version") != std::string::npos,
+		   "Bytecode files from other versions are not loaded.");
+	ASSERT(load_error(bytecode + '\0').find("end of the file") != std::string::npos,
+		   "Bytecode files with trailing data are not loaded.");
+	for (size_t size = 0; size < bytecode.size(); ++size) {
+		ASSERT(!load_error(bytecode.substr(0, size)).empty(), "Truncated files never load.");
+	}
+
+	// The implicit `return nil` at the end of a function is counted in it's stack size.
+	for (const char* const source : {"", "let x = 1 let y = 2"}) {
+		Closure* const script = vm.compile(SourceCode{"implicit-return.vy", source});
+		ASSERT(script != nullptr, "Scripts compile.");
+		ASSERT(load_error(dump_bytecode(*script->m_codeblock)).empty(),
+			   "Functions that return implicitly load.");
+	}
+
+	// Every operand is checked when a file is loaded, so a corrupted file is an error rather than
+	// a crash once it runs.
+	Closure* const loop = vm.compile(
+		SourceCode{"loop.vy", "let t = 0 for i = 1, 10 { if i > 5 { t = t + i } } return t"});
+	ASSERT(loop != nullptr, "Scripts compile.");
+	const Block& block = loop->m_codeblock->block();
+	const std::string loop_bytecode = dump_bytecode(*loop->m_codeblock);
+	const size_t code_start = loop_bytecode.find(
+		std::string{reinterpret_cast<const char*>(block.code.data()), block.code.size()});
+	ASSERT(code_start != std::string::npos, "Code is stored as it is.");
+
+	// Sets the byte at [offset] from the instruction [op] to [value], and loads the file.
+	const auto corrupt = [&](Opcode op, size_t offset, u8 value) {
+		size_t i = 0;
+		while (block.code[i] != op) i += 1 + Compiler::op_arity(block, i);
+		std::string bytes = loop_bytecode;
+		bytes[code_start + i + offset] = char(value);
+		return load_error(bytes);
+	};
+
+	ASSERT(corrupt(Opcode::gt_var_const_jmp, 2, 0xff).find("invalid constant") != std::string::npos,
+		   "Constant indices are checked.");
+	ASSERT(corrupt(Opcode::gt_var_const_jmp, 1, 0xf0).find("invalid local") != std::string::npos,
+		   "Local slots are checked.");
+	ASSERT(corrupt(Opcode::gt_var_const_jmp, 3, u8(Opcode::jmp)).find("invalid instruction") !=
+			   std::string::npos,
+		   "Fused instructions are followed by their jump.");
+	ASSERT(corrupt(Opcode::for_prep, 1, 0xff).find("invalid jump") != std::string::npos,
+		   "Jump targets are checked.");
+	ASSERT(corrupt(Opcode::add, 0, u8(Opcode::subscript_set)).find("stack depth") !=
+			   std::string::npos,
+		   "The depth of the stack is checked.");
+
+	for (size_t i = 0; i < loop_bytecode.size(); ++i) {
+		std::string bytes = loop_bytecode;
+		bytes[i] ^= 0x5a;
+		// Whatever loads has passed every check, so it would be safe to run.
+		load_error(bytes);
+	}
+
+	std::cout << "[Bytecode tests passed]\n";
+}
+
+static void compile_cache_test() {
+	namespace fs = std::filesystem;
+	const fs::path dir = fs::temp_directory_path() / "vyse-compile-cache-test";
+	fs::remove_all(dir);
+	fs::create_directories(dir);
+
+	const auto write = [&](const char* name, const char* code) {
+		std::ofstream{dir / name} << code;
+	};
+	write("main.vy", "const m = import(\"./mod.vy\")  return m.f(20)");
+	write("mod.vy", "return { f: fn (x) { return x + 22 } }");
+
+	VMConfig config;
+	config.compile_cache = (dir / "cache").string();
+	const auto run = [&](Value expected) {
+		VM vm{config};
+		vm.load_stdlib();
+		ASSERT(vm.runfile((dir / "main.vy").string()) == ExitCode::Success,
+			   "Scripts run with a compile cache.");
+		assert_val_eq(expected, vm.return_value, "Cached modules give the same results.");
+		return vm.dynloader.compile_cache_stats();
+	};
+
+	CompileCacheStats stats = run(NUM(42));
+	ASSERT(stats.hits == 0 and stats.misses == 1 and stats.writes == 1,
+		   "Modules are compiled and written to the cache the first time they are imported.");
+	stats = run(NUM(42));
+	ASSERT(stats.hits == 1 and stats.misses == 0, "Modules are loaded from the cache afterwards.");
+
+	write("mod.vy", "return { f: fn (x) { return x * 2 } }");
+	stats = run(NUM(40));
+	ASSERT(stats.misses == 1 and stats.writes == 1, "Modules are compiled again when they change.");
+
+	// Files in the cache that can't be loaded are replaced.
+	for (const auto& entry : fs::directory_iterator(dir / "cache")) {
+		std::ofstream{entry.path(), std::ios::binary} << BytecodeImageMagic << "broken";
+	}
+	stats = run(NUM(40));
+	ASSERT(stats.misses == 1 and stats.writes == 1, "Broken cache files are ignored.");
+	stats = run(NUM(40));
+	ASSERT(stats.hits == 1, "Broken cache files are replaced.");
+
+	// So are files that were corrupted after they were written.
+	for (const auto& entry : fs::directory_iterator(dir / "cache")) {
+		std::fstream file{entry.path(), std::ios::binary | std::ios::in | std::ios::out};
+		file.seekg(-1, std::ios::end);
+		const char last = char(file.get());
+		file.seekp(-1, std::ios::end);
+		file.put(char(last ^ 0x5a));
+	}
+	stats = run(NUM(40));
+	ASSERT(stats.hits == 0 and stats.misses == 1 and stats.writes == 1,
+		   "Corrupted cache files are ignored.");
+	stats = run(NUM(40));
+	ASSERT(stats.hits == 1, "Corrupted cache files are replaced.");
+
+	fs::remove_all(dir);
+	std::cout << "[Compile cache tests passed]\n";
+}
+
+static void image_test() {
+	namespace fs = std::filesystem;
+	const fs::path path = fs::temp_directory_path() / "vyse-image-test.vyi";
+	const char* const code = R"(
+		outer = fn () { return fn () { return "inner" } }
+		let total = 0
+		for i = 0, 100 { total = total + i * 2 }
+		return total
+	)";
+
+	VM compiler;
+	Closure* const script = compiler.compile(SourceCode{"image.vy", code});
+	ASSERT(script != nullptr, "Scripts compile.");
+	const std::string image = dump_image(*script->m_codeblock);
+	ASSERT(is_bytecode_image(image) and !is_bytecode(image), "Bytecode images are recognized.");
+	std::ofstream{path, std::ios::binary} << image;
+
+	VM vm;
+	vm.load_stdlib();
+	ASSERT(vm.runfile(path.string()) == ExitCode::Success and vm.return_value == VYSE_INT(9900),
+		   "Bytecode images run like the scripts they were compiled from.");
+
+	const CodeBlock& outer = *VYSE_AS_CLOSURE(vm.get_global("outer"))->m_codeblock;
+	ASSERT(outer.block().code.is_external() and outer.block().lines.is_external(),
+		   "Functions in images run their code in place.");
+	const CodeBlock& inner = *VYSE_AS_PROTO(outer.block().constant_pool[0]);
+	ASSERT(inner.is_pending(), "Functions are loaded when their first closure is made.");
+	ASSERT(vm.runcode("return outer()()") == ExitCode::Success and !inner.is_pending(),
+		   "Pending functions are loaded.");
+	ASSERT(VYSE_IS_STRING(vm.return_value) and
+			   std::string{VYSE_AS_STRING(vm.return_value)->c_str()} == "inner",
+		   "The constants of pending functions are loaded with them.");
+
+	std::ifstream file{path, std::ios::binary};
+	std::ostringstream contents;
+	contents << file.rdbuf();
+	ASSERT(contents.str() == image, "Running an image doesn't change it.");
+
+	const auto load_error = [&](std::string bytes) {
+		std::ofstream{path, std::ios::binary} << bytes;
+		VM vm;
+		vm.on_error = [](VM&, RuntimeError error) { error_trace = error.message; };
+		error_trace.clear();
+		return vm.runfile(path.string()) == ExitCode::CompileError ? error_trace : "";
+	};
+
+	ASSERT(load_error(image.substr(0, image.size() - 1)).find("unexpected end of file") !=
+			   std::string::npos,
+		   "Truncated images are not loaded.");
+	std::string other_version = image;
+	other_version[BytecodeImageMagic.size()] ^= 0xff;
+	ASSERT(load_error(other_version).find("different version") != std::string::npos,
+		   "Images from other versions are not loaded.");
+
+	// The code of every block is verified when the image is opened, like in bytecode files.
+	const Block& block = script->m_codeblock->block();
+	const size_t code_start = image.find(
+		std::string{reinterpret_cast<const char*>(block.code.data()), block.code.size()});
+	ASSERT(code_start != std::string::npos, "Code is stored as it is.");
+	size_t for_prep = 0;
+	while (block.code[for_prep] != Opcode::for_prep) {
+		for_prep += 1 + Compiler::op_arity(block, for_prep);
+	}
+	std::string bad_jump = image;
+	bad_jump[code_start + for_prep + 1] = char(0xff);
+	ASSERT(load_error(bad_jump).find("checksum mismatch") != std::string::npos,
+		   "Corrupted images are not loaded.");
+
+	// Updates the checksum of a corrupted image, which is the FNV-1a hash of the bytes after the
+	// 40 byte header, and is stored after the magic and 4 other fields.
+	const auto reseal = [](std::string bytes) {
+		constexpr size_t HeaderSize = 40, ChecksumOffset = 20;
+		u32 hash = 2166136261u;
+		for (size_t i = HeaderSize; i < bytes.size(); ++i) hash = (hash ^ u8(bytes[i])) * 16777619u;
+		std::memcpy(&bytes[ChecksumOffset], &hash, sizeof(hash));
+		return bytes;
+	};
+	ASSERT(load_error(reseal(image)).empty(), "Resealed images load.");
+	ASSERT(load_error(reseal(bad_jump)).find("invalid jump") != std::string::npos,
+		   "Jump targets in images are checked.");
+
+	for (size_t i = 0; i < image.size(); ++i) {
+		std::string bytes = image;
+		bytes[i] ^= 0x5a;
+		std::string error;
+		// Whatever opens has passed every check, so it would be safe to run.
+		BytecodeImage::from_bytes(reseal(bytes), error);
+	}
+
+	fs::remove(path);
+	std::cout << "[Bytecode image tests passed]\n";
 }
 
 int main() {
-	expr_tests();
-	stmt_tests();
-	fn_tests();
-	table_test();
+	// The tests that only run programs check that both tiers give the same results.
+	for (const Tier tier : {Tier::Stack, Tier::Register}) {
+		test_tier = tier;
+		expr_tests();
+		stmt_tests();
+		fn_tests();
+		table_test();
+		string_test();
+		loop_test();
+		negative_tests();
+	}
+
+	test_tier = Tier::Stack;
 	global_test();
-	string_test();
-	loop_test();
 	multiple_runs_test();
-	negative_tests();
+	inline_cache_test();
+	quickening_test();
+	fused_ops_test();
+	superinstruction_test();
+	register_tier_test();
+	tail_call_test();
+	vararg_test();
+	fast_native_test();
+	bind_test();
+	prepared_call_test();
+	jit_test();
+	bytecode_test();
+	image_test();
+	compile_cache_test();
 	return 0;
 }